@@ -0,0 +1,253 @@
+// Benchmark and accuracy suite for the map builders.
+//
+// Drives the public bridge API against the synthetic calibrations in
+// synthetic-lenses.xml (poly3, poly5, ptlens and ACM distortion, linear and
+// poly3 TCA, pa vignetting, plus a zoom interpolated between two focals).
+// Each module (lfw_bench_<module>.cpp) checks one part of the bridge against
+// properties any correct implementation keeps; see the comment at the top of
+// each file. --module runs only the named modules, which is how ctest
+// registers each as its own test.
+//
+// With --golden the maps are also compared against stored reference maps, and with --baseline the throughput
+// of each case is compared against recorded numbers. Any failed check makes
+// the exit status non-zero.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+namespace
+{
+using namespace lfw_bench;
+
+struct Module
+{
+    const char *name;
+    void (*run)(Suite &suite);
+};
+
+// In the order they run; the database modules replace the loaded database.
+const Module kModules[] = {
+    {"maps", run_maps},
+    {"tiles", run_tiles},
+    {"descriptor", run_descriptor},
+    {"normalized", run_normalized},
+    {"crop", run_crop},
+    {"thumbnail", run_thumbnail},
+    {"cfa", run_cfa},
+    {"fixed", run_fixed},
+    {"jobs", run_jobs},
+    {"blob", run_blob},
+    {"step", run_step},
+    {"batch", run_batch},
+    {"zoom", run_zoom},
+    {"prune", run_prune},
+    {"compact", run_compact},
+    {"cache", run_cache},
+#if LFW_ENABLE_DB_PACK
+    {"pack", run_pack},
+#endif
+};
+
+bool selected(const Options &options, const char *module)
+{
+    return options.modules.empty() ||
+           std::find(options.modules.begin(), options.modules.end(), module) != options.modules.end();
+}
+
+// Baseline files hold one "<case> <Mpoints/s>" pair per line.
+bool read_baseline(const char *path, std::map<std::string, double> *baseline)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    char name[256];
+    double value = 0.0;
+    while (fscanf(file, "%255s %lf", name, &value) == 2)
+    {
+        (*baseline)[name] = value;
+    }
+    fclose(file);
+    return true;
+}
+
+bool write_baseline(const char *path, const std::map<std::string, double> &measured)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    for (const auto &entry : measured)
+    {
+        fprintf(file, "%s %.3f\n", entry.first.c_str(), entry.second);
+    }
+    return fclose(file) == 0;
+}
+
+void usage()
+{
+    fprintf(
+        stderr,
+        "usage: lfw_bench [--data FILE] [--quick] [--min-seconds S] [--module NAME]...\n"
+        "                 [--golden DIR] [--record-golden DIR] [--tolerance PX] [--gain-tolerance G]\n"
+        "                 [--baseline FILE] [--record-baseline FILE] [--max-slowdown FRACTION]\n");
+}
+
+bool parse_options(int argc, char **argv, Options *options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--quick") == 0)
+        {
+            options->quick = true;
+            options->min_seconds = 0.02;
+            continue;
+        }
+        if (!value)
+        {
+            return false;
+        }
+
+        if (strcmp(arg, "--data") == 0)
+        {
+            options->data = value;
+        }
+        else if (strcmp(arg, "--golden") == 0)
+        {
+            options->golden = value;
+        }
+        else if (strcmp(arg, "--record-golden") == 0)
+        {
+            options->record_golden = value;
+        }
+        else if (strcmp(arg, "--module") == 0)
+        {
+            options->modules.push_back(value);
+        }
+        else if (strcmp(arg, "--baseline") == 0)
+        {
+            options->baseline = value;
+        }
+        else if (strcmp(arg, "--record-baseline") == 0)
+        {
+            options->record_baseline = value;
+        }
+        else if (strcmp(arg, "--tolerance") == 0)
+        {
+            options->tolerance = static_cast<float>(atof(value));
+        }
+        else if (strcmp(arg, "--gain-tolerance") == 0)
+        {
+            options->gain_tolerance = static_cast<float>(atof(value));
+        }
+        else if (strcmp(arg, "--max-slowdown") == 0)
+        {
+            options->max_slowdown = static_cast<float>(atof(value));
+        }
+        else if (strcmp(arg, "--min-seconds") == 0)
+        {
+            options->min_seconds = atof(value);
+        }
+        else
+        {
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Suite suite;
+    if (!parse_options(argc, argv, &suite.options))
+    {
+        usage();
+        return 2;
+    }
+
+    const Options &options = suite.options;
+    for (const std::string &name : options.modules)
+    {
+        const bool known = std::any_of(
+            std::begin(kModules), std::end(kModules), [&](const Module &module) { return name == module.name; });
+        if (!known)
+        {
+            fprintf(stderr, "lfw_bench: unknown module %s\n", name.c_str());
+            return 2;
+        }
+    }
+
+    if (options.baseline && !read_baseline(options.baseline, &suite.baseline))
+    {
+        fprintf(stderr, "lfw_bench: cannot read baseline %s\n", options.baseline);
+        return 2;
+    }
+
+    if (options.record_golden && mkdir(options.record_golden, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "lfw_bench: cannot create %s\n", options.record_golden);
+        return 2;
+    }
+
+    const int32_t rc = lfw_init(options.data);
+    if (rc != 0)
+    {
+        fprintf(stderr, "lfw_bench: lfw_init(%s) failed with code %d\n", options.data, rc);
+        return 2;
+    }
+
+    printf("tolerance %g px, gain tolerance %g, max slowdown %.0f%%\n",
+           options.tolerance,
+           options.gain_tolerance,
+           options.max_slowdown * 100.0);
+
+    suite.size_count = options.quick ? kQuickSizes : static_cast<int>(sizeof(kSizes) / sizeof(kSizes[0]));
+    for (const LensCase &lens : kLenses)
+    {
+        const uint32_t handle = find_lens_handle("LFW Synthetic", lens.model);
+        if (handle == 0)
+        {
+            printf("%s: lens \"%s\" not found\n", lens.slug, lens.model);
+            ++suite.failures;
+            continue;
+        }
+        suite.lenses.push_back({&lens, handle});
+    }
+
+    for (const Module &module : kModules)
+    {
+        if (selected(options, module.name))
+        {
+            module.run(suite);
+        }
+    }
+
+    lfw_dispose();
+
+    if (options.record_baseline && !write_baseline(options.record_baseline, suite.measured))
+    {
+        fprintf(stderr, "lfw_bench: cannot write baseline %s\n", options.record_baseline);
+        ++suite.failures;
+    }
+
+    printf("%d case(s), %d failure(s)\n", suite.cases, suite.failures);
+    return suite.failures == 0 ? 0 : 1;
+}
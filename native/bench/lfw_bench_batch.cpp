@@ -0,0 +1,296 @@
+// Batch module: a correction batch must build each distinct map once, equal
+// to the maps built alone, and remap a coordinate ramp back onto the geometry
+// map, also past the last samples of a grid that stops short of the edges,
+// and keep to the database it was created with.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace lfw_bench
+{
+namespace
+{
+// An RGB image whose pixels hold their own (x, y, 0) coordinates.
+std::vector<float> coordinate_ramp(const ImageSize &size)
+{
+    std::vector<float> ramp(static_cast<size_t>(size.width) * size.height * 3);
+    for (int y = 0; y < size.height; ++y)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            float *pixel = &ramp[(static_cast<size_t>(y) * size.width + x) * 3];
+            pixel[0] = static_cast<float>(x);
+            pixel[1] = static_cast<float>(y);
+            pixel[2] = 0.0f;
+        }
+    }
+    return ramp;
+}
+
+// Six items share one set of parameters and two more differ only in an
+// aperture their corrections ignore, so the batch must build two groups.
+void batch_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/batch";
+    const int items = 8;
+    const int shared = 6;
+    const int32_t all_mods = kModifyDistortion | kModifyTca | kModifyVignetting;
+    ++suite.cases;
+
+    Map maps[3];
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    // What an exporter without the batch does: every item builds its maps.
+    const auto items_start = std::chrono::steady_clock::now();
+    int32_t map_rc = 0;
+    for (int i = 0; i < items && map_rc == 0; ++i)
+    {
+        for (int k = 0; k < (i < shared ? 3 : 1) && map_rc == 0; ++k)
+        {
+            map_rc = build_map(builders[k], handle, lens.focal, size, 1, false, &maps[k]);
+        }
+    }
+    const double items_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - items_start).count();
+    if (map_rc != 0)
+    {
+        printf("%s reference build failed\n", name.c_str());
+        ++suite.failures;
+        return;
+    }
+
+    const auto add_items = [&](uint32_t batch) {
+        for (int i = 0; i < items; ++i)
+        {
+            const bool all = i < shared;
+            lfw_batch_add(batch,
+                          handle,
+                          lens.focal,
+                          kCrop,
+                          all ? kAperture : 4.0f + static_cast<float>(i),
+                          kDistance,
+                          size.width,
+                          size.height,
+                          0,
+                          1,
+                          all ? all_mods : kModifyDistortion);
+        }
+    };
+
+    const uint32_t batch = static_cast<uint32_t>(std::max(lfw_batch_create(), 0));
+    add_items(batch);
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t groups = lfw_batch_run(batch, 1);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double error = 0.0;
+    bool complete = groups > 0;
+    for (int i = 0; i < items && complete; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const float *map = lfw_batch_map(batch, i, k);
+            if (!map != (i >= shared && k > 0))
+            {
+                complete = false;
+                break;
+            }
+            if (map)
+            {
+                Map got = maps[k];
+                std::copy(map, map + got.data.size(), got.data.begin());
+                error = std::max(error, max_abs_diff(got, maps[k]));
+            }
+        }
+    }
+    const bool grouped = lfw_batch_item_group(batch, 0) == lfw_batch_item_group(batch, shared - 1) &&
+                         lfw_batch_item_group(batch, shared) == lfw_batch_item_group(batch, items - 1) &&
+                         lfw_batch_item_group(batch, 0) != lfw_batch_item_group(batch, items - 1);
+    lfw_batch_destroy(batch);
+    if (!complete)
+    {
+        printf("%s failed with code %d\n", name.c_str(), groups);
+        ++suite.failures;
+        return;
+    }
+
+    // Every item with pixels, the distortion-only ones holding their own
+    // coordinates, on a pool of four.
+    const size_t floats = static_cast<size_t>(size.width) * size.height * 3;
+    const std::vector<float> ramp = coordinate_ramp(size);
+    std::vector<std::vector<float>> outputs(items, std::vector<float>(floats, 0.0f));
+    const uint32_t remap_batch = static_cast<uint32_t>(std::max(lfw_batch_create(), 0));
+    add_items(remap_batch);
+    for (int i = 0; i < items; ++i)
+    {
+        lfw_batch_set_pixels(remap_batch, i, ramp.data(), outputs[i].data(), 3);
+    }
+    const auto remap_start = std::chrono::steady_clock::now();
+    const int32_t remap_rc = lfw_batch_run(remap_batch, 4);
+    const double remap_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - remap_start).count();
+    lfw_batch_destroy(remap_batch);
+
+    double worst = 0.0;
+    const Map &geometry = maps[0];
+    for (int i = shared; i < items; ++i)
+    {
+        for (int y = 0; y < geometry.gy; ++y)
+        {
+            for (int x = 0; x < geometry.gx; ++x)
+            {
+                const float *expected = geometry.at(x, y);
+                if (expected[0] < 0.0f || expected[1] < 0.0f || expected[0] > size.width - 1 ||
+                    expected[1] > size.height - 1)
+                {
+                    continue;
+                }
+                const float *got = &outputs[i][(static_cast<size_t>(y) * size.width + x) * 3];
+                worst = std::max(worst, static_cast<double>(std::hypot(got[0] - expected[0], got[1] - expected[1])));
+            }
+        }
+    }
+
+    const double mpixels = static_cast<double>(size.width) * size.height * items / remap_seconds / 1e6;
+    printf("%-44s %d groups of %d items, maps %.3f of per-item builds, remap %.5f px %9.2f Mpx/s\n",
+           name.c_str(),
+           groups,
+           items,
+           seconds / std::max(items_seconds, 1e-9),
+           worst,
+           mpixels);
+    if (groups != 2 || !grouped)
+    {
+        fail(suite, "batch built %g groups, expected %g", groups, 2);
+    }
+    if (error > suite.options.tolerance)
+    {
+        fail(suite, "batch maps off by %g (tolerance %g)", error, suite.options.tolerance);
+    }
+    if (remap_rc != groups || worst > suite.options.tolerance)
+    {
+        fail(suite, "batch remap off by %g (tolerance %g)", worst, suite.options.tolerance);
+    }
+}
+
+// Unless (size - 1) is a multiple of the step, the grid's last samples stop
+// short of the right and bottom edges. A remap of the coordinate ramp must
+// follow the geometry map past them as closely as it does between samples.
+void batch_edge_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = {kSizes[0].width + 6, kSizes[0].height + 6};
+    const int step = 8;
+    const std::string name = std::string(lens.slug) + "/batch-edge";
+    ++suite.cases;
+
+    Map exact;
+    if (build_map(Builder::Geometry, handle, lens.focal, size, 1, false, &exact) != 0)
+    {
+        printf("%s reference build failed\n", name.c_str());
+        ++suite.failures;
+        return;
+    }
+
+    const std::vector<float> ramp = coordinate_ramp(size);
+    std::vector<float> output(ramp.size(), 0.0f);
+    const uint32_t batch = static_cast<uint32_t>(std::max(lfw_batch_create(), 0));
+    lfw_batch_add(
+        batch, handle, lens.focal, kCrop, kAperture, kDistance, size.width, size.height, 0, step, kModifyDistortion);
+    lfw_batch_set_pixels(batch, 0, ramp.data(), output.data(), 3);
+    const int32_t rc = lfw_batch_run(batch, 1);
+    lfw_batch_destroy(batch);
+    if (rc != 1)
+    {
+        printf("%s failed with code %d\n", name.c_str(), rc);
+        ++suite.failures;
+        return;
+    }
+
+    const int last_x = (grid_points(size.width, step) - 1) * step;
+    const int last_y = (grid_points(size.height, step) - 1) * step;
+    double between = 0.0;
+    double past = 0.0;
+    for (int y = 0; y < size.height; ++y)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            // Sources within a pixel of the border may fall outside it
+            // after interpolation, and come out black.
+            const float *expected = exact.at(x, y);
+            if (expected[0] < 1.0f || expected[1] < 1.0f || expected[0] > size.width - 2 ||
+                expected[1] > size.height - 2)
+            {
+                continue;
+            }
+            const float *got = &output[(static_cast<size_t>(y) * size.width + x) * 3];
+            const double error = std::hypot(got[0] - expected[0], got[1] - expected[1]);
+            double &worst = x > last_x || y > last_y ? past : between;
+            worst = std::max(worst, error);
+        }
+    }
+
+    printf("%-44s step %d, %d px past the last sample: off by %.5f px, between samples %.5f px\n",
+           name.c_str(),
+           step,
+           size.width - 1 - last_x,
+           past,
+           between);
+    // Bilinear error grows as t (t - 1) along a cell, t its fraction; the
+    // worst between samples is at t = 1/2. Clamping instead would be off by
+    // about the distance past the last sample.
+    const double t = 1.0 + static_cast<double>(std::max(size.width - 1 - last_x, size.height - 1 - last_y)) / step;
+    const double limit = 2.0 * 4.0 * t * (t - 1.0) * between + suite.options.tolerance;
+    if (past > limit)
+    {
+        fail(suite, "pixels past the last sample off by %g (limit %g)", past, limit);
+    }
+}
+
+// A batch resolves its lenses through the database it was created with, even
+// when the context has since loaded another one, and cannot be created
+// without a database.
+void batch_database_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const std::string name = std::string(lens.slug) + "/batch-database";
+    ++suite.cases;
+    const uint32_t batch = static_cast<uint32_t>(std::max(lfw_batch_create(), 0));
+    const uint32_t context = lfw_context_create();
+    lfw_context_bind(context);
+    lfw_dispose();
+    const int32_t orphan = lfw_batch_create();
+    const bool reloaded = lfw_init(suite.options.data) == 0;
+    const uint32_t other = find_lens_handle("LFW Synthetic", lens.model);
+    const int32_t own = lfw_batch_add(
+        batch, handle, lens.focal, kCrop, kAperture, kDistance, 64, 48, 0, 8, kModifyDistortion);
+    const int32_t foreign = lfw_batch_add(
+        batch, other, lens.focal, kCrop, kAperture, kDistance, 64, 48, 0, 8, kModifyDistortion);
+    const int32_t groups = lfw_batch_run(batch, 1);
+    lfw_context_bind(0);
+    lfw_context_destroy(context);
+    lfw_batch_destroy(batch);
+
+    printf("%-44s own lens %d, other database's lens %d, no database %d\n", name.c_str(), own, foreign, orphan);
+    if (!reloaded || batch == 0 || other == 0 || other == handle || own != 0 || foreign != -1 || groups != 1 ||
+        orphan != -1)
+    {
+        fail(suite, "batch resolved lenses outside its database (%g, expected %g)", 1.0, 0.0);
+    }
+}
+} // namespace
+
+void run_batch(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        batch_case(suite, *lens.lens, lens.handle);
+        batch_edge_case(suite, *lens.lens, lens.handle);
+        batch_database_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,124 @@
+// Map blob module: blobs must import back to the exported map and reject
+// damaged, outdated or foreign data, and blobs of another map.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace lfw_bench
+{
+namespace
+{
+void map_blob_case(Suite &suite, const LensCase &lens, uint32_t handle, Builder builder)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/map-blob-" + builder_name(builder);
+    const int32_t kind = static_cast<int32_t>(builder);
+    ++suite.cases;
+    Map map;
+    const double build_seconds = time_build(builder, handle, lens.focal, size, 1, suite.options.min_seconds, &map);
+    const int32_t bytes = lfw_map_blob_size(kind, handle, size.width, size.height, 1);
+    if (build_seconds < 0.0 || bytes <= 0)
+    {
+        printf("%s reference build failed\n", name.c_str());
+        ++suite.failures;
+        return;
+    }
+
+    std::vector<uint8_t> blob(static_cast<size_t>(bytes));
+    const int32_t written = lfw_map_blob_export(
+        kind, handle, lens.focal, kCrop, kAperture, kDistance, size.width, size.height, 0, 1, blob.data(), bytes);
+    // Imports `data` expecting the exported map, or the same map at `focal`.
+    const auto import = [&](const std::vector<uint8_t> &data, float focal, float *out, int32_t out_len) {
+        return lfw_map_blob_import(data.data(),
+                                   static_cast<int32_t>(data.size()),
+                                   kind,
+                                   handle,
+                                   focal,
+                                   kCrop,
+                                   kAperture,
+                                   kDistance,
+                                   size.width,
+                                   size.height,
+                                   0,
+                                   1,
+                                   out,
+                                   out_len);
+    };
+    Map imported = map;
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t rc = import(blob, lens.focal, imported.data.data(), static_cast<int32_t>(imported.data.size()));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (written != bytes || rc != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), written != bytes ? written : rc);
+        ++suite.failures;
+        return;
+    }
+    const double error = max_abs_diff(imported, map);
+
+    // Each damaged copy must be turned away with its own code.
+    const auto damaged = [&](size_t offset, size_t len) {
+        std::vector<uint8_t> copy(blob.begin(), blob.begin() + len);
+        if (offset < len)
+        {
+            copy[offset] ^= 0x01;
+        }
+        return import(copy, lens.focal, nullptr, 0);
+    };
+    const int32_t truncated = damaged(blob.size(), blob.size() - 4);
+    const int32_t version = damaged(4, blob.size());
+    const int32_t database = damaged(8, blob.size());
+    const int32_t payload = damaged(blob.size() - 1, blob.size());
+    // An unknown kind with no channels and no map floats, which only the
+    // header checks can turn away: past them it fails the payload hash, or
+    // with a forged hash would be accepted.
+    std::vector<uint8_t> unknown(blob.begin(), blob.end() - map.data.size() * sizeof(float));
+    const int32_t unknown_kind = 7;
+    const int32_t no_channels = 0;
+    memcpy(unknown.data() + 24, &unknown_kind, sizeof(unknown_kind));
+    memcpy(unknown.data() + 68, &no_channels, sizeof(no_channels));
+    const int32_t unknown_rc = import(unknown, lens.focal, nullptr, 0);
+    // An intact blob filed under another focal length.
+    const int32_t other_map = import(blob, lens.focal + 1.0f, nullptr, 0);
+
+    printf("%-44s max error %.2e, import %.3f of a build, %d KiB\n",
+           name.c_str(),
+           error,
+           seconds / std::max(build_seconds, 1e-9),
+           bytes / 1024);
+    if (error != 0.0)
+    {
+        fail(suite, "imported map off by %g (tolerance %g)", error, 0.0);
+    }
+    const int32_t codes[][2] = {
+        {truncated, -1}, {version, -3}, {database, -5}, {payload, -4}, {unknown_rc, -1}, {other_map, -7}};
+    for (const auto &code : codes)
+    {
+        if (code[0] != code[1])
+        {
+            fail(suite, "damaged or mismatched blob accepted or misreported (code %g, expected %g)", code[0], code[1]);
+            break;
+        }
+    }
+}
+} // namespace
+
+void run_blob(Suite &suite)
+{
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        for (Builder builder : builders)
+        {
+            map_blob_case(suite, *lens.lens, lens.handle, builder);
+        }
+    }
+}
+} // namespace lfw_bench
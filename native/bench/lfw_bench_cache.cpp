@@ -0,0 +1,106 @@
+// Table cache module: a focal scrub must keep the cached map tables within
+// their byte budget, and the table of a focal the editor keeps returning to
+// must survive the evictions.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// A zoom lens scrubbed across its range in steps far finer than the 1/100 mm
+// the calibrations are rounded to; the tables are keyed by the exact focal.
+const char *const kScrubModel = "Poly3 24-70mm f/2.8";
+constexpr float kScrubMin = 24.0f;
+constexpr float kScrubStep = 0.0137f;
+constexpr int kScrubFrames = 600;
+// Large enough that the tables of a scrub outgrow the budget several times.
+constexpr ImageSize kScrubSize = {6000, 4000};
+constexpr int kScrubGridStep = 256;
+// CalibrationCache::kTableBytes.
+constexpr double kTableBudget = 8.0 * 1024 * 1024;
+
+struct TableStats
+{
+    double hits = 0.0;
+    double misses = 0.0;
+    double entries = 0.0;
+    double bytes = 0.0;
+};
+
+TableStats table_stats(const char *kind)
+{
+    TableStats stats;
+    char *json = lfw_get_stats_json();
+    if (!json)
+    {
+        return stats;
+    }
+    const std::string text(json);
+    lfw_free(json);
+    const size_t section = text.find(std::string("\"") + kind + "\":", text.find("\"calibrationCache\":"));
+    stats.hits = json_number(text, "hits", section);
+    stats.misses = json_number(text, "misses", section);
+    stats.entries = json_number(text, "entries", section);
+    stats.bytes = json_number(text, "bytes", section);
+    return stats;
+}
+
+// Scrubs `builder` maps across the range, returning to `kScrubMin` between
+// frames. Every scrub frame must miss, the returns must hit after the first,
+// and the cache must evict tables rather than outgrow its budget.
+void scrub_case(Suite &suite, uint32_t handle, Builder builder, bool reverse, const char *kind)
+{
+    const std::string name = std::string("cache/") + kind;
+    ++suite.cases;
+    lfw_reset_stats();
+    Map map;
+    double peak_bytes = 0.0;
+    int failed = 0;
+    for (int frame = 0; frame < kScrubFrames; ++frame)
+    {
+        const float focal = kScrubMin + kScrubStep * static_cast<float>(frame + 1);
+        failed += build_map(builder, handle, focal, kScrubSize, kScrubGridStep, reverse, &map) != 0;
+        failed += build_map(builder, handle, kScrubMin, kScrubSize, kScrubGridStep, reverse, &map) != 0;
+        peak_bytes = std::max(peak_bytes, table_stats(kind).bytes);
+    }
+    const TableStats stats = table_stats(kind);
+
+    printf("%-44s %.0f tables in %.0f KiB after %d frames (peak %.0f KiB)\n",
+           name.c_str(),
+           stats.entries,
+           stats.bytes / 1024.0,
+           kScrubFrames,
+           peak_bytes / 1024.0);
+    if (failed != 0)
+    {
+        fail(suite, "%g map builds failed (expected %g)", static_cast<double>(failed), 0.0);
+    }
+    if (stats.entries <= 0.0 || stats.entries >= kScrubFrames)
+    {
+        fail(suite, "table cache holds %g tables after a scrub of %g", stats.entries, static_cast<double>(kScrubFrames));
+    }
+    if (peak_bytes > kTableBudget)
+    {
+        fail(suite, "table cache peaked at %g bytes (limit %g)", peak_bytes, kTableBudget);
+    }
+    if (stats.misses != kScrubFrames + 1 || stats.hits != kScrubFrames - 1)
+    {
+        fail(suite, "returning focal missed %g time(s) (expected %g)", stats.misses - kScrubFrames, 1.0);
+    }
+}
+} // namespace
+
+void run_cache(Suite &suite)
+{
+    const uint32_t handle = find_lens_handle("LFW Synthetic", kScrubModel);
+    scrub_case(suite, handle, Builder::Geometry, true, "reverseGeometry");
+    scrub_case(suite, handle, Builder::Geometry, false, "radialGeometry");
+    scrub_case(suite, handle, Builder::Vignetting, false, "radialVignetting");
+}
+} // namespace lfw_bench
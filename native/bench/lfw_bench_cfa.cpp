@@ -0,0 +1,90 @@
+// CFA module: vignetting on a Bayer mosaic must scale each photosite by the
+// vignetting map's gain.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// Every photosite of a flat Bayer mosaic must end up at black + (value -
+// black) * gain, rounded, with the gain read from the vignetting map.
+void cfa_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/cfa-vignetting";
+    const int black = 64;
+    const int white = 16383;
+    const uint16_t flat = 4000;
+    ++suite.cases;
+    Map gains;
+    const auto map_start = std::chrono::steady_clock::now();
+    const int32_t map_rc = build_map(Builder::Vignetting, handle, lens.focal, size, 1, false, &gains);
+    const double map_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - map_start).count();
+
+    std::vector<uint16_t> mosaic(static_cast<size_t>(size.width) * size.height, flat);
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t rc = lfw_cfa_vignetting(
+        handle,
+        lens.focal,
+        kCrop,
+        kAperture,
+        kDistance,
+        size.width,
+        size.height,
+        "RGGB",
+        2,
+        black,
+        white,
+        mosaic.data(),
+        0,
+        static_cast<int32_t>(mosaic.size()));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (rc != 0 || map_rc != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), rc != 0 ? rc : map_rc);
+        ++suite.failures;
+        return;
+    }
+
+    double worst = 0.0;
+    for (int y = 0; y < size.height; ++y)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            const int colour = (y % 2) + (x % 2);
+            const double expected =
+                std::min(black + (flat - black) * static_cast<double>(gains.at(x, y)[colour]), static_cast<double>(white));
+            worst = std::max(worst, std::fabs(mosaic[static_cast<size_t>(y) * size.width + x] - expected));
+        }
+    }
+
+    const double mpixels = static_cast<double>(size.width) * size.height / seconds / 1e6;
+    printf("%-44s max error %.3f DN %9.2f Mpx/s, time vs vignetting map %.3f\n",
+           name.c_str(),
+           worst,
+           mpixels,
+           seconds / std::max(map_seconds, 1e-9));
+    // Rounding to whole numbers moves each photosite by up to half a unit.
+    if (worst > 0.5 + 1e-3)
+    {
+        fail(suite, "CFA vignetting off by %g DN (tolerance %g)", worst, 0.5);
+    }
+}
+} // namespace
+
+void run_cfa(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        cfa_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,102 @@
+// Compaction module: a database whose documents are replaced over and over
+// must shed its retired records, keep its lens handles and build the same
+// maps as before.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+double database_count(const char *key)
+{
+    char *stats = lfw_get_stats_json();
+    if (!stats)
+    {
+        return -1.0;
+    }
+    const std::string text(stats);
+    lfw_free(stats);
+    return json_number(text, key, text.find("\"database\":"));
+}
+
+std::string content_hash()
+{
+    char *hash = lfw_db_content_hash();
+    const std::string text = hash ? hash : "";
+    lfw_free(hash);
+    return text;
+}
+} // namespace
+
+// Replaces one document kRounds times, then compacts. Replaces the loaded
+// database.
+void run_compact(Suite &suite)
+{
+    const char *name = "database/compacted";
+    constexpr int kOtherLenses = 20;
+    constexpr int kRounds = 10;
+    const ImageSize size = kSizes[0];
+    ++suite.cases;
+
+    lfw_dispose();
+    const std::string update = pruning_document(kOtherLenses);
+    bool loaded = lfw_init(suite.options.data) == 0;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        loaded = loaded && lfw_db_load_xml("update", update.c_str(), static_cast<int32_t>(update.size())) == 0;
+    }
+    const uint32_t handle = find_lens_handle("LFW Synthetic", kLenses[0].model);
+    const uint32_t updated = find_lens_handle("LFW Synthetic", "Kept 50mm f/2");
+    Map before;
+    if (!loaded || handle == 0 || updated == 0 ||
+        build_map(Builder::Geometry, handle, kLenses[0].focal, size, 4, false, &before) != 0)
+    {
+        printf("%s failed to load\n", name);
+        ++suite.failures;
+        return;
+    }
+
+    const double lenses = database_count("lenses");
+    const double retired = database_count("retiredLenses");
+    const std::string hash = content_hash();
+    // The threshold counts retired cameras too.
+    const double retired_cameras = database_count("retiredCameras");
+    const int32_t skipped = lfw_db_compact(static_cast<int32_t>(retired + retired_cameras) + 1);
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t compacted = lfw_db_compact(1);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Map after;
+    const bool rebuilt = build_map(Builder::Geometry, handle, kLenses[0].focal, size, 4, false, &after) == 0;
+    printf("%-44s %.0f retired of %.0f lenses dropped in %.3f ms\n",
+           name,
+           retired,
+           lenses + retired,
+           seconds * 1e3);
+    if (retired < (kRounds - 1) * (kOtherLenses + 1) || skipped != 0 || compacted != 1)
+    {
+        fail(suite, "compaction ran %g time(s) (expected %g)", skipped + compacted, 1.0);
+    }
+    if (database_count("retiredLenses") != 0 || database_count("lenses") != lenses || content_hash() != hash)
+    {
+        fail(suite, "compacted database holds %g retired lenses (expected %g), or different content",
+             database_count("retiredLenses"), 0.0);
+    }
+    if (find_lens_handle("LFW Synthetic", kLenses[0].model) != handle ||
+        find_lens_handle("LFW Synthetic", "Kept 50mm f/2") != updated)
+    {
+        fail(suite, "lens handles changed by compaction (%g, expected %g)", 1.0, 0.0);
+    }
+    if (!rebuilt || max_abs_diff(before, after) != 0.0)
+    {
+        fail(suite, "map after compaction differs by %g (expected %g)", rebuilt ? max_abs_diff(before, after) : -1.0,
+             0.0);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,110 @@
+// Valid crop module: crops found from border rays must agree with a scan of
+// the full geometry map.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// Floats written by lfw_valid_crop.
+constexpr int kValidCropFloats = 5;
+
+// The valid crop must hold only pixels the geometry map takes from inside the
+// image, and its fit must match the one found by scanning the whole map: the
+// smallest fit of a rectangle reaching an outside pixel.
+void valid_crop_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/valid-crop";
+    ++suite.cases;
+    float crop[kValidCropFloats];
+    const int32_t rc = lfw_valid_crop(
+        handle, lens.focal, kCrop, size.width, size.height, kModifyDistortion, crop, kValidCropFloats);
+    Map map;
+    const auto scan_start = std::chrono::steady_clock::now();
+    const int32_t map_rc = build_map(Builder::Geometry, handle, lens.focal, size, 1, false, &map);
+    const double scan_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - scan_start).count();
+    if (rc != 0 || map_rc != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), rc != 0 ? rc : map_rc);
+        ++suite.failures;
+        return;
+    }
+    // Best of repeated calls, like time_build.
+    double crop_seconds = 0.0;
+    double total = 0.0;
+    for (int runs = 0; runs == 0 || total < suite.options.min_seconds; ++runs)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        lfw_valid_crop(handle, lens.focal, kCrop, size.width, size.height, kModifyDistortion, crop, kValidCropFloats);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        crop_seconds = runs == 0 ? seconds : std::min(crop_seconds, seconds);
+        total += seconds;
+    }
+
+    const double cx = 0.5 * (size.width - 1);
+    const double cy = 0.5 * (size.height - 1);
+    const int x0 = static_cast<int>(crop[1]);
+    const int y0 = static_cast<int>(crop[2]);
+    const int x1 = x0 + static_cast<int>(crop[3]);
+    const int y1 = y0 + static_cast<int>(crop[4]);
+    const double slack = suite.options.tolerance;
+    double scan_fit = 1.0;
+    int outside = 0;
+    for (int y = 0; y < map.gy; ++y)
+    {
+        for (int x = 0; x < map.gx; ++x)
+        {
+            const float *p = map.at(x, y);
+            if (p[0] >= -slack && p[1] >= -slack && p[0] <= size.width - 1 + slack && p[1] <= size.height - 1 + slack)
+            {
+                continue;
+            }
+            scan_fit = std::min(scan_fit, std::max(std::fabs(x - cx) / cx, std::fabs(y - cy) / cy));
+            if (x >= x0 && x < x1 && y >= y0 && y < y1)
+            {
+                ++outside;
+            }
+        }
+    }
+
+    // A fit above 1 leaves the whole frame valid, which is all a scan of the
+    // frame can show.
+    const double fit = crop[0] > 0.0f ? std::min(1.0 / crop[0], 1.0) : 0.0;
+    const double error = std::fabs(fit - scan_fit) * std::max(cx, cy);
+    printf("%-44s scale %.5f, %dx%d, fit error %.2f px, %.1f us vs %.2f ms map scan\n",
+           name.c_str(),
+           crop[0],
+           static_cast<int>(crop[3]),
+           static_cast<int>(crop[4]),
+           error,
+           crop_seconds * 1e6,
+           scan_seconds * 1e3);
+    if (outside > 0)
+    {
+        fail(suite, "%g pixel(s) of the valid crop map outside the image (allowed %g)", outside, 0.0);
+    }
+    if (error > 1.0)
+    {
+        fail(suite, "valid crop fit off by %g px (tolerance %g)", error, 1.0);
+    }
+}
+} // namespace
+
+void run_crop(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        valid_crop_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
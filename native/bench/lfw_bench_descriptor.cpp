@@ -0,0 +1,107 @@
+// Descriptor module: maps evaluated from a correction descriptor must match
+// the built ones.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// Floats in a packed correction descriptor.
+constexpr int kDescriptorFloats = 26;
+
+void descriptor_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[1];
+    const int step = 4;
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (int reverse = 0; reverse < 2; ++reverse)
+    {
+        const std::string name = std::string(lens.slug) + (reverse ? "/descriptor-reverse" : "/descriptor");
+        ++suite.cases;
+        float descriptor[kDescriptorFloats];
+        const int32_t rc = lfw_correction_descriptor(
+            handle,
+            lens.focal,
+            kCrop,
+            kAperture,
+            kDistance,
+            size.width,
+            size.height,
+            reverse,
+            descriptor,
+            kDescriptorFloats);
+        if (rc != kDescriptorFloats)
+        {
+            printf("%s failed with code %d\n", name.c_str(), rc);
+            ++suite.failures;
+            continue;
+        }
+
+        double errors[3] = {};
+        for (Builder builder : builders)
+        {
+            Map built;
+            Map evaluated;
+            evaluated.gx = grid_points(size.width, step);
+            evaluated.gy = grid_points(size.height, step);
+            evaluated.channels = builder_channels(builder);
+            evaluated.data.assign(static_cast<size_t>(evaluated.gx) * evaluated.gy * evaluated.channels, 0.0f);
+            const int index = static_cast<int>(builder);
+            const int32_t built_rc = build_map(builder, handle, lens.focal, size, step, reverse != 0, &built);
+            const int32_t evaluated_rc = lfw_descriptor_build_map(
+                descriptor,
+                kDescriptorFloats,
+                index,
+                step,
+                evaluated.data.data(),
+                static_cast<int32_t>(evaluated.data.size()));
+            if (built_rc != evaluated_rc)
+            {
+                printf("%s/%s: builder code %d, descriptor code %d\n",
+                       name.c_str(),
+                       builder_name(builder),
+                       built_rc,
+                       evaluated_rc);
+                ++suite.failures;
+                continue;
+            }
+            if (built_rc != 0)
+            {
+                continue;
+            }
+            errors[index] = max_abs_diff(built, evaluated);
+        }
+
+        printf("%-44s %d bytes, max error %.5f px / %.5f px / %.7f gain\n",
+               name.c_str(),
+               kDescriptorFloats * static_cast<int>(sizeof(float)),
+               errors[0],
+               errors[1],
+               errors[2]);
+        for (Builder builder : builders)
+        {
+            const double tolerance =
+                builder == Builder::Vignetting ? suite.options.gain_tolerance : suite.options.tolerance;
+            if (errors[static_cast<int>(builder)] > tolerance)
+            {
+                fail(suite, "descriptor map differs by %g (tolerance %g)", errors[static_cast<int>(builder)], tolerance);
+            }
+        }
+    }
+}
+} // namespace
+
+void run_descriptor(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        descriptor_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,166 @@
+// Fixed-point module: RGBA8 remaps must stay within a level or two of a
+// float bilinear remap through the same geometry or TCA map.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace lfw_bench
+{
+namespace
+{
+// Bilinear RGBA8 sample at (sx, sy) in float, clamped to the image like the
+// fixed-point sampler.
+void sample_rgba(const std::vector<uint8_t> &image, const ImageSize &size, float sx, float sy, float *out)
+{
+    sx = std::min(std::max(sx, 0.0f), static_cast<float>(size.width - 1));
+    sy = std::min(std::max(sy, 0.0f), static_cast<float>(size.height - 1));
+    const int ix = std::min(static_cast<int>(sx), size.width - 1);
+    const int iy = std::min(static_cast<int>(sy), size.height - 1);
+    const int ix1 = std::min(ix + 1, size.width - 1);
+    const int iy1 = std::min(iy + 1, size.height - 1);
+    const float fx = sx - static_cast<float>(ix);
+    const float fy = sy - static_cast<float>(iy);
+    const uint8_t *p00 = &image[(static_cast<size_t>(iy) * size.width + ix) * 4];
+    const uint8_t *p01 = &image[(static_cast<size_t>(iy) * size.width + ix1) * 4];
+    const uint8_t *p10 = &image[(static_cast<size_t>(iy1) * size.width + ix) * 4];
+    const uint8_t *p11 = &image[(static_cast<size_t>(iy1) * size.width + ix1) * 4];
+    for (int c = 0; c < 4; ++c)
+    {
+        const float top = p00[c] + (p01[c] - p00[c]) * fx;
+        const float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+        out[c] = top + (bottom - top) * fy;
+    }
+}
+
+// The float path a fixed map replaces: bilinear through the float map, with
+// points outside the image written as 0.
+void remap_float(const Map &map, const ImageSize &size, const std::vector<uint8_t> &src, std::vector<float> *dst)
+{
+    const float max_x = static_cast<float>(size.width - 1);
+    const float max_y = static_cast<float>(size.height - 1);
+    const int pairs = map.channels / 2;
+    float colours[3][4];
+    for (int y = 0; y < size.height; ++y)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            const float *point = map.at(x, y);
+            for (int p = 0; p < pairs; ++p)
+            {
+                const float sx = point[p * 2];
+                const float sy = point[p * 2 + 1];
+                if (sx >= 0.0f && sx <= max_x && sy >= 0.0f && sy <= max_y)
+                {
+                    sample_rgba(src, size, sx, sy, colours[p]);
+                }
+                else
+                {
+                    std::fill(colours[p], colours[p] + 4, 0.0f);
+                }
+            }
+            // Red, green (with alpha) and blue come from their own pairs with
+            // TCA.
+            float *out = &(*dst)[(static_cast<size_t>(y) * size.width + x) * 4];
+            out[0] = colours[0][0];
+            out[1] = colours[pairs == 3 ? 1 : 0][1];
+            out[2] = colours[pairs == 3 ? 2 : 0][2];
+            out[3] = colours[pairs == 3 ? 1 : 0][3];
+        }
+    }
+}
+
+void fixed_remap_case(Suite &suite, const LensCase &lens, uint32_t handle, Builder builder)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/fixed-remap-" + builder_name(builder);
+    ++suite.cases;
+    Map map;
+    const int32_t map_rc = build_map(builder, handle, lens.focal, size, 1, false, &map);
+    const int32_t kind = builder == Builder::Geometry ? 0 : 1;
+    const int32_t fixed = lfw_fixed_map_create(kind, handle, lens.focal, kCrop, size.width, size.height, 0);
+    if (fixed <= 0 || map_rc != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), map_rc != 0 ? map_rc : fixed);
+        ++suite.failures;
+        if (fixed > 0)
+        {
+            lfw_fixed_map_destroy(static_cast<uint32_t>(fixed));
+        }
+        return;
+    }
+
+    // Noise-like bytes, the worst case for rounding in the weights.
+    const size_t bytes = static_cast<size_t>(size.width) * size.height * 4;
+    std::vector<uint8_t> src(bytes);
+    uint32_t state = 12345;
+    for (uint8_t &value : src)
+    {
+        state = state * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(state >> 24);
+    }
+    std::vector<uint8_t> dst(bytes);
+    std::vector<float> expected(bytes);
+
+    const auto float_start = std::chrono::steady_clock::now();
+    remap_float(map, size, src, &expected);
+    const double float_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - float_start).count();
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t rc = lfw_fixed_map_remap(static_cast<uint32_t>(fixed),
+                                           src.data(),
+                                           static_cast<int32_t>(bytes),
+                                           dst.data(),
+                                           static_cast<int32_t>(bytes),
+                                           0,
+                                           size.height);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const int32_t bits = lfw_fixed_map_fraction_bits(static_cast<uint32_t>(fixed));
+    lfw_fixed_map_destroy(static_cast<uint32_t>(fixed));
+    if (rc != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), rc);
+        ++suite.failures;
+        return;
+    }
+
+    double worst = 0.0;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        worst = std::max(worst, std::fabs(dst[i] - static_cast<double>(expected[i])));
+    }
+
+    const size_t float_bytes = map.data.size() * sizeof(float);
+    const size_t fixed_bytes = map.data.size() * sizeof(int16_t);
+    printf("%-44s max error %.2f levels, %d fraction bits, speed vs float %.2fx, map %zu vs %zu KiB\n",
+           name.c_str(),
+           worst,
+           bits,
+           float_seconds / std::max(seconds, 1e-9),
+           fixed_bytes / 1024,
+           float_bytes / 1024);
+    // Rounded coordinates and 8-bit weights, each worth about a level on
+    // noise, on top of rounding the result.
+    const double tolerance = 2.5;
+    if (worst > tolerance)
+    {
+        fail(suite, "fixed remap off by %g levels (tolerance %g)", worst, tolerance);
+    }
+}
+} // namespace
+
+void run_fixed(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        fixed_remap_case(suite, *lens.lens, lens.handle, Builder::Geometry);
+        fixed_remap_case(suite, *lens.lens, lens.handle, Builder::Tca);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,107 @@
+// Map job module: progressive jobs' coarse and final grids must equal the
+// maps built at those steps, and a cancelled job must stop soon after.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+void map_job_case(Suite &suite, const LensCase &lens, uint32_t handle, Builder builder)
+{
+    const ImageSize size = kSizes[1];
+    const int coarse_step = 32;
+    const std::string name = std::string(lens.slug) + "/map-job-" + builder_name(builder);
+    ++suite.cases;
+    Map full;
+    Map coarse;
+    const double full_seconds = time_build(builder, handle, lens.focal, size, 1, suite.options.min_seconds, &full);
+    const int32_t coarse_rc = build_map(builder, handle, lens.focal, size, coarse_step, false, &coarse);
+    if (full_seconds < 0.0 || coarse_rc != 0)
+    {
+        printf("%s reference build failed\n", name.c_str());
+        ++suite.failures;
+        return;
+    }
+
+    const int32_t kind = static_cast<int32_t>(builder);
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t job = lfw_map_job_create(
+        kind, handle, lens.focal, kCrop, kAperture, kDistance, size.width, size.height, 0, 1, coarse_step);
+    // Small budgets, as a caller yielding to its UI between calls would use.
+    int32_t stage = job > 0 ? 0 : job;
+    double coarse_seconds = 0.0;
+    while (stage >= 0 && stage < 2)
+    {
+        stage = lfw_map_job_run(static_cast<uint32_t>(job), 64);
+        if (stage >= 1 && coarse_seconds == 0.0)
+        {
+            coarse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stage != 2)
+    {
+        printf("%s failed with code %d\n", name.c_str(), stage);
+        ++suite.failures;
+        if (job > 0)
+        {
+            lfw_map_job_destroy(static_cast<uint32_t>(job));
+        }
+        return;
+    }
+
+    Map job_coarse = coarse;
+    Map job_full = full;
+    const float *coarse_out = lfw_map_job_coarse(static_cast<uint32_t>(job));
+    const float *full_out = lfw_map_job_result(static_cast<uint32_t>(job));
+    std::copy(coarse_out, coarse_out + coarse.data.size(), job_coarse.data.begin());
+    std::copy(full_out, full_out + full.data.size(), job_full.data.begin());
+    lfw_map_job_destroy(static_cast<uint32_t>(job));
+    const double error = std::max(max_abs_diff(job_coarse, coarse), max_abs_diff(job_full, full));
+
+    // Cancelled after its first band, the next run must stop at once.
+    const int32_t cancelled = lfw_map_job_create(
+        kind, handle, lens.focal, kCrop, kAperture, kDistance, size.width, size.height, 0, 1, coarse_step);
+    lfw_map_job_run(static_cast<uint32_t>(cancelled), 16);
+    lfw_map_job_cancel(static_cast<uint32_t>(cancelled));
+    const int32_t cancel_rc = lfw_map_job_run(static_cast<uint32_t>(cancelled), 0);
+    const bool released = lfw_map_job_result(static_cast<uint32_t>(cancelled)) == nullptr;
+    lfw_map_job_destroy(static_cast<uint32_t>(cancelled));
+
+    printf("%-44s max error %.2e, coarse after %.3f, done after %.3f of a full build\n",
+           name.c_str(),
+           error,
+           coarse_seconds / std::max(full_seconds, 1e-9),
+           seconds / std::max(full_seconds, 1e-9));
+    // Both come from the same builders as the reference maps.
+    const double tolerance = builder == Builder::Vignetting ? suite.options.gain_tolerance : suite.options.tolerance;
+    if (error > tolerance)
+    {
+        fail(suite, "map job off by %g (tolerance %g)", error, tolerance);
+    }
+    if (cancel_rc != -7 || !released)
+    {
+        fail(suite, "cancelled map job returned %g, expected %g", cancel_rc, -7);
+    }
+}
+} // namespace
+
+void run_jobs(Suite &suite)
+{
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        for (Builder builder : builders)
+        {
+            map_job_case(suite, *lens.lens, lens.handle, builder);
+        }
+    }
+}
+} // namespace lfw_bench
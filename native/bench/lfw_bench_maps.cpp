@@ -0,0 +1,431 @@
+// Map builder module: every builder at several sizes and steps, checked for
+// point symmetry about the image centre, TCA leaving the green channel alone,
+// unit vignetting gain at the centre, step-N maps equal to the step-1 map
+// subsampled, the same map streamed in row bands, stored reference maps
+// (--golden) and recorded throughput (--baseline), plus forward/reverse
+// geometry composing to the identity.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+
+namespace lfw_bench
+{
+namespace
+{
+// Reference maps are recorded only for cases up to this many points.
+constexpr int64_t kGoldenMaxPoints = 10000;
+
+// Smaller cases finish in microseconds and are too noisy for throughput checks.
+constexpr int64_t kThroughputMinPoints = 40000;
+
+constexpr char kGoldenMagic[8] = {'L', 'F', 'W', 'M', 'A', 'P', '1', '\0'};
+
+// Largest difference between `map` and the same map streamed through
+// lfw_map_stream_rows in bands of `band` rows, or -1 if streaming failed.
+double stream_error(Builder builder, uint32_t handle, float focal, const ImageSize &size, int step, int band, const Map &map)
+{
+    const int32_t stream = lfw_map_stream_create(
+        static_cast<int32_t>(builder), handle, focal, kCrop, kAperture, kDistance, size.width, size.height, 0, step);
+    if (stream <= 0)
+    {
+        return -1.0;
+    }
+
+    const size_t row_floats = static_cast<size_t>(map.gx) * map.channels;
+    std::vector<float> rows(row_floats * band);
+    double worst = 0.0;
+    for (int y0 = 0; y0 < map.gy && worst >= 0.0; y0 += band)
+    {
+        const int y1 = std::min(map.gy, y0 + band);
+        if (lfw_map_stream_rows(stream, y0, y1, rows.data(), static_cast<int32_t>(rows.size())) != 0)
+        {
+            worst = -1.0;
+            break;
+        }
+        const float *expected = map.at(0, y0);
+        for (size_t i = 0; i < row_floats * (y1 - y0); ++i)
+        {
+            worst = std::max(worst, static_cast<double>(fabs(rows[i] - expected[i])));
+        }
+    }
+    lfw_map_stream_destroy(static_cast<uint32_t>(stream));
+    return worst;
+}
+
+float sample_coord(int index, int step)
+{
+    return static_cast<float>(index * step);
+}
+
+// Largest deviation from point symmetry about the image centre. Coordinates
+// of mirrored points must add up to the image extent; gains must be equal.
+double symmetry_error(Builder builder, const Map &map, const ImageSize &size)
+{
+    double worst = 0.0;
+    for (int y = 0; y < map.gy; ++y)
+    {
+        for (int x = 0; x < map.gx; ++x)
+        {
+            const float *a = map.at(x, y);
+            const float *b = map.at(map.gx - 1 - x, map.gy - 1 - y);
+            for (int c = 0; c < map.channels; ++c)
+            {
+                double error = 0.0;
+                if (builder == Builder::Vignetting)
+                {
+                    error = fabs(a[c] - b[c]);
+                }
+                else
+                {
+                    const double extent = (c % 2 == 0) ? size.width - 1 : size.height - 1;
+                    error = fabs(a[c] + b[c] - extent);
+                }
+                worst = std::max(worst, error);
+            }
+        }
+    }
+    return worst;
+}
+
+// TCA maps must leave the green channel on the sampled pixel.
+double green_error(const Map &map, int step)
+{
+    double worst = 0.0;
+    for (int y = 0; y < map.gy; ++y)
+    {
+        for (int x = 0; x < map.gx; ++x)
+        {
+            const float *p = map.at(x, y);
+            worst = std::max(worst, static_cast<double>(fabs(p[2] - sample_coord(x, step))));
+            worst = std::max(worst, static_cast<double>(fabs(p[3] - sample_coord(y, step))));
+        }
+    }
+    return worst;
+}
+
+double subsample_error(const Map &map, const Map &full, int step)
+{
+    double worst = 0.0;
+    for (int y = 0; y < map.gy; ++y)
+    {
+        for (int x = 0; x < map.gx; ++x)
+        {
+            const float *a = map.at(x, y);
+            const float *b = full.at(x * step, y * step);
+            for (int c = 0; c < map.channels; ++c)
+            {
+                worst = std::max(worst, static_cast<double>(fabs(a[c] - b[c])));
+            }
+        }
+    }
+    return worst;
+}
+
+std::string golden_path(const char *dir, const std::string &name)
+{
+    std::string path = std::string(dir) + "/" + name + ".bin";
+    std::replace(path.begin() + strlen(dir) + 1, path.end(), '/', '.');
+    return path;
+}
+
+// Reference maps are raw host-endian dumps: magic, three int32 (gx, gy,
+// channels), then the floats.
+bool read_golden(const std::string &path, Map *map)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[sizeof(kGoldenMagic)];
+    int32_t dims[3];
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, kGoldenMagic, sizeof(magic)) == 0 &&
+              fread(dims, sizeof(dims), 1, file) == 1 && dims[0] > 0 && dims[1] > 0 && dims[2] > 0;
+    if (ok)
+    {
+        map->gx = dims[0];
+        map->gy = dims[1];
+        map->channels = dims[2];
+        map->data.resize(static_cast<size_t>(dims[0]) * dims[1] * dims[2]);
+        ok = fread(map->data.data(), sizeof(float), map->data.size(), file) == map->data.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+bool write_golden(const std::string &path, const Map &map)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    const int32_t dims[3] = {map.gx, map.gy, map.channels};
+    const bool ok = fwrite(kGoldenMagic, sizeof(kGoldenMagic), 1, file) == 1 &&
+                    fwrite(dims, sizeof(dims), 1, file) == 1 &&
+                    fwrite(map.data.data(), sizeof(float), map.data.size(), file) == map.data.size();
+    return fclose(file) == 0 && ok;
+}
+
+void check_reference(Suite &suite, const std::string &name, Builder builder, const Map &map)
+{
+    const Options &options = suite.options;
+    const int64_t points = static_cast<int64_t>(map.gx) * map.gy;
+    if (points > kGoldenMaxPoints)
+    {
+        return;
+    }
+
+    if (options.record_golden)
+    {
+        const std::string path = golden_path(options.record_golden, name);
+        if (!write_golden(path, map))
+        {
+            printf("    FAIL: cannot write %s\n", path.c_str());
+            ++suite.failures;
+        }
+    }
+
+    if (options.golden)
+    {
+        // A case without a reference would pass unchecked, so it fails too;
+        // record them with --record-golden (the lfw_bench_golden target).
+        const std::string path = golden_path(options.golden, name);
+        Map reference;
+        if (!read_golden(path, &reference))
+        {
+            printf("    FAIL: no reference map %s\n", path.c_str());
+            ++suite.failures;
+            return;
+        }
+
+        const double tolerance = builder == Builder::Vignetting ? options.gain_tolerance : options.tolerance;
+        if (reference.gx != map.gx || reference.gy != map.gy || reference.channels != map.channels)
+        {
+            printf("    FAIL: reference map has a different shape\n");
+            ++suite.failures;
+        }
+        else
+        {
+            const double diff = max_abs_diff(map, reference);
+            if (diff > tolerance)
+            {
+                fail(suite, "differs from reference by %g (tolerance %g)", diff, tolerance);
+            }
+        }
+    }
+}
+
+void check_throughput(Suite &suite, const std::string &name, int64_t points, double mpoints)
+{
+    if (points < kThroughputMinPoints)
+    {
+        return;
+    }
+
+    suite.measured[name] = mpoints;
+    const auto expected = suite.baseline.find(name);
+    if (expected == suite.baseline.end())
+    {
+        return;
+    }
+
+    const double floor = expected->second * (1.0 - suite.options.max_slowdown);
+    if (mpoints < floor)
+    {
+        fail(suite, "throughput %.2f Mpt/s below threshold %.2f Mpt/s", mpoints, floor);
+    }
+}
+
+// Builds, times and checks one case. `full` is the step-1 map of the same
+// lens, builder and size when available. Returns false if no usable map was
+// produced.
+bool map_case(
+    Suite &suite,
+    const LensCase &lens,
+    uint32_t handle,
+    Builder builder,
+    const ImageSize &size,
+    int step,
+    const Map *full,
+    Map *out)
+{
+    const Options &options = suite.options;
+    char name[160];
+    snprintf(name, sizeof(name), "%s/%s/%dx%d/s%d", lens.slug, builder_name(builder), size.width, size.height, step);
+
+    Map &map = *out;
+    const double seconds = time_build(builder, handle, lens.focal, size, step, options.min_seconds, &map);
+    ++suite.cases;
+    if (seconds < 0.0)
+    {
+        printf("%-44s build failed\n", name);
+        ++suite.failures;
+        return false;
+    }
+
+    const int64_t points = static_cast<int64_t>(map.gx) * map.gy;
+    const double mpoints = static_cast<double>(points) / seconds / 1e6;
+    printf("%-44s %9lld pts %10.3f ms %9.2f Mpt/s\n", name, static_cast<long long>(points), seconds * 1e3, mpoints);
+
+    if (!all_finite(map))
+    {
+        printf("    FAIL: map contains non-finite values\n");
+        ++suite.failures;
+        return false;
+    }
+
+    const double tolerance = builder == Builder::Vignetting ? options.gain_tolerance : options.tolerance;
+    const double symmetry = symmetry_error(builder, map, size);
+    if (symmetry > tolerance)
+    {
+        fail(suite, "not symmetric about the centre, error %g (tolerance %g)", symmetry, tolerance);
+    }
+
+    if (builder == Builder::Tca)
+    {
+        const double green = green_error(map, step);
+        if (green > options.tolerance)
+        {
+            fail(suite, "green channel moved by %g (tolerance %g)", green, options.tolerance);
+        }
+    }
+
+    if (builder == Builder::Vignetting)
+    {
+        const float *centre = map.at(map.gx / 2, map.gy / 2);
+        const double centre_error = fabs(centre[1] - 1.0);
+        if (centre_error > options.gain_tolerance)
+        {
+            fail(suite, "centre gain off by %g (tolerance %g)", centre_error, options.gain_tolerance);
+        }
+
+        // Every synthetic profile darkens towards the corners, so corrections
+        // never attenuate.
+        const float lowest = *std::min_element(map.data.begin(), map.data.end());
+        if (lowest < 1.0f - options.gain_tolerance)
+        {
+            fail(suite, "correction gain %g below 1 - %g", lowest, options.gain_tolerance);
+        }
+    }
+
+    if (full && step > 1)
+    {
+        const double subsample = subsample_error(map, *full, step);
+        if (subsample > tolerance)
+        {
+            fail(suite, "differs from the step-1 map by %g (tolerance %g)", subsample, tolerance);
+        }
+    }
+
+    const double streamed = stream_error(builder, handle, lens.focal, size, step, 7, map);
+    if (streamed < 0.0)
+    {
+        printf("    FAIL: streaming in row bands failed\n");
+        ++suite.failures;
+    }
+    else if (streamed > tolerance)
+    {
+        fail(suite, "streamed rows differ from the map by %g (tolerance %g)", streamed, tolerance);
+    }
+
+    check_reference(suite, name, builder, map);
+    check_throughput(suite, name, points, mpoints);
+    return true;
+}
+
+// Geometry correction followed by its reverse must land where it started:
+// the forward map sampled where the reverse map points is the identity.
+void round_trip_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[0];
+    const double tolerance = 5.0 * suite.options.tolerance;
+    Map forward;
+    Map reverse;
+    ++suite.cases;
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t forward_rc = build_map(Builder::Geometry, handle, lens.focal, size, 1, false, &forward);
+    const auto middle = std::chrono::steady_clock::now();
+    const int32_t reverse_rc = build_map(Builder::Geometry, handle, lens.focal, size, 1, true, &reverse);
+    const auto end = std::chrono::steady_clock::now();
+    if (forward_rc != 0 || reverse_rc != 0)
+    {
+        printf("%s/round-trip build failed\n", lens.slug);
+        ++suite.failures;
+        return;
+    }
+    // First builds, so the reverse time includes fitting its inverse table.
+    const double ratio = std::chrono::duration<double>(end - middle).count() /
+                         std::max(std::chrono::duration<double>(middle - start).count(), 1e-9);
+
+    double worst = 0.0;
+    for (int y = 0; y < reverse.gy; ++y)
+    {
+        for (int x = 0; x < reverse.gx; ++x)
+        {
+            const float *q = reverse.at(x, y);
+            float p[2];
+            if (bilinear(forward, q[0], q[1], p))
+            {
+                worst = std::max(worst, static_cast<double>(std::hypot(p[0] - x, p[1] - y)));
+            }
+        }
+    }
+
+    printf("%-44s max error %.5f px, reverse/forward time %.2f\n",
+           (std::string(lens.slug) + "/round-trip").c_str(),
+           worst,
+           ratio);
+    if (worst > tolerance)
+    {
+        fail(suite, "round trip error %g (tolerance %g)", worst, tolerance);
+    }
+}
+} // namespace
+
+void run_maps(Suite &suite)
+{
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        for (Builder builder : builders)
+        {
+            for (int s = 0; s < suite.size_count; ++s)
+            {
+                const ImageSize &size = kSizes[s];
+                Map full;
+                bool have_full = false;
+                for (int step : kSteps)
+                {
+                    const int64_t points =
+                        static_cast<int64_t>(grid_points(size.width, step)) * grid_points(size.height, step);
+                    if (points > kMaxPoints)
+                    {
+                        continue;
+                    }
+
+                    Map map;
+                    const bool built = map_case(
+                        suite, *lens.lens, lens.handle, builder, size, step, have_full ? &full : nullptr, &map);
+                    if (step == 1 && built)
+                    {
+                        full = std::move(map);
+                        have_full = true;
+                    }
+                }
+            }
+        }
+        round_trip_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
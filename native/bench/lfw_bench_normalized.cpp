@@ -0,0 +1,93 @@
+// Normalized map module: one resolution-independent map sampled at every
+// size must match the maps built for that size.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// One normalized map per builder, sampled at every size, must match the maps
+// built for each size. Sampling is timed against building at the largest.
+void normalized_case(Suite &suite, const LensCase &lens, uint32_t handle, int size_count)
+{
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (Builder builder : builders)
+    {
+        const std::string name = std::string(lens.slug) + "/normalized/" + builder_name(builder);
+        ++suite.cases;
+        const ImageSize &reference = kSizes[0];
+        const float aspect = static_cast<float>(reference.width - 1) / static_cast<float>(reference.height - 1);
+        const int32_t normalized = lfw_normalized_map_create(
+            static_cast<int32_t>(builder), handle, lens.focal, kCrop, kAperture, kDistance, aspect, 0, 257);
+        if (normalized <= 0)
+        {
+            printf("%s failed with code %d\n", name.c_str(), normalized);
+            ++suite.failures;
+            continue;
+        }
+
+        double worst = 0.0;
+        double sample_seconds = 0.0;
+        double build_seconds = 0.0;
+        for (int s = 0; s < size_count; ++s)
+        {
+            const ImageSize &size = kSizes[s];
+            const int step =
+                static_cast<int64_t>(size.width) * size.height > kMaxPoints ? kSteps[1] : kSteps[0];
+            Map built;
+            const auto build_start = std::chrono::steady_clock::now();
+            const int32_t built_rc = build_map(builder, handle, lens.focal, size, step, false, &built);
+            const auto build_end = std::chrono::steady_clock::now();
+            Map sampled = built;
+            const auto sample_start = std::chrono::steady_clock::now();
+            const int32_t sampled_rc = lfw_normalized_map_sample(
+                static_cast<uint32_t>(normalized),
+                size.width,
+                size.height,
+                step,
+                sampled.data.data(),
+                static_cast<int32_t>(sampled.data.size()));
+            const auto end = std::chrono::steady_clock::now();
+            if (built_rc != 0 || sampled_rc != 0)
+            {
+                printf("%s %dx%d failed with code %d\n", name.c_str(), size.width, size.height, built_rc ? built_rc : sampled_rc);
+                ++suite.failures;
+                continue;
+            }
+            worst = std::max(worst, max_abs_diff(built, sampled));
+            build_seconds = std::chrono::duration<double>(build_end - build_start).count();
+            sample_seconds = std::chrono::duration<double>(end - sample_start).count();
+        }
+        lfw_normalized_map_destroy(static_cast<uint32_t>(normalized));
+
+        // Rounding the reference to whole pixels moves the model by a
+        // fraction of a pixel at small sizes, hence the looser bound.
+        const double tolerance =
+            builder == Builder::Vignetting ? suite.options.gain_tolerance : 5.0 * suite.options.tolerance;
+        printf("%-44s max error %.5f, sample/build time %.3f\n",
+               name.c_str(),
+               worst,
+               sample_seconds / std::max(build_seconds, 1e-9));
+        if (worst > tolerance)
+        {
+            fail(suite, "normalized map differs by %g (tolerance %g)", worst, tolerance);
+        }
+    }
+}
+} // namespace
+
+void run_normalized(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        normalized_case(suite, *lens.lens, lens.handle, suite.size_count);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,228 @@
+// Database package module: compressed packages must load the same records
+// as the XML files they were packed from.
+
+#include "lfw_bench_util.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if LFW_ENABLE_DB_PACK
+#include <zlib.h>
+
+namespace lfw_bench
+{
+namespace
+{
+bool read_bytes(const std::string &path, std::string *out)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    char buffer[65536];
+    size_t got = 0;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        out->append(buffer, got);
+    }
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+bool write_bytes(const std::string &path, const std::string &bytes)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+    const bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+void append_u32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+// Packs (name, XML) documents in the layout scripts/pack-db.mjs writes; see
+// native/src/lfw_pack.h.
+std::string pack_documents(const std::vector<std::pair<std::string, std::string>> &documents, uint32_t version)
+{
+    std::string records;
+    uint32_t xml_bytes = 0;
+    for (const auto &doc : documents)
+    {
+        append_u32(records, static_cast<uint32_t>(doc.first.size()));
+        append_u32(records, static_cast<uint32_t>(doc.second.size()));
+        records += doc.first;
+        records += doc.second;
+        xml_bytes += static_cast<uint32_t>(doc.second.size());
+    }
+    uLongf packed_size = compressBound(records.size());
+    std::string packed(packed_size, '\0');
+    compress2(reinterpret_cast<Bytef *>(&packed[0]),
+              &packed_size,
+              reinterpret_cast<const Bytef *>(records.data()),
+              records.size(),
+              Z_BEST_COMPRESSION);
+    packed.resize(packed_size);
+
+    std::string out;
+    append_u32(out, 0x4457464c);
+    append_u32(out, version);
+    append_u32(out, static_cast<uint32_t>(documents.size()));
+    append_u32(out, xml_bytes);
+    return out + packed;
+}
+
+// Seconds from lfw_init(path) to the first geometry map built from the
+// loaded database (best of a few runs), or -1 if either fails.
+double first_correction_seconds(const std::string &path)
+{
+    double best = -1.0;
+    for (int run = 0; run < 3; ++run)
+    {
+        lfw_dispose();
+        const auto start = std::chrono::steady_clock::now();
+        if (lfw_init(path.c_str()) != 0)
+        {
+            return -1.0;
+        }
+        const uint32_t handle = find_lens_handle("LFW Synthetic", kLenses[0].model);
+        Map map;
+        if (handle == 0 || build_map(Builder::Geometry, handle, kLenses[0].focal, kSizes[1], 16, false, &map) != 0)
+        {
+            return -1.0;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+// Content hash and lens count of the loaded database.
+std::string database_identity()
+{
+    char *hash = lfw_db_content_hash();
+    char *stats = lfw_get_stats_json();
+    std::string identity = hash ? hash : "";
+    if (stats)
+    {
+        const std::string json(stats);
+        identity += " " + std::to_string(json_number(json, "lenses", json.find("\"database\":")));
+    }
+    lfw_free(hash);
+    lfw_free(stats);
+    return identity;
+}
+} // namespace
+
+// A package of the synthetic database plus a document large enough to span
+// many inflate chunks must load the same records, with the same content
+// hash, as the XML files it was packed from; truncated packages and other
+// versions must fail. Replaces the loaded database.
+void run_pack(Suite &suite)
+{
+    const char *name = "database/packed";
+    ++suite.cases;
+    char dir_template[] = "/tmp/lfw_bench_pack_XXXXXX";
+    const char *dir = mkdtemp(dir_template);
+    std::string synthetic;
+    if (!dir || !read_bytes(suite.options.data, &synthetic))
+    {
+        printf("%s cannot set up a scratch directory\n", name);
+        ++suite.failures;
+        return;
+    }
+
+    const std::string base(dir);
+    const std::string xml_dir = base + "/xml";
+    const std::string pack_dir = base + "/pack";
+    const std::string pack_path = pack_dir + "/lensfun-db.lfwpack";
+    const std::string truncated_path = base + "/truncated.lfwpack";
+    const std::string version_path = base + "/version.lfwpack";
+    const std::vector<std::pair<std::string, std::string>> documents = {
+        {"other-lenses.xml", pruning_document(300)},
+        {"synthetic-lenses.xml", synthetic},
+    };
+    const std::string pack = pack_documents(documents, 1);
+    bool written = mkdir(xml_dir.c_str(), 0700) == 0 && mkdir(pack_dir.c_str(), 0700) == 0 &&
+                   write_bytes(pack_path, pack) && write_bytes(truncated_path, pack.substr(0, pack.size() / 2)) &&
+                   write_bytes(version_path, pack_documents(documents, 2));
+    double xml_bytes = 0.0;
+    for (const auto &doc : documents)
+    {
+        written = written && write_bytes(xml_dir + "/" + doc.first, doc.second);
+        xml_bytes += static_cast<double>(doc.second.size());
+    }
+
+    const double raw_seconds = written ? first_correction_seconds(xml_dir) : -1.0;
+    const std::string raw_identity = database_identity();
+    const double packed_seconds = written ? first_correction_seconds(pack_dir) : -1.0;
+    const std::string packed_identity = database_identity();
+    char *stats = lfw_get_stats_json();
+    const std::string json = stats ? stats : "";
+    lfw_free(stats);
+    const size_t section = json.find("\"packages\":");
+    const double packed_documents = json_number(json, "documents", section);
+    const double packed_bytes = json_number(json, "packedBytes", section);
+    const double inflated_bytes = json_number(json, "xmlBytes", section);
+    lfw_dispose();
+    const bool truncated_rejected = lfw_init(truncated_path.c_str()) != 0;
+    lfw_dispose();
+    const bool version_rejected = lfw_init(version_path.c_str()) != 0;
+
+    remove(pack_path.c_str());
+    remove(truncated_path.c_str());
+    remove(version_path.c_str());
+    for (const auto &doc : documents)
+    {
+        remove((xml_dir + "/" + doc.first).c_str());
+    }
+    rmdir(xml_dir.c_str());
+    rmdir(pack_dir.c_str());
+    rmdir(base.c_str());
+
+    if (raw_seconds < 0.0 || packed_seconds < 0.0)
+    {
+        printf("%s failed to load\n", name);
+        ++suite.failures;
+        return;
+    }
+    printf("%-44s %.0f KiB of XML in %.0f KiB (%.1f%%); init to first map %.2f ms packed, %.2f ms from XML\n",
+           name,
+           xml_bytes / 1024.0,
+           static_cast<double>(pack.size()) / 1024.0,
+           100.0 * static_cast<double>(pack.size()) / xml_bytes,
+           packed_seconds * 1e3,
+           raw_seconds * 1e3);
+    if (packed_identity != raw_identity)
+    {
+        printf("    FAIL: packed database %s, XML files %s\n", packed_identity.c_str(), raw_identity.c_str());
+        ++suite.failures;
+    }
+    if (packed_documents != static_cast<double>(documents.size()) || inflated_bytes != xml_bytes ||
+        packed_bytes != static_cast<double>(pack.size()))
+    {
+        fail(suite, "package stats report %g XML bytes (expected %g)", inflated_bytes, xml_bytes);
+    }
+    if (!truncated_rejected || !version_rejected)
+    {
+        fail(suite, "damaged or foreign package accepted (%g, expected %g)", 1.0, 0.0);
+    }
+}
+} // namespace lfw_bench
+#endif
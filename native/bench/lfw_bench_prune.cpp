@@ -0,0 +1,116 @@
+// Pruning module: mount filters must keep other systems' records out of the
+// database and the rest loading as before.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+struct LoadedDatabase
+{
+    double lenses = -1.0;
+    double cameras = -1.0;
+    double live_bytes = -1.0;
+    std::string stats;
+};
+
+// Loads the synthetic database plus `extra`, with or without the mount
+// filter, and reads back the counts and the heap the database holds.
+bool load_database(const Options &options, const std::string &extra, bool filtered, LoadedDatabase *out)
+{
+    lfw_dispose();
+    lfw_alloc_tracking_start();
+    const int32_t rc = filtered ? lfw_init_filtered(options.data, "LFW Synthetic", nullptr) : lfw_init(options.data);
+    const int32_t loaded = lfw_db_load_xml("pruning", extra.c_str(), static_cast<int32_t>(extra.size()));
+    char *report = lfw_alloc_report_json();
+    lfw_alloc_tracking_stop();
+    char *stats = lfw_get_stats_json();
+    if (rc != 0 || loaded != 0 || !report || !stats)
+    {
+        lfw_free(report);
+        lfw_free(stats);
+        return false;
+    }
+    const std::string alloc(report);
+    out->stats = stats;
+    lfw_free(report);
+    lfw_free(stats);
+    out->live_bytes = json_number(alloc, "liveBytes", alloc.find("\"databaseLoad\":"));
+    const size_t database = out->stats.find("\"database\":");
+    out->lenses = json_number(out->stats, "lenses", database);
+    out->cameras = json_number(out->stats, "cameras", database);
+    return true;
+}
+} // namespace
+
+// Records on other mounts must never be loaded, the rest must load as
+// before, and the heap the database holds must shrink accordingly. Replaces
+// the loaded database.
+void run_prune(Suite &suite)
+{
+    const char *name = "database/pruned-by-mount";
+    constexpr int kOtherLenses = 200;
+    ++suite.cases;
+    const std::string extra = pruning_document(kOtherLenses);
+    LoadedDatabase full;
+    LoadedDatabase pruned;
+    const auto start = std::chrono::steady_clock::now();
+    const bool full_ok = load_database(suite.options, extra, false, &full);
+    const auto middle = std::chrono::steady_clock::now();
+    const bool pruned_ok = load_database(suite.options, extra, true, &pruned);
+    const auto end = std::chrono::steady_clock::now();
+    if (!full_ok || !pruned_ok)
+    {
+        printf("%s failed to load\n", name);
+        ++suite.failures;
+        return;
+    }
+
+    const size_t section = pruned.stats.find("\"pruned\":");
+    const double pruned_lenses = json_number(pruned.stats, "lenses", section);
+    const double pruned_cameras = json_number(pruned.stats, "cameras", section);
+    const double pruned_calibrations = json_number(pruned.stats, "calibrations", section);
+    const double pruned_bytes = json_number(pruned.stats, "xmlBytes", section);
+    bool kept = find_lens_handle("LFW Synthetic", "Kept 50mm f/2") != 0 &&
+                find_lens_handle("LFW Other", "Other 20mm f/2.8") == 0;
+    for (const LensCase &lens : kLenses)
+    {
+        kept = kept && find_lens_handle("LFW Synthetic", lens.model) != 0;
+    }
+
+    printf("%-44s %.0f lenses, %.0f cameras, %.0f calibrations, %.0f KiB of XML skipped; database heap %.0f -> %.0f "
+           "KiB, load %.2f of unfiltered\n",
+           name,
+           pruned_lenses,
+           pruned_cameras,
+           pruned_calibrations,
+           pruned_bytes / 1024.0,
+           full.live_bytes / 1024.0,
+           pruned.live_bytes / 1024.0,
+           std::chrono::duration<double>(end - middle).count() /
+               std::max(std::chrono::duration<double>(middle - start).count(), 1e-9));
+    if (pruned_lenses != kOtherLenses || pruned_cameras != 1 || pruned_calibrations != 3 * kOtherLenses ||
+        full.lenses - pruned.lenses != kOtherLenses || full.cameras - pruned.cameras != 1)
+    {
+        fail(suite, "pruned record count off by %g (expected %g)", fabs(full.lenses - pruned.lenses - kOtherLenses), 0.0);
+    }
+    if (!kept)
+    {
+        fail(suite, "allowed lens missing or other lens loaded (%g, expected %g)", 1.0, 0.0);
+    }
+    // The tracker sees lensfun's records through g_malloc (and through new
+    // with LFW_TRACK_CXX_ALLOCS); a lensfun that allocates neither way leaves
+    // nothing to compare.
+    if (full.live_bytes > 0.0 && !(pruned.live_bytes < full.live_bytes))
+    {
+        fail(suite, "pruned database holds %g bytes (unfiltered %g)", pruned.live_bytes, full.live_bytes);
+    }
+}
+} // namespace lfw_bench
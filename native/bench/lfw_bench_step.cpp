@@ -0,0 +1,119 @@
+// Step choice module: steps chosen for a pixel tolerance must give grids that
+// reconstruct the step-1 map within it.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// The chosen step must reconstruct the step-1 map within tolerance wherever
+// its grid reaches, checked at every pixel rather than the probed ones. The
+// true error of the next step up is printed to show how close the choice is.
+double grid_error(const Map &grid, const Map &full, int step)
+{
+    const int last_x = (grid.gx - 1) * step;
+    const int last_y = (grid.gy - 1) * step;
+    double worst = 0.0;
+    for (int y = 0; y <= last_y; ++y)
+    {
+        const int y0 = std::min(y / step, grid.gy - 2);
+        const float fy = static_cast<float>(y - y0 * step) / static_cast<float>(step);
+        for (int x = 0; x <= last_x; ++x)
+        {
+            const int x0 = std::min(x / step, grid.gx - 2);
+            const float fx = static_cast<float>(x - x0 * step) / static_cast<float>(step);
+            const float *p00 = grid.at(x0, y0);
+            const float *p01 = grid.at(x0 + 1, y0);
+            const float *p10 = grid.at(x0, y0 + 1);
+            const float *p11 = grid.at(x0 + 1, y0 + 1);
+            const float *exact = full.at(x, y);
+            for (int c = 0; c < grid.channels; ++c)
+            {
+                const float top = p00[c] + (p01[c] - p00[c]) * fx;
+                const float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+                worst = std::max(worst, fabs(static_cast<double>(top + (bottom - top) * fy) - exact[c]));
+            }
+        }
+    }
+    return worst;
+}
+
+void step_choice_case(Suite &suite, const LensCase &lens, uint32_t handle, Builder builder)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/step-choice-" + builder_name(builder);
+    const float tolerance = builder == Builder::Vignetting ? 1e-3f : 0.05f;
+    ++suite.cases;
+    Map full;
+    if (build_map(builder, handle, lens.focal, size, 1, false, &full) != 0)
+    {
+        printf("%s reference build failed\n", name.c_str());
+        ++suite.failures;
+        return;
+    }
+
+    float choice[3];
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t rc = lfw_choose_step(static_cast<int32_t>(builder),
+                                       handle,
+                                       lens.focal,
+                                       kCrop,
+                                       kAperture,
+                                       kDistance,
+                                       size.width,
+                                       size.height,
+                                       0,
+                                       tolerance,
+                                       64,
+                                       choice,
+                                       3);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const int step = static_cast<int>(choice[0]);
+    Map grid;
+    Map coarser;
+    if (rc != 0 || step < 1 || build_map(builder, handle, lens.focal, size, step, false, &grid) != 0 ||
+        build_map(builder, handle, lens.focal, size, step + 1, false, &coarser) != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), rc);
+        ++suite.failures;
+        return;
+    }
+    const double error = step > 1 ? grid_error(grid, full, step) : 0.0;
+    const double next_error = grid_error(coarser, full, step + 1);
+
+    printf("%-44s step %d, probe error %.2e, full error %.2e (step %d: %.2e), %d points in %.2f ms\n",
+           name.c_str(),
+           step,
+           choice[1],
+           error,
+           step + 1,
+           next_error,
+           static_cast<int>(choice[2]),
+           seconds * 1e3);
+    if (error > tolerance * 1.25)
+    {
+        fail(suite, "chosen step off by %g (tolerance %g)", error, tolerance * 1.25);
+    }
+}
+} // namespace
+
+void run_step(Suite &suite)
+{
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        for (Builder builder : builders)
+        {
+            step_choice_case(suite, *lens.lens, lens.handle, builder);
+        }
+    }
+}
+} // namespace lfw_bench
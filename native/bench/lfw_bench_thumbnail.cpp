@@ -0,0 +1,151 @@
+// Thumbnail module: fused thumbnails of a coordinate ramp must land on the
+// geometry map at each block centre.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// Lanczos weights are symmetric, so prefiltering a linear image gives back
+// its value at the footprint centre; box weights, which treat pixels as
+// squares, are within a small fraction of a pixel of it. A thumbnail of the ramp
+// (x, y, 1) with distortion and vignetting holds gain * (x, y, 1), where
+// (x, y) is the geometry map and the gain the vignetting map at the centre of
+// each block. Pixels whose footprint is clipped by the border are skipped.
+// The thumbnail is timed against a full-size tiled correction of the same
+// image.
+void thumbnail_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[1];
+    const int factor = 8;
+    const int out_width = size.width / factor;
+    const int out_height = size.height / factor;
+    const int32_t mods = kModifyDistortion | kModifyVignetting;
+    Map geometry;
+    Map gains;
+    if (build_map(Builder::Geometry, handle, lens.focal, size, 1, false, &geometry) != 0 ||
+        build_map(Builder::Vignetting, handle, lens.focal, size, 1, false, &gains) != 0)
+    {
+        printf("%s/thumbnail build failed\n", lens.slug);
+        ++suite.failures;
+        return;
+    }
+
+    std::vector<float> source(static_cast<size_t>(size.width) * size.height * 3);
+    for (int y = 0; y < size.height; ++y)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            float *p = &source[(static_cast<size_t>(y) * size.width + x) * 3];
+            p[0] = static_cast<float>(x);
+            p[1] = static_cast<float>(y);
+            p[2] = 1.0f;
+        }
+    }
+
+    const int32_t tiler =
+        lfw_tiler_create(handle, lens.focal, kCrop, kAperture, kDistance, size.width, size.height, 3, mods, 256);
+    Ramp ramp;
+    ramp.width = size.width;
+    ramp.out.assign(source.size(), 0.0f);
+    const auto tiled_start = std::chrono::steady_clock::now();
+    const int32_t tiled_rc = tiler > 0 ? lfw_tiler_run(static_cast<uint32_t>(tiler), read_ramp, write_ramp, &ramp) : tiler;
+    const double tiled_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - tiled_start).count();
+    if (tiler > 0)
+    {
+        lfw_tiler_destroy(static_cast<uint32_t>(tiler));
+    }
+
+    const char *const filters[] = {"box", "lanczos3"};
+    for (int filter = 0; filter < 2; ++filter)
+    {
+        const std::string name = std::string(lens.slug) + "/thumbnail/" + filters[filter];
+        ++suite.cases;
+        std::vector<float> out(static_cast<size_t>(out_width) * out_height * 3);
+        const auto start = std::chrono::steady_clock::now();
+        const int32_t rc = lfw_thumbnail(
+            handle,
+            lens.focal,
+            kCrop,
+            kAperture,
+            kDistance,
+            size.width,
+            size.height,
+            3,
+            mods,
+            filter,
+            source.data(),
+            static_cast<int32_t>(source.size()),
+            out_width,
+            out_height,
+            out.data(),
+            static_cast<int32_t>(out.size()));
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (rc != 0 || tiled_rc != 0)
+        {
+            printf("%s failed with code %d\n", name.c_str(), rc != 0 ? rc : tiled_rc);
+            ++suite.failures;
+            continue;
+        }
+
+        // Lanczos reaches three footprints out, with footprints up to twice a
+        // block where the distortion stretches the image.
+        const double margin = 6.0 * factor;
+        double worst = 0.0;
+        double worst_gain = 0.0;
+        for (int v = 0; v < out_height; ++v)
+        {
+            for (int u = 0; u < out_width; ++u)
+            {
+                const double x = (u + 0.5) * size.width / out_width - 0.5;
+                const double y = (v + 0.5) * size.height / out_height - 0.5;
+                float expected[2];
+                float gain[3];
+                if (!bilinear(geometry, x, y, expected) || expected[0] < margin || expected[1] < margin ||
+                    expected[0] > size.width - 1 - margin || expected[1] > size.height - 1 - margin ||
+                    !bilinear(gains, expected[0], expected[1], gain))
+                {
+                    continue;
+                }
+                const float *got = &out[(static_cast<size_t>(v) * out_width + u) * 3];
+                const double dx = static_cast<double>(got[0]) / got[2] - expected[0];
+                const double dy = static_cast<double>(got[1]) / got[2] - expected[1];
+                worst = std::max(worst, std::hypot(dx, dy));
+                worst_gain = std::max(worst_gain, std::fabs(static_cast<double>(got[2]) - gain[0]));
+            }
+        }
+
+        printf("%-44s max error %.5f px, gain error %.6f, time vs full-size correction %.3f\n",
+               name.c_str(),
+               worst,
+               worst_gain,
+               seconds / std::max(tiled_seconds, 1e-9));
+        if (worst > 5.0 * suite.options.tolerance)
+        {
+            fail(suite, "thumbnail off by %g px (tolerance %g)", worst, 5.0 * suite.options.tolerance);
+        }
+        if (worst_gain > suite.options.gain_tolerance)
+        {
+            fail(suite, "thumbnail gain off by %g (tolerance %g)", worst_gain, suite.options.gain_tolerance);
+        }
+    }
+}
+} // namespace
+
+void run_thumbnail(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        thumbnail_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,85 @@
+// Tiler module: tiled correction of a coordinate ramp must reproduce the
+// geometry map.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// Bilinear sampling reproduces a linear image exactly, so distortion
+// correction of the coordinate ramp must give back the geometry map wherever
+// it points inside the image.
+void tiled_case(Suite &suite, const LensCase &lens, uint32_t handle)
+{
+    const ImageSize size = kSizes[1];
+    const std::string name = std::string(lens.slug) + "/tiled";
+    Map map;
+    ++suite.cases;
+    const int32_t tiler =
+        lfw_tiler_create(handle, lens.focal, kCrop, kAperture, kDistance, size.width, size.height, 3, kModifyDistortion, 128);
+    if (tiler <= 0 || build_map(Builder::Geometry, handle, lens.focal, size, 1, false, &map) != 0)
+    {
+        printf("%s build failed\n", name.c_str());
+        ++suite.failures;
+        if (tiler > 0)
+        {
+            lfw_tiler_destroy(static_cast<uint32_t>(tiler));
+        }
+        return;
+    }
+
+    Ramp ramp;
+    ramp.width = size.width;
+    ramp.out.assign(static_cast<size_t>(size.width) * size.height * 3, 0.0f);
+    const auto start = std::chrono::steady_clock::now();
+    const int32_t rc = lfw_tiler_run(static_cast<uint32_t>(tiler), read_ramp, write_ramp, &ramp);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    lfw_tiler_destroy(static_cast<uint32_t>(tiler));
+    if (rc != 0)
+    {
+        printf("%s failed with code %d\n", name.c_str(), rc);
+        ++suite.failures;
+        return;
+    }
+
+    double worst = 0.0;
+    for (int y = 0; y < map.gy; ++y)
+    {
+        for (int x = 0; x < map.gx; ++x)
+        {
+            const float *expected = map.at(x, y);
+            if (expected[0] < 0.0f || expected[1] < 0.0f || expected[0] > size.width - 1 ||
+                expected[1] > size.height - 1)
+            {
+                continue;
+            }
+            const float *got = &ramp.out[(static_cast<size_t>(y) * size.width + x) * 3];
+            worst = std::max(worst, static_cast<double>(std::hypot(got[0] - expected[0], got[1] - expected[1])));
+        }
+    }
+
+    const double mpixels = static_cast<double>(size.width) * size.height / seconds / 1e6;
+    printf("%-44s max error %.5f px %9.2f Mpx/s\n", name.c_str(), worst, mpixels);
+    if (worst > suite.options.tolerance)
+    {
+        fail(suite, "tiled correction off by %g (tolerance %g)", worst, suite.options.tolerance);
+    }
+}
+} // namespace
+
+void run_tiles(Suite &suite)
+{
+    for (const SuiteLens &lens : suite.lenses)
+    {
+        tiled_case(suite, *lens.lens, lens.handle);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,178 @@
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+const char *builder_name(Builder builder)
+{
+    switch (builder)
+    {
+    case Builder::Geometry:
+        return "geometry";
+    case Builder::Tca:
+        return "tca";
+    case Builder::Vignetting:
+        return "vignetting";
+    }
+    return "unknown";
+}
+
+int builder_channels(Builder builder)
+{
+    switch (builder)
+    {
+    case Builder::Geometry:
+        return 2;
+    case Builder::Tca:
+        return 6;
+    case Builder::Vignetting:
+        return 3;
+    }
+    return 0;
+}
+
+int build_map(Builder builder, uint32_t handle, float focal, const ImageSize &size, int step, bool reverse, Map *map)
+{
+    map->gx = grid_points(size.width, step);
+    map->gy = grid_points(size.height, step);
+    map->channels = builder_channels(builder);
+    map->data.assign(static_cast<size_t>(map->gx) * map->gy * map->channels, 0.0f);
+
+    float *out = map->data.data();
+    const int32_t len = static_cast<int32_t>(map->data.size());
+    const int32_t rev = reverse ? 1 : 0;
+    switch (builder)
+    {
+    case Builder::Geometry:
+        return lfw_build_geometry_map(handle, focal, kCrop, size.width, size.height, rev, step, out, len);
+    case Builder::Tca:
+        return lfw_build_tca_map(handle, focal, kCrop, size.width, size.height, rev, step, out, len);
+    case Builder::Vignetting:
+        return lfw_build_vignetting_map(
+            handle, focal, kCrop, kAperture, kDistance, size.width, size.height, rev, step, out, len);
+    }
+    return -1;
+}
+
+double time_build(Builder builder, uint32_t handle, float focal, const ImageSize &size, int step, double min_seconds, Map *map)
+{
+    double best = 0.0;
+    double total = 0.0;
+    int runs = 0;
+    while (runs == 0 || total < min_seconds)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (build_map(builder, handle, focal, size, step, false, map) != 0)
+        {
+            return -1.0;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = runs == 0 ? seconds : std::min(best, seconds);
+        total += seconds;
+        ++runs;
+    }
+    return best;
+}
+
+void fail(Suite &suite, const char *format, double value, double limit)
+{
+    printf("    FAIL: ");
+    printf(format, value, limit);
+    printf("\n");
+    ++suite.failures;
+}
+
+double max_abs_diff(const Map &a, const Map &b)
+{
+    double worst = 0.0;
+    for (size_t i = 0; i < a.data.size(); ++i)
+    {
+        worst = std::max(worst, static_cast<double>(fabs(a.data[i] - b.data[i])));
+    }
+    return worst;
+}
+
+bool all_finite(const Map &map)
+{
+    return std::all_of(map.data.begin(), map.data.end(), [](float v) { return std::isfinite(v); });
+}
+
+bool bilinear(const Map &map, double x, double y, float *out)
+{
+    if (x < 0.0 || y < 0.0 || x > map.gx - 1 || y > map.gy - 1)
+    {
+        return false;
+    }
+
+    const int x0 = std::min(static_cast<int>(x), map.gx - 2);
+    const int y0 = std::min(static_cast<int>(y), map.gy - 2);
+    const double fx = x - x0;
+    const double fy = y - y0;
+    for (int c = 0; c < map.channels; ++c)
+    {
+        const double top = map.at(x0, y0)[c] * (1.0 - fx) + map.at(x0 + 1, y0)[c] * fx;
+        const double bottom = map.at(x0, y0 + 1)[c] * (1.0 - fx) + map.at(x0 + 1, y0 + 1)[c] * fx;
+        out[c] = static_cast<float>(top * (1.0 - fy) + bottom * fy);
+    }
+    return true;
+}
+
+int32_t read_ramp(void *, int32_t x, int32_t y, int32_t width, int32_t height, float *out)
+{
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            *out++ = static_cast<float>(x + i);
+            *out++ = static_cast<float>(y + j);
+            *out++ = 0.0f;
+        }
+    }
+    return 0;
+}
+
+int32_t write_ramp(void *user, int32_t x, int32_t y, int32_t width, int32_t height, const float *tile)
+{
+    Ramp &ramp = *static_cast<Ramp *>(user);
+    for (int j = 0; j < height; ++j)
+    {
+        memcpy(&ramp.out[(static_cast<size_t>(y + j) * ramp.width + x) * 3],
+               tile + static_cast<size_t>(j) * width * 3,
+               static_cast<size_t>(width) * 3 * sizeof(float));
+    }
+    return 0;
+}
+
+std::string pruning_document(int other_lenses)
+{
+    std::string xml = "<lensdatabase version=\"2\">\n"
+                      "    <!-- <lens><maker>Commented</maker><mount>LFW Other</mount></lens> -->\n"
+                      "    <mount><name>LFW Other</name></mount>\n"
+                      "    <camera><maker>LFW Synthetic</maker><model>Body A</model><mount>LFW Synthetic</mount>"
+                      "<cropfactor>1</cropfactor></camera>\n"
+                      "    <camera><maker>LFW Other</maker><model>Body B</model><mount>LFW Other</mount>"
+                      "<cropfactor>1.5</cropfactor></camera>\n"
+                      "    <lens><maker lang=\"en\">lfw synthetic</maker><maker>LFW Synthetic</maker>"
+                      "<model>Kept 50mm f/2</model><mount>LFW Other</mount><mount> lfw synthetic </mount>"
+                      "<cropfactor>1</cropfactor><calibration><distortion model=\"poly3\" focal=\"50\" k1=\"-0.01\"/>"
+                      "</calibration></lens>\n";
+    for (int i = 0; i < other_lenses; ++i)
+    {
+        const std::string focal = std::to_string(20 + i);
+        xml += "    <lens><maker>LFW Other</maker><model>Other " + focal + "mm f/2.8</model><mount>LFW Other</mount>"
+               "<cropfactor>1</cropfactor><calibration>"
+               "<distortion model=\"poly3\" focal=\"" + focal + "\" k1=\"-0.02\"/>"
+               "<tca model=\"linear\" focal=\"" + focal + "\" kr=\"1.0003\" kb=\"0.9997\"/>"
+               "<vignetting model=\"pa\" focal=\"" + focal + "\" aperture=\"2.8\" distance=\"10\" k1=\"-0.3\" "
+               "k2=\"0.1\" k3=\"-0.04\"/></calibration></lens>\n";
+    }
+    return xml + "</lensdatabase>\n";
+}
+} // namespace lfw_bench
@@ -0,0 +1,210 @@
+#ifndef LFW_BENCH_UTIL_H
+#define LFW_BENCH_UTIL_H
+
+#include "lensfun_wasm_bridge.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef LFW_BENCH_DATA
+#define LFW_BENCH_DATA "synthetic-lenses.xml"
+#endif
+
+namespace lfw_bench
+{
+// Handle of the lens whose maker and model match exactly, or 0. The fuzzy
+// search may also return siblings with similar names, so its result is
+// filtered here.
+inline uint32_t find_lens_handle(const char *maker, const char *model)
+{
+    char *json = lfw_find_lenses_json(nullptr, nullptr, maker, model, 0);
+    if (!json)
+    {
+        return 0;
+    }
+
+    const std::string text(json);
+    lfw_free(json);
+
+    const std::string want_maker = std::string("\"maker\":\"") + maker + "\"";
+    const std::string want_model = std::string("\"model\":\"") + model + "\"";
+    size_t pos = 0;
+    while ((pos = text.find("{\"handle\":", pos)) != std::string::npos)
+    {
+        const size_t end = text.find('}', pos);
+        const std::string object = text.substr(pos, end - pos);
+        if (object.find(want_maker) != std::string::npos && object.find(want_model) != std::string::npos)
+        {
+            return static_cast<uint32_t>(strtoul(object.c_str() + 10, nullptr, 10));
+        }
+        pos = end;
+    }
+    return 0;
+}
+
+// The number after the first `"key":` at or after `from` in `json`, or -1.
+inline double json_number(const std::string &json, const char *key, size_t from = 0)
+{
+    const std::string quoted = std::string("\"") + key + "\":";
+    const size_t pos = json.find(quoted, from);
+    return pos != std::string::npos ? strtod(json.c_str() + pos + quoted.size(), nullptr) : -1.0;
+}
+
+// Points along one side of a map grid sampled every `step` pixels.
+inline int grid_points(int size, int step)
+{
+    return size > 0 && step > 0 ? ((size - 1) / step) + 1 : 0;
+}
+
+// The benchmark suite (lfw_bench.cpp) runs one module per lfw_bench_*.cpp
+// file; the rest of this header is what the modules share.
+
+constexpr float kCrop = 1.0f;
+constexpr float kAperture = 2.8f;
+constexpr float kDistance = 10.0f;
+// LF_MODIFY_TCA, LF_MODIFY_DISTORTION and LF_MODIFY_VIGNETTING; the bench
+// only sees the bridge header.
+constexpr int32_t kModifyTca = 0x01;
+constexpr int32_t kModifyDistortion = 0x08;
+constexpr int32_t kModifyVignetting = 0x02;
+
+// Step-1 maps above this many points are skipped: they only cost memory.
+constexpr int64_t kMaxPoints = int64_t(1) << 21;
+
+enum class Builder
+{
+    Geometry,
+    Tca,
+    Vignetting
+};
+
+struct LensCase
+{
+    const char *slug;
+    const char *model;
+    float focal;
+};
+
+inline constexpr LensCase kLenses[] = {
+    {"poly3-35mm", "Poly3 35mm f/2.8", 35.0f},
+    {"poly5-35mm", "Poly5 35mm f/2.8", 35.0f},
+    {"ptlens-35mm", "PTLens 35mm f/2.8", 35.0f},
+    {"acm-35mm", "ACM 35mm f/2.8", 35.0f},
+    {"zoom-at-35mm", "Poly3 24-70mm f/2.8", 35.0f},
+};
+
+struct ImageSize
+{
+    int width;
+    int height;
+};
+
+// (size - 1) is a multiple of every step, so each grid is symmetric about the
+// image centre and contains it.
+inline constexpr ImageSize kSizes[] = {{257, 193}, {1025, 769}, {4097, 3073}};
+constexpr int kQuickSizes = 2;
+inline constexpr int kSteps[] = {1, 4, 16};
+
+struct Options
+{
+    const char *data = LFW_BENCH_DATA;
+    const char *golden = nullptr;
+    const char *record_golden = nullptr;
+    const char *baseline = nullptr;
+    const char *record_baseline = nullptr;
+    // Modules to run; all of them when empty.
+    std::vector<std::string> modules;
+    float tolerance = 0.01f;
+    float gain_tolerance = 1e-4f;
+    float max_slowdown = 0.25f;
+    double min_seconds = 0.2;
+    bool quick = false;
+};
+
+struct Map
+{
+    int gx = 0;
+    int gy = 0;
+    int channels = 0;
+    std::vector<float> data;
+
+    const float *at(int x, int y) const
+    {
+        return &data[(static_cast<size_t>(y) * gx + x) * channels];
+    }
+};
+
+// A synthetic lens found in the loaded database.
+struct SuiteLens
+{
+    const LensCase *lens;
+    uint32_t handle;
+};
+
+struct Suite
+{
+    Options options;
+    // Every kLenses entry that was found, in order.
+    std::vector<SuiteLens> lenses;
+    std::map<std::string, double> baseline;
+    std::map<std::string, double> measured;
+    int cases = 0;
+    int failures = 0;
+    // Sizes a module runs; the largest only without --quick.
+    int size_count = 0;
+};
+
+const char *builder_name(Builder builder);
+int builder_channels(Builder builder);
+int build_map(Builder builder, uint32_t handle, float focal, const ImageSize &size, int step, bool reverse, Map *map);
+// Best-of-N wall time of one build, repeated until min_seconds have passed.
+double time_build(
+    Builder builder, uint32_t handle, float focal, const ImageSize &size, int step, double min_seconds, Map *map);
+void fail(Suite &suite, const char *format, double value, double limit);
+double max_abs_diff(const Map &a, const Map &b);
+bool all_finite(const Map &map);
+bool bilinear(const Map &map, double x, double y, float *out);
+
+// A tiler output image the size of the source, written by write_ramp.
+struct Ramp
+{
+    int width = 0;
+    std::vector<float> out;
+};
+
+// A source whose pixels hold their own (x, y, 0) coordinates.
+int32_t read_ramp(void *, int32_t x, int32_t y, int32_t width, int32_t height, float *out);
+int32_t write_ramp(void *user, int32_t x, int32_t y, int32_t width, int32_t height, const float *tile);
+
+// A document of lenses and cameras on another mount, next to a few that the
+// filter must keep despite a comment, letter case and a localized maker.
+std::string pruning_document(int other_lenses);
+
+// Modules, in the order lfw_bench runs them. The database modules replace
+// the loaded database, so they come last.
+void run_maps(Suite &suite);
+void run_tiles(Suite &suite);
+void run_descriptor(Suite &suite);
+void run_normalized(Suite &suite);
+void run_crop(Suite &suite);
+void run_thumbnail(Suite &suite);
+void run_cfa(Suite &suite);
+void run_fixed(Suite &suite);
+void run_jobs(Suite &suite);
+void run_blob(Suite &suite);
+void run_step(Suite &suite);
+void run_batch(Suite &suite);
+void run_zoom(Suite &suite);
+void run_prune(Suite &suite);
+void run_compact(Suite &suite);
+void run_cache(Suite &suite);
+#if LFW_ENABLE_DB_PACK
+void run_pack(Suite &suite);
+#endif
+} // namespace lfw_bench
+
+#endif
@@ -0,0 +1,115 @@
+// Zoom module: sequences blended from focal anchors must stay within
+// tolerance of the exact maps across the calibrated range.
+
+#include "lfw_bench_util.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace lfw_bench
+{
+namespace
+{
+// The zoom sequence check sweeps the whole calibrated range of this lens.
+const char *const kZoomModel = "Poly3 24-70mm f/2.8";
+constexpr float kZoomMin = 24.0f;
+constexpr float kZoomMax = 70.0f;
+
+// A zoom sequence blended at every half millimetre must stay within twice the
+// anchor tolerance of the exact map; the tolerance itself is only enforced at
+// the quarter, half and three-quarter probes of each interval. Frames from
+// the double buffer must match the direct blend.
+void zoom_case(Suite &suite, uint32_t handle, Builder builder)
+{
+    const ImageSize size = kSizes[0];
+    const int step = 4;
+    const float tolerance = builder == Builder::Vignetting ? suite.options.gain_tolerance : suite.options.tolerance;
+    const std::string name = std::string("zoom/") + builder_name(builder);
+    ++suite.cases;
+    const int32_t zoom = lfw_zoom_create(static_cast<int32_t>(builder),
+                                         handle,
+                                         kZoomMin,
+                                         kZoomMax,
+                                         kCrop,
+                                         kAperture,
+                                         kDistance,
+                                         size.width,
+                                         size.height,
+                                         0,
+                                         step,
+                                         tolerance,
+                                         32);
+    if (zoom <= 0)
+    {
+        printf("%s create failed with code %d\n", name.c_str(), zoom);
+        ++suite.failures;
+        return;
+    }
+
+    Map exact;
+    std::vector<float> blended;
+    double worst = 0.0;
+    double blend_seconds = 0.0;
+    int frames = 0;
+    for (float focal = kZoomMin; focal <= kZoomMax; focal += 0.5f, ++frames)
+    {
+        if (build_map(builder, handle, focal, size, step, false, &exact) != 0)
+        {
+            printf("%s exact map at %g failed\n", name.c_str(), focal);
+            ++suite.failures;
+            break;
+        }
+        blended.resize(exact.data.size());
+        const auto start = std::chrono::steady_clock::now();
+        const int32_t rc =
+            lfw_zoom_blend(static_cast<uint32_t>(zoom), focal, blended.data(), static_cast<int32_t>(blended.size()));
+        blend_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (rc != 0)
+        {
+            printf("%s blend at %g failed with code %d\n", name.c_str(), focal, rc);
+            ++suite.failures;
+            break;
+        }
+        for (size_t i = 0; i < blended.size(); ++i)
+        {
+            worst = std::max(worst, static_cast<double>(fabsf(blended[i] - exact.data[i])));
+        }
+    }
+    bool buffered = frames > 0;
+    for (int frame = 0; buffered && frame < 4; ++frame)
+    {
+        const float focal = kZoomMin + (kZoomMax - kZoomMin) * (frame + 0.3f) / 4.0f;
+        lfw_zoom_blend(static_cast<uint32_t>(zoom), focal, blended.data(), static_cast<int32_t>(blended.size()));
+        const float *acquired = lfw_zoom_prepare(static_cast<uint32_t>(zoom), focal) == 0
+                                    ? lfw_zoom_acquire(static_cast<uint32_t>(zoom))
+                                    : nullptr;
+        buffered = acquired && std::equal(blended.begin(), blended.end(), acquired);
+    }
+    lfw_zoom_destroy(static_cast<uint32_t>(zoom));
+
+    printf("%-44s max error %.5f %9.2f us/frame\n", name.c_str(), worst, blend_seconds / std::max(frames, 1) * 1e6);
+    if (worst > 2.0 * tolerance)
+    {
+        fail(suite, "zoom blend off by %g (limit %g)", worst, 2.0 * tolerance);
+    }
+    if (!buffered)
+    {
+        fail(suite, "double-buffered frame differs from the blend (%g, expected %g)", 1.0, 0.0);
+    }
+}
+} // namespace
+
+void run_zoom(Suite &suite)
+{
+    const uint32_t handle = find_lens_handle("LFW Synthetic", kZoomModel);
+    const Builder builders[] = {Builder::Geometry, Builder::Tca, Builder::Vignetting};
+    for (Builder builder : builders)
+    {
+        zoom_case(suite, handle, builder);
+    }
+}
+} // namespace lfw_bench
@@ -0,0 +1,455 @@
+// Replays a call log recorded by the bridge's capture mode
+// (lfw_capture_start / LensfunClient.startCapture) against the native build.
+//
+//   lfw_replay LOG [--db PATH] [--threads 1,4] [--repeat N] [--memory] [--strict]
+//
+// Each thread count is one pass over the whole log from a clean state.
+// Database events (init, dispose, document loads and unloads) run on the
+// main thread in log order. The queries between two of them (searches, mod
+// lookups, map builds, correction descriptors, valid crops, thumbnails, CFA
+// vignetting, map blob exports) are dealt round-robin to the worker threads, each on its own
+// context sharing the main thread's database, and all workers finish before
+// the next database event. Context events in the log are replayed only
+// single-threaded, where each recorded context maps to a new one. Map
+// stream, tiler, zoom, normalized map, fixed map, map job and batch calls
+// are stateful and also stay on the main thread. A log that does not begin
+// with lfw_init is replayed against --db.
+//
+// A pass reports wall time, call throughput and per-entry-point latency
+// percentiles plus the number of calls that returned an error. --memory also
+// turns on the allocation tracker and reports the peak tracked heap; the peak
+// RSS of the process is always printed. Calls that failed when recorded (say,
+// a lens without TCA data) fail again on replay, so --strict instead exits
+// non-zero when a pass's per-entry error counts differ from the first pass.
+//
+// Log parsing lives in lfw_replay_log.cpp, the stateless queries in
+// lfw_replay_query.cpp and each stateful module in its own
+// lfw_replay_<module>.cpp.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace lfw_replay;
+
+struct Options
+{
+    const char *log = nullptr;
+    const char *db = nullptr;
+    std::vector<int> threads;
+    int repeat = 1;
+    bool memory = false;
+    bool strict = false;
+};
+
+class Replayer
+{
+public:
+    Replayer(const Options &options, const std::vector<Event> &events)
+        : options_(options),
+          events_(events)
+    {
+        modules_.push_back(make_stream_replay());
+        modules_.push_back(make_tiler_replay());
+        modules_.push_back(make_zoom_replay());
+        modules_.push_back(make_normalized_replay());
+        modules_.push_back(make_fixed_replay());
+        modules_.push_back(make_job_replay());
+        modules_.push_back(make_batch_replay());
+    }
+
+    // Returns the latency samples of one pass and its wall time.
+    std::vector<Sample> run(int threads, double *seconds)
+    {
+        samples_.clear();
+        contexts_.clear();
+        lenses_.clear();
+        lfw_context_bind(0);
+        lfw_dispose();
+        if (events_.empty() || !is_init(events_.front().kind))
+        {
+            // Captures started after init (the usual case from JavaScript)
+            // start against the --db database, outside the timed pass.
+            lfw_init(options_.db);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < options_.repeat; ++r)
+        {
+            size_t i = 0;
+            while (i < events_.size())
+            {
+                if (!is_query(events_[i].kind))
+                {
+                    run_state_event(events_[i], threads);
+                    ++i;
+                    continue;
+                }
+
+                size_t end = i;
+                while (end < events_.size() && is_query(events_[end].kind))
+                {
+                    ++end;
+                }
+                resolve_lenses(events_, i, end, &lenses_);
+                if (threads <= 1)
+                {
+                    run_segment(i, end, 0, 1, &samples_);
+                }
+                else
+                {
+                    run_parallel(i, end, threads);
+                }
+                i = end;
+            }
+        }
+        *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lfw_context_bind(0);
+        for (const auto &context : contexts_)
+        {
+            lfw_context_destroy(context.second);
+        }
+        for (const std::unique_ptr<StateReplay> &module : modules_)
+        {
+            module->reset();
+        }
+        return samples_;
+    }
+
+private:
+    void run_state_event(const Event &event, int threads)
+    {
+        for (const std::unique_ptr<StateReplay> &module : modules_)
+        {
+            if (module->handles(event.kind))
+            {
+                samples_.push_back(module->run(event));
+                return;
+            }
+        }
+
+        const std::vector<Field> &a = event.args;
+        const auto start = std::chrono::steady_clock::now();
+        int32_t rc = 0;
+        switch (event.kind)
+        {
+        case Kind::Init:
+            rc = lfw_init(options_.db ? options_.db : a[0].c_str());
+            break;
+        case Kind::InitFiltered:
+            rc = lfw_init_filtered(options_.db ? options_.db : a[0].c_str(), a[1].c_str(), a[2].c_str());
+            break;
+        case Kind::Dispose:
+            lfw_dispose();
+            break;
+        case Kind::ContextCreate:
+            if (threads <= 1)
+            {
+                contexts_[a[0].i32()] = lfw_context_create();
+            }
+            break;
+        case Kind::ContextDestroy:
+            if (threads <= 1)
+            {
+                rc = lfw_context_destroy(mapped_context(a[0].i32()));
+                contexts_.erase(a[0].i32());
+            }
+            break;
+        case Kind::ContextBind:
+            if (threads <= 1)
+            {
+                rc = lfw_context_bind(mapped_context(a[0].i32()));
+            }
+            break;
+        case Kind::DbLoadXml:
+            rc = lfw_db_load_xml(a[0].c_str(), a[1].value.data(), static_cast<int32_t>(a[1].value.size()));
+            break;
+        case Kind::DbLoadFile:
+            rc = lfw_db_load_file(a[0].c_str());
+            break;
+        case Kind::DbUnload:
+            rc = lfw_db_unload(a[0].c_str());
+            break;
+        case Kind::DbCompact:
+            // 1 when it compacted, 0 when there was nothing to do.
+            rc = std::min(lfw_db_compact(a[0].i32()), 0);
+            break;
+        default:
+            break;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        samples_.push_back(make_sample(event.kind, elapsed, rc != 0));
+
+        // Handles change with every load, unload or context switch.
+        lenses_.clear();
+    }
+
+    uint32_t mapped_context(int32_t recorded) const
+    {
+        const auto it = contexts_.find(recorded);
+        return it != contexts_.end() ? it->second : 0;
+    }
+
+    void run_segment(size_t begin, size_t end, size_t offset, size_t stride, std::vector<Sample> *samples) const
+    {
+        std::vector<float> scratch;
+        std::vector<uint16_t> mosaic;
+        for (size_t i = begin + offset; i < end; i += stride)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const int32_t rc = run_query(events_[i], lenses_, &scratch, &mosaic);
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            samples->push_back(make_sample(events_[i].kind, elapsed, rc != 0));
+        }
+    }
+
+    void run_parallel(size_t begin, size_t end, int threads)
+    {
+        std::vector<uint32_t> contexts(threads);
+        for (uint32_t &context : contexts)
+        {
+            context = lfw_context_create();
+        }
+
+        std::vector<std::vector<Sample>> per_thread(threads);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([this, begin, end, t, threads, &contexts, &per_thread] {
+                lfw_context_bind(contexts[t]);
+                run_segment(begin, end, static_cast<size_t>(t), static_cast<size_t>(threads), &per_thread[t]);
+                lfw_context_bind(0);
+            });
+        }
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+
+        for (int t = 0; t < threads; ++t)
+        {
+            lfw_context_destroy(contexts[t]);
+            samples_.insert(samples_.end(), per_thread[t].begin(), per_thread[t].end());
+        }
+    }
+
+    const Options &options_;
+    const std::vector<Event> &events_;
+    std::vector<Sample> samples_;
+    std::map<int32_t, uint32_t> contexts_;
+    std::vector<std::unique_ptr<StateReplay>> modules_;
+    LensCache lenses_;
+};
+
+double percentile_ms(const std::vector<uint64_t> &sorted, double fraction)
+{
+    const size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[index]) / 1e6;
+}
+
+// Prints one pass and returns the number of failed calls per entry point.
+std::vector<size_t> report(int threads, double seconds, const std::vector<Sample> &samples)
+{
+    printf("\nthreads %d: %zu calls in %.3f s, %.1f calls/s\n",
+           threads,
+           samples.size(),
+           seconds,
+           static_cast<double>(samples.size()) / seconds);
+    printf("  %-26s %8s %8s %10s %10s %10s %10s\n", "entry point", "calls", "errors", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+    std::vector<size_t> failures(kKindCount, 0);
+    for (int k = 0; k < kKindCount; ++k)
+    {
+        std::vector<uint64_t> ns;
+        size_t errors = 0;
+        for (const Sample &sample : samples)
+        {
+            if (static_cast<int>(sample.kind) == k)
+            {
+                ns.push_back(sample.ns);
+                errors += sample.failed ? 1 : 0;
+            }
+        }
+        if (ns.empty())
+        {
+            continue;
+        }
+
+        std::sort(ns.begin(), ns.end());
+        failures[k] = errors;
+        printf("  %-26s %8zu %8zu %10.3f %10.3f %10.3f %10.3f\n",
+               kEntries[k].name,
+               ns.size(),
+               errors,
+               percentile_ms(ns, 0.50),
+               percentile_ms(ns, 0.90),
+               percentile_ms(ns, 0.99),
+               static_cast<double>(ns.back()) / 1e6);
+    }
+    return failures;
+}
+
+// Top-level peakBytes of lfw_alloc_report_json; it is the first one written.
+long long tracked_peak_bytes()
+{
+    char *json = lfw_alloc_report_json();
+    const char *peak = json ? strstr(json, "\"peakBytes\":") : nullptr;
+    const long long bytes = peak ? strtoll(peak + 12, nullptr, 10) : -1;
+    lfw_free(json);
+    return bytes;
+}
+
+bool parse_threads(const char *list, std::vector<int> *threads)
+{
+    threads->clear();
+    const char *p = list;
+    while (*p)
+    {
+        char *end = nullptr;
+        const long value = strtol(p, &end, 10);
+        if (end == p || value <= 0 || value > 1024)
+        {
+            return false;
+        }
+        threads->push_back(static_cast<int>(value));
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+        {
+            return false;
+        }
+    }
+    return !threads->empty();
+}
+
+bool parse_options(int argc, char **argv, Options *options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--memory") == 0)
+        {
+            options->memory = true;
+        }
+        else if (strcmp(arg, "--strict") == 0)
+        {
+            options->strict = true;
+        }
+        else if (strcmp(arg, "--db") == 0 && i + 1 < argc)
+        {
+            options->db = argv[++i];
+        }
+        else if (strcmp(arg, "--threads") == 0 && i + 1 < argc)
+        {
+            if (!parse_threads(argv[++i], &options->threads))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--repeat") == 0 && i + 1 < argc)
+        {
+            options->repeat = atoi(argv[++i]);
+            if (options->repeat <= 0)
+            {
+                return false;
+            }
+        }
+        else if (arg[0] != '-' && !options->log)
+        {
+            options->log = arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (options->threads.empty())
+    {
+        const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        options->threads.push_back(1);
+        if (hardware > 1)
+        {
+            options->threads.push_back(hardware);
+        }
+    }
+    return options->log != nullptr;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, &options))
+    {
+        fprintf(stderr, "usage: lfw_replay LOG [--db PATH] [--threads 1,4] [--repeat N] [--memory] [--strict]\n");
+        return 2;
+    }
+
+    std::vector<Event> events;
+    if (!read_log(options.log, &events))
+    {
+        return 2;
+    }
+    printf("%zu recorded calls from %s\n", events.size(), options.log);
+    if (!options.db && (events.empty() || !is_init(events.front().kind)))
+    {
+        fprintf(stderr, "lfw_replay: %s does not start with lfw_init; pass --db\n", options.log);
+        return 2;
+    }
+
+    Replayer replayer(options, events);
+    std::vector<size_t> first_failures;
+    bool diverged = false;
+    for (int threads : options.threads)
+    {
+        if (options.memory)
+        {
+            lfw_alloc_tracking_start();
+        }
+
+        double seconds = 0.0;
+        const std::vector<Sample> samples = replayer.run(threads, &seconds);
+        const std::vector<size_t> failures = report(threads, seconds, samples);
+        if (first_failures.empty())
+        {
+            first_failures = failures;
+        }
+        else if (failures != first_failures)
+        {
+            fprintf(stderr, "lfw_replay: threads %d failed a different set of calls than the first pass\n", threads);
+            diverged = true;
+        }
+
+        if (options.memory)
+        {
+            printf("  peak tracked heap %.2f MiB\n", static_cast<double>(tracked_peak_bytes()) / (1024.0 * 1024.0));
+            lfw_alloc_tracking_stop();
+        }
+    }
+
+    lfw_dispose();
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        printf("\npeak RSS %.2f MiB\n", static_cast<double>(usage.ru_maxrss) / 1024.0);
+    }
+    return options.strict && diverged ? 1 : 0;
+}
+
@@ -0,0 +1,173 @@
+#ifndef LFW_REPLAY_H
+#define LFW_REPLAY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+// Floats in a packed correction descriptor (kDescriptorFloats); the replay
+// tool only sees the bridge header.
+constexpr int kDescriptorFloats = 26;
+
+enum class Kind
+{
+    Init,
+    InitFiltered,
+    Dispose,
+    ContextCreate,
+    ContextDestroy,
+    ContextBind,
+    DbLoadXml,
+    DbLoadFile,
+    DbUnload,
+    DbCompact,
+    FindLenses,
+    FindCameras,
+    AvailableMods,
+    BuildGeometryMap,
+    BuildTcaMap,
+    BuildVignettingMap,
+    MapStreamCreate,
+    MapStreamRows,
+    MapStreamDestroy,
+    TilerCreate,
+    TilerBeginTile,
+    TilerFinishTile,
+    TilerRun,
+    TilerDestroy,
+    ZoomCreate,
+    ZoomBlend,
+    ZoomPrepare,
+    ZoomAcquire,
+    ZoomDestroy,
+    CorrectionDescriptor,
+    DescriptorBuildMap,
+    NormalizedMapCreate,
+    NormalizedMapSample,
+    NormalizedMapDestroy,
+    ValidCrop,
+    Thumbnail,
+    CfaVignetting,
+    FixedMapCreate,
+    FixedMapRemap,
+    FixedMapDestroy,
+    MapJobCreate,
+    MapJobRun,
+    MapJobCancel,
+    MapJobDestroy,
+    BatchCreate,
+    BatchAdd,
+    BatchSetPixels,
+    BatchRun,
+    BatchItemGroup,
+    BatchItemStatus,
+    BatchDestroy,
+    MapBlobExport,
+    MapBlobImport,
+    ChooseStep,
+    Count
+};
+
+constexpr int kKindCount = static_cast<int>(Kind::Count);
+
+struct EntryInfo
+{
+    const char *name;
+    int args;
+    bool query;
+};
+
+// Indexed by Kind.
+extern const EntryInfo kEntries[kKindCount];
+
+struct Field
+{
+    bool null = false;
+    std::string value;
+
+    const char *c_str() const
+    {
+        return null ? nullptr : value.c_str();
+    }
+
+    int32_t i32() const
+    {
+        return static_cast<int32_t>(strtol(value.c_str(), nullptr, 10));
+    }
+
+    float f32() const
+    {
+        return static_cast<float>(strtod(value.c_str(), nullptr));
+    }
+};
+
+struct Event
+{
+    Kind kind;
+    std::vector<Field> args;
+};
+
+struct Sample
+{
+    Kind kind;
+    uint64_t ns;
+    bool failed;
+};
+
+inline Sample make_sample(Kind kind, std::chrono::steady_clock::duration elapsed, bool failed)
+{
+    return {kind,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+            failed};
+}
+
+// Lens handles of one database, by maker and model.
+using LensCache = std::map<std::pair<std::string, std::string>, uint32_t>;
+
+// lfw_replay_log.cpp
+bool read_log(const char *path, std::vector<Event> *events);
+bool is_query(Kind kind);
+bool is_init(Kind kind);
+
+// lfw_replay_query.cpp: stateless queries, which may run on any thread.
+// Resolves every lens the queries in [begin, end) use, so the lookups are
+// not counted as replayed traffic.
+void resolve_lenses(const std::vector<Event> &events, size_t begin, size_t end, LensCache *lenses);
+// Returns the bridge's status code; searches and mod lookups cannot fail.
+int32_t run_query(
+    const Event &event, const LensCache &lenses, std::vector<float> *scratch, std::vector<uint16_t> *mosaic);
+
+// The calls of one stateful module (streams, tilers, ...), replayed on the
+// main thread in log order whatever the thread count. Each module maps the
+// handles recorded in the log to the ones it gets on replay.
+class StateReplay
+{
+public:
+    virtual ~StateReplay() = default;
+
+    virtual bool handles(Kind kind) const = 0;
+    // Times the call itself, without the lens lookup and buffer sizing.
+    virtual Sample run(const Event &event) = 0;
+    // Destroys whatever the log left alive, at the end of a pass.
+    virtual void reset() = 0;
+};
+
+// One per lfw_replay_<module>.cpp.
+std::unique_ptr<StateReplay> make_stream_replay();
+std::unique_ptr<StateReplay> make_tiler_replay();
+std::unique_ptr<StateReplay> make_zoom_replay();
+std::unique_ptr<StateReplay> make_normalized_replay();
+std::unique_ptr<StateReplay> make_fixed_replay();
+std::unique_ptr<StateReplay> make_job_replay();
+std::unique_ptr<StateReplay> make_batch_replay();
+} // namespace lfw_replay
+
+#endif
@@ -0,0 +1,155 @@
+// Batch replay: correction batches sharing maps across items.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+
+class BatchReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::BatchCreate || kind == Kind::BatchAdd || kind == Kind::BatchSetPixels ||
+               kind == Kind::BatchRun || kind == Kind::BatchItemGroup || kind == Kind::BatchItemStatus ||
+               kind == Kind::BatchDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        const auto it = batches_.find(recorded);
+        ReplayBatch *batch = it != batches_.end() ? &it->second : nullptr;
+        const uint32_t handle = batch ? batch->handle : 0;
+        int32_t rc = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        if (event.kind == Kind::BatchCreate)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_batch_create();
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc > 0)
+            {
+                batches_[recorded].handle = static_cast<uint32_t>(rc);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::BatchAdd)
+        {
+            const uint32_t lens = a[1].null || a[2].null ? 0 : find_lens_handle(a[1].c_str(), a[2].c_str());
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_batch_add(handle,
+                               lens,
+                               a[3].f32(),
+                               a[4].f32(),
+                               a[5].f32(),
+                               a[6].f32(),
+                               a[7].i32(),
+                               a[8].i32(),
+                               a[9].i32(),
+                               a[10].i32(),
+                               a[11].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc >= 0 && batch)
+            {
+                batch->pixels.resize(rc + 1);
+                batch->pixels[rc] = static_cast<size_t>(std::max(a[7].i32(), 0)) * std::max(a[8].i32(), 0);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::BatchSetPixels)
+        {
+            const int32_t item = a[1].i32();
+            const int32_t channels = a[2].i32();
+            const size_t floats =
+                batch && item >= 0 && static_cast<size_t>(item) < batch->pixels.size()
+                    ? batch->pixels[item] * static_cast<size_t>(std::max(channels, 0))
+                    : 0;
+            float *source = nullptr;
+            float *output = nullptr;
+            if (batch)
+            {
+                batch->buffers.emplace_back(floats, 0.0f);
+                source = batch->buffers.back().data();
+                batch->buffers.emplace_back(floats, 0.0f);
+                output = batch->buffers.back().data();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_batch_set_pixels(handle, item, source, output, channels);
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        else if (event.kind == Kind::BatchRun)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_batch_run(handle, a[1].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+            // Group counts are not errors.
+            rc = std::min(rc, 0);
+        }
+        else if (event.kind == Kind::BatchItemGroup || event.kind == Kind::BatchItemStatus)
+        {
+            const bool group = event.kind == Kind::BatchItemGroup;
+            const auto start = std::chrono::steady_clock::now();
+            rc = group ? lfw_batch_item_group(handle, a[1].i32()) : lfw_batch_item_status(handle, a[1].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+            // An item without a group means the replay diverged; a status is
+            // the outcome of a build, as in the recorded session.
+            rc = group && rc < 0 ? -1 : 0;
+        }
+        else
+        {
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_batch_destroy(handle);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (it != batches_.end())
+            {
+                batches_.erase(it);
+            }
+        }
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &batch : batches_)
+        {
+            lfw_batch_destroy(batch.second.handle);
+        }
+        batches_.clear();
+    }
+
+private:
+    // A replayed batch, the pixels of each of its items and the images handed
+    // to it.
+    struct ReplayBatch
+    {
+        uint32_t handle = 0;
+        std::vector<size_t> pixels;
+        std::list<std::vector<float>> buffers;
+    };
+    // Recorded batch handle to replayed batch.
+    std::map<int32_t, ReplayBatch> batches_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_batch_replay()
+{
+    return std::make_unique<BatchReplay>();
+}
+} // namespace lfw_replay
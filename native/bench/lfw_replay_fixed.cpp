@@ -0,0 +1,98 @@
+// Fixed map replay: fixed-point RGBA8 remaps.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+
+class FixedReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::FixedMapCreate || kind == Kind::FixedMapRemap || kind == Kind::FixedMapDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        const auto it = fixed_.find(recorded);
+        const uint32_t map = it != fixed_.end() ? it->second.first : 0;
+        int32_t rc = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        if (event.kind == Kind::FixedMapCreate)
+        {
+            const uint32_t lens = a[2].null || a[3].null ? 0 : find_lens_handle(a[2].c_str(), a[3].c_str());
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_fixed_map_create(a[1].i32(), lens, a[4].f32(), a[5].f32(), a[6].i32(), a[7].i32(), a[8].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc > 0)
+            {
+                const size_t bytes = static_cast<size_t>(std::max(a[6].i32(), 0)) * std::max(a[7].i32(), 0) * 4;
+                fixed_[recorded] = std::make_pair(static_cast<uint32_t>(rc), bytes);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::FixedMapRemap)
+        {
+            const size_t bytes = it != fixed_.end() ? it->second.second : 0;
+            if (fixed_src_.size() < std::max<size_t>(bytes, 1))
+            {
+                fixed_src_.resize(std::max<size_t>(bytes, 1));
+                fixed_dst_.resize(fixed_src_.size());
+            }
+            const int32_t len = static_cast<int32_t>(fixed_src_.size());
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_fixed_map_remap(map, fixed_src_.data(), len, fixed_dst_.data(), len, a[1].i32(), a[2].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        else
+        {
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_fixed_map_destroy(map);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (it != fixed_.end())
+            {
+                fixed_.erase(it);
+            }
+        }
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &map : fixed_)
+        {
+            lfw_fixed_map_destroy(map.second.first);
+        }
+        fixed_.clear();
+    }
+
+private:
+    // Recorded fixed map handle to replayed handle and bytes per image.
+    std::map<int32_t, std::pair<uint32_t, size_t>> fixed_;
+    std::vector<uint8_t> fixed_src_;
+    std::vector<uint8_t> fixed_dst_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_fixed_replay()
+{
+    return std::make_unique<FixedReplay>();
+}
+} // namespace lfw_replay
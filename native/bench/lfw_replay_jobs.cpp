@@ -0,0 +1,101 @@
+// Map job replay: progressive, cancellable map builds.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+
+class JobReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::MapJobCreate || kind == Kind::MapJobRun || kind == Kind::MapJobCancel ||
+               kind == Kind::MapJobDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        const auto it = jobs_.find(recorded);
+        const uint32_t job = it != jobs_.end() ? it->second : 0;
+        int32_t rc = 0;
+        const uint32_t lens = event.kind != Kind::MapJobCreate || a[2].null || a[3].null
+                                  ? 0
+                                  : find_lens_handle(a[2].c_str(), a[3].c_str());
+        const auto start = std::chrono::steady_clock::now();
+        switch (event.kind)
+        {
+        case Kind::MapJobCreate:
+            rc = lfw_map_job_create(a[1].i32(),
+                                    lens,
+                                    a[4].f32(),
+                                    a[5].f32(),
+                                    a[6].f32(),
+                                    a[7].f32(),
+                                    a[8].i32(),
+                                    a[9].i32(),
+                                    a[10].i32(),
+                                    a[11].i32(),
+                                    a[12].i32());
+            break;
+        case Kind::MapJobRun:
+            rc = lfw_map_job_run(job, a[1].i32());
+            break;
+        case Kind::MapJobCancel:
+            rc = lfw_map_job_cancel(job);
+            break;
+        default:
+            rc = lfw_map_job_destroy(job);
+            break;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (event.kind == Kind::MapJobCreate && rc > 0)
+        {
+            jobs_[recorded] = static_cast<uint32_t>(rc);
+        }
+        else if (event.kind == Kind::MapJobDestroy && it != jobs_.end())
+        {
+            jobs_.erase(it);
+        }
+        // Handles and stages are not errors.
+        rc = std::min(rc, 0);
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &job : jobs_)
+        {
+            lfw_map_job_destroy(job.second);
+        }
+        jobs_.clear();
+    }
+
+private:
+    // Recorded map job handle to replayed handle.
+    std::map<int32_t, uint32_t> jobs_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_job_replay()
+{
+    return std::make_unique<JobReplay>();
+}
+} // namespace lfw_replay
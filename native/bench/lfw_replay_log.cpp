@@ -0,0 +1,198 @@
+// Call log parsing for lfw_replay; the format is described in
+// native/src/lfw_capture.h.
+
+#include "lfw_replay.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+const EntryInfo kEntries[kKindCount] = {
+    {"lfw_init", 1, false},
+    {"lfw_init_filtered", 3, false},
+    {"lfw_dispose", 0, false},
+    {"lfw_context_create", 1, false},
+    {"lfw_context_destroy", 1, false},
+    {"lfw_context_bind", 1, false},
+    {"lfw_db_load_xml", 2, false},
+    {"lfw_db_load_file", 1, false},
+    {"lfw_db_unload", 1, false},
+    {"lfw_db_compact", 1, false},
+    {"lfw_find_lenses_json", 5, true},
+    {"lfw_find_cameras_json", 3, true},
+    {"lfw_available_mods", 3, true},
+    {"lfw_build_geometry_map", 8, true},
+    {"lfw_build_tca_map", 8, true},
+    {"lfw_build_vignetting_map", 10, true},
+    {"lfw_map_stream_create", 12, false},
+    {"lfw_map_stream_rows", 3, false},
+    {"lfw_map_stream_destroy", 1, false},
+    {"lfw_tiler_create", 12, false},
+    {"lfw_tiler_begin_tile", 2, false},
+    {"lfw_tiler_finish_tile", 1, false},
+    {"lfw_tiler_run", 1, false},
+    {"lfw_tiler_destroy", 1, false},
+    {"lfw_zoom_create", 15, false},
+    {"lfw_zoom_blend", 2, false},
+    {"lfw_zoom_prepare", 2, false},
+    {"lfw_zoom_acquire", 1, false},
+    {"lfw_zoom_destroy", 1, false},
+    {"lfw_correction_descriptor", 9, true},
+    {"lfw_descriptor_build_map", 3 + kDescriptorFloats, true},
+    {"lfw_normalized_map_create", 11, false},
+    {"lfw_normalized_map_sample", 4, false},
+    {"lfw_normalized_map_destroy", 1, false},
+    {"lfw_valid_crop", 7, true},
+    {"lfw_thumbnail", 13, true},
+    {"lfw_cfa_vignetting", 13, true},
+    {"lfw_fixed_map_create", 9, false},
+    {"lfw_fixed_map_remap", 3, false},
+    {"lfw_fixed_map_destroy", 1, false},
+    {"lfw_map_job_create", 13, false},
+    {"lfw_map_job_run", 2, false},
+    {"lfw_map_job_cancel", 1, false},
+    {"lfw_map_job_destroy", 1, false},
+    {"lfw_batch_create", 1, false},
+    {"lfw_batch_add", 12, false},
+    {"lfw_batch_set_pixels", 3, false},
+    {"lfw_batch_run", 2, false},
+    {"lfw_batch_item_group", 2, false},
+    {"lfw_batch_item_status", 2, false},
+    {"lfw_batch_destroy", 1, false},
+    {"lfw_map_blob_export", 11, true},
+    {"lfw_map_blob_import", 12, true},
+    {"lfw_choose_step", 12, true},
+};
+
+namespace
+{
+bool decode_field(const std::string &raw, Field *field)
+{
+    if (raw == "~")
+    {
+        field->null = true;
+        return true;
+    }
+
+    field->value.clear();
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        if (raw[i] != '%')
+        {
+            field->value += raw[i];
+            continue;
+        }
+        if (i + 2 >= raw.size())
+        {
+            return false;
+        }
+        field->value += static_cast<char>(strtol(raw.substr(i + 1, 2).c_str(), nullptr, 16));
+        i += 2;
+    }
+    return true;
+}
+
+bool parse_line(const std::string &line, Event *event)
+{
+    std::vector<std::string> raw;
+    size_t start = 0;
+    while (true)
+    {
+        const size_t tab = line.find('\t', start);
+        raw.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos)
+        {
+            break;
+        }
+        start = tab + 1;
+    }
+
+    // <start us> <thread> <entry> <args...>
+    if (raw.size() < 3)
+    {
+        return false;
+    }
+
+    for (int k = 0; k < kKindCount; ++k)
+    {
+        if (raw[2] != kEntries[k].name)
+        {
+            continue;
+        }
+        if (static_cast<int>(raw.size()) - 3 != kEntries[k].args)
+        {
+            return false;
+        }
+
+        event->kind = static_cast<Kind>(k);
+        event->args.resize(raw.size() - 3);
+        for (size_t i = 3; i < raw.size(); ++i)
+        {
+            if (!decode_field(raw[i], &event->args[i - 3]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+bool read_log(const char *path, std::vector<Event> *events)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "lfw_replay: cannot open %s\n", path);
+        return false;
+    }
+
+    std::string line;
+    int line_no = 0;
+    bool ok = true;
+    int c = 0;
+    while (ok && (c = fgetc(file)) != EOF)
+    {
+        if (c != '\n')
+        {
+            line += static_cast<char>(c);
+            continue;
+        }
+
+        ++line_no;
+        Event event;
+        if (!line.empty() && line[0] != '#')
+        {
+            if (parse_line(line, &event))
+            {
+                events->push_back(std::move(event));
+            }
+            else
+            {
+                fprintf(stderr, "lfw_replay: %s:%d: malformed line\n", path, line_no);
+                ok = false;
+            }
+        }
+        line.clear();
+    }
+    fclose(file);
+    return ok;
+}
+
+bool is_query(Kind kind)
+{
+    return kEntries[static_cast<int>(kind)].query;
+}
+
+bool is_init(Kind kind)
+{
+    return kind == Kind::Init || kind == Kind::InitFiltered;
+}
+} // namespace lfw_replay
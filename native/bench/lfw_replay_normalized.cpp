@@ -0,0 +1,102 @@
+// Normalized map replay: resolution-independent maps and their sampler.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+using lfw_bench::grid_points;
+
+class NormalizedReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::NormalizedMapCreate || kind == Kind::NormalizedMapSample ||
+               kind == Kind::NormalizedMapDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        const auto it = normalized_.find(recorded);
+        const uint32_t map = it != normalized_.end() ? it->second.first : 0;
+        int32_t rc = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        if (event.kind == Kind::NormalizedMapCreate)
+        {
+            const uint32_t lens = a[2].null || a[3].null ? 0 : find_lens_handle(a[2].c_str(), a[3].c_str());
+            const int32_t kind = a[1].i32();
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_normalized_map_create(
+                kind, lens, a[4].f32(), a[5].f32(), a[6].f32(), a[7].f32(), a[8].f32(), a[9].i32(), a[10].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc > 0)
+            {
+                normalized_[recorded] = std::make_pair(static_cast<uint32_t>(rc), kind == 0 ? 2 : kind == 1 ? 6 : 3);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::NormalizedMapSample)
+        {
+            const int32_t step = a[3].i32();
+            const int channels = it != normalized_.end() ? it->second.second : 1;
+            const size_t needed =
+                static_cast<size_t>(grid_points(a[1].i32(), step)) * grid_points(a[2].i32(), step) * channels;
+            if (normalized_out_.size() < std::max<size_t>(needed, 1))
+            {
+                normalized_out_.resize(std::max<size_t>(needed, 1));
+            }
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_normalized_map_sample(
+                map, a[1].i32(), a[2].i32(), step, normalized_out_.data(), static_cast<int32_t>(normalized_out_.size()));
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        else
+        {
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_normalized_map_destroy(map);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (it != normalized_.end())
+            {
+                normalized_.erase(it);
+            }
+        }
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &map : normalized_)
+        {
+            lfw_normalized_map_destroy(map.second.first);
+        }
+        normalized_.clear();
+    }
+
+private:
+    // Recorded normalized map handle to replayed handle and floats per point.
+    std::map<int32_t, std::pair<uint32_t, int>> normalized_;
+    std::vector<float> normalized_out_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_normalized_replay()
+{
+    return std::make_unique<NormalizedReplay>();
+}
+} // namespace lfw_replay
@@ -0,0 +1,292 @@
+// Stateless query replay: searches, mod lookups, map builds, correction
+// descriptors, valid crops, thumbnails, CFA vignetting, map blob exports and
+// imports and step choices, dealt to worker threads by lfw_replay.cpp.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::grid_points;
+
+// Queries whose first two arguments name a lens.
+bool uses_lens(Kind kind)
+{
+    return kind == Kind::AvailableMods || kind == Kind::BuildGeometryMap || kind == Kind::BuildTcaMap ||
+           kind == Kind::BuildVignettingMap || kind == Kind::CorrectionDescriptor || kind == Kind::ValidCrop ||
+           kind == Kind::Thumbnail || kind == Kind::CfaVignetting || kind == Kind::MapBlobExport ||
+           kind == Kind::MapBlobImport || kind == Kind::ChooseStep;
+}
+
+uint32_t cached_lens(const LensCache &lenses, const Field &maker, const Field &model)
+{
+    if (maker.null || model.null)
+    {
+        return 0;
+    }
+    const auto it = lenses.find(std::make_pair(maker.value, model.value));
+    return it != lenses.end() ? it->second : 0;
+}
+} // namespace
+
+void resolve_lenses(const std::vector<Event> &events, size_t begin, size_t end, LensCache *lenses)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const Event &event = events[i];
+        if (!uses_lens(event.kind) || event.args[0].null || event.args[1].null)
+        {
+            continue;
+        }
+
+        const auto key = std::make_pair(event.args[0].value, event.args[1].value);
+        if (lenses->find(key) == lenses->end())
+        {
+            (*lenses)[key] = lfw_bench::find_lens_handle(key.first.c_str(), key.second.c_str());
+        }
+    }
+}
+
+int32_t run_query(
+    const Event &event, const LensCache &lenses, std::vector<float> *scratch, std::vector<uint16_t> *mosaic)
+{
+    const std::vector<Field> &a = event.args;
+    switch (event.kind)
+    {
+    case Kind::FindLenses:
+        lfw_free(lfw_find_lenses_json(a[0].c_str(), a[1].c_str(), a[2].c_str(), a[3].c_str(), a[4].i32()));
+        return 0;
+    case Kind::FindCameras:
+        lfw_free(lfw_find_cameras_json(a[0].c_str(), a[1].c_str(), a[2].i32()));
+        return 0;
+    case Kind::AvailableMods:
+        lfw_available_mods(cached_lens(lenses, a[0], a[1]), a[2].f32());
+        return 0;
+    case Kind::BuildGeometryMap:
+    case Kind::BuildTcaMap:
+    case Kind::BuildVignettingMap:
+    {
+        const bool vignetting = event.kind == Kind::BuildVignettingMap;
+        const int base = vignetting ? 6 : 4;
+        const int32_t width = a[base].i32();
+        const int32_t height = a[base + 1].i32();
+        const int32_t reverse = a[base + 2].i32();
+        const int32_t step = a[base + 3].i32();
+        const int channels = event.kind == Kind::BuildGeometryMap ? 2 : event.kind == Kind::BuildTcaMap ? 6 : 3;
+        const size_t needed = static_cast<size_t>(grid_points(width, step)) * grid_points(height, step) * channels;
+        if (scratch->size() < needed)
+        {
+            scratch->resize(needed);
+        }
+
+        const uint32_t handle = cached_lens(lenses, a[0], a[1]);
+        const int32_t len = static_cast<int32_t>(scratch->size());
+        if (event.kind == Kind::BuildGeometryMap)
+        {
+            return lfw_build_geometry_map(
+                handle, a[2].f32(), a[3].f32(), width, height, reverse, step, scratch->data(), len);
+        }
+        if (event.kind == Kind::BuildTcaMap)
+        {
+            return lfw_build_tca_map(
+                handle, a[2].f32(), a[3].f32(), width, height, reverse, step, scratch->data(), len);
+        }
+        return lfw_build_vignetting_map(
+            handle,
+            a[2].f32(),
+            a[3].f32(),
+            a[4].f32(),
+            a[5].f32(),
+            width,
+            height,
+            reverse,
+            step,
+            scratch->data(),
+            len);
+    }
+    case Kind::CorrectionDescriptor:
+    {
+        float descriptor[kDescriptorFloats];
+        const int32_t rc = lfw_correction_descriptor(
+            cached_lens(lenses, a[0], a[1]),
+            a[2].f32(),
+            a[3].f32(),
+            a[4].f32(),
+            a[5].f32(),
+            a[6].i32(),
+            a[7].i32(),
+            a[8].i32(),
+            descriptor,
+            kDescriptorFloats);
+        return rc < 0 ? rc : 0;
+    }
+    case Kind::DescriptorBuildMap:
+    {
+        // Only the first kDescriptorFloats are recorded, which is all the
+        // bridge reads.
+        float descriptor[kDescriptorFloats];
+        for (int i = 0; i < kDescriptorFloats; ++i)
+        {
+            descriptor[i] = a[3 + i].f32();
+        }
+        const int32_t descriptor_len = std::min(a[0].i32(), kDescriptorFloats);
+        const int32_t kind = a[1].i32();
+        const int32_t step = a[2].i32();
+        const int channels = kind == 0 ? 2 : kind == 1 ? 6 : 3;
+        const size_t needed =
+            static_cast<size_t>(grid_points(static_cast<int>(descriptor[1]), step)) *
+            grid_points(static_cast<int>(descriptor[2]), step) * channels;
+        if (scratch->size() < needed)
+        {
+            scratch->resize(needed);
+        }
+        return lfw_descriptor_build_map(
+            descriptor, descriptor_len, kind, step, scratch->data(), static_cast<int32_t>(scratch->size()));
+    }
+    case Kind::ValidCrop:
+    {
+        float crop[5];
+        return lfw_valid_crop(
+            cached_lens(lenses, a[0], a[1]), a[2].f32(), a[3].f32(), a[4].i32(), a[5].i32(), a[6].i32(), crop, 5);
+    }
+    case Kind::Thumbnail:
+    {
+        // The source pixels are not recorded; a black image of the recorded
+        // size costs the same to filter.
+        const int32_t width = a[6].i32();
+        const int32_t height = a[7].i32();
+        const int32_t channels = a[8].i32();
+        const int32_t out_width = a[11].i32();
+        const int32_t out_height = a[12].i32();
+        if (width <= 0 || height <= 0 || channels <= 0 || out_width <= 0 || out_height <= 0)
+        {
+            return -1;
+        }
+        const size_t source_len = static_cast<size_t>(width) * height * channels;
+        const size_t out_len = static_cast<size_t>(out_width) * out_height * channels;
+        scratch->assign(source_len + out_len, 0.0f);
+        return lfw_thumbnail(
+            cached_lens(lenses, a[0], a[1]),
+            a[2].f32(),
+            a[3].f32(),
+            a[4].f32(),
+            a[5].f32(),
+            width,
+            height,
+            channels,
+            a[9].i32(),
+            a[10].i32(),
+            scratch->data(),
+            static_cast<int32_t>(source_len),
+            out_width,
+            out_height,
+            scratch->data() + source_len,
+            static_cast<int32_t>(out_len));
+    }
+    case Kind::CfaVignetting:
+    {
+        // Like thumbnails, the mosaic is not recorded; a flat one of the
+        // recorded size stands in.
+        const int32_t width = a[6].i32();
+        const int32_t height = a[7].i32();
+        const int32_t stride = a[12].i32() > 0 ? a[12].i32() : width;
+        if (width <= 0 || height <= 0 || stride < width)
+        {
+            return -1;
+        }
+        mosaic->assign(static_cast<size_t>(stride) * height, 4096);
+        return lfw_cfa_vignetting(
+            cached_lens(lenses, a[0], a[1]),
+            a[2].f32(),
+            a[3].f32(),
+            a[4].f32(),
+            a[5].f32(),
+            width,
+            height,
+            a[8].c_str(),
+            a[9].i32(),
+            a[10].i32(),
+            a[11].i32(),
+            mosaic->data(),
+            a[12].i32(),
+            static_cast<int32_t>(mosaic->size()));
+    }
+    case Kind::MapBlobExport:
+    {
+        const uint32_t handle = cached_lens(lenses, a[0], a[1]);
+        const int32_t bytes = lfw_map_blob_size(a[2].i32(), handle, a[7].i32(), a[8].i32(), a[10].i32());
+        if (bytes < 0)
+        {
+            return bytes;
+        }
+        scratch->resize(std::max(scratch->size(), static_cast<size_t>(bytes) / sizeof(float) + 1));
+        const int32_t rc = lfw_map_blob_export(
+            a[2].i32(),
+            handle,
+            a[3].f32(),
+            a[4].f32(),
+            a[5].f32(),
+            a[6].f32(),
+            a[7].i32(),
+            a[8].i32(),
+            a[9].i32(),
+            a[10].i32(),
+            reinterpret_cast<uint8_t *>(scratch->data()),
+            bytes);
+        return rc < 0 ? rc : 0;
+    }
+    case Kind::MapBlobImport:
+    {
+        // The map in a blob never holds more floats than the blob has bytes
+        // for; the import fails the database check unless the replay loaded
+        // the database the blob was exported from.
+        const std::string &blob = a[11].value;
+        scratch->resize(std::max(scratch->size(), blob.size() / sizeof(float)));
+        return lfw_map_blob_import(reinterpret_cast<const uint8_t *>(blob.data()),
+                                   static_cast<int32_t>(blob.size()),
+                                   a[2].i32(),
+                                   cached_lens(lenses, a[0], a[1]),
+                                   a[3].f32(),
+                                   a[4].f32(),
+                                   a[5].f32(),
+                                   a[6].f32(),
+                                   a[7].i32(),
+                                   a[8].i32(),
+                                   a[9].i32(),
+                                   a[10].i32(),
+                                   scratch->data(),
+                                   static_cast<int32_t>(scratch->size()));
+    }
+    case Kind::ChooseStep:
+    {
+        float choice[3];
+        return lfw_choose_step(
+            a[2].i32(),
+            cached_lens(lenses, a[0], a[1]),
+            a[3].f32(),
+            a[4].f32(),
+            a[5].f32(),
+            a[6].f32(),
+            a[7].i32(),
+            a[8].i32(),
+            a[9].i32(),
+            a[10].f32(),
+            a[11].i32(),
+            choice,
+            3);
+    }
+    default:
+        return 0;
+    }
+}
+} // namespace lfw_replay
@@ -0,0 +1,103 @@
+// Map stream replay: row bands of streamed correction maps.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+using lfw_bench::grid_points;
+
+class StreamReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::MapStreamCreate || kind == Kind::MapStreamRows || kind == Kind::MapStreamDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        int32_t rc = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        if (event.kind == Kind::MapStreamCreate)
+        {
+            const uint32_t lens = a[2].null || a[3].null ? 0 : find_lens_handle(a[2].c_str(), a[3].c_str());
+            const int32_t kind = a[1].i32();
+            const int32_t width = a[8].i32();
+            const int32_t step = a[11].i32();
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_map_stream_create(
+                kind, lens, a[4].f32(), a[5].f32(), a[6].f32(), a[7].f32(), width, a[9].i32(), a[10].i32(), step);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc > 0)
+            {
+                const int channels = kind == 0 ? 2 : kind == 1 ? 6 : 3;
+                streams_[recorded] = std::make_pair(static_cast<uint32_t>(rc), grid_points(width, step) * channels);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::MapStreamRows)
+        {
+            const auto it = streams_.find(recorded);
+            const uint32_t stream = it != streams_.end() ? it->second.first : 0;
+            const int32_t y0 = a[1].i32();
+            const int32_t y1 = a[2].i32();
+            const size_t needed = it != streams_.end() && y1 > y0 ? static_cast<size_t>(it->second.second) * (y1 - y0) : 1;
+            if (stream_rows_.size() < needed)
+            {
+                stream_rows_.resize(needed);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_map_stream_rows(stream, y0, y1, stream_rows_.data(), static_cast<int32_t>(stream_rows_.size()));
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        else
+        {
+            const auto it = streams_.find(recorded);
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_map_stream_destroy(it != streams_.end() ? it->second.first : 0);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (it != streams_.end())
+            {
+                streams_.erase(it);
+            }
+        }
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &stream : streams_)
+        {
+            lfw_map_stream_destroy(stream.second.first);
+        }
+        streams_.clear();
+    }
+
+private:
+    // Recorded stream handle to replayed handle and floats per grid row.
+    std::map<int32_t, std::pair<uint32_t, int>> streams_;
+    std::vector<float> stream_rows_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_stream_replay()
+{
+    return std::make_unique<StreamReplay>();
+}
+} // namespace lfw_replay
@@ -0,0 +1,123 @@
+// Tiler replay: tiled out-of-core corrections.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+
+class TilerReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::TilerCreate || kind == Kind::TilerBeginTile || kind == Kind::TilerFinishTile ||
+               kind == Kind::TilerRun || kind == Kind::TilerDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        const auto it = tilers_.find(recorded);
+        const uint32_t tiler = it != tilers_.end() ? it->second.first : 0;
+        int32_t rc = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        if (event.kind == Kind::TilerCreate)
+        {
+            const uint32_t lens = a[1].null || a[2].null ? 0 : find_lens_handle(a[1].c_str(), a[2].c_str());
+            const int32_t channels = a[9].i32();
+            const int32_t tile_size = a[11].i32();
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_tiler_create(
+                lens, a[3].f32(), a[4].f32(), a[5].f32(), a[6].f32(), a[7].i32(), a[8].i32(), channels, a[10].i32(), tile_size);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc > 0)
+            {
+                tilers_[recorded] = std::make_pair(static_cast<uint32_t>(rc), static_cast<size_t>(tile_size) * tile_size * channels);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::TilerFinishTile)
+        {
+            const size_t needed = it != tilers_.end() ? it->second.second : 1;
+            if (tile_out_.size() < needed)
+            {
+                tile_out_.resize(needed);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_tiler_finish_tile(tiler, tile_out_.data(), static_cast<int32_t>(tile_out_.size()));
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        else
+        {
+            int32_t rects[8];
+            const auto start = std::chrono::steady_clock::now();
+            if (event.kind == Kind::TilerBeginTile)
+            {
+                rc = lfw_tiler_begin_tile(tiler, a[1].i32(), rects);
+            }
+            else if (event.kind == Kind::TilerRun)
+            {
+                rc = lfw_tiler_run(tiler, read_zeros, drop_tile, nullptr);
+            }
+            else
+            {
+                rc = lfw_tiler_destroy(tiler);
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (event.kind == Kind::TilerDestroy && it != tilers_.end())
+            {
+                tilers_.erase(it);
+            }
+        }
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &tiler : tilers_)
+        {
+            lfw_tiler_destroy(tiler.second.first);
+        }
+        tilers_.clear();
+    }
+
+private:
+    static int32_t read_zeros(void *, int32_t, int32_t, int32_t width, int32_t height, float *out)
+    {
+        // Channel count is not passed; the buffer holds at least one float
+        // per pixel and the content does not matter.
+        std::fill(out, out + static_cast<size_t>(width) * height, 0.0f);
+        return 0;
+    }
+
+    static int32_t drop_tile(void *, int32_t, int32_t, int32_t, int32_t, const float *)
+    {
+        return 0;
+    }
+
+    // Recorded tiler handle to replayed handle and floats per output tile.
+    std::map<int32_t, std::pair<uint32_t, size_t>> tilers_;
+    std::vector<float> tile_out_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_tiler_replay()
+{
+    return std::make_unique<TilerReplay>();
+}
+} // namespace lfw_replay
@@ -0,0 +1,125 @@
+// Zoom replay: interpolated zoom sequences.
+
+#include "lensfun_wasm_bridge.h"
+#include "lfw_bench_util.h"
+#include "lfw_replay.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lfw_replay
+{
+namespace
+{
+using lfw_bench::find_lens_handle;
+using lfw_bench::grid_points;
+
+class ZoomReplay : public StateReplay
+{
+public:
+    bool handles(Kind kind) const override
+    {
+        return kind == Kind::ZoomCreate || kind == Kind::ZoomBlend || kind == Kind::ZoomPrepare ||
+               kind == Kind::ZoomAcquire || kind == Kind::ZoomDestroy;
+    }
+
+    Sample run(const Event &event) override
+    {
+        const std::vector<Field> &a = event.args;
+        const int32_t recorded = a[0].i32();
+        const auto it = zooms_.find(recorded);
+        const uint32_t zoom = it != zooms_.end() ? it->second.first : 0;
+        int32_t rc = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        if (event.kind == Kind::ZoomCreate)
+        {
+            const uint32_t lens = a[2].null || a[3].null ? 0 : find_lens_handle(a[2].c_str(), a[3].c_str());
+            const int32_t kind = a[1].i32();
+            const int32_t width = a[9].i32();
+            const int32_t height = a[10].i32();
+            const int32_t step = a[12].i32();
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_zoom_create(kind,
+                                 lens,
+                                 a[4].f32(),
+                                 a[5].f32(),
+                                 a[6].f32(),
+                                 a[7].f32(),
+                                 a[8].f32(),
+                                 width,
+                                 height,
+                                 a[11].i32(),
+                                 step,
+                                 a[13].f32(),
+                                 a[14].i32());
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (rc > 0)
+            {
+                const int channels = kind == 0 ? 2 : kind == 1 ? 6 : 3;
+                const size_t floats = static_cast<size_t>(grid_points(width, step)) * grid_points(height, step) * channels;
+                zooms_[recorded] = std::make_pair(static_cast<uint32_t>(rc), floats);
+                rc = 0;
+            }
+        }
+        else if (event.kind == Kind::ZoomBlend)
+        {
+            const size_t needed = it != zooms_.end() ? it->second.second : 1;
+            if (zoom_out_.size() < needed)
+            {
+                zoom_out_.resize(needed);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            rc = lfw_zoom_blend(zoom, a[1].f32(), zoom_out_.data(), static_cast<int32_t>(zoom_out_.size()));
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        else
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (event.kind == Kind::ZoomPrepare)
+            {
+                rc = lfw_zoom_prepare(zoom, a[1].f32());
+            }
+            else if (event.kind == Kind::ZoomAcquire)
+            {
+                rc = lfw_zoom_acquire(zoom) ? 0 : -1;
+            }
+            else
+            {
+                rc = lfw_zoom_destroy(zoom);
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (event.kind == Kind::ZoomDestroy && it != zooms_.end())
+            {
+                zooms_.erase(it);
+            }
+        }
+        return make_sample(event.kind, elapsed, rc != 0);
+    }
+
+    void reset() override
+    {
+        for (const auto &zoom : zooms_)
+        {
+            lfw_zoom_destroy(zoom.second.first);
+        }
+        zooms_.clear();
+    }
+
+private:
+    // Recorded zoom handle to replayed handle and floats per frame.
+    std::map<int32_t, std::pair<uint32_t, size_t>> zooms_;
+    std::vector<float> zoom_out_;
+};
+} // namespace
+
+std::unique_ptr<StateReplay> make_zoom_replay()
+{
+    return std::make_unique<ZoomReplay>();
+}
+} // namespace lfw_replay
@@ -7,14 +7,85 @@
 extern "C" {
 #endif
 
+/* Tile callbacks of lfw_tiler_run; a non-zero return aborts the run. */
+typedef int32_t (*lfw_tile_read_fn)(void *user, int32_t x, int32_t y, int32_t width, int32_t height, float *out);
+typedef int32_t (*lfw_tile_write_fn)(void *user, int32_t x, int32_t y, int32_t width, int32_t height, const float *tile);
+
 int32_t lfw_init(const char *db_dir);
+int32_t lfw_init_filtered(const char *db_dir, const char *mounts, const char *makers);
 void lfw_dispose(void);
+uint32_t lfw_context_create(void);
+int32_t lfw_context_destroy(uint32_t context_handle);
+int32_t lfw_context_bind(uint32_t context_handle);
+int32_t lfw_db_load_xml(const char *doc_id, const char *xml, int32_t xml_len);
+int32_t lfw_db_load_file(const char *path);
+int32_t lfw_db_unload(const char *doc_id);
+int32_t lfw_db_compact(int32_t min_retired);
 char *lfw_find_lenses_json(const char *camera_maker, const char *camera_model, const char *lens_maker, const char *lens_model, int32_t search_flags);
 char *lfw_find_cameras_json(const char *maker, const char *model, int32_t search_flags);
 int32_t lfw_available_mods(uint32_t lens_handle, float crop);
 int32_t lfw_build_geometry_map(uint32_t lens_handle, float focal, float crop, int32_t width, int32_t height, int32_t reverse, int32_t step, float *out_xy, int32_t out_len);
 int32_t lfw_build_tca_map(uint32_t lens_handle, float focal, float crop, int32_t width, int32_t height, int32_t reverse, int32_t step, float *out_rgbxy, int32_t out_len);
 int32_t lfw_build_vignetting_map(uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step, float *out_rgb_gain, int32_t out_len);
+int32_t lfw_map_stream_create(int32_t kind, uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step);
+int32_t lfw_map_stream_rows(uint32_t stream, int32_t y0, int32_t y1, float *out, int32_t out_len);
+int32_t lfw_map_stream_destroy(uint32_t stream);
+int32_t lfw_tiler_create(uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t channels, int32_t mods, int32_t tile_size);
+int32_t lfw_tiler_tile_count(uint32_t tiler);
+int32_t lfw_tiler_begin_tile(uint32_t tiler, int32_t index, int32_t *out_rects);
+float *lfw_tiler_source_buffer(uint32_t tiler);
+int32_t lfw_tiler_finish_tile(uint32_t tiler, float *out, int32_t out_len);
+int32_t lfw_tiler_run(uint32_t tiler, lfw_tile_read_fn read, lfw_tile_write_fn write, void *user);
+int32_t lfw_tiler_destroy(uint32_t tiler);
+int32_t lfw_zoom_create(int32_t kind, uint32_t lens_handle, float min_focal, float max_focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step, float tolerance, int32_t max_anchors);
+char *lfw_zoom_info_json(uint32_t zoom);
+int32_t lfw_zoom_blend(uint32_t zoom, float focal, float *out, int32_t out_len);
+int32_t lfw_zoom_prepare(uint32_t zoom, float focal);
+const float *lfw_zoom_acquire(uint32_t zoom);
+int32_t lfw_zoom_destroy(uint32_t zoom);
+int32_t lfw_correction_descriptor(uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, float *out, int32_t out_len);
+int32_t lfw_descriptor_build_map(const float *descriptor, int32_t descriptor_len, int32_t kind, int32_t step, float *out, int32_t out_len);
+int32_t lfw_normalized_map_create(int32_t kind, uint32_t lens_handle, float focal, float crop, float aperture, float distance, float aspect, int32_t reverse, int32_t grid_size);
+int32_t lfw_normalized_map_sample(uint32_t map, int32_t width, int32_t height, int32_t step, float *out, int32_t out_len);
+int32_t lfw_normalized_map_destroy(uint32_t map);
+int32_t lfw_valid_crop(uint32_t lens_handle, float focal, float crop, int32_t width, int32_t height, int32_t mods, float *out, int32_t out_len);
+int32_t lfw_thumbnail(uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t channels, int32_t mods, int32_t filter, const float *source, int32_t source_len, int32_t out_width, int32_t out_height, float *out, int32_t out_len);
+int32_t lfw_cfa_vignetting(uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, const char *pattern, int32_t pattern_width, int32_t black, int32_t white, uint16_t *data, int32_t stride, int32_t data_len);
+int32_t lfw_fixed_map_create(int32_t kind, uint32_t lens_handle, float focal, float crop, int32_t width, int32_t height, int32_t reverse);
+int32_t lfw_fixed_map_fraction_bits(uint32_t map);
+int32_t lfw_fixed_map_remap(uint32_t map, const uint8_t *src, int32_t src_len, uint8_t *dst, int32_t dst_len, int32_t y0, int32_t y1);
+int32_t lfw_fixed_map_destroy(uint32_t map);
+int32_t lfw_map_job_create(int32_t kind, uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step, int32_t coarse_step);
+int32_t lfw_map_job_run(uint32_t job, int32_t max_rows);
+int32_t lfw_map_job_cancel(uint32_t job);
+float lfw_map_job_progress(uint32_t job);
+const float *lfw_map_job_coarse(uint32_t job);
+const float *lfw_map_job_result(uint32_t job);
+int32_t lfw_map_job_destroy(uint32_t job);
+int32_t lfw_batch_create(void);
+int32_t lfw_batch_add(uint32_t batch, uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step, int32_t mods);
+int32_t lfw_batch_set_pixels(uint32_t batch, int32_t item, const float *source, float *output, int32_t channels);
+int32_t lfw_batch_run(uint32_t batch, int32_t threads);
+int32_t lfw_batch_item_group(uint32_t batch, int32_t item);
+int32_t lfw_batch_item_status(uint32_t batch, int32_t item);
+const float *lfw_batch_map(uint32_t batch, int32_t item, int32_t kind);
+int32_t lfw_batch_destroy(uint32_t batch);
+char *lfw_db_content_hash(void);
+int32_t lfw_map_blob_size(int32_t kind, uint32_t lens_handle, int32_t width, int32_t height, int32_t step);
+int32_t lfw_map_blob_export(int32_t kind, uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step, uint8_t *out, int32_t out_len);
+int32_t lfw_map_blob_import(const uint8_t *blob, int32_t blob_len, int32_t kind, uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, int32_t step, float *out, int32_t out_len);
+int32_t lfw_choose_step(int32_t kind, uint32_t lens_handle, float focal, float crop, float aperture, float distance, int32_t width, int32_t height, int32_t reverse, float tolerance, int32_t max_step, float *out, int32_t out_len);
+char *lfw_get_stats_json(void);
+void lfw_reset_stats(void);
+int32_t lfw_trace_start(int32_t capacity);
+void lfw_trace_stop(void);
+char *lfw_trace_dump_json(void);
+int32_t lfw_capture_start(int32_t max_bytes);
+void lfw_capture_stop(void);
+char *lfw_capture_dump(void);
+void lfw_alloc_tracking_start(void);
+void lfw_alloc_tracking_stop(void);
+char *lfw_alloc_report_json(void);
 void lfw_free(void *p);
 
 #ifdef __cplusplus
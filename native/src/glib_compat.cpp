@@ -1,4 +1,5 @@
 #include "glib.h"
+#include "lfw_alloc.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -11,8 +12,12 @@
 #include <sys/stat.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <mutex>
+#include <new>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "tinyxml2.h"
@@ -39,6 +44,258 @@ struct _GMarkupParseContext
     gint current_column = 0;
 };
 
+static std::atomic<uint64_t> g_malloc_calls{0};
+static std::atomic<uint64_t> g_realloc_calls{0};
+static std::atomic<uint64_t> g_free_calls{0};
+static std::atomic<uint64_t> g_requested_bytes{0};
+static thread_local lfw::AllocCounters t_alloc_counters;
+
+static void count_allocation(std::atomic<uint64_t> &calls, uint64_t &thread_calls, gsize size)
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    g_requested_bytes.fetch_add(size, std::memory_order_relaxed);
+    ++thread_calls;
+    t_alloc_counters.requested_bytes += size;
+}
+
+lfw::AllocCounters lfw::process_alloc_counters()
+{
+    AllocCounters counters;
+    counters.malloc_calls = g_malloc_calls.load(std::memory_order_relaxed);
+    counters.realloc_calls = g_realloc_calls.load(std::memory_order_relaxed);
+    counters.free_calls = g_free_calls.load(std::memory_order_relaxed);
+    counters.requested_bytes = g_requested_bytes.load(std::memory_order_relaxed);
+    return counters;
+}
+
+lfw::AllocCounters lfw::thread_alloc_counters()
+{
+    return t_alloc_counters;
+}
+
+namespace
+{
+constexpr int kAllocCategoryCount = static_cast<int>(lfw::AllocCategory::Count);
+
+const char *const kAllocCategoryNames[kAllocCategoryCount] = {
+    "other",
+    "databaseLoad",
+    "search",
+    "modifier",
+    "jsonOutput",
+};
+
+struct TrackedBlock
+{
+    size_t size;
+    lfw::AllocCategory category;
+};
+
+struct AllocTracker
+{
+    std::mutex mutex;
+    std::unordered_map<const void *, TrackedBlock> blocks;
+    lfw::AllocTrackingReport report;
+};
+
+std::atomic<bool> g_alloc_tracking{false};
+thread_local lfw::AllocCategory t_alloc_category = lfw::AllocCategory::Other;
+thread_local bool t_in_alloc_tracker = false;
+
+AllocTracker &alloc_tracker()
+{
+    // Never destroyed: operator delete may still reach it during exit.
+    static AllocTracker *tracker = new AllocTracker();
+    return *tracker;
+}
+
+// Marks the thread as inside the tracker so the side table's own allocations
+// are neither recorded nor allowed to re-enter the mutex.
+class TrackerGuard
+{
+public:
+    TrackerGuard()
+        : active_(!t_in_alloc_tracker)
+    {
+        t_in_alloc_tracker = true;
+    }
+
+    ~TrackerGuard()
+    {
+        if (active_)
+        {
+            t_in_alloc_tracker = false;
+        }
+    }
+
+    bool active() const
+    {
+        return active_;
+    }
+
+private:
+    bool active_;
+};
+
+void add_block(AllocTracker &tracker, const void *ptr, size_t size, lfw::AllocCategory category)
+{
+    tracker.blocks[ptr] = TrackedBlock{size, category};
+
+    lfw::AllocTrackingReport &report = tracker.report;
+    lfw::AllocCategoryStats &stats = report.categories[static_cast<int>(category)];
+    ++stats.allocations;
+    ++stats.live_blocks;
+    stats.live_bytes += size;
+    stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+    report.live_bytes += size;
+    report.peak_bytes = std::max(report.peak_bytes, report.live_bytes);
+}
+
+bool remove_block(AllocTracker &tracker, const void *ptr, TrackedBlock *removed)
+{
+    const auto it = tracker.blocks.find(ptr);
+    if (it == tracker.blocks.end())
+    {
+        return false;
+    }
+
+    lfw::AllocCategoryStats &stats = tracker.report.categories[static_cast<int>(it->second.category)];
+    ++stats.frees;
+    --stats.live_blocks;
+    stats.live_bytes -= it->second.size;
+    tracker.report.live_bytes -= it->second.size;
+
+    *removed = it->second;
+    tracker.blocks.erase(it);
+    return true;
+}
+
+void track_alloc(const void *ptr, size_t size)
+{
+    if (!g_alloc_tracking.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    const TrackerGuard guard;
+    if (!guard.active())
+    {
+        return;
+    }
+
+    AllocTracker &tracker = alloc_tracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    add_block(tracker, ptr, size, t_alloc_category);
+}
+
+// A resized block keeps the category it was first allocated under; the
+// resize itself counts as one free plus one allocation.
+void track_realloc(const void *old_ptr, const void *new_ptr, size_t size)
+{
+    if (!g_alloc_tracking.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    const TrackerGuard guard;
+    if (!guard.active())
+    {
+        return;
+    }
+
+    AllocTracker &tracker = alloc_tracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    TrackedBlock previous{0, t_alloc_category};
+    if (old_ptr)
+    {
+        remove_block(tracker, old_ptr, &previous);
+    }
+    add_block(tracker, new_ptr, size, previous.category);
+}
+
+void track_free(const void *ptr)
+{
+    if (!ptr || !g_alloc_tracking.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    const TrackerGuard guard;
+    if (!guard.active())
+    {
+        return;
+    }
+
+    AllocTracker &tracker = alloc_tracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    TrackedBlock removed;
+    remove_block(tracker, ptr, &removed);
+}
+} // namespace
+
+const char *lfw::alloc_category_name(AllocCategory category)
+{
+    const int index = static_cast<int>(category);
+    return index >= 0 && index < kAllocCategoryCount ? kAllocCategoryNames[index] : "unknown";
+}
+
+lfw::AllocScope::AllocScope(AllocCategory category)
+    : previous_(t_alloc_category)
+{
+    t_alloc_category = category;
+}
+
+lfw::AllocScope::~AllocScope()
+{
+    t_alloc_category = previous_;
+}
+
+void lfw::alloc_tracking_start()
+{
+    const TrackerGuard guard;
+    AllocTracker &tracker = alloc_tracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    std::unordered_map<const void *, TrackedBlock>().swap(tracker.blocks);
+    tracker.report = AllocTrackingReport();
+    g_alloc_tracking.store(true, std::memory_order_relaxed);
+}
+
+void lfw::alloc_tracking_stop()
+{
+    g_alloc_tracking.store(false, std::memory_order_relaxed);
+}
+
+bool lfw::alloc_tracking_enabled()
+{
+    return g_alloc_tracking.load(std::memory_order_relaxed);
+}
+
+lfw::AllocTrackingReport lfw::alloc_tracking_report()
+{
+    const TrackerGuard guard;
+    AllocTracker &tracker = alloc_tracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    AllocTrackingReport report = tracker.report;
+    report.enabled = g_alloc_tracking.load(std::memory_order_relaxed);
+    return report;
+}
+
+lfw::AllocTrackingReport lfw::alloc_tracking_mark_dispose()
+{
+    const TrackerGuard guard;
+    AllocTracker &tracker = alloc_tracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    AllocTrackingReport &report = tracker.report;
+    report.has_dispose_leaks = true;
+    for (int i = 0; i < kAllocCategoryCount; ++i)
+    {
+        report.dispose_leaks[i] = AllocCategoryStats();
+        report.dispose_leaks[i].live_blocks = report.categories[i].live_blocks;
+        report.dispose_leaks[i].live_bytes = report.categories[i].live_bytes;
+    }
+
+    AllocTrackingReport copy = report;
+    copy.enabled = g_alloc_tracking.load(std::memory_order_relaxed);
+    return copy;
+}
+
 static std::string vformat(const char *format, va_list args)
 {
     va_list copy;
@@ -98,29 +355,39 @@ void g_assertion_message(const char *expr, const char *file, int line)
 void *g_malloc(gsize n_bytes)
 {
     const gsize size = n_bytes == 0 ? 1 : n_bytes;
+    count_allocation(g_malloc_calls, t_alloc_counters.malloc_calls, size);
     void *ptr = malloc(size);
     if (!ptr)
     {
         fprintf(stderr, "[glib-compat] out of memory\n");
         abort();
     }
+    track_alloc(ptr, size);
     return ptr;
 }
 
 void *g_realloc(gpointer mem, gsize n_bytes)
 {
     const gsize size = n_bytes == 0 ? 1 : n_bytes;
+    count_allocation(g_realloc_calls, t_alloc_counters.realloc_calls, size);
     void *ptr = realloc(mem, size);
     if (!ptr)
     {
         fprintf(stderr, "[glib-compat] out of memory\n");
         abort();
     }
+    track_realloc(mem, ptr, size);
     return ptr;
 }
 
 void g_free(gpointer mem)
 {
+    if (mem)
+    {
+        g_free_calls.fetch_add(1, std::memory_order_relaxed);
+        ++t_alloc_counters.free_calls;
+        track_free(mem);
+    }
     free(mem);
 }
 
@@ -797,3 +1064,102 @@ gchar *g_markup_printf_escaped(const gchar *format, ...)
 }
 
 } // extern "C"
+
+#if LFW_TRACK_CXX_ALLOCS
+// Profiling builds only (LFW_TRACK_CXX_ALLOCS): lensfun builds its C++
+// objects (lfModifier, lfLens, ...) with plain new, so replacing the global
+// operators lets the tracker see them too. The replacement applies to the
+// whole program the library is linked into, which is why it is opt-in. The
+// operators do not touch the g_malloc call counters.
+namespace
+{
+void *tracked_new(std::size_t size)
+{
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    track_alloc(ptr, size);
+    return ptr;
+}
+
+void *tracked_aligned_new(std::size_t size, std::align_val_t alignment)
+{
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void *));
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, align, size == 0 ? 1 : size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    track_alloc(ptr, size);
+    return ptr;
+}
+
+void tracked_delete(void *ptr) noexcept
+{
+    track_free(ptr);
+    free(ptr);
+}
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    return tracked_new(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return tracked_new(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return tracked_aligned_new(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return tracked_aligned_new(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    tracked_delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    tracked_delete(ptr);
+}
+#endif
@@ -1,4 +1,26 @@
+#include "glib.h"
 #include "lensfun.h"
+#include "lensfun_wasm_bridge.h"
+#include "lfw_alloc.h"
+#include "lfw_batch.h"
+#include "lfw_blob.h"
+#include "lfw_capture.h"
+#include "lfw_cfa.h"
+#include "lfw_context.h"
+#include "lfw_crop.h"
+#include "lfw_describe.h"
+#include "lfw_fixed.h"
+#include "lfw_jobs.h"
+#include "lfw_json.h"
+#include "lfw_maps.h"
+#include "lfw_normalized.h"
+#include "lfw_prune.h"
+#include "lfw_stats.h"
+#include "lfw_step.h"
+#include "lfw_thumbnail.h"
+#include "lfw_tiles.h"
+#include "lfw_trace.h"
+#include "lfw_zoom.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -6,8 +28,11 @@
 #include <string.h>
 
 #include <algorithm>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #if defined(__EMSCRIPTEN__)
 #include <emscripten/emscripten.h>
@@ -16,104 +41,91 @@
 #define LFW_EXPORT
 #endif
 
-namespace
-{
-lfDatabase *g_db = nullptr;
+// Opens an entry point: times it as lfw::Entry::`entry` and counts the
+// g_malloc traffic it makes as lfw::AllocCategory::`category`.
+#define LFW_ENTRY(entry, category)                                                                                     \
+    const lfw::CallTimer timer(lfw::Entry::entry);                                                                     \
+    const lfw::AllocScope alloc_scope(lfw::AllocCategory::category)
 
-void append_json_escaped(std::ostringstream &out, const char *value)
+// Records a call in the capture log, with its arguments chained on as on
+// lfw::CaptureLine; while capture is off, no line is built. It expands to a
+// single loop statement, so it has no `else` for a caller's to bind to. A
+// call that creates, changes or reads handle state and is left out makes a
+// replay of the log diverge from the session it came from.
+#define LFW_CAPTURE(entry_name)                                                                                        \
+    for (bool lfw_capture_once = lfw::capture_enabled(); lfw_capture_once; lfw_capture_once = false)                   \
+    lfw::CaptureLine(entry_name)
+
+namespace
 {
-    out << '"';
-    if (value)
-    {
-        for (const char *p = value; *p; ++p)
-        {
-            const unsigned char c = static_cast<unsigned char>(*p);
-            switch (c)
-            {
-            case '\\':
-                out << "\\\\";
-                break;
-            case '"':
-                out << "\\\"";
-                break;
-            case '\n':
-                out << "\\n";
-                break;
-            case '\r':
-                out << "\\r";
-                break;
-            case '\t':
-                out << "\\t";
-                break;
-            default:
-                if (c < 0x20)
-                {
-                    out << "\\u00";
-                    const char hex[] = "0123456789abcdef";
-                    out << hex[(c >> 4) & 0x0F] << hex[c & 0x0F];
-                }
-                else
-                {
-                    out << *p;
-                }
-                break;
-            }
-        }
-    }
-    out << '"';
-}
+using lfw::append_json_escaped;
 
+// Returned strings go through g_malloc so the allocation tracker sees any
+// that the caller never hands back to lfw_free.
 char *dup_cstr(const std::string &s)
 {
-    auto *buf = static_cast<char *>(malloc(s.size() + 1));
-    if (!buf)
-    {
-        return nullptr;
-    }
+    const lfw::AllocScope alloc_scope(lfw::AllocCategory::JsonOutput);
+    auto *buf = static_cast<char *>(g_malloc(s.size() + 1));
     memcpy(buf, s.data(), s.size());
     buf[s.size()] = '\0';
     return buf;
 }
 
+const char *lens_maker_or_null(const lfLens *lens)
+{
+    return lens && lens->Maker ? lf_mlstr_get(lens->Maker) : nullptr;
+}
+
+const char *lens_model_or_null(const lfLens *lens)
+{
+    return lens && lens->Model ? lf_mlstr_get(lens->Model) : nullptr;
+}
+
 const lfLens *resolve_lens(uint32_t lens_handle)
 {
-    if (!g_db || lens_handle == 0)
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    return db ? db->resolve_lens(lens_handle) : nullptr;
+}
+
+// One-shot build of a whole map into `out`.
+int32_t build_map(const lfw::MapRequest &request, float *out, int32_t out_len)
+{
+    if (!request.lens || !out || request.width <= 0 || request.height <= 0 || request.step <= 0)
     {
-        return nullptr;
+        return -1;
     }
 
-    const auto *target = reinterpret_cast<const lfLens *>(static_cast<uintptr_t>(lens_handle));
-    const lfLens *const *all_lenses = lf_db_get_lenses(g_db);
-    if (!all_lenses)
+    lfw::MapBuilder builder(request, lfw::current_context().db);
+    const size_t needed = builder.row_floats() * static_cast<size_t>(builder.grid_height());
+    if (out_len < 0 || static_cast<size_t>(out_len) < needed)
     {
-        return nullptr;
+        return -2;
     }
 
-    for (size_t i = 0; all_lenses[i] != nullptr; ++i)
+    const int32_t rc = builder.init();
+    if (rc != 0)
     {
-        if (all_lenses[i] == target)
-        {
-            return target;
-        }
+        return rc;
     }
-
-    return nullptr;
+    return builder.fill_rows(0, builder.grid_height(), out);
 }
 
-int grid_points(int size, int step)
+// Replaces the current context's database with one loaded from `db_dir`.
+int32_t init_database(const char *db_dir, lfw::RecordFilter filter)
 {
-    if (size <= 0 || step <= 0)
+    lfw::Context &ctx = lfw::current_context();
+    ctx.db.reset();
+
+    auto db = std::make_shared<lfw::Database>(std::move(filter));
+    if (!db->valid())
     {
-        return 0;
+        return -1;
     }
-    return ((size - 1) / step) + 1;
-}
+    ctx.db = db;
 
-float sample_coord(int index, int step, int bound)
-{
-    const int value = index * step;
-    const int clamped = std::min(value, std::max(bound - 1, 0));
-    return static_cast<float>(clamped);
+    const char *path = db_dir ? db_dir : "/lensfun-db";
+    const lfError err = db->load_path(path);
+    return static_cast<int32_t>(err);
 }
 } // namespace
 
@@ -121,30 +133,132 @@ extern "C" {
 
 LFW_EXPORT int32_t lfw_init(const char *db_dir)
 {
-    if (g_db)
+    LFW_ENTRY(Init, Other);
+    LFW_CAPTURE("lfw_init").str(db_dir);
+    return init_database(db_dir, lfw::RecordFilter());
+}
+
+LFW_EXPORT int32_t lfw_init_filtered(const char *db_dir, const char *mounts, const char *makers)
+{
+    LFW_ENTRY(InitFiltered, Other);
+    LFW_CAPTURE("lfw_init_filtered").str(db_dir).str(mounts).str(makers);
+    lfw::RecordFilter filter;
+    filter.mounts = lfw::split_filter_list(mounts);
+    filter.makers = lfw::split_filter_list(makers);
+    return init_database(db_dir, std::move(filter));
+}
+
+LFW_EXPORT void lfw_dispose(void)
+{
+    LFW_ENTRY(Dispose, Other);
+    LFW_CAPTURE("lfw_dispose");
+    std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    const bool last_reference = db && db.use_count() == 1;
+    db.reset();
+
+    // Only once the database is really gone is every tracked block a leak.
+    if (last_reference && lfw::alloc_tracking_enabled())
     {
-        lf_db_destroy(g_db);
-        g_db = nullptr;
+        lfw::report_dispose_leaks();
     }
+}
+
+LFW_EXPORT uint32_t lfw_context_create(void)
+{
+    const uint32_t handle = lfw::create_context()->handle;
+    LFW_CAPTURE("lfw_context_create").integer(handle);
+    return handle;
+}
+
+LFW_EXPORT int32_t lfw_context_destroy(uint32_t context_handle)
+{
+    LFW_CAPTURE("lfw_context_destroy").integer(context_handle);
+    return lfw::destroy_context(context_handle) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_context_bind(uint32_t context_handle)
+{
+    LFW_CAPTURE("lfw_context_bind").integer(context_handle);
+    return lfw::bind_context(context_handle) ? 0 : -1;
+}
 
-    g_db = lf_db_create();
-    if (!g_db)
+LFW_EXPORT int32_t lfw_db_load_xml(const char *doc_id, const char *xml, int32_t xml_len)
+{
+    LFW_ENTRY(DbLoadXml, Other);
+    if (!doc_id || !*doc_id || !xml)
     {
         return -1;
     }
 
-    const char *path = db_dir ? db_dir : "/lensfun-db";
-    const lfError err = lf_db_load_path(g_db, path);
-    return static_cast<int32_t>(err);
+    const size_t size = xml_len < 0 ? strlen(xml) : static_cast<size_t>(xml_len);
+    LFW_CAPTURE("lfw_db_load_xml").str(doc_id).str(xml, size);
+
+    lfw::Context &ctx = lfw::current_context();
+    if (!ctx.db)
+    {
+        ctx.db = std::make_shared<lfw::Database>();
+    }
+
+    return static_cast<int32_t>(ctx.db->load_xml(doc_id, xml, size));
 }
 
-LFW_EXPORT void lfw_dispose(void)
+LFW_EXPORT int32_t lfw_db_load_file(const char *path)
+{
+    LFW_ENTRY(DbLoadFile, Other);
+    LFW_CAPTURE("lfw_db_load_file").str(path);
+    if (!path || !*path)
+    {
+        return -1;
+    }
+
+    lfw::Context &ctx = lfw::current_context();
+    if (!ctx.db)
+    {
+        ctx.db = std::make_shared<lfw::Database>();
+    }
+
+    return static_cast<int32_t>(ctx.db->load_file(path));
+}
+
+LFW_EXPORT int32_t lfw_db_unload(const char *doc_id)
+{
+    LFW_ENTRY(DbUnload, Other);
+    LFW_CAPTURE("lfw_db_unload").str(doc_id);
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    if (!db || !doc_id)
+    {
+        return -1;
+    }
+
+    return db->unload(doc_id) ? 0 : -1;
+}
+
+// 1 once the database has been replaced by a compacted copy, 0 while fewer
+// than `min_retired` lenses and cameras are retired.
+LFW_EXPORT int32_t lfw_db_compact(int32_t min_retired)
 {
-    if (g_db)
+    LFW_ENTRY(DbCompact, DatabaseLoad);
+    LFW_CAPTURE("lfw_db_compact").integer(min_retired);
+    const std::shared_ptr<lfw::Database> db = lfw::current_context().db;
+    if (!db)
+    {
+        return -1;
+    }
+
+    const lfw::Database::Counts counts = db->counts();
+    const size_t retired = counts.retired_lenses + counts.retired_cameras;
+    if (retired == 0 || retired < static_cast<size_t>(std::max(min_retired, 0)))
+    {
+        return 0;
+    }
+
+    std::shared_ptr<lfw::Database> compacted = db->compacted();
+    if (!compacted)
     {
-        lf_db_destroy(g_db);
-        g_db = nullptr;
+        return -2;
     }
+    lfw::replace_database(db, compacted);
+    return 1;
 }
 
 LFW_EXPORT char *lfw_find_lenses_json(
@@ -154,57 +268,46 @@ LFW_EXPORT char *lfw_find_lenses_json(
     const char *lens_model,
     int32_t search_flags)
 {
-    if (!g_db)
+    LFW_ENTRY(FindLenses, Other);
+    LFW_CAPTURE("lfw_find_lenses_json")
+        .str(camera_maker)
+        .str(camera_model)
+        .str(lens_maker)
+        .str(lens_model)
+        .integer(search_flags);
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    if (!db)
     {
         return dup_cstr("[]");
     }
 
-    const lfCamera *camera = nullptr;
-    const lfCamera **cameras_to_free = nullptr;
-    if (camera_maker || camera_model)
-    {
-        cameras_to_free = lf_db_find_cameras(g_db, camera_maker, camera_model);
-        if (cameras_to_free)
-        {
-            camera = cameras_to_free[0];
-        }
-    }
-
-    const lfLens **lenses = lf_db_find_lenses(g_db, camera, lens_maker, lens_model, search_flags);
+    const std::vector<lfw::Database::LensMatch> matches =
+        db->find_lenses(camera_maker, camera_model, lens_maker, lens_model, search_flags);
 
+    const lfw::AllocScope json_scope(lfw::AllocCategory::JsonOutput);
     std::ostringstream out;
     out << '[';
     bool first = true;
-    if (lenses)
+    for (const lfw::Database::LensMatch &match : matches)
     {
-        for (size_t i = 0; lenses[i] != nullptr; ++i)
+        if (!first)
         {
-            const lfLens *lens = lenses[i];
-            if (!first)
-            {
-                out << ',';
-            }
-            first = false;
-
-            const uint32_t handle = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(lens));
-            out << "{\"handle\":" << handle << ",\"maker\":";
-            append_json_escaped(out, lens->Maker ? lf_mlstr_get(lens->Maker) : "");
-            out << ",\"model\":";
-            append_json_escaped(out, lens->Model ? lf_mlstr_get(lens->Model) : "");
-            out << ",\"score\":" << lens->Score;
-            out << ",\"minFocal\":" << lens->MinFocal;
-            out << ",\"maxFocal\":" << lens->MaxFocal;
-            out << ",\"minAperture\":" << lens->MinAperture;
-            out << ",\"maxAperture\":" << lens->MaxAperture;
-            out << ",\"cropFactor\":" << lens->CropFactor;
-            out << '}';
+            out << ',';
         }
-        lf_free(lenses);
-    }
+        first = false;
 
-    if (cameras_to_free)
-    {
-        lf_free(cameras_to_free);
+        const lfLens *lens = match.lens;
+        out << "{\"handle\":" << db->lens_handle(lens) << ",\"maker\":";
+        append_json_escaped(out, lens->Maker ? lf_mlstr_get(lens->Maker) : "");
+        out << ",\"model\":";
+        append_json_escaped(out, lens->Model ? lf_mlstr_get(lens->Model) : "");
+        out << ",\"score\":" << match.score;
+        out << ",\"minFocal\":" << lens->MinFocal;
+        out << ",\"maxFocal\":" << lens->MaxFocal;
+        out << ",\"minAperture\":" << lens->MinAperture;
+        out << ",\"maxAperture\":" << lens->MaxAperture;
+        out << ",\"cropFactor\":" << lens->CropFactor;
+        out << '}';
     }
 
     out << ']';
@@ -213,44 +316,42 @@ LFW_EXPORT char *lfw_find_lenses_json(
 
 LFW_EXPORT char *lfw_find_cameras_json(const char *maker, const char *model, int32_t search_flags)
 {
-    (void)search_flags;
+    LFW_ENTRY(FindCameras, Other);
+    LFW_CAPTURE("lfw_find_cameras_json").str(maker).str(model).integer(search_flags);
 
-    if (!g_db)
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    if (!db)
     {
         return dup_cstr("[]");
     }
 
-    const lfCamera **cameras = lf_db_find_cameras_ext(g_db, maker, model, search_flags);
+    const std::vector<lfw::Database::CameraMatch> cameras = db->find_cameras(maker, model, search_flags);
 
+    const lfw::AllocScope json_scope(lfw::AllocCategory::JsonOutput);
     std::ostringstream out;
     out << '[';
     bool first = true;
 
-    if (cameras)
+    for (const lfw::Database::CameraMatch &match : cameras)
     {
-        for (size_t i = 0; cameras[i] != nullptr; ++i)
+        if (!first)
         {
-            const lfCamera *camera = cameras[i];
-            if (!first)
-            {
-                out << ',';
-            }
-            first = false;
-
-            out << "{\"maker\":";
-            append_json_escaped(out, camera->Maker ? lf_mlstr_get(camera->Maker) : "");
-            out << ",\"model\":";
-            append_json_escaped(out, camera->Model ? lf_mlstr_get(camera->Model) : "");
-            out << ",\"variant\":";
-            append_json_escaped(out, camera->Variant ? lf_mlstr_get(camera->Variant) : "");
-            out << ",\"mount\":";
-            append_json_escaped(out, camera->Mount ? camera->Mount : "");
-            out << ",\"cropFactor\":" << camera->CropFactor;
-            out << ",\"score\":" << camera->Score;
-            out << '}';
+            out << ',';
         }
+        first = false;
 
-        lf_free(cameras);
+        const lfCamera *camera = match.camera;
+        out << "{\"maker\":";
+        append_json_escaped(out, camera->Maker ? lf_mlstr_get(camera->Maker) : "");
+        out << ",\"model\":";
+        append_json_escaped(out, camera->Model ? lf_mlstr_get(camera->Model) : "");
+        out << ",\"variant\":";
+        append_json_escaped(out, camera->Variant ? lf_mlstr_get(camera->Variant) : "");
+        out << ",\"mount\":";
+        append_json_escaped(out, camera->Mount ? camera->Mount : "");
+        out << ",\"cropFactor\":" << camera->CropFactor;
+        out << ",\"score\":" << match.score;
+        out << '}';
     }
 
     out << ']';
@@ -259,7 +360,12 @@ LFW_EXPORT char *lfw_find_cameras_json(const char *maker, const char *model, int
 
 LFW_EXPORT int32_t lfw_available_mods(uint32_t lens_handle, float crop)
 {
+    LFW_ENTRY(AvailableMods, Other);
     const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_available_mods")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(crop);
     if (!lens)
     {
         return 0;
@@ -279,124 +385,412 @@ LFW_EXPORT int32_t lfw_build_geometry_map(
     float *out_xy,
     int32_t out_len)
 {
+    LFW_ENTRY(BuildGeometryMap, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_build_geometry_map")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step);
+    lfw::MapRequest request;
+    request.kind = lfw::MapKind::Geometry;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.width = width;
+    request.height = height;
+    request.reverse = reverse != 0;
+    request.step = step;
+    return build_map(request, out_xy, out_len);
+}
+
+LFW_EXPORT int32_t lfw_build_tca_map(
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step,
+    float *out_rgbxy,
+    int32_t out_len)
+{
+    LFW_ENTRY(BuildTcaMap, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_build_tca_map")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step);
+    lfw::MapRequest request;
+    request.kind = lfw::MapKind::Tca;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.width = width;
+    request.height = height;
+    request.reverse = reverse != 0;
+    request.step = step;
+    return build_map(request, out_rgbxy, out_len);
+}
+
+LFW_EXPORT int32_t lfw_build_vignetting_map(
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step,
+    float *out_rgb_gain,
+    int32_t out_len)
+{
+    LFW_ENTRY(BuildVignettingMap, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_build_vignetting_map")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step);
+    lfw::MapRequest request;
+    request.kind = lfw::MapKind::Vignetting;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = aperture;
+    request.distance = distance;
+    request.width = width;
+    request.height = height;
+    request.reverse = reverse != 0;
+    request.step = step;
+    return build_map(request, out_rgb_gain, out_len);
+}
+
+LFW_EXPORT int32_t lfw_map_stream_create(
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step)
+{
+    LFW_ENTRY(MapStreamCreate, Modifier);
     const lfLens *lens = resolve_lens(lens_handle);
-    if (!lens || !out_xy || width <= 0 || height <= 0 || step <= 0)
+    if (!lens || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count) || width <= 0 || height <= 0 ||
+        step <= 0)
+    {
+        return -1;
+    }
+
+    lfw::MapRequest request;
+    request.kind = static_cast<lfw::MapKind>(kind);
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = aperture;
+    request.distance = distance;
+    request.width = width;
+    request.height = height;
+    request.reverse = reverse != 0;
+    request.step = step;
+
+    auto builder = std::make_unique<lfw::MapBuilder>(request, lfw::current_context().db);
+    const int32_t rc = builder->init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    const uint32_t handle = lfw::register_map_stream(std::move(builder));
+    LFW_CAPTURE("lfw_map_stream_create")
+        .integer(handle)
+        .integer(kind)
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step);
+    return static_cast<int32_t>(handle);
+}
+
+LFW_EXPORT int32_t lfw_map_stream_rows(uint32_t stream, int32_t y0, int32_t y1, float *out, int32_t out_len)
+{
+    LFW_ENTRY(MapStreamRows, Modifier);
+    LFW_CAPTURE("lfw_map_stream_rows").integer(stream).integer(y0).integer(y1);
+    lfw::MapBuilder *builder = lfw::find_map_stream(stream);
+    if (!builder || !out || y0 < 0 || y1 <= y0 || y1 > builder->grid_height())
     {
         return -1;
     }
 
-    const int gx = grid_points(width, step);
-    const int gy = grid_points(height, step);
-    const int needed = gx * gy * 2;
-    if (out_len < needed)
+    const size_t needed = builder->row_floats() * static_cast<size_t>(y1 - y0);
+    if (out_len < 0 || static_cast<size_t>(out_len) < needed)
     {
         return -2;
     }
+    return builder->fill_rows(y0, y1, out);
+}
 
-    lfModifier *modifier = lf_modifier_create(
-        lens,
-        focal,
-        crop,
-        width,
-        height,
-        LF_PF_F32,
-        reverse != 0);
+LFW_EXPORT int32_t lfw_map_stream_destroy(uint32_t stream)
+{
+    LFW_CAPTURE("lfw_map_stream_destroy").integer(stream);
+    return lfw::destroy_map_stream(stream) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_tiler_create(
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t channels,
+    int32_t mods,
+    int32_t tile_size)
+{
+    LFW_ENTRY(TilerCreate, Modifier);
+    lfw::TileRequest request;
+    request.lens = resolve_lens(lens_handle);
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = aperture;
+    request.distance = distance;
+    request.width = width;
+    request.height = height;
+    request.channels = channels;
+    request.mods = mods;
+    request.tile_size = tile_size;
 
-    if (!modifier)
+    auto tiler = std::make_unique<lfw::TileCorrector>(request, lfw::current_context().db);
+    const int32_t rc = tiler->init();
+    if (rc != 0)
     {
-        return -3;
+        return rc;
     }
 
-    lf_modifier_enable_distortion_correction(modifier);
+    const uint32_t handle = lfw::register_tiler(std::move(tiler));
+    LFW_CAPTURE("lfw_tiler_create")
+        .integer(handle)
+        .str(lens_maker_or_null(request.lens))
+        .str(lens_model_or_null(request.lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(channels)
+        .integer(mods)
+        .integer(tile_size);
+    return static_cast<int32_t>(handle);
+}
+
+LFW_EXPORT int32_t lfw_tiler_tile_count(uint32_t tiler)
+{
+    const lfw::TileCorrector *corrector = lfw::find_tiler(tiler);
+    return corrector ? corrector->tile_count() : -1;
+}
 
-    int cursor = 0;
-    float result[2] = {0.0f, 0.0f};
-    for (int y = 0; y < gy; ++y)
+LFW_EXPORT int32_t lfw_tiler_begin_tile(uint32_t tiler, int32_t index, int32_t *out_rects)
+{
+    LFW_ENTRY(TilerBeginTile, Other);
+    LFW_CAPTURE("lfw_tiler_begin_tile").integer(tiler).integer(index);
+    lfw::TileCorrector *corrector = lfw::find_tiler(tiler);
+    if (!corrector || !out_rects)
     {
-        const float py = sample_coord(y, step, height);
-        for (int x = 0; x < gx; ++x)
-        {
-            const float px = sample_coord(x, step, width);
-            if (!lf_modifier_apply_geometry_distortion(modifier, px, py, 1, 1, result))
-            {
-                lf_modifier_destroy(modifier);
-                return -4;
-            }
-            out_xy[cursor++] = result[0];
-            out_xy[cursor++] = result[1];
-        }
+        return -1;
     }
 
-    lf_modifier_destroy(modifier);
+    lfw::TileRect dst;
+    lfw::TileRect src;
+    const int32_t rc = corrector->begin_tile(index, &dst, &src);
+    if (rc != 0)
+    {
+        return rc;
+    }
+    const int32_t rects[8] = {dst.x, dst.y, dst.width, dst.height, src.x, src.y, src.width, src.height};
+    memcpy(out_rects, rects, sizeof(rects));
     return 0;
 }
 
-LFW_EXPORT int32_t lfw_build_tca_map(
+LFW_EXPORT float *lfw_tiler_source_buffer(uint32_t tiler)
+{
+    lfw::TileCorrector *corrector = lfw::find_tiler(tiler);
+    return corrector ? corrector->source_buffer() : nullptr;
+}
+
+LFW_EXPORT int32_t lfw_tiler_finish_tile(uint32_t tiler, float *out, int32_t out_len)
+{
+    LFW_ENTRY(TilerFinishTile, Other);
+    LFW_CAPTURE("lfw_tiler_finish_tile").integer(tiler);
+    lfw::TileCorrector *corrector = lfw::find_tiler(tiler);
+    if (!corrector || out_len < 0)
+    {
+        return -1;
+    }
+    return corrector->finish_tile(out, static_cast<size_t>(out_len));
+}
+
+LFW_EXPORT int32_t lfw_tiler_run(uint32_t tiler, lfw_tile_read_fn read, lfw_tile_write_fn write, void *user)
+{
+    LFW_ENTRY(TilerRun, Other);
+    LFW_CAPTURE("lfw_tiler_run").integer(tiler);
+    lfw::TileCorrector *corrector = lfw::find_tiler(tiler);
+    if (!corrector)
+    {
+        return -1;
+    }
+    return corrector->run(read, write, user);
+}
+
+LFW_EXPORT int32_t lfw_tiler_destroy(uint32_t tiler)
+{
+    LFW_CAPTURE("lfw_tiler_destroy").integer(tiler);
+    return lfw::destroy_tiler(tiler) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_zoom_create(
+    int32_t kind,
     uint32_t lens_handle,
-    float focal,
+    float min_focal,
+    float max_focal,
     float crop,
+    float aperture,
+    float distance,
     int32_t width,
     int32_t height,
     int32_t reverse,
     int32_t step,
-    float *out_rgbxy,
-    int32_t out_len)
+    float tolerance,
+    int32_t max_anchors)
 {
+    LFW_ENTRY(ZoomCreate, Modifier);
     const lfLens *lens = resolve_lens(lens_handle);
-    if (!lens || !out_rgbxy || width <= 0 || height <= 0 || step <= 0)
+    if (!lens || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count) || width <= 0 || height <= 0 ||
+        step <= 0)
     {
         return -1;
     }
 
-    const int gx = grid_points(width, step);
-    const int gy = grid_points(height, step);
-    const int needed = gx * gy * 6;
-    if (out_len < needed)
+    lfw::ZoomRequest request;
+    request.map.kind = static_cast<lfw::MapKind>(kind);
+    request.map.lens = lens;
+    request.map.crop = crop;
+    request.map.aperture = aperture;
+    request.map.distance = distance;
+    request.map.width = width;
+    request.map.height = height;
+    request.map.reverse = reverse != 0;
+    request.map.step = step;
+    request.min_focal = min_focal;
+    request.max_focal = max_focal;
+    request.tolerance = tolerance;
+    request.max_anchors = max_anchors;
+
+    auto sequence = std::make_unique<lfw::ZoomSequence>(request, lfw::current_context().db);
+    const int32_t rc = sequence->init();
+    if (rc != 0)
     {
-        return -2;
+        return rc;
     }
 
-    lfModifier *modifier = lf_modifier_create(
-        lens,
-        focal,
-        crop,
-        width,
-        height,
-        LF_PF_F32,
-        reverse != 0);
+    const uint32_t handle = lfw::register_zoom(std::move(sequence));
+    LFW_CAPTURE("lfw_zoom_create")
+        .integer(handle)
+        .integer(kind)
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(min_focal)
+        .num(max_focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step)
+        .num(tolerance)
+        .integer(max_anchors);
+    return static_cast<int32_t>(handle);
+}
+
+LFW_EXPORT char *lfw_zoom_info_json(uint32_t zoom)
+{
+    const lfw::ZoomSequence *sequence = lfw::find_zoom(zoom);
+    return sequence ? dup_cstr(sequence->info_json()) : nullptr;
+}
 
-    if (!modifier)
+LFW_EXPORT int32_t lfw_zoom_blend(uint32_t zoom, float focal, float *out, int32_t out_len)
+{
+    LFW_ENTRY(ZoomBlend, Other);
+    LFW_CAPTURE("lfw_zoom_blend").integer(zoom).num(focal);
+    const lfw::ZoomSequence *sequence = lfw::find_zoom(zoom);
+    if (!sequence || !out)
     {
-        return -3;
+        return -1;
     }
-
-    lf_modifier_enable_tca_correction(modifier);
-
-    int cursor = 0;
-    float result[6] = {0};
-    for (int y = 0; y < gy; ++y)
+    if (out_len < 0 || static_cast<size_t>(out_len) < sequence->frame_floats())
     {
-        const float py = sample_coord(y, step, height);
-        for (int x = 0; x < gx; ++x)
-        {
-            const float px = sample_coord(x, step, width);
-            if (!lf_modifier_apply_subpixel_distortion(modifier, px, py, 1, 1, result))
-            {
-                lf_modifier_destroy(modifier);
-                return -4;
-            }
-            for (int k = 0; k < 6; ++k)
-            {
-                out_rgbxy[cursor++] = result[k];
-            }
-        }
+        return -2;
     }
+    sequence->blend(focal, out);
+    return 0;
+}
 
-    lf_modifier_destroy(modifier);
+LFW_EXPORT int32_t lfw_zoom_prepare(uint32_t zoom, float focal)
+{
+    LFW_ENTRY(ZoomPrepare, Modifier);
+    LFW_CAPTURE("lfw_zoom_prepare").integer(zoom).num(focal);
+    lfw::ZoomSequence *sequence = lfw::find_zoom(zoom);
+    if (!sequence)
+    {
+        return -1;
+    }
+    sequence->prepare(focal);
     return 0;
 }
 
-LFW_EXPORT int32_t lfw_build_vignetting_map(
+LFW_EXPORT const float *lfw_zoom_acquire(uint32_t zoom)
+{
+    LFW_ENTRY(ZoomAcquire, Other);
+    LFW_CAPTURE("lfw_zoom_acquire").integer(zoom);
+    lfw::ZoomSequence *sequence = lfw::find_zoom(zoom);
+    return sequence ? sequence->acquire() : nullptr;
+}
+
+LFW_EXPORT int32_t lfw_zoom_destroy(uint32_t zoom)
+{
+    LFW_CAPTURE("lfw_zoom_destroy").integer(zoom);
+    return lfw::destroy_zoom(zoom) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_correction_descriptor(
     uint32_t lens_handle,
     float focal,
     float crop,
@@ -405,83 +799,957 @@ LFW_EXPORT int32_t lfw_build_vignetting_map(
     int32_t width,
     int32_t height,
     int32_t reverse,
-    int32_t step,
-    float *out_rgb_gain,
+    float *out,
     int32_t out_len)
 {
+    LFW_ENTRY(CorrectionDescriptor, Modifier);
     const lfLens *lens = resolve_lens(lens_handle);
-    if (!lens || !out_rgb_gain || width <= 0 || height <= 0 || step <= 0)
+    LFW_CAPTURE("lfw_correction_descriptor")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse);
+    if (!lens || !out)
     {
         return -1;
     }
-
-    const int gx = grid_points(width, step);
-    const int gy = grid_points(height, step);
-    const int needed = gx * gy * 3;
-    if (out_len < needed)
+    if (out_len < lfw::kDescriptorFloats)
     {
         return -2;
     }
 
-    lfModifier *modifier = lf_modifier_create(
-        lens,
-        focal,
-        crop,
-        width,
-        height,
-        LF_PF_F32,
-        reverse != 0);
+    lfw::MapRequest request;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = aperture;
+    request.distance = distance;
+    request.width = width;
+    request.height = height;
+    request.reverse = reverse != 0;
+    lfw::CorrectionDescriptor descriptor;
+    const int32_t rc =
+        lfw::describe_correction(request, lfw::current_context().db->calibrations(), &descriptor);
+    if (rc != 0)
+    {
+        return rc;
+    }
+    lfw::pack_descriptor(descriptor, out);
+    return lfw::kDescriptorFloats;
+}
 
-    if (!modifier)
+LFW_EXPORT int32_t lfw_descriptor_build_map(
+    const float *descriptor,
+    int32_t descriptor_len,
+    int32_t kind,
+    int32_t step,
+    float *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(DescriptorBuildMap, Other);
+    LFW_CAPTURE("lfw_descriptor_build_map")
+        .integer(descriptor_len)
+        .integer(kind)
+        .integer(step)
+        .nums(descriptor, static_cast<size_t>(std::max(descriptor_len, 0)), lfw::kDescriptorFloats);
+    lfw::CorrectionDescriptor d;
+    if (!lfw::unpack_descriptor(descriptor, descriptor_len, &d) || !out || kind < 0 ||
+        kind >= static_cast<int32_t>(lfw::MapKind::Count) || step <= 0)
     {
-        return -3;
+        return -1;
+    }
+    const lfw::MapKind map_kind = static_cast<lfw::MapKind>(kind);
+    const size_t needed = static_cast<size_t>(lfw::grid_points(d.width, step)) * lfw::grid_points(d.height, step) *
+                          lfw::map_channels(map_kind);
+    if (out_len < 0 || static_cast<size_t>(out_len) < needed)
+    {
+        return -2;
     }
+    return lfw::evaluate_descriptor_rows(d, kind, step, 0, lfw::grid_points(d.height, step), out);
+}
 
-    if (!lf_modifier_enable_vignetting_correction(modifier, aperture, distance))
+LFW_EXPORT int32_t lfw_normalized_map_create(
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    float aspect,
+    int32_t reverse,
+    int32_t grid_size)
+{
+    LFW_ENTRY(NormalizedMapCreate, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    if (!lens || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count))
     {
-        lf_modifier_destroy(modifier);
-        return -4;
+        return -1;
     }
 
-    int cursor = 0;
-    float pixel[3] = {1.0f, 1.0f, 1.0f};
-    for (int y = 0; y < gy; ++y)
+    lfw::NormalizedRequest request;
+    request.map.kind = static_cast<lfw::MapKind>(kind);
+    request.map.lens = lens;
+    request.map.focal = focal;
+    request.map.crop = crop;
+    request.map.aperture = aperture;
+    request.map.distance = distance;
+    request.map.reverse = reverse != 0;
+    request.aspect = aspect;
+    request.grid_size = grid_size;
+
+    auto map = std::make_unique<lfw::NormalizedMap>(request, lfw::current_context().db);
+    const int32_t rc = map->init();
+    if (rc != 0)
     {
-        const float py = sample_coord(y, step, height);
-        for (int x = 0; x < gx; ++x)
-        {
-            const float px = sample_coord(x, step, width);
-            pixel[0] = 1.0f;
-            pixel[1] = 1.0f;
-            pixel[2] = 1.0f;
-
-            if (!lf_modifier_apply_color_modification(
-                    modifier,
-                    pixel,
-                    px,
-                    py,
-                    1,
-                    1,
-                    LF_CR_3(RED, GREEN, BLUE),
-                    0))
-            {
-                lf_modifier_destroy(modifier);
-                return -5;
-            }
-
-            out_rgb_gain[cursor++] = pixel[0];
-            out_rgb_gain[cursor++] = pixel[1];
-            out_rgb_gain[cursor++] = pixel[2];
-        }
+        return rc;
     }
 
-    lf_modifier_destroy(modifier);
-    return 0;
+    const uint32_t handle = lfw::register_normalized_map(std::move(map));
+    LFW_CAPTURE("lfw_normalized_map_create")
+        .integer(handle)
+        .integer(kind)
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .num(aspect)
+        .integer(reverse)
+        .integer(grid_size);
+    return static_cast<int32_t>(handle);
+}
+
+LFW_EXPORT int32_t lfw_normalized_map_sample(
+    uint32_t map,
+    int32_t width,
+    int32_t height,
+    int32_t step,
+    float *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(NormalizedMapSample, Other);
+    LFW_CAPTURE("lfw_normalized_map_sample").integer(map).integer(width).integer(height).integer(step);
+    const lfw::NormalizedMap *normalized = lfw::find_normalized_map(map);
+    if (!normalized || !out || width <= 0 || height <= 0 || step <= 0)
+    {
+        return -1;
+    }
+    const size_t needed = lfw::NormalizedMap::sample_floats(normalized->kind(), width, height, step);
+    if (out_len < 0 || static_cast<size_t>(out_len) < needed)
+    {
+        return -2;
+    }
+    return normalized->sample(width, height, step, out);
+}
+
+LFW_EXPORT int32_t lfw_normalized_map_destroy(uint32_t map)
+{
+    LFW_CAPTURE("lfw_normalized_map_destroy").integer(map);
+    return lfw::destroy_normalized_map(map) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_valid_crop(
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    int32_t width,
+    int32_t height,
+    int32_t mods,
+    float *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(ValidCrop, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_valid_crop")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .integer(width)
+        .integer(height)
+        .integer(mods);
+    if (!lens || !out)
+    {
+        return -1;
+    }
+    if (out_len < lfw::kValidCropFloats)
+    {
+        return -2;
+    }
+
+    lfw::CropRequest request;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.width = width;
+    request.height = height;
+    request.mods = mods;
+    lfw::ValidCrop valid;
+    const int32_t rc = lfw::find_valid_crop(request, lfw::current_context().db->calibrations(), &valid);
+    if (rc != 0)
+    {
+        return rc;
+    }
+    out[0] = valid.scale;
+    out[1] = static_cast<float>(valid.x);
+    out[2] = static_cast<float>(valid.y);
+    out[3] = static_cast<float>(valid.width);
+    out[4] = static_cast<float>(valid.height);
+    return 0;
+}
+
+LFW_EXPORT int32_t lfw_thumbnail(
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t channels,
+    int32_t mods,
+    int32_t filter,
+    const float *source,
+    int32_t source_len,
+    int32_t out_width,
+    int32_t out_height,
+    float *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(Thumbnail, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_thumbnail")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(channels)
+        .integer(mods)
+        .integer(filter)
+        .integer(out_width)
+        .integer(out_height);
+    if (!lens || !source || !out || width <= 0 || height <= 0 || out_width <= 0 || out_height <= 0 || channels <= 0)
+    {
+        return -1;
+    }
+    if (static_cast<int64_t>(source_len) < static_cast<int64_t>(width) * height * channels ||
+        static_cast<int64_t>(out_len) < static_cast<int64_t>(out_width) * out_height * channels)
+    {
+        return -2;
+    }
+
+    lfw::ThumbnailRequest request;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = aperture;
+    request.distance = distance;
+    request.width = width;
+    request.height = height;
+    request.channels = channels;
+    request.mods = mods;
+    request.out_width = out_width;
+    request.out_height = out_height;
+    request.filter = static_cast<lfw::ThumbnailFilter>(filter);
+    return lfw::render_thumbnail(request, lfw::current_context().db->calibrations(), source, out);
+}
+
+LFW_EXPORT int32_t lfw_cfa_vignetting(
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    const char *pattern,
+    int32_t pattern_width,
+    int32_t black,
+    int32_t white,
+    uint16_t *data,
+    int32_t stride,
+    int32_t data_len)
+{
+    LFW_ENTRY(CfaVignetting, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_cfa_vignetting")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .str(pattern)
+        .integer(pattern_width)
+        .integer(black)
+        .integer(white)
+        .integer(stride);
+    if (!lens || !data || width <= 0 || height <= 0 || stride < 0)
+    {
+        return -1;
+    }
+    const int64_t row = stride > 0 ? stride : width;
+    if (static_cast<int64_t>(data_len) < row * (height - 1) + width)
+    {
+        return -2;
+    }
+
+    lfw::CfaRequest request;
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = aperture;
+    request.distance = distance;
+    request.width = width;
+    request.height = height;
+    request.pattern = pattern;
+    request.pattern_width = pattern_width;
+    request.black = black;
+    request.white = white;
+    request.stride = stride;
+    return lfw::correct_cfa_vignetting(request, lfw::current_context().db, data);
+}
+
+LFW_EXPORT int32_t lfw_fixed_map_create(
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    int32_t width,
+    int32_t height,
+    int32_t reverse)
+{
+    LFW_ENTRY(FixedMapCreate, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    if (!lens || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count))
+    {
+        return -1;
+    }
+
+    lfw::FixedMapRequest request;
+    request.map.kind = static_cast<lfw::MapKind>(kind);
+    request.map.lens = lens;
+    request.map.focal = focal;
+    request.map.crop = crop;
+    request.map.width = width;
+    request.map.height = height;
+    request.map.reverse = reverse != 0;
+
+    auto map = std::make_unique<lfw::FixedMap>(request, lfw::current_context().db);
+    const int32_t rc = map->init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    const uint32_t handle = lfw::register_fixed_map(std::move(map));
+    LFW_CAPTURE("lfw_fixed_map_create")
+        .integer(handle)
+        .integer(kind)
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .integer(width)
+        .integer(height)
+        .integer(reverse);
+    return static_cast<int32_t>(handle);
+}
+
+LFW_EXPORT int32_t lfw_fixed_map_fraction_bits(uint32_t map)
+{
+    const lfw::FixedMap *fixed = lfw::find_fixed_map(map);
+    return fixed ? fixed->fraction_bits() : -1;
+}
+
+LFW_EXPORT int32_t lfw_fixed_map_remap(
+    uint32_t map,
+    const uint8_t *src,
+    int32_t src_len,
+    uint8_t *dst,
+    int32_t dst_len,
+    int32_t y0,
+    int32_t y1)
+{
+    LFW_ENTRY(FixedMapRemap, Other);
+    LFW_CAPTURE("lfw_fixed_map_remap").integer(map).integer(y0).integer(y1);
+    const lfw::FixedMap *fixed = lfw::find_fixed_map(map);
+    if (!fixed || !src || !dst)
+    {
+        return -1;
+    }
+    const int64_t bytes = static_cast<int64_t>(fixed->width()) * fixed->height() * 4;
+    if (static_cast<int64_t>(src_len) < bytes || static_cast<int64_t>(dst_len) < bytes)
+    {
+        return -2;
+    }
+    return fixed->remap(src, dst, y0, y1);
+}
+
+LFW_EXPORT int32_t lfw_fixed_map_destroy(uint32_t map)
+{
+    LFW_CAPTURE("lfw_fixed_map_destroy").integer(map);
+    return lfw::destroy_fixed_map(map) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_map_job_create(
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step,
+    int32_t coarse_step)
+{
+    LFW_ENTRY(MapJobCreate, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    if (!lens || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count) || width <= 0 || height <= 0 ||
+        step <= 0)
+    {
+        return -1;
+    }
+
+    lfw::MapJobRequest request;
+    request.map.kind = static_cast<lfw::MapKind>(kind);
+    request.map.lens = lens;
+    request.map.focal = focal;
+    request.map.crop = crop;
+    request.map.aperture = aperture;
+    request.map.distance = distance;
+    request.map.width = width;
+    request.map.height = height;
+    request.map.reverse = reverse != 0;
+    request.map.step = step;
+    request.coarse_step = coarse_step;
+
+    auto job = std::make_unique<lfw::MapJob>(request, lfw::current_context().db);
+    const int32_t rc = job->init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    const uint32_t handle = lfw::register_map_job(std::move(job));
+    LFW_CAPTURE("lfw_map_job_create")
+        .integer(handle)
+        .integer(kind)
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step)
+        .integer(coarse_step);
+    return static_cast<int32_t>(handle);
+}
+
+LFW_EXPORT int32_t lfw_map_job_run(uint32_t job, int32_t max_rows)
+{
+    LFW_ENTRY(MapJobRun, Modifier);
+    LFW_CAPTURE("lfw_map_job_run").integer(job).integer(max_rows);
+    lfw::MapJob *map_job = lfw::find_map_job(job);
+    return map_job ? map_job->run(max_rows) : -1;
+}
+
+LFW_EXPORT int32_t lfw_map_job_cancel(uint32_t job)
+{
+    LFW_CAPTURE("lfw_map_job_cancel").integer(job);
+    lfw::MapJob *map_job = lfw::find_map_job(job);
+    if (!map_job)
+    {
+        return -1;
+    }
+    map_job->cancel();
+    return 0;
+}
+
+LFW_EXPORT float lfw_map_job_progress(uint32_t job)
+{
+    const lfw::MapJob *map_job = lfw::find_map_job(job);
+    if (!map_job || map_job->total_rows() == 0)
+    {
+        return -1.0f;
+    }
+    return static_cast<float>(map_job->rows_done()) / static_cast<float>(map_job->total_rows());
+}
+
+LFW_EXPORT const float *lfw_map_job_coarse(uint32_t job)
+{
+    const lfw::MapJob *map_job = lfw::find_map_job(job);
+    return map_job ? map_job->coarse() : nullptr;
+}
+
+LFW_EXPORT const float *lfw_map_job_result(uint32_t job)
+{
+    const lfw::MapJob *map_job = lfw::find_map_job(job);
+    return map_job ? map_job->result() : nullptr;
+}
+
+LFW_EXPORT int32_t lfw_map_job_destroy(uint32_t job)
+{
+    LFW_CAPTURE("lfw_map_job_destroy").integer(job);
+    return lfw::destroy_map_job(job) ? 0 : -1;
+}
+
+LFW_EXPORT int32_t lfw_batch_create(void)
+{
+    LFW_ENTRY(BatchCreate, Modifier);
+    std::shared_ptr<lfw::Database> db = lfw::current_context().db;
+    const int32_t handle =
+        db ? static_cast<int32_t>(lfw::register_batch(std::make_unique<lfw::CorrectionBatch>(std::move(db)))) : -1;
+    LFW_CAPTURE("lfw_batch_create").integer(handle);
+    return handle;
+}
+
+LFW_EXPORT int32_t lfw_batch_add(
+    uint32_t batch,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step,
+    int32_t mods)
+{
+    LFW_ENTRY(BatchAdd, Modifier);
+    lfw::CorrectionBatch *correction_batch = lfw::find_batch(batch);
+    // The lens must come from the database the batch keeps alive and builds
+    // against, not whichever one the context holds now.
+    const lfLens *lens = correction_batch ? correction_batch->db()->resolve_lens(lens_handle) : nullptr;
+    LFW_CAPTURE("lfw_batch_add")
+        .integer(batch)
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step)
+        .integer(mods);
+    if (!correction_batch || !lens)
+    {
+        return -1;
+    }
+
+    lfw::BatchItem item;
+    item.lens = lens;
+    item.focal = focal;
+    item.crop = crop;
+    item.aperture = aperture;
+    item.distance = distance;
+    item.width = width;
+    item.height = height;
+    item.reverse = reverse != 0;
+    item.step = step;
+    item.mods = mods;
+    return correction_batch->add(item);
+}
+
+LFW_EXPORT int32_t lfw_batch_set_pixels(uint32_t batch, int32_t item, const float *source, float *output,
+                                        int32_t channels)
+{
+    // The pixels are not captured; a replay remaps buffers of its own.
+    LFW_CAPTURE("lfw_batch_set_pixels").integer(batch).integer(item).integer(channels);
+    lfw::CorrectionBatch *correction_batch = lfw::find_batch(batch);
+    if (!correction_batch)
+    {
+        return -1;
+    }
+    return correction_batch->set_pixels(item, source, output, channels);
+}
+
+LFW_EXPORT int32_t lfw_batch_run(uint32_t batch, int32_t threads)
+{
+    LFW_ENTRY(BatchRun, Modifier);
+    LFW_CAPTURE("lfw_batch_run").integer(batch).integer(threads);
+    lfw::CorrectionBatch *correction_batch = lfw::find_batch(batch);
+    return correction_batch ? correction_batch->run(threads) : -1;
+}
+
+LFW_EXPORT int32_t lfw_batch_item_group(uint32_t batch, int32_t item)
+{
+    LFW_CAPTURE("lfw_batch_item_group").integer(batch).integer(item);
+    const lfw::CorrectionBatch *correction_batch = lfw::find_batch(batch);
+    return correction_batch ? correction_batch->item_group(item) : -1;
+}
+
+LFW_EXPORT int32_t lfw_batch_item_status(uint32_t batch, int32_t item)
+{
+    LFW_CAPTURE("lfw_batch_item_status").integer(batch).integer(item);
+    const lfw::CorrectionBatch *correction_batch = lfw::find_batch(batch);
+    return correction_batch ? correction_batch->item_status(item) : -1;
+}
+
+LFW_EXPORT const float *lfw_batch_map(uint32_t batch, int32_t item, int32_t kind)
+{
+    const lfw::CorrectionBatch *correction_batch = lfw::find_batch(batch);
+    if (!correction_batch || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count))
+    {
+        return nullptr;
+    }
+    return correction_batch->map(item, static_cast<lfw::MapKind>(kind));
+}
+
+LFW_EXPORT int32_t lfw_batch_destroy(uint32_t batch)
+{
+    LFW_CAPTURE("lfw_batch_destroy").integer(batch);
+    return lfw::destroy_batch(batch) ? 0 : -1;
+}
+
+LFW_EXPORT char *lfw_db_content_hash(void)
+{
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    if (!db)
+    {
+        return nullptr;
+    }
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(db->content_hash()));
+    return dup_cstr(hex);
+}
+
+LFW_EXPORT int32_t lfw_map_blob_size(int32_t kind, uint32_t lens_handle, int32_t width, int32_t height, int32_t step)
+{
+    const lfLens *lens = resolve_lens(lens_handle);
+    if (!lens || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count) || width <= 0 || height <= 0 ||
+        step <= 0)
+    {
+        return -1;
+    }
+    lfw::MapBlobKey key;
+    key.lens_maker = lens_maker_or_null(lens) ? lens_maker_or_null(lens) : "";
+    key.lens_model = lens_model_or_null(lens) ? lens_model_or_null(lens) : "";
+    const uint64_t floats = static_cast<uint64_t>(lfw::grid_points(width, step)) * lfw::grid_points(height, step) *
+                            lfw::map_channels(static_cast<lfw::MapKind>(kind));
+    if (floats > INT32_MAX / sizeof(float))
+    {
+        return -1;
+    }
+    const size_t bytes = lfw::map_blob_bytes(key, static_cast<size_t>(floats));
+    return bytes <= INT32_MAX ? static_cast<int32_t>(bytes) : -1;
+}
+
+LFW_EXPORT int32_t lfw_map_blob_export(
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step,
+    uint8_t *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(MapBlobExport, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_map_blob_export")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .integer(kind)
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step);
+    const int32_t bytes = lfw_map_blob_size(kind, lens_handle, width, height, step);
+    if (bytes < 0 || !out)
+    {
+        return -1;
+    }
+    if (out_len < bytes)
+    {
+        return -2;
+    }
+
+    // Aperture and distance do not change the other maps, so they are not
+    // part of their key.
+    const bool vignetting = kind == static_cast<int32_t>(lfw::MapKind::Vignetting);
+    lfw::MapRequest request;
+    request.kind = static_cast<lfw::MapKind>(kind);
+    request.lens = lens;
+    request.focal = focal;
+    request.crop = crop;
+    request.aperture = vignetting ? aperture : 0.0f;
+    request.distance = vignetting ? distance : 0.0f;
+    request.width = width;
+    request.height = height;
+    request.reverse = reverse != 0;
+    request.step = step;
+    // Built aside: `out` need not be aligned for floats.
+    const int grid_width = lfw::grid_points(width, step);
+    const int grid_height = lfw::grid_points(height, step);
+    const int channels = lfw::map_channels(request.kind);
+    std::vector<float> map(static_cast<size_t>(grid_width) * grid_height * channels);
+    const int32_t rc = build_map(request, map.data(), static_cast<int32_t>(map.size()));
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    lfw::MapBlobKey key;
+    key.kind = kind;
+    key.lens_maker = lens_maker_or_null(lens) ? lens_maker_or_null(lens) : "";
+    key.lens_model = lens_model_or_null(lens) ? lens_model_or_null(lens) : "";
+    key.lens_ordinal = db->lens_ordinal(lens);
+    key.focal = focal;
+    key.crop = crop;
+    key.aperture = request.aperture;
+    key.distance = request.distance;
+    key.width = width;
+    key.height = height;
+    key.step = step;
+    key.reverse = request.reverse;
+    key.db_hash = db->content_hash();
+    lfw::write_map_blob(key, grid_width, grid_height, channels, map.data(), out);
+    return bytes;
+}
+
+LFW_EXPORT int32_t lfw_map_blob_import(
+    const uint8_t *blob,
+    int32_t blob_len,
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    int32_t step,
+    float *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(MapBlobImport, Other);
+    const lfLens *lens = resolve_lens(lens_handle);
+    // The blob itself, so a replay imports the same bytes.
+    LFW_CAPTURE("lfw_map_blob_import")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .integer(kind)
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .integer(step)
+        .bytes(blob, blob ? static_cast<size_t>(std::max(blob_len, 0)) : 0);
+    if (!blob || blob_len < 0 || !lens)
+    {
+        return -1;
+    }
+    lfw::MapBlobView view;
+    const int32_t rc = lfw::read_map_blob(blob, static_cast<size_t>(blob_len), &view);
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    const std::shared_ptr<lfw::Database> &db = lfw::current_context().db;
+    if (!db || db->content_hash() != view.key.db_hash)
+    {
+        return -5;
+    }
+    const lfLens *blob_lens =
+        db->find_lens(view.key.lens_maker.c_str(), view.key.lens_model.c_str(), view.key.lens_ordinal);
+    if (!blob_lens)
+    {
+        return -6;
+    }
+    // A blob filed under the wrong cache key must not stand in for the map
+    // the caller asked for. Aperture and distance are only kept for
+    // vignetting, as in lfw_map_blob_export.
+    const lfw::MapBlobKey &key = view.key;
+    const bool vignetting = kind == static_cast<int32_t>(lfw::MapKind::Vignetting);
+    if (blob_lens != lens || key.kind != kind || key.focal != focal || key.crop != crop ||
+        key.aperture != (vignetting ? aperture : 0.0f) || key.distance != (vignetting ? distance : 0.0f) ||
+        key.width != width || key.height != height || key.step != step || key.reverse != (reverse != 0))
+    {
+        return -7;
+    }
+
+    const size_t floats = static_cast<size_t>(view.grid_width) * view.grid_height * view.channels;
+    if (out)
+    {
+        if (out_len < 0 || static_cast<size_t>(out_len) < floats)
+        {
+            return -2;
+        }
+        memcpy(out, view.map, floats * sizeof(float));
+    }
+    return 0;
+}
+
+LFW_EXPORT int32_t lfw_choose_step(
+    int32_t kind,
+    uint32_t lens_handle,
+    float focal,
+    float crop,
+    float aperture,
+    float distance,
+    int32_t width,
+    int32_t height,
+    int32_t reverse,
+    float tolerance,
+    int32_t max_step,
+    float *out,
+    int32_t out_len)
+{
+    LFW_ENTRY(ChooseStep, Modifier);
+    const lfLens *lens = resolve_lens(lens_handle);
+    LFW_CAPTURE("lfw_choose_step")
+        .str(lens_maker_or_null(lens))
+        .str(lens_model_or_null(lens))
+        .integer(kind)
+        .num(focal)
+        .num(crop)
+        .num(aperture)
+        .num(distance)
+        .integer(width)
+        .integer(height)
+        .integer(reverse)
+        .num(tolerance)
+        .integer(max_step);
+    if (!lens || !out || kind < 0 || kind >= static_cast<int32_t>(lfw::MapKind::Count))
+    {
+        return -1;
+    }
+    if (out_len < lfw::kStepChoiceFloats)
+    {
+        return -2;
+    }
+
+    lfw::StepRequest request;
+    request.map.kind = static_cast<lfw::MapKind>(kind);
+    request.map.lens = lens;
+    request.map.focal = focal;
+    request.map.crop = crop;
+    request.map.aperture = aperture;
+    request.map.distance = distance;
+    request.map.width = width;
+    request.map.height = height;
+    request.map.reverse = reverse != 0;
+    request.tolerance = tolerance;
+    request.max_step = max_step;
+    lfw::StepChoice choice;
+    const int32_t rc = lfw::choose_step(request, lfw::current_context().db, &choice);
+    if (rc != 0)
+    {
+        return rc;
+    }
+    out[0] = static_cast<float>(choice.step);
+    out[1] = static_cast<float>(choice.error);
+    out[2] = static_cast<float>(choice.evaluations);
+    return 0;
+}
+
+LFW_EXPORT char *lfw_get_stats_json(void)
+{
+    const std::shared_ptr<lfw::Database> db = lfw::current_context().db;
+    return dup_cstr(lfw::stats_json(db.get()));
+}
+
+LFW_EXPORT void lfw_reset_stats(void)
+{
+    lfw::reset_stats();
+    const std::shared_ptr<lfw::Database> db = lfw::current_context().db;
+    if (db)
+    {
+        db->calibrations().reset_counters();
+    }
+}
+
+LFW_EXPORT int32_t lfw_trace_start(int32_t capacity)
+{
+    if (capacity <= 0)
+    {
+        return -1;
+    }
+    return lfw::trace_start(static_cast<size_t>(capacity)) ? 0 : -2;
+}
+
+LFW_EXPORT void lfw_trace_stop(void)
+{
+    lfw::trace_stop();
+}
+
+LFW_EXPORT char *lfw_trace_dump_json(void)
+{
+    return dup_cstr(lfw::trace_json());
+}
+
+LFW_EXPORT int32_t lfw_capture_start(int32_t max_bytes)
+{
+    if (max_bytes <= 0)
+    {
+        return -1;
+    }
+    return lfw::capture_start(static_cast<size_t>(max_bytes)) ? 0 : -1;
+}
+
+LFW_EXPORT void lfw_capture_stop(void)
+{
+    lfw::capture_stop();
+}
+
+LFW_EXPORT char *lfw_capture_dump(void)
+{
+    return dup_cstr(lfw::capture_log());
+}
+
+LFW_EXPORT void lfw_alloc_tracking_start(void)
+{
+    lfw::alloc_tracking_start();
+}
+
+LFW_EXPORT void lfw_alloc_tracking_stop(void)
+{
+    lfw::alloc_tracking_stop();
+}
+
+LFW_EXPORT char *lfw_alloc_report_json(void)
+{
+    return dup_cstr(lfw::alloc_report_json());
 }
 
 LFW_EXPORT void lfw_free(void *p)
 {
-    free(p);
+    g_free(p);
 }
 
 } // extern "C"
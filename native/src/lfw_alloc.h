@@ -0,0 +1,89 @@
+#ifndef LFW_ALLOC_H
+#define LFW_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef LFW_TRACK_CXX_ALLOCS
+#define LFW_TRACK_CXX_ALLOCS 0
+#endif
+
+namespace lfw
+{
+// Counters maintained by the g_malloc/g_realloc/g_free shims in
+// glib_compat.cpp. Process-wide totals are atomics; the per-thread totals let
+// callers attribute allocations to the entry point running on that thread.
+struct AllocCounters
+{
+    uint64_t malloc_calls = 0;
+    uint64_t realloc_calls = 0;
+    uint64_t free_calls = 0;
+    uint64_t requested_bytes = 0;
+};
+
+AllocCounters process_alloc_counters();
+AllocCounters thread_alloc_counters();
+
+// Call-site categories for the opt-in allocation tracker. Allocations are
+// attributed to the innermost AllocScope active on the allocating thread.
+enum class AllocCategory
+{
+    Other,
+    DatabaseLoad,
+    Search,
+    Modifier,
+    JsonOutput,
+    Count
+};
+
+const char *alloc_category_name(AllocCategory category);
+
+class AllocScope
+{
+public:
+    explicit AllocScope(AllocCategory category);
+    ~AllocScope();
+
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+
+private:
+    AllocCategory previous_;
+};
+
+struct AllocCategoryStats
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t live_blocks = 0;
+    uint64_t live_bytes = 0;
+    uint64_t peak_bytes = 0;
+};
+
+struct AllocTrackingReport
+{
+    bool enabled = false;
+    uint64_t live_bytes = 0;
+    uint64_t peak_bytes = 0;
+    AllocCategoryStats categories[static_cast<int>(AllocCategory::Count)];
+
+    // Live blocks and bytes per category when the last database reference
+    // was disposed, if that happened while tracking.
+    bool has_dispose_leaks = false;
+    AllocCategoryStats dispose_leaks[static_cast<int>(AllocCategory::Count)];
+};
+
+// While tracking is on, every g_malloc/g_realloc/g_free records its block
+// size and category in a side table; so does every global operator
+// new/delete in builds with LFW_TRACK_CXX_ALLOCS. Starting clears previous
+// results; blocks allocated before the start are ignored when freed.
+// Tracking off costs one relaxed load per allocation.
+void alloc_tracking_start();
+void alloc_tracking_stop();
+bool alloc_tracking_enabled();
+AllocTrackingReport alloc_tracking_report();
+// Copies the current live blocks into the report's dispose_leaks section.
+AllocTrackingReport alloc_tracking_mark_dispose();
+} // namespace lfw
+
+#endif
@@ -0,0 +1,330 @@
+#include "lfw_batch.h"
+
+#include "lfw_alloc.h"
+#include "lfw_handles.h"
+#include "lfw_pool.h"
+#include "lfw_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<CorrectionBatch> g_batches;
+
+// Rows of one remap task: enough work to amortize taking a task, small enough
+// that a few large images still spread over every thread.
+constexpr int kRemapRows = 64;
+
+constexpr int kGeometry = static_cast<int>(MapKind::Geometry);
+constexpr int kTca = static_cast<int>(MapKind::Tca);
+constexpr int kVignetting = static_cast<int>(MapKind::Vignetting);
+
+typedef std::tuple<const lfLens *, float, float, float, float, int, int, bool, int, int> GroupKey;
+
+GroupKey group_key(const BatchItem &item)
+{
+    const bool vignetting = (item.mods & LF_MODIFY_VIGNETTING) != 0;
+    return GroupKey(item.lens,
+                    item.focal,
+                    item.crop,
+                    vignetting ? item.aperture : 0.0f,
+                    vignetting ? item.distance : 0.0f,
+                    item.width,
+                    item.height,
+                    item.reverse,
+                    item.step,
+                    item.mods);
+}
+
+// Bilinear sample of a `step` grid map at pixel (x, y). Unless (size - 1) is a
+// multiple of the step, the last samples stop short of the far edges; pixels
+// past them extrapolate the last cell linearly instead of repeating its edge.
+void sample_map(const float *map, int channels, int grid_width, int grid_height, int step, float x, float y, float *out)
+{
+    const float gx = x / static_cast<float>(step);
+    const float gy = y / static_cast<float>(step);
+    const int x0 = std::min(std::max(static_cast<int>(gx), 0), std::max(grid_width - 2, 0));
+    const int y0 = std::min(std::max(static_cast<int>(gy), 0), std::max(grid_height - 2, 0));
+    const int x1 = std::min(x0 + 1, grid_width - 1);
+    const int y1 = std::min(y0 + 1, grid_height - 1);
+    const float fx = x1 > x0 ? gx - static_cast<float>(x0) : 0.0f;
+    const float fy = y1 > y0 ? gy - static_cast<float>(y0) : 0.0f;
+    const float *p00 = map + (static_cast<size_t>(y0) * grid_width + x0) * channels;
+    const float *p01 = map + (static_cast<size_t>(y0) * grid_width + x1) * channels;
+    const float *p10 = map + (static_cast<size_t>(y1) * grid_width + x0) * channels;
+    const float *p11 = map + (static_cast<size_t>(y1) * grid_width + x1) * channels;
+    for (int c = 0; c < channels; ++c)
+    {
+        const float top = p00[c] + (p01[c] - p00[c]) * fx;
+        const float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+        out[c] = top + (bottom - top) * fy;
+    }
+}
+} // namespace
+
+CorrectionBatch::CorrectionBatch(std::shared_ptr<Database> db)
+    : db_(std::move(db))
+{
+}
+
+int32_t CorrectionBatch::add(const BatchItem &item)
+{
+    const int known = LF_MODIFY_DISTORTION | LF_MODIFY_TCA | LF_MODIFY_VIGNETTING;
+    if (ran_ || !item.lens || item.width <= 0 || item.height <= 0 || item.step <= 0 || (item.mods & ~known) != 0)
+    {
+        return -1;
+    }
+    Entry entry;
+    entry.item = item;
+    entries_.push_back(entry);
+    return static_cast<int32_t>(entries_.size() - 1);
+}
+
+int32_t CorrectionBatch::set_pixels(int index, const float *source, float *output, int channels)
+{
+    if (ran_ || index < 0 || index >= static_cast<int>(entries_.size()) || !source || !output ||
+        (channels != 1 && channels != 3 && channels != 4))
+    {
+        return -1;
+    }
+    Entry &entry = entries_[index];
+    entry.source = source;
+    entry.output = output;
+    entry.channels = channels;
+    return 0;
+}
+
+int32_t CorrectionBatch::run(int threads)
+{
+    if (ran_ || entries_.empty())
+    {
+        return -1;
+    }
+    ran_ = true;
+
+    std::map<GroupKey, int> index;
+    for (Entry &entry : entries_)
+    {
+        const auto inserted = index.emplace(group_key(entry.item), static_cast<int>(groups_.size()));
+        if (inserted.second)
+        {
+            Group group;
+            group.item = entry.item;
+            groups_.push_back(std::move(group));
+        }
+        entry.group = inserted.first->second;
+    }
+
+    // Each group's build comes before its remaps, which a thread that takes
+    // one early waits for.
+    std::vector<Task> tasks;
+    std::vector<std::vector<int>> members(groups_.size());
+    for (size_t e = 0; e < entries_.size(); ++e)
+    {
+        if (entries_[e].source)
+        {
+            members[entries_[e].group].push_back(static_cast<int>(e));
+        }
+    }
+    for (size_t g = 0; g < groups_.size(); ++g)
+    {
+        tasks.push_back({static_cast<int>(g), -1, 0, 0});
+        for (int e : members[g])
+        {
+            for (int y0 = 0; y0 < entries_[e].item.height; y0 += kRemapRows)
+            {
+                tasks.push_back({static_cast<int>(g), e, y0, std::min(y0 + kRemapRows, entries_[e].item.height)});
+            }
+        }
+    }
+
+    const TraceSpan span("correction batch");
+    std::mutex mutex;
+    std::condition_variable built_changed;
+    std::vector<char> built(groups_.size(), 0);
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        const AllocScope alloc_scope(AllocCategory::Modifier);
+        for (size_t i = next++; i < tasks.size(); i = next++)
+        {
+            const Task &task = tasks[i];
+            Group &group = groups_[task.group];
+            if (task.entry < 0)
+            {
+                build(group);
+                std::lock_guard<std::mutex> lock(mutex);
+                built[task.group] = 1;
+                built_changed.notify_all();
+                continue;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                built_changed.wait(lock, [&]() { return built[task.group] != 0; });
+            }
+            if (group.status == 0)
+            {
+                remap(group, entries_[task.entry], task.y0, task.y1);
+            }
+        }
+    };
+
+    pool_run(std::min(threads, static_cast<int>(tasks.size())), work);
+    return static_cast<int32_t>(groups_.size());
+}
+
+void CorrectionBatch::build(Group &group)
+{
+    const TraceSpan span("batch maps");
+    const BatchItem &item = group.item;
+    const int mods[] = {LF_MODIFY_DISTORTION, LF_MODIFY_TCA, LF_MODIFY_VIGNETTING};
+    for (int kind = 0; kind < static_cast<int>(MapKind::Count); ++kind)
+    {
+        if (!(item.mods & mods[kind]))
+        {
+            continue;
+        }
+        MapRequest request;
+        request.kind = static_cast<MapKind>(kind);
+        request.lens = item.lens;
+        request.focal = item.focal;
+        request.crop = item.crop;
+        request.aperture = item.aperture;
+        request.distance = item.distance;
+        request.width = item.width;
+        request.height = item.height;
+        request.reverse = item.reverse;
+        request.step = item.step;
+        MapBuilder builder(request, db_);
+        int32_t rc = builder.init();
+        if (rc == 0)
+        {
+            group.grid_width = builder.grid_width();
+            group.grid_height = builder.grid_height();
+            group.maps[kind].resize(builder.row_floats() * builder.grid_height());
+            rc = builder.fill_rows(0, builder.grid_height(), group.maps[kind].data());
+        }
+        if (rc != 0)
+        {
+            group.status = rc;
+            for (std::vector<float> &map : group.maps)
+            {
+                std::vector<float>().swap(map);
+            }
+            return;
+        }
+    }
+}
+
+void CorrectionBatch::remap(const Group &group, const Entry &entry, int y0, int y1) const
+{
+    const TraceSpan span("batch remap");
+    const BatchItem &item = entry.item;
+    const int channels = entry.channels;
+    const int gw = group.grid_width;
+    const int gh = group.grid_height;
+    const float *geometry = group.maps[kGeometry].empty() ? nullptr : group.maps[kGeometry].data();
+    const float *tca = group.maps[kTca].empty() ? nullptr : group.maps[kTca].data();
+    const float *vignetting = group.maps[kVignetting].empty() ? nullptr : group.maps[kVignetting].data();
+    const float max_x = static_cast<float>(item.width - 1);
+    const float max_y = static_cast<float>(item.height - 1);
+    const size_t row = static_cast<size_t>(item.width) * channels;
+
+    float base[2];
+    float pairs[6];
+    float gains[3];
+    for (int y = y0; y < y1; ++y)
+    {
+        float *out = entry.output + row * y;
+        for (int x = 0; x < item.width; ++x, out += channels)
+        {
+            base[0] = static_cast<float>(x);
+            base[1] = static_cast<float>(y);
+            if (geometry)
+            {
+                sample_map(geometry, 2, gw, gh, item.step, base[0], base[1], base);
+            }
+            if (tca)
+            {
+                // TCA on top of geometry, as lensfun applies both.
+                sample_map(tca, 6, gw, gh, item.step, base[0], base[1], pairs);
+            }
+            for (int c = 0; c < channels; ++c)
+            {
+                // Intensity and alpha follow green.
+                const int colour = channels == 1 || c == 3 ? 1 : c;
+                const float sx = tca ? pairs[colour * 2] : base[0];
+                const float sy = tca ? pairs[colour * 2 + 1] : base[1];
+                if (!(sx >= 0.0f && sx <= max_x && sy >= 0.0f && sy <= max_y))
+                {
+                    out[c] = 0.0f;
+                    continue;
+                }
+                const int ix = static_cast<int>(sx);
+                const int iy = static_cast<int>(sy);
+                const int ix1 = std::min(ix + 1, item.width - 1);
+                const int iy1 = std::min(iy + 1, item.height - 1);
+                const float fx = sx - static_cast<float>(ix);
+                const float fy = sy - static_cast<float>(iy);
+                const float *row0 = entry.source + row * iy;
+                const float *row1 = entry.source + row * iy1;
+                const float top = row0[ix * channels + c] + (row0[ix1 * channels + c] - row0[ix * channels + c]) * fx;
+                const float bottom =
+                    row1[ix * channels + c] + (row1[ix1 * channels + c] - row1[ix * channels + c]) * fx;
+                float value = top + (bottom - top) * fy;
+                if (vignetting && c < 3)
+                {
+                    // The gain at the source position, where lensfun applies it.
+                    sample_map(vignetting, 3, gw, gh, item.step, sx, sy, gains);
+                    value *= gains[colour];
+                }
+                out[c] = value;
+            }
+        }
+    }
+}
+
+int CorrectionBatch::item_group(int index) const
+{
+    return index >= 0 && index < static_cast<int>(entries_.size()) ? entries_[index].group : -1;
+}
+
+int32_t CorrectionBatch::item_status(int index) const
+{
+    const int group = item_group(index);
+    return group >= 0 ? groups_[group].status : -1;
+}
+
+const float *CorrectionBatch::map(int index, MapKind kind) const
+{
+    const int group = item_group(index);
+    if (group < 0 || kind == MapKind::Count)
+    {
+        return nullptr;
+    }
+    const std::vector<float> &map = groups_[group].maps[static_cast<int>(kind)];
+    return map.empty() ? nullptr : map.data();
+}
+
+uint32_t register_batch(std::unique_ptr<CorrectionBatch> batch)
+{
+    return g_batches.add(std::move(batch));
+}
+
+CorrectionBatch *find_batch(uint32_t handle)
+{
+    return g_batches.find(handle);
+}
+
+bool destroy_batch(uint32_t handle)
+{
+    return g_batches.remove(handle);
+}
+} // namespace lfw
@@ -0,0 +1,124 @@
+#ifndef LFW_BATCH_H
+#define LFW_BATCH_H
+
+#include "lensfun.h"
+#include "lfw_maps.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+struct BatchItem
+{
+    const lfLens *lens = nullptr;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    // Vignetting only.
+    float aperture = 0.0f;
+    float distance = 0.0f;
+    int width = 0;
+    int height = 0;
+    bool reverse = false;
+    int step = 1;
+    // LF_MODIFY_DISTORTION, LF_MODIFY_TCA and LF_MODIFY_VIGNETTING: the maps
+    // built, and the corrections applied to the pixels.
+    int mods = 0;
+};
+
+// Corrections for many images at once, as an exporter runs them. Items with
+// the same parameters share one group whose maps are built once; grouping
+// ignores the aperture and distance of items without vignetting.
+//
+// Items may carry interleaved float pixels. Those are remapped through their
+// group's maps in bands of rows, like the tiled corrector: vignetting is the
+// gain at each source position, TCA is applied on top of geometry, and pixels
+// that map outside the image are 0. With threads, the caller and workers of
+// the shared pool (lfw_pool.h) work through the whole batch at once, so the
+// remaps of one group overlap the map builds of the next.
+class CorrectionBatch
+{
+public:
+    // `db` must not be null; item lenses must come from it.
+    explicit CorrectionBatch(std::shared_ptr<Database> db);
+
+    CorrectionBatch(const CorrectionBatch &) = delete;
+    CorrectionBatch &operator=(const CorrectionBatch &) = delete;
+
+    const std::shared_ptr<Database> &db() const
+    {
+        return db_;
+    }
+
+    // Returns the item's index, or -1 for a bad item or a batch already run.
+    int32_t add(const BatchItem &item);
+    // `source` and `output` are `width * height * channels` floats with 1, 3
+    // or 4 channels; they must stay valid until run() returns. Returns 0 or -1.
+    int32_t set_pixels(int index, const float *source, float *output, int channels);
+
+    // Builds every group's maps and remaps the items with pixels on up to
+    // `threads` threads: the caller and up to `threads - 1` pool workers, or
+    // the caller alone where threads are not available. Returns the number of
+    // groups, or -1 when the batch is empty or has already run. A failed group
+    // does not stop the others; see item_status().
+    int32_t run(int threads);
+
+    int group_count() const
+    {
+        return static_cast<int>(groups_.size());
+    }
+    // The item's group after run(), else -1.
+    int item_group(int index) const;
+    // 0, or the map builder code of the item's group.
+    int32_t item_status(int index) const;
+    // The group's map of `kind` in the lfw_build_*_map layout, or null when
+    // it was not requested or not built.
+    const float *map(int index, MapKind kind) const;
+
+private:
+    struct Entry
+    {
+        BatchItem item;
+        const float *source = nullptr;
+        float *output = nullptr;
+        int channels = 0;
+        int group = -1;
+    };
+
+    struct Group
+    {
+        BatchItem item;
+        int grid_width = 0;
+        int grid_height = 0;
+        std::vector<float> maps[static_cast<int>(MapKind::Count)];
+        int32_t status = 0;
+    };
+
+    struct Task
+    {
+        int group;
+        // -1 builds the group's maps, else remaps rows [y0, y1) of the item.
+        int entry;
+        int y0;
+        int y1;
+    };
+
+    void build(Group &group);
+    void remap(const Group &group, const Entry &entry, int y0, int y1) const;
+
+    std::shared_ptr<Database> db_;
+    std::vector<Entry> entries_;
+    std::vector<Group> groups_;
+    bool ran_ = false;
+};
+
+// Batches handed out by lfw_batch_create.
+uint32_t register_batch(std::unique_ptr<CorrectionBatch> batch);
+CorrectionBatch *find_batch(uint32_t handle);
+bool destroy_batch(uint32_t handle);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,171 @@
+#include "lfw_blob.h"
+
+#include <string.h>
+
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+// Longer names are not lens names; the bound keeps size arithmetic in range.
+constexpr uint32_t kMaxNameBytes = 4096;
+
+size_t padded(size_t bytes)
+{
+    return (bytes + 3) & ~static_cast<size_t>(3);
+}
+
+int kind_channels(int kind)
+{
+    return kind == 0 ? 2 : kind == 1 ? 6 : kind == 2 ? 3 : 0;
+}
+
+int blob_grid_points(int size, int step)
+{
+    return ((size - 1) / step) + 1;
+}
+
+template <typename T>
+void put(uint8_t *out, size_t offset, T value)
+{
+    memcpy(out + offset, &value, sizeof(T));
+}
+
+template <typename T>
+T get(const uint8_t *in, size_t offset)
+{
+    T value;
+    memcpy(&value, in + offset, sizeof(T));
+    return value;
+}
+} // namespace
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    // FNV-1a's step taken a 64-bit word at a time, folding the high half back
+    // in so every input bit reaches every output bit. Four independent lanes
+    // keep the multiplies from waiting on each other: maps are megabytes, and
+    // checking a blob must stay far cheaper than building its map.
+    constexpr uint64_t kPrime = 0x100000001b3ull;
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t lanes[4] = {seed, seed ^ 1, seed ^ 2, seed ^ 3};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            lanes[k] = (lanes[k] ^ get<uint64_t>(bytes, i + k * 8)) * kPrime;
+            lanes[k] ^= lanes[k] >> 32;
+        }
+    }
+    uint64_t hash = seed;
+    for (uint64_t lane : lanes)
+    {
+        hash = (hash ^ lane) * kPrime;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * kPrime;
+    }
+    return hash;
+}
+
+size_t map_blob_bytes(const MapBlobKey &key, size_t map_floats)
+{
+    return kMapBlobHeaderBytes + padded(key.lens_maker.size() + key.lens_model.size()) + map_floats * sizeof(float);
+}
+
+void write_map_blob(const MapBlobKey &key, int grid_width, int grid_height, int channels, const float *map,
+                    uint8_t *out)
+{
+    const size_t names = key.lens_maker.size() + key.lens_model.size();
+    const size_t floats = static_cast<size_t>(grid_width) * grid_height * channels;
+    uint8_t *payload = out + kMapBlobHeaderBytes;
+    memcpy(payload, key.lens_maker.data(), key.lens_maker.size());
+    memcpy(payload + key.lens_maker.size(), key.lens_model.data(), key.lens_model.size());
+    memset(payload + names, 0, padded(names) - names);
+    memcpy(payload + padded(names), map, floats * sizeof(float));
+    const size_t payload_bytes = padded(names) + floats * sizeof(float);
+
+    put<uint32_t>(out, 0, kMapBlobMagic);
+    put<uint32_t>(out, 4, kMapBlobVersion);
+    put<uint64_t>(out, 8, key.db_hash);
+    put<uint64_t>(out, 16, hash_bytes(payload, payload_bytes));
+    put<int32_t>(out, 24, key.kind);
+    put<int32_t>(out, 28, key.width);
+    put<int32_t>(out, 32, key.height);
+    put<int32_t>(out, 36, key.step);
+    put<int32_t>(out, 40, key.reverse ? 1 : 0);
+    put<float>(out, 44, key.focal);
+    put<float>(out, 48, key.crop);
+    put<float>(out, 52, key.aperture);
+    put<float>(out, 56, key.distance);
+    put<int32_t>(out, 60, grid_width);
+    put<int32_t>(out, 64, grid_height);
+    put<int32_t>(out, 68, channels);
+    put<uint32_t>(out, 72, key.lens_ordinal);
+    put<uint32_t>(out, 76, static_cast<uint32_t>(key.lens_maker.size()));
+    put<uint32_t>(out, 80, static_cast<uint32_t>(key.lens_model.size()));
+    put<uint32_t>(out, 84, 0);
+}
+
+int32_t read_map_blob(const uint8_t *blob, size_t size, MapBlobView *out)
+{
+    if (!blob || size < kMapBlobHeaderBytes || get<uint32_t>(blob, 0) != kMapBlobMagic)
+    {
+        return -1;
+    }
+    if (get<uint32_t>(blob, 4) != kMapBlobVersion)
+    {
+        return kMapBlobVersionMismatch;
+    }
+
+    MapBlobView view;
+    MapBlobKey &key = view.key;
+    key.db_hash = get<uint64_t>(blob, 8);
+    key.kind = get<int32_t>(blob, 24);
+    key.width = get<int32_t>(blob, 28);
+    key.height = get<int32_t>(blob, 32);
+    key.step = get<int32_t>(blob, 36);
+    key.reverse = get<int32_t>(blob, 40) != 0;
+    key.focal = get<float>(blob, 44);
+    key.crop = get<float>(blob, 48);
+    key.aperture = get<float>(blob, 52);
+    key.distance = get<float>(blob, 56);
+    view.grid_width = get<int32_t>(blob, 60);
+    view.grid_height = get<int32_t>(blob, 64);
+    view.channels = get<int32_t>(blob, 68);
+    key.lens_ordinal = get<uint32_t>(blob, 72);
+    const uint32_t maker_bytes = get<uint32_t>(blob, 76);
+    const uint32_t model_bytes = get<uint32_t>(blob, 80);
+
+    // An unknown kind has no channels, so it must not match a forged count of 0.
+    if (key.width <= 0 || key.height <= 0 || key.step <= 0 || kind_channels(key.kind) == 0 ||
+        view.channels != kind_channels(key.kind) || view.grid_width != blob_grid_points(key.width, key.step) ||
+        view.grid_height != blob_grid_points(key.height, key.step) || maker_bytes > kMaxNameBytes ||
+        model_bytes > kMaxNameBytes)
+    {
+        return -1;
+    }
+    // In 64 bits, so a forged grid cannot wrap around to the blob's size.
+    const uint64_t names = padded(static_cast<size_t>(maker_bytes) + model_bytes);
+    const uint64_t floats = static_cast<uint64_t>(view.grid_width) * view.grid_height * view.channels;
+    if (size != kMapBlobHeaderBytes + names + floats * sizeof(float))
+    {
+        return -1;
+    }
+
+    const uint8_t *payload = blob + kMapBlobHeaderBytes;
+    if (get<uint64_t>(blob, 16) != hash_bytes(payload, size - kMapBlobHeaderBytes))
+    {
+        return kMapBlobCorrupt;
+    }
+    key.lens_maker.assign(reinterpret_cast<const char *>(payload), maker_bytes);
+    key.lens_model.assign(reinterpret_cast<const char *>(payload) + maker_bytes, model_bytes);
+    view.map = payload + names;
+    *out = std::move(view);
+    return 0;
+}
+} // namespace lfw
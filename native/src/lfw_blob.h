@@ -0,0 +1,79 @@
+#ifndef LFW_BLOB_H
+#define LFW_BLOB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace lfw
+{
+// A map stored for reuse in a later session: the parameters that fully
+// determine it, the content hash of the database it was built from, and the
+// map itself. All fields are little-endian (host order on every target the
+// bridge builds for):
+//
+//   0 magic "LFWM", 4 version, 8 database hash (u64), 16 payload hash (u64),
+//   24 kind, 28 width, 32 height, 36 step, 40 reverse,
+//   44 focal, 48 crop, 52 aperture, 56 distance (f32),
+//   60 grid width, 64 grid height, 68 channels,
+//   72 lens ordinal, 76 maker bytes, 80 model bytes, 84 reserved (0),
+//   88 lens maker and model, zero-padded to a multiple of 4, then the map
+//   in the lfw_build_*_map layout.
+//
+// The payload hash covers everything after the header. The version changes
+// whenever the layout or the maps the builders produce do, so blobs of an
+// older bridge are rejected rather than reused. Like the descriptor, this
+// header and its source do not use lensfun.
+constexpr uint32_t kMapBlobMagic = 0x4d57464c;
+constexpr uint32_t kMapBlobVersion = 1;
+constexpr size_t kMapBlobHeaderBytes = 88;
+
+// Returned by read_map_blob besides -1 for a truncated or inconsistent blob.
+constexpr int32_t kMapBlobVersionMismatch = -3;
+constexpr int32_t kMapBlobCorrupt = -4;
+
+struct MapBlobKey
+{
+    // lfw_map_stream_create numbering: 0 geometry, 1 TCA, 2 vignetting.
+    int kind = 0;
+    std::string lens_maker;
+    std::string lens_model;
+    // Which of the database's lenses named `lens_maker` / `lens_model`; see
+    // Database::lens_ordinal.
+    uint32_t lens_ordinal = 0;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    // 0 unless `kind` is vignetting.
+    float aperture = 0.0f;
+    float distance = 0.0f;
+    int width = 0;
+    int height = 0;
+    int step = 1;
+    bool reverse = false;
+    uint64_t db_hash = 0;
+};
+
+struct MapBlobView
+{
+    MapBlobKey key;
+    int grid_width = 0;
+    int grid_height = 0;
+    int channels = 0;
+    // Unaligned; grid_width * grid_height * channels floats.
+    const uint8_t *map = nullptr;
+};
+
+// A fast 64-bit content hash, for database documents and blob payloads.
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+size_t map_blob_bytes(const MapBlobKey &key, size_t map_floats);
+// `out` must hold map_blob_bytes(key, grid_width * grid_height * channels).
+void write_map_blob(const MapBlobKey &key, int grid_width, int grid_height, int channels, const float *map,
+                    uint8_t *out);
+// Returns 0, -1, kMapBlobVersionMismatch or kMapBlobCorrupt. `out` points
+// into `blob`.
+int32_t read_map_blob(const uint8_t *blob, size_t size, MapBlobView *out);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,325 @@
+#include "lfw_calibration.h"
+
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace lfw
+{
+namespace
+{
+// Calibrations are a few dozen bytes, keyed at 1/100, so this is far beyond
+// what the editor needs; a full calibration table is simply dropped rather
+// than aged. Map tables are held to kTableBytes instead.
+constexpr size_t kMaxEntries = 4096;
+
+int32_t quantize(float value, float scale)
+{
+    return static_cast<int32_t>(lroundf(value * scale));
+}
+
+float dequantize(int32_t value, float scale)
+{
+    return static_cast<float>(value) / scale;
+}
+
+int32_t float_bits(float value)
+{
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+constexpr float kScale = 100.0f;
+constexpr float kCropScale = 1000.0f;
+} // namespace
+
+size_t CalibrationCache::KeyHash::operator()(const Key &key) const
+{
+    size_t h = std::hash<const void *>()(key.lens);
+    const auto mix = [&h](int32_t part) { h ^= std::hash<int32_t>()(part) + 0x9e3779b9u + (h << 6) + (h >> 2); };
+    mix(key.crop);
+    mix(key.focal);
+    for (int32_t part : key.extra)
+    {
+        mix(part);
+    }
+    return h;
+}
+
+template <typename Calib, typename Interpolate>
+bool CalibrationCache::lookup(Table<Calib> &table, CalibrationKind kind, const Key &key, Calib *out, Interpolate interpolate)
+{
+    const int index = static_cast<int>(kind);
+    {
+        const std::shared_lock<std::shared_mutex> lock(mutex_);
+        const auto it = table.find(key);
+        if (it != table.end())
+        {
+            hits_[index].fetch_add(1, std::memory_order_relaxed);
+            *out = it->second.calib;
+            return it->second.ok;
+        }
+        misses_[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Interpolate outside the lock; two threads missing the same key both
+    // compute the same value.
+    Entry<Calib> entry;
+    {
+        const TraceSpan span("calibration interpolate");
+        entry.ok = interpolate(&entry.calib);
+    }
+    *out = entry.calib;
+
+    const std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (table.size() >= kMaxEntries)
+    {
+        table.clear();
+    }
+    table.emplace(key, entry);
+    return entry.ok;
+}
+
+bool CalibrationCache::distortion(const lfLens *lens, float crop, float focal, lfLensCalibDistortion *out)
+{
+    const Key key = {lens, quantize(crop, kCropScale), quantize(focal, kScale), {0, 0, 0, 0, 0}};
+    return lookup(distortion_, CalibrationKind::Distortion, key, out, [&key](lfLensCalibDistortion *calib) {
+        return lf_lens_interpolate_distortion(
+                   key.lens, dequantize(key.crop, kCropScale), dequantize(key.focal, kScale), calib) != 0;
+    });
+}
+
+bool CalibrationCache::tca(const lfLens *lens, float crop, float focal, lfLensCalibTCA *out)
+{
+    const Key key = {lens, quantize(crop, kCropScale), quantize(focal, kScale), {0, 0, 0, 0, 0}};
+    return lookup(tca_, CalibrationKind::Tca, key, out, [&key](lfLensCalibTCA *calib) {
+        return lf_lens_interpolate_tca(
+                   key.lens, dequantize(key.crop, kCropScale), dequantize(key.focal, kScale), calib) != 0;
+    });
+}
+
+bool CalibrationCache::vignetting(
+    const lfLens *lens,
+    float crop,
+    float focal,
+    float aperture,
+    float distance,
+    lfLensCalibVignetting *out)
+{
+    const Key key = {
+        lens,
+        quantize(crop, kCropScale),
+        quantize(focal, kScale),
+        {quantize(aperture, kScale), quantize(distance, kScale), 0, 0, 0}};
+    return lookup(vignetting_, CalibrationKind::Vignetting, key, out, [&key](lfLensCalibVignetting *calib) {
+        return lf_lens_interpolate_vignetting(
+                   key.lens,
+                   dequantize(key.crop, kCropScale),
+                   dequantize(key.focal, kScale),
+                   dequantize(key.extra[0], kScale),
+                   dequantize(key.extra[1], kScale),
+                   calib) != 0;
+    });
+}
+
+template <typename T>
+std::shared_ptr<const T> CalibrationCache::lookup_cached(
+    TableCache<T> &cache,
+    CalibrationKind kind,
+    const Key &key,
+    const std::function<std::unique_ptr<T>()> &build)
+{
+    const int index = static_cast<int>(kind);
+    {
+        const std::shared_lock<std::shared_mutex> lock(mutex_);
+        const auto it = cache.tables.find(key);
+        if (it != cache.tables.end())
+        {
+            hits_[index].fetch_add(1, std::memory_order_relaxed);
+            it->second.used.store(tick_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return it->second.table;
+        }
+        misses_[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<const T> built = build();
+    // A null table (no usable table for this request) costs its entry only.
+    const size_t bytes = sizeof(Key) + sizeof(CachedTable<T>) + (built ? built->bytes() : 0);
+    const std::unique_lock<std::shared_mutex> lock(mutex_);
+    const auto found = cache.tables.find(key);
+    if (found != cache.tables.end())
+    {
+        return found->second.table;
+    }
+    evict(cache, bytes);
+    CachedTable<T> &entry = cache.tables[key];
+    entry.table = built;
+    entry.bytes = bytes;
+    entry.used.store(tick_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    cache.bytes += bytes;
+    return built;
+}
+
+// Makes room for `incoming` bytes. Once over budget, the least recently used
+// tables are dropped until a quarter of the budget is free, so a scrub evicts
+// in occasional passes rather than on every insert.
+template <typename T>
+void CalibrationCache::evict(TableCache<T> &cache, size_t incoming)
+{
+    if (cache.bytes + incoming <= kTableBytes)
+    {
+        return;
+    }
+    typedef typename std::unordered_map<Key, CachedTable<T>, KeyHash>::iterator Iterator;
+    std::vector<std::pair<uint64_t, Iterator>> order;
+    order.reserve(cache.tables.size());
+    for (auto it = cache.tables.begin(); it != cache.tables.end(); ++it)
+    {
+        order.emplace_back(it->second.used.load(std::memory_order_relaxed), it);
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, Iterator> &a,
+                                             const std::pair<uint64_t, Iterator> &b) { return a.first < b.first; });
+    const size_t target = kTableBytes - kTableBytes / 4;
+    for (const auto &oldest : order)
+    {
+        if (cache.bytes + incoming <= target)
+        {
+            break;
+        }
+        cache.bytes -= oldest.second->second.bytes;
+        cache.tables.erase(oldest.second);
+    }
+}
+
+std::shared_ptr<const RadialInverse> CalibrationCache::reverse_geometry(
+    const lfLens *lens,
+    float crop,
+    float focal,
+    int width,
+    int height,
+    const std::function<std::unique_ptr<RadialInverse>()> &build)
+{
+    const Key key = {lens, float_bits(crop), float_bits(focal), {0, 0, width, height, 0}};
+    return lookup_cached(reverse_geometry_, CalibrationKind::ReverseGeometry, key, build);
+}
+
+std::shared_ptr<const RadialTable> CalibrationCache::radial_geometry(
+    const lfLens *lens,
+    float crop,
+    float focal,
+    int width,
+    int height,
+    const std::function<std::unique_ptr<RadialTable>()> &build)
+{
+    const Key key = {lens, float_bits(crop), float_bits(focal), {0, 0, width, height, 0}};
+    return lookup_cached(radial_geometry_, CalibrationKind::RadialGeometry, key, build);
+}
+
+std::shared_ptr<const RadialTable> CalibrationCache::radial_vignetting(
+    const lfLens *lens,
+    float crop,
+    float focal,
+    float aperture,
+    float distance,
+    int width,
+    int height,
+    bool reverse,
+    const std::function<std::unique_ptr<RadialTable>()> &build)
+{
+    const Key key = {
+        lens,
+        float_bits(crop),
+        float_bits(focal),
+        {float_bits(aperture), float_bits(distance), width, height, reverse ? 1 : 0}};
+    return lookup_cached(radial_vignetting_, CalibrationKind::RadialVignetting, key, build);
+}
+
+CalibrationCache::Counters CalibrationCache::counters(CalibrationKind kind) const
+{
+    const int index = static_cast<int>(kind);
+    const std::shared_lock<std::shared_mutex> lock(mutex_);
+    Counters counters;
+    counters.hits = hits_[index].load(std::memory_order_relaxed);
+    counters.misses = misses_[index].load(std::memory_order_relaxed);
+    switch (kind)
+    {
+    case CalibrationKind::Distortion:
+        counters.entries = distortion_.size();
+        break;
+    case CalibrationKind::Tca:
+        counters.entries = tca_.size();
+        break;
+    case CalibrationKind::ReverseGeometry:
+        counters.entries = reverse_geometry_.tables.size();
+        counters.bytes = reverse_geometry_.bytes;
+        break;
+    case CalibrationKind::RadialGeometry:
+        counters.entries = radial_geometry_.tables.size();
+        counters.bytes = radial_geometry_.bytes;
+        break;
+    case CalibrationKind::RadialVignetting:
+        counters.entries = radial_vignetting_.tables.size();
+        counters.bytes = radial_vignetting_.bytes;
+        break;
+    default:
+        counters.entries = vignetting_.size();
+        break;
+    }
+    return counters;
+}
+
+void CalibrationCache::reset_counters()
+{
+    for (int i = 0; i < static_cast<int>(CalibrationKind::Count); ++i)
+    {
+        hits_[i].store(0, std::memory_order_relaxed);
+        misses_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int enable_distortion(lfModifier *modifier, CalibrationCache &cache, const lfLens *lens, float crop, float focal)
+{
+    lfLensCalibDistortion calib;
+    if (cache.distortion(lens, crop, focal, &calib))
+    {
+        modifier->EnableDistortionCorrection(calib);
+    }
+    return lf_modifier_get_mod_flags(modifier);
+}
+
+int enable_tca(lfModifier *modifier, CalibrationCache &cache, const lfLens *lens, float crop, float focal)
+{
+    lfLensCalibTCA calib;
+    if (cache.tca(lens, crop, focal, &calib))
+    {
+        modifier->EnableTCACorrection(calib);
+    }
+    return lf_modifier_get_mod_flags(modifier);
+}
+
+int enable_vignetting(
+    lfModifier *modifier,
+    CalibrationCache &cache,
+    const lfLens *lens,
+    float crop,
+    float focal,
+    float aperture,
+    float distance)
+{
+    lfLensCalibVignetting calib;
+    if (cache.vignetting(lens, crop, focal, aperture, distance, &calib))
+    {
+        modifier->EnableVignettingCorrection(calib);
+    }
+    return lf_modifier_get_mod_flags(modifier);
+}
+} // namespace lfw
@@ -0,0 +1,188 @@
+#ifndef LFW_CALIBRATION_H
+#define LFW_CALIBRATION_H
+
+#include "lensfun.h"
+#include "lfw_inverse.h"
+#include "lfw_radial.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace lfw
+{
+enum class CalibrationKind
+{
+    Distortion,
+    Tca,
+    Vignetting,
+    ReverseGeometry,
+    RadialGeometry,
+    RadialVignetting,
+    Count
+};
+
+// Interpolated calibrations of the lenses of one database, keyed by lens and
+// by focal, crop, aperture and distance quantized to 1/100 (crop to 1/1000).
+// Interpolation always runs at the quantized values, so a result does not
+// depend on which request filled the entry. Misses, including lenses without
+// the calibration, are cached too. Lens records are never freed while their
+// database lives, so entries can not go stale.
+//
+// Reverse geometry and radial tables are cached alongside, keyed by lens,
+// image size and the exact focal, crop, aperture and distance the map builder
+// asked for. A focal scrub makes a new table on almost every request, so each
+// kind of table is held to kTableBytes: past it, the least recently used
+// tables are evicted, and tables still in use stay cached.
+//
+// Every context of a database shares its cache, so N workers interpolate a
+// calibration once rather than N times. Hits take only a shared lock and
+// bump relaxed counters; only a miss takes the exclusive lock, to insert.
+class CalibrationCache
+{
+public:
+    struct Counters
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+        // Bytes held by tables; 0 for calibrations.
+        size_t bytes = 0;
+    };
+
+    // Budget of each kind of table held to a byte size.
+    static constexpr size_t kTableBytes = size_t(8) << 20;
+
+    bool distortion(const lfLens *lens, float crop, float focal, lfLensCalibDistortion *out);
+    bool tca(const lfLens *lens, float crop, float focal, lfLensCalibTCA *out);
+    bool vignetting(
+        const lfLens *lens,
+        float crop,
+        float focal,
+        float aperture,
+        float distance,
+        lfLensCalibVignetting *out);
+
+    // `build` runs on a miss. A null table (a distortion the table cannot
+    // invert within its residual bound) is cached as well.
+    std::shared_ptr<const RadialInverse> reverse_geometry(
+        const lfLens *lens,
+        float crop,
+        float focal,
+        int width,
+        int height,
+        const std::function<std::unique_ptr<RadialInverse>()> &build);
+    std::shared_ptr<const RadialTable> radial_geometry(
+        const lfLens *lens,
+        float crop,
+        float focal,
+        int width,
+        int height,
+        const std::function<std::unique_ptr<RadialTable>()> &build);
+    std::shared_ptr<const RadialTable> radial_vignetting(
+        const lfLens *lens,
+        float crop,
+        float focal,
+        float aperture,
+        float distance,
+        int width,
+        int height,
+        bool reverse,
+        const std::function<std::unique_ptr<RadialTable>()> &build);
+
+    Counters counters(CalibrationKind kind) const;
+    void reset_counters();
+
+private:
+    struct Key
+    {
+        const lfLens *lens;
+        int32_t crop;
+        int32_t focal;
+        // Aperture and distance for vignetting, then image size and
+        // direction for tables, zero otherwise.
+        int32_t extra[5];
+
+        bool operator==(const Key &other) const
+        {
+            return lens == other.lens && crop == other.crop && focal == other.focal &&
+                   memcmp(extra, other.extra, sizeof(extra)) == 0;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const;
+    };
+
+    template <typename Calib>
+    struct Entry
+    {
+        bool ok = false;
+        Calib calib{};
+    };
+
+    template <typename Calib>
+    using Table = std::unordered_map<Key, Entry<Calib>, KeyHash>;
+
+    // A table and the tick of the last lookup that returned it. Hits bump
+    // the tick under the shared lock, so they stay concurrent.
+    template <typename T>
+    struct CachedTable
+    {
+        std::shared_ptr<const T> table;
+        size_t bytes = 0;
+        std::atomic<uint64_t> used{0};
+    };
+
+    template <typename T>
+    struct TableCache
+    {
+        std::unordered_map<Key, CachedTable<T>, KeyHash> tables;
+        size_t bytes = 0;
+    };
+
+    template <typename Calib, typename Interpolate>
+    bool lookup(Table<Calib> &table, CalibrationKind kind, const Key &key, Calib *out, Interpolate interpolate);
+    template <typename T>
+    std::shared_ptr<const T> lookup_cached(
+        TableCache<T> &cache,
+        CalibrationKind kind,
+        const Key &key,
+        const std::function<std::unique_ptr<T>()> &build);
+    template <typename T>
+    static void evict(TableCache<T> &cache, size_t incoming);
+
+    mutable std::shared_mutex mutex_;
+    Table<lfLensCalibDistortion> distortion_;
+    Table<lfLensCalibTCA> tca_;
+    Table<lfLensCalibVignetting> vignetting_;
+    TableCache<RadialInverse> reverse_geometry_;
+    TableCache<RadialTable> radial_geometry_;
+    TableCache<RadialTable> radial_vignetting_;
+    std::atomic<uint64_t> hits_[static_cast<int>(CalibrationKind::Count)] = {};
+    std::atomic<uint64_t> misses_[static_cast<int>(CalibrationKind::Count)] = {};
+    std::atomic<uint64_t> tick_{0};
+};
+
+// lf_modifier_enable_*_correction with the calibration taken from `cache`.
+// Return the modifier's flags like the lensfun calls they replace.
+int enable_distortion(lfModifier *modifier, CalibrationCache &cache, const lfLens *lens, float crop, float focal);
+int enable_tca(lfModifier *modifier, CalibrationCache &cache, const lfLens *lens, float crop, float focal);
+int enable_vignetting(
+    lfModifier *modifier,
+    CalibrationCache &cache,
+    const lfLens *lens,
+    float crop,
+    float focal,
+    float aperture,
+    float distance);
+} // namespace lfw
+
+#endif
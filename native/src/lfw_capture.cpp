@@ -0,0 +1,163 @@
+#include "lfw_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <mutex>
+
+namespace lfw
+{
+std::atomic<bool> g_capture_enabled{false};
+
+namespace
+{
+std::mutex g_capture_mutex;
+std::string g_log;
+size_t g_max_bytes = 0;
+uint64_t g_dropped = 0;
+std::chrono::steady_clock::time_point g_started;
+
+std::atomic<uint32_t> g_next_thread{1};
+thread_local uint32_t t_thread = 0;
+
+uint32_t current_thread()
+{
+    if (t_thread == 0)
+    {
+        t_thread = g_next_thread.fetch_add(1, std::memory_order_relaxed);
+    }
+    return t_thread;
+}
+
+const char kHeader[] = "# lensfun-wasm capture 1\n";
+} // namespace
+
+bool capture_start(size_t max_bytes)
+{
+    if (max_bytes == 0)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_capture_mutex);
+    g_log.assign(kHeader);
+    g_max_bytes = max_bytes;
+    g_dropped = 0;
+    g_started = std::chrono::steady_clock::now();
+    g_capture_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void capture_stop()
+{
+    g_capture_enabled.store(false, std::memory_order_relaxed);
+}
+
+std::string capture_log()
+{
+    std::lock_guard<std::mutex> lock(g_capture_mutex);
+    std::string log = g_log.empty() ? std::string(kHeader) : g_log;
+    if (g_dropped != 0)
+    {
+        log += "# dropped " + std::to_string(g_dropped) + "\n";
+    }
+    return log;
+}
+
+CaptureLine::CaptureLine(const char *entry)
+{
+    const auto elapsed = std::chrono::steady_clock::now() - g_started;
+    line_ = std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    line_ += '\t';
+    line_ += std::to_string(current_thread());
+    line_ += '\t';
+    line_ += entry;
+}
+
+CaptureLine::~CaptureLine()
+{
+    line_ += '\n';
+
+    std::lock_guard<std::mutex> lock(g_capture_mutex);
+    if (!capture_enabled())
+    {
+        return;
+    }
+    if (g_log.size() + line_.size() > g_max_bytes)
+    {
+        ++g_dropped;
+        return;
+    }
+    g_log += line_;
+}
+
+CaptureLine &CaptureLine::str(const char *value)
+{
+    return value ? str(value, strlen(value)) : str(nullptr, 0);
+}
+
+CaptureLine &CaptureLine::str(const char *value, size_t size)
+{
+    line_ += '\t';
+    if (!value)
+    {
+        line_ += '~';
+        return *this;
+    }
+
+    append_encoded(value, size, false);
+    return *this;
+}
+
+CaptureLine &CaptureLine::bytes(const void *value, size_t size)
+{
+    line_ += '\t';
+    append_encoded(static_cast<const char *>(value), size, true);
+    return *this;
+}
+
+void CaptureLine::append_encoded(const char *value, size_t size, bool binary)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        const char c = value[i];
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (c == '%' || c == '~' || c == '\t' || c == '\r' || c == '\n' || (binary && (u < 0x20 || u >= 0x7f)))
+        {
+            char escaped[4];
+            snprintf(escaped, sizeof(escaped), "%%%02X", u);
+            line_ += escaped;
+        }
+        else
+        {
+            line_ += c;
+        }
+    }
+}
+
+CaptureLine &CaptureLine::num(double value)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", value);
+    line_ += '\t';
+    line_ += buf;
+    return *this;
+}
+
+CaptureLine &CaptureLine::nums(const float *values, size_t size, size_t width)
+{
+    for (size_t i = 0; i < width; ++i)
+    {
+        num(values && i < size ? values[i] : 0.0f);
+    }
+    return *this;
+}
+
+CaptureLine &CaptureLine::integer(int64_t value)
+{
+    line_ += '\t';
+    line_ += std::to_string(value);
+    return *this;
+}
+} // namespace lfw
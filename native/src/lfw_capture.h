@@ -0,0 +1,60 @@
+#ifndef LFW_CAPTURE_H
+#define LFW_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+namespace lfw
+{
+// Call capture for offline replay (native/bench/lfw_replay). While enabled,
+// every bridge entry point appends one line to an in-memory log:
+//
+//   # lensfun-wasm capture 1
+//   <start us>\t<thread>\t<entry point>\t<arg>\t<arg>...
+//
+// Numbers are written in decimal, strings percent-encoded (%, ~, tab, CR and
+// LF), and a null string as a lone "~". Binary data is percent-encoded
+// outside printable ASCII too, so the log stays text. Lenses are recorded by maker and
+// model instead of handle, since handles do not survive the process.
+extern std::atomic<bool> g_capture_enabled;
+
+inline bool capture_enabled()
+{
+    return g_capture_enabled.load(std::memory_order_relaxed);
+}
+
+// Starts a new capture, discarding any previous one. Lines that would grow
+// the log past `max_bytes` are dropped and counted.
+bool capture_start(size_t max_bytes);
+void capture_stop();
+std::string capture_log();
+
+// Builds one log line; it is appended when the object goes out of scope.
+class CaptureLine
+{
+public:
+    explicit CaptureLine(const char *entry);
+    ~CaptureLine();
+
+    CaptureLine(const CaptureLine &) = delete;
+    CaptureLine &operator=(const CaptureLine &) = delete;
+
+    CaptureLine &str(const char *value);
+    CaptureLine &str(const char *value, size_t size);
+    CaptureLine &bytes(const void *value, size_t size);
+    CaptureLine &num(double value);
+    // `width` numbers: the first `size` of `values`, then zeros.
+    CaptureLine &nums(const float *values, size_t size, size_t width);
+    CaptureLine &integer(int64_t value);
+
+private:
+    void append_encoded(const char *value, size_t size, bool binary);
+
+    std::string line_;
+};
+} // namespace lfw
+
+#endif
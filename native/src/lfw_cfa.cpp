@@ -0,0 +1,122 @@
+#include "lfw_cfa.h"
+
+#include "lfw_maps.h"
+#include "lfw_trace.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace lfw
+{
+namespace
+{
+// Rows of gains computed per batch: large enough to amortize a fill_rows
+// call, small enough that the batch stays in cache next to the mosaic rows.
+constexpr int kBandRows = 16;
+
+int colour_index(char c)
+{
+    switch (c)
+    {
+    case 'R':
+    case 'r':
+        return 0;
+    case 'G':
+    case 'g':
+        return 1;
+    case 'B':
+    case 'b':
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+// Scales the signal above `black` by the photosite's gain. Written without
+// branches so the loop vectorizes.
+void apply_gains(uint16_t *row, const float *gains, int width, float black, float white)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        const float value = static_cast<float>(row[x]);
+        const float signal = value - black;
+        const float corrected = signal > 0.0f ? black + signal * gains[x] : value;
+        row[x] = static_cast<uint16_t>(std::min(corrected, white) + 0.5f);
+    }
+}
+} // namespace
+
+int32_t correct_cfa_vignetting(const CfaRequest &request, std::shared_ptr<Database> db, uint16_t *data)
+{
+    const CfaRequest &r = request;
+    const int stride = r.stride > 0 ? r.stride : r.width;
+    const int pattern_len = r.pattern ? static_cast<int>(strlen(r.pattern)) : 0;
+    if (!r.lens || !data || r.width <= 0 || r.height <= 0 || stride < r.width || r.pattern_width <= 0 ||
+        r.pattern_width > kMaxCfaPeriod || pattern_len == 0 || pattern_len % r.pattern_width != 0 ||
+        pattern_len / r.pattern_width > kMaxCfaPeriod || r.black < 0 || r.white <= r.black || r.white > 65535)
+    {
+        return -1;
+    }
+    const int pattern_height = pattern_len / r.pattern_width;
+    int colours[kMaxCfaPeriod * kMaxCfaPeriod];
+    for (int i = 0; i < pattern_len; ++i)
+    {
+        colours[i] = colour_index(r.pattern[i]);
+        if (colours[i] < 0)
+        {
+            return -1;
+        }
+    }
+
+    const TraceSpan span("cfa vignetting");
+    MapRequest map;
+    map.kind = MapKind::Vignetting;
+    map.lens = r.lens;
+    map.focal = r.focal;
+    map.crop = r.crop;
+    map.aperture = r.aperture;
+    map.distance = r.distance;
+    map.width = r.width;
+    map.height = r.height;
+    MapBuilder builder(map, std::move(db));
+    int32_t rc = builder.init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    const int channels = map_channels(MapKind::Vignetting);
+    const size_t band_floats = builder.row_floats();
+    std::vector<float> band(band_floats * kBandRows);
+    std::vector<float> gains(r.width);
+    const float black = static_cast<float>(r.black);
+    const float white = static_cast<float>(r.white);
+    for (int y0 = 0; y0 < r.height; y0 += kBandRows)
+    {
+        const int y1 = std::min(y0 + kBandRows, r.height);
+        rc = builder.fill_rows(y0, y1, band.data());
+        if (rc != 0)
+        {
+            return rc;
+        }
+        for (int y = y0; y < y1; ++y)
+        {
+            // Picks each photosite's colour out of the r/g/b gains.
+            const float *row_gains = band.data() + band_floats * (y - y0);
+            const int *row_colours = colours + (y % pattern_height) * r.pattern_width;
+            for (int phase = 0; phase < r.pattern_width; ++phase)
+            {
+                const float *colour_gains = row_gains + row_colours[phase];
+                for (int x = phase; x < r.width; x += r.pattern_width)
+                {
+                    gains[x] = colour_gains[x * channels];
+                }
+            }
+            apply_gains(data + static_cast<size_t>(y) * stride, gains.data(), r.width, black, white);
+        }
+    }
+    return 0;
+}
+} // namespace lfw
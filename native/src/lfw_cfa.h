@@ -0,0 +1,50 @@
+#ifndef LFW_CFA_H
+#define LFW_CFA_H
+
+#include "lensfun.h"
+#include "lfw_database.h"
+
+#include <stdint.h>
+
+#include <memory>
+
+namespace lfw
+{
+// Largest CFA repeat along either axis; X-Trans repeats every 6 photosites.
+constexpr int kMaxCfaPeriod = 8;
+
+struct CfaRequest
+{
+    const lfLens *lens = nullptr;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    float aperture = 0.0f;
+    float distance = 0.0f;
+    int width = 0;
+    int height = 0;
+    // Colour of each photosite of one repeat, row after row: 'R', 'G' or 'B'
+    // ("RGGB" with a width of 2 for a Bayer mosaic, 36 letters with a width of
+    // 6 for X-Trans). The repeat starts at the top-left photosite.
+    const char *pattern = nullptr;
+    int pattern_width = 0;
+    // Only the signal above the black level is scaled; results are clamped to
+    // the white level.
+    int black = 0;
+    int white = 65535;
+    // Photosites from one row to the next; 0 means `width`.
+    int stride = 0;
+};
+
+// Corrects vignetting in place on a 16-bit CFA mosaic, before demosaicing.
+// Each photosite is scaled by the gain of its own colour at its position.
+// The gains come from a vignetting MapBuilder, which reads lensfun's model
+// through its radial table, a band of rows at a time. Applying them is a
+// branch-free loop over each row that the compiler vectorizes.
+//
+// Returns 0, -1 for a bad request or pattern, -3 when lensfun has no
+// modifier, -4 when vignetting is not available for the lens, or -5 when
+// lensfun rejects a row.
+int32_t correct_cfa_vignetting(const CfaRequest &request, std::shared_ptr<Database> db, uint16_t *data);
+} // namespace lfw
+
+#endif
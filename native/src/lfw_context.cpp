@@ -0,0 +1,94 @@
+#include "lfw_context.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace lfw
+{
+namespace
+{
+Context g_default_context;
+thread_local Context *t_current = nullptr;
+
+// Handles are small integers rather than pointers so they survive the trip
+// through 32-bit JS numbers on 64-bit native builds as well.
+std::mutex g_registry_mutex;
+std::unordered_map<uint32_t, Context *> g_contexts;
+uint32_t g_next_handle = 1;
+} // namespace
+
+Context &current_context()
+{
+    return t_current ? *t_current : g_default_context;
+}
+
+Context *create_context()
+{
+    auto *context = new Context();
+    context->db = current_context().db;
+
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    context->handle = g_next_handle++;
+    g_contexts[context->handle] = context;
+    return context;
+}
+
+bool destroy_context(uint32_t handle)
+{
+    Context *context = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        const auto found = g_contexts.find(handle);
+        if (found == g_contexts.end())
+        {
+            return false;
+        }
+        context = found->second;
+        g_contexts.erase(found);
+    }
+
+    if (t_current == context)
+    {
+        t_current = nullptr;
+    }
+    delete context;
+    return true;
+}
+
+bool bind_context(uint32_t handle)
+{
+    if (handle == 0)
+    {
+        t_current = nullptr;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    const auto found = g_contexts.find(handle);
+    if (found == g_contexts.end())
+    {
+        return false;
+    }
+    t_current = found->second;
+    return true;
+}
+
+void replace_database(const std::shared_ptr<Database> &from, const std::shared_ptr<Database> &to)
+{
+    // `from` may be one of the pointers being replaced.
+    const std::shared_ptr<Database> old = from;
+    if (g_default_context.db == old)
+    {
+        g_default_context.db = to;
+    }
+
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    for (auto &entry : g_contexts)
+    {
+        if (entry.second->db == old)
+        {
+            entry.second->db = to;
+        }
+    }
+}
+} // namespace lfw
@@ -0,0 +1,44 @@
+#ifndef LFW_CONTEXT_H
+#define LFW_CONTEXT_H
+
+#include "lfw_database.h"
+
+#include <stdint.h>
+
+#include <memory>
+
+namespace lfw
+{
+// Per-caller state. Contexts are cheap: the parsed database is shared through
+// `db`, so N worker threads cost one database plus N contexts. A context must
+// only be used by one thread at a time; each thread binds its own with
+// bind_context and every lfw_* entry point then runs against it.
+//
+// The calibration cache stays with the database: its entries depend only on
+// the shared lens records, and batch and job threads that have no context
+// bound use it too. Modifiers and scratch buffers are sized to each request
+// and live for one call, so there is nothing per context to keep.
+struct Context
+{
+    uint32_t handle = 0;
+    std::shared_ptr<Database> db;
+};
+
+// The context bound to the calling thread, or the process-wide default one.
+Context &current_context();
+
+// New context sharing the database of the calling thread's context.
+Context *create_context();
+// Must not be called while another thread still has the context bound.
+bool destroy_context(uint32_t handle);
+
+// Binds the context `handle` to the calling thread; 0 restores the default.
+bool bind_context(uint32_t handle);
+
+// Points every context that shares `from`, the default one included, at
+// `to`. Must not be called while another thread is inside a call on one of
+// them.
+void replace_database(const std::shared_ptr<Database> &from, const std::shared_ptr<Database> &to);
+} // namespace lfw
+
+#endif
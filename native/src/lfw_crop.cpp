@@ -0,0 +1,205 @@
+#include "lfw_crop.h"
+
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace lfw
+{
+namespace
+{
+constexpr int kCropMods = LF_MODIFY_DISTORTION | LF_MODIFY_TCA;
+
+// Border points per side of the frame, a power of two so they can be visited
+// coarse to fine.
+constexpr int kEdgeBits = 5;
+constexpr int kEdgeSamples = 1 << kEdgeBits;
+// Largest fit searched; the frame grown twice over is far outside any
+// calibrated radius.
+constexpr float kMaxFit = 2.0f;
+// A ray is bisected until its bracket is this short, in pixels.
+constexpr float kPrecision = 1.0f / 64.0f;
+
+int bit_reverse(int value, int bits)
+{
+    int out = 0;
+    for (int i = 0; i < bits; ++i)
+    {
+        out = (out << 1) | ((value >> i) & 1);
+    }
+    return out;
+}
+
+class CropSearch
+{
+public:
+    CropSearch(lfModifier *modifier, bool geometry, bool tca, int width, int height)
+        : modifier_(modifier),
+          geometry_(geometry),
+          tca_(tca),
+          right_(static_cast<float>(width - 1)),
+          bottom_(static_cast<float>(height - 1))
+    {
+    }
+
+    // 1 when output point (x, y) has every source coordinate inside the
+    // image, 0 when not, -1 when lensfun rejects it.
+    int inside(float x, float y) const
+    {
+        float coords[6];
+        bool ok = false;
+        if (geometry_ && tca_)
+        {
+            ok = lf_modifier_apply_subpixel_geometry_distortion(modifier_, x, y, 1, 1, coords);
+        }
+        else if (tca_)
+        {
+            ok = lf_modifier_apply_subpixel_distortion(modifier_, x, y, 1, 1, coords);
+        }
+        else
+        {
+            ok = lf_modifier_apply_geometry_distortion(modifier_, x, y, 1, 1, coords);
+        }
+        if (!ok)
+        {
+            return -1;
+        }
+        const int count = tca_ ? 6 : 2;
+        for (int c = 0; c < count; c += 2)
+        {
+            // Written so that NaN counts as outside.
+            if (!(coords[c] >= 0.0f && coords[c] <= right_ && coords[c + 1] >= 0.0f && coords[c + 1] <= bottom_))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+private:
+    lfModifier *modifier_;
+    bool geometry_;
+    bool tca_;
+    float right_;
+    float bottom_;
+};
+
+// Lowers `fit` to where the ray from (cx, cy) through (cx + dx, cy + dy)
+// leaves the valid region, if that is closer. Validity is taken to shrink
+// monotonically along a ray, so its border is found by bisection. Returns 0
+// or -5 when lensfun rejects a point.
+int32_t tighten(const CropSearch &search, float cx, float cy, float dx, float dy, float *fit)
+{
+    const int at_fit = search.inside(cx + dx * *fit, cy + dy * *fit);
+    if (at_fit != 0)
+    {
+        return at_fit < 0 ? -5 : 0;
+    }
+
+    const float length = hypotf(dx, dy);
+    float lo = 0.0f;
+    float hi = *fit;
+    while ((hi - lo) * length > kPrecision)
+    {
+        const float mid = 0.5f * (lo + hi);
+        const int valid = search.inside(cx + dx * mid, cy + dy * mid);
+        if (valid < 0)
+        {
+            return -5;
+        }
+        (valid ? lo : hi) = mid;
+    }
+    *fit = lo;
+    return 0;
+}
+} // namespace
+
+int32_t find_valid_crop(const CropRequest &request, CalibrationCache &cache, ValidCrop *out)
+{
+    const CropRequest &r = request;
+    if (!r.lens || !out || r.width <= 0 || r.height <= 0 || (r.mods & kCropMods) == 0 || (r.mods & ~kCropMods) != 0)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("valid crop");
+    lfModifier *modifier = nullptr;
+    {
+        const TraceSpan create_span("lf_modifier_create");
+        modifier = lf_modifier_create(r.lens, r.focal, r.crop, r.width, r.height, LF_PF_F32, false);
+    }
+    if (!modifier)
+    {
+        return -3;
+    }
+
+    bool geometry = false;
+    bool tca = false;
+    if (r.mods & LF_MODIFY_DISTORTION)
+    {
+        geometry = (enable_distortion(modifier, cache, r.lens, r.crop, r.focal) & LF_MODIFY_DISTORTION) != 0;
+    }
+    if (r.mods & LF_MODIFY_TCA)
+    {
+        tca = (enable_tca(modifier, cache, r.lens, r.crop, r.focal) & LF_MODIFY_TCA) != 0;
+    }
+    if (geometry != ((r.mods & LF_MODIFY_DISTORTION) != 0) || tca != ((r.mods & LF_MODIFY_TCA) != 0))
+    {
+        lf_modifier_destroy(modifier);
+        return -4;
+    }
+
+    const CropSearch search(modifier, geometry, tca, r.width, r.height);
+    const float cx = 0.5f * static_cast<float>(r.width - 1);
+    const float cy = 0.5f * static_cast<float>(r.height - 1);
+    float fit = kMaxFit;
+    int32_t rc = 0;
+    // Corners and edge midpoints come first; they usually set the fit, after
+    // which most other points pass with a single evaluation.
+    for (int k = 0; k < kEdgeSamples && rc == 0; ++k)
+    {
+        const float t = static_cast<float>(bit_reverse(k, kEdgeBits)) / kEdgeSamples;
+        const float border[4][2] = {
+            {-cx + 2.0f * cx * t, -cy},
+            {cx, -cy + 2.0f * cy * t},
+            {cx - 2.0f * cx * t, cy},
+            {-cx, cy - 2.0f * cy * t}};
+        for (const auto &d : border)
+        {
+            rc = tighten(search, cx, cy, d[0], d[1], &fit);
+            if (rc != 0)
+            {
+                break;
+            }
+        }
+    }
+    lf_modifier_destroy(modifier);
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    ValidCrop crop;
+    if (fit > 0.0f)
+    {
+        // The tolerance keeps a border pixel that the fit reaches up to
+        // rounding.
+        const float inset = 1.0f - std::min(fit, 1.0f);
+        crop.scale = 1.0f / fit;
+        crop.x = static_cast<int>(ceilf(cx * inset - 1e-3f));
+        crop.y = static_cast<int>(ceilf(cy * inset - 1e-3f));
+        crop.width = r.width - 2 * crop.x;
+        crop.height = r.height - 2 * crop.y;
+    }
+    else
+    {
+        crop.scale = 0.0f;
+        crop.x = r.width / 2;
+        crop.y = r.height / 2;
+    }
+    *out = crop;
+    return 0;
+}
+} // namespace lfw
@@ -0,0 +1,54 @@
+#ifndef LFW_CROP_H
+#define LFW_CROP_H
+
+#include "lensfun.h"
+#include "lfw_calibration.h"
+
+#include <stdint.h>
+
+namespace lfw
+{
+// Floats written by lfw_valid_crop: scale, x, y, width, height.
+constexpr int kValidCropFloats = 5;
+
+struct CropRequest
+{
+    const lfLens *lens = nullptr;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    int width = 0;
+    int height = 0;
+    // LF_MODIFY_DISTORTION and LF_MODIFY_TCA.
+    int mods = LF_MODIFY_DISTORTION;
+};
+
+// The part of a corrected image that has source pixels behind it.
+struct ValidCrop
+{
+    // Magnification that makes the corrected image fill the frame, as
+    // lensfun's auto-scale: 1 / fit, where `fit` is the largest factor the
+    // frame can be shrunk by about its centre and still map inside the
+    // source. Below 1 when the whole frame is valid.
+    float scale = 1.0f;
+    // Largest valid rectangle with the image's aspect ratio and centre, in
+    // whole output pixels. Empty, with a scale of 0, when not even the centre
+    // is valid.
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Finds the valid crop of the forward correction of `request` without
+// building a map. Points on the frame border are followed inwards from the
+// image centre until their source coordinates (every channel, with TCA) fall
+// inside the image; only rays that would tighten the result are searched, so
+// a few hundred lensfun evaluations suffice at any image size.
+//
+// Returns 0, -1 for a bad request, -3 when lensfun has no modifier, -4 when a
+// requested correction is not available for the lens, or -5 when lensfun
+// rejects a point.
+int32_t find_valid_crop(const CropRequest &request, CalibrationCache &cache, ValidCrop *out);
+} // namespace lfw
+
+#endif
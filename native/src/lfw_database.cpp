@@ -0,0 +1,645 @@
+#include "lfw_database.h"
+
+#include "lfw_alloc.h"
+#include "lfw_blob.h"
+#include "lfw_trace.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+std::atomic<uint32_t> g_next_lens_handle{1};
+
+bool has_xml_suffix(const char *name)
+{
+    const size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".xml") == 0;
+}
+
+const char *mlstr_or_empty(const lfMLstr value)
+{
+    return value ? lf_mlstr_get(value) : "";
+}
+
+bool same_name(const lfLens *lens, const char *maker, const char *model)
+{
+    return strcmp(mlstr_or_empty(lens->Maker), maker) == 0 && strcmp(mlstr_or_empty(lens->Model), model) == 0;
+}
+
+bool read_file(const std::string &path, std::string *out)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    char buffer[65536];
+    size_t got = 0;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        out->append(buffer, got);
+    }
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Sort by score and drop repeated maker/model pairs, keeping the best match.
+void uniquify_lenses(std::vector<Database::LensMatch> &lenses)
+{
+    std::stable_sort(lenses.begin(), lenses.end(), [](const Database::LensMatch &a, const Database::LensMatch &b) {
+        return a.score > b.score;
+    });
+
+    std::vector<Database::LensMatch> unique;
+    unique.reserve(lenses.size());
+    for (const Database::LensMatch &match : lenses)
+    {
+        const lfLens *lens = match.lens;
+        const bool duplicate = std::any_of(unique.begin(), unique.end(), [lens](const Database::LensMatch &kept) {
+            return strcmp(mlstr_or_empty(kept.lens->Maker), mlstr_or_empty(lens->Maker)) == 0 &&
+                   strcmp(mlstr_or_empty(kept.lens->Model), mlstr_or_empty(lens->Model)) == 0;
+        });
+        if (!duplicate)
+        {
+            unique.push_back(match);
+        }
+    }
+    lenses.swap(unique);
+}
+} // namespace
+
+Database::Database(RecordFilter filter)
+    : filter_(std::move(filter))
+{
+    const AllocScope alloc_scope(AllocCategory::DatabaseLoad);
+    db_ = lf_db_create();
+}
+
+Database::~Database()
+{
+    if (db_)
+    {
+        lf_db_destroy(db_);
+    }
+}
+
+bool Database::valid() const
+{
+    return db_ != nullptr;
+}
+
+// Runs `load` against the live database and attributes every record it added
+// to `doc_id`. On success the previous records of `doc_id` are retired; on
+// failure whatever was parsed before the error is retired instead, so a broken
+// update never leaves a half-loaded document visible.
+template <typename Loader>
+lfError Database::load_document(
+    const std::string &doc_id, Document added, Loader load, const std::vector<uint32_t> *handles)
+{
+    if (!db_)
+    {
+        return LF_NO_DATABASE;
+    }
+
+    const TraceSpan span("db.load_document", doc_id.c_str());
+    const AllocScope alloc_scope(AllocCategory::DatabaseLoad);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    lfError err = load(db_);
+
+    const lfLens *const *lenses = lf_db_get_lenses(db_);
+    for (size_t i = 0; lenses && lenses[i] != nullptr; ++i)
+    {
+        if (known_lenses_.insert(lenses[i]).second)
+        {
+            added.lenses.push_back(lenses[i]);
+        }
+    }
+    if (handles && handles->size() != added.lenses.size())
+    {
+        err = LF_WRONG_FORMAT;
+    }
+    for (size_t i = 0; i < added.lenses.size(); ++i)
+    {
+        const uint32_t handle =
+            handles && err == LF_NO_ERROR ? (*handles)[i] : g_next_lens_handle.fetch_add(1, std::memory_order_relaxed);
+        lens_handles_.emplace(added.lenses[i], handle);
+        handle_lenses_.emplace(handle, added.lenses[i]);
+    }
+    const lfCamera *const *cameras = lf_db_get_cameras(db_);
+    for (size_t i = 0; cameras && cameras[i] != nullptr; ++i)
+    {
+        if (known_cameras_.insert(cameras[i]).second)
+        {
+            added.cameras.push_back(cameras[i]);
+        }
+    }
+
+    if (err != LF_NO_ERROR)
+    {
+        return err;
+    }
+
+    const auto previous = documents_.find(doc_id);
+    if (previous != documents_.end())
+    {
+        retire(previous->second);
+    }
+
+    live_lenses_.insert(added.lenses.begin(), added.lenses.end());
+    live_cameras_.insert(added.cameras.begin(), added.cameras.end());
+    added.sequence = next_sequence_++;
+    documents_[doc_id] = std::move(added);
+    return LF_NO_ERROR;
+}
+
+void Database::retire(const Document &doc)
+{
+    for (const lfLens *lens : doc.lenses)
+    {
+        live_lenses_.erase(lens);
+    }
+    for (const lfCamera *camera : doc.cameras)
+    {
+        live_cameras_.erase(camera);
+    }
+}
+
+// Mirrors lfDatabase::Load(dir): every *.xml file (and package) is loaded,
+// per-file errors are tolerated, and the call fails only if nothing could be
+// loaded. Files are loaded one by one so each becomes an individually
+// replaceable document.
+lfError Database::load_path(const char *path)
+{
+    struct stat st;
+    if (!path || stat(path, &st) != 0)
+    {
+        return LF_NO_DATABASE;
+    }
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        return has_pack_suffix(path) ? load_pack(path) : load_file(path);
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        return LF_NO_DATABASE;
+    }
+
+    std::vector<std::string> files;
+    while (const struct dirent *entry = readdir(dir))
+    {
+        if (has_xml_suffix(entry->d_name) || (kPackSupported && has_pack_suffix(entry->d_name)))
+        {
+            files.emplace_back(std::string(path) + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+
+    bool loaded_any = false;
+    for (const std::string &file : files)
+    {
+        const lfError err = has_pack_suffix(file.c_str()) ? load_pack(file) : load_file(file);
+        if (err == LF_NO_ERROR)
+        {
+            loaded_any = true;
+        }
+    }
+
+    return loaded_any ? LF_NO_ERROR : LF_NO_DATABASE;
+}
+
+// Read here rather than by lensfun so the bytes parsed are the bytes hashed.
+lfError Database::load_file(const std::string &path)
+{
+    std::string xml;
+    {
+        const AllocScope alloc_scope(AllocCategory::DatabaseLoad);
+        if (!read_file(path, &xml))
+        {
+            return LF_NO_DATABASE;
+        }
+    }
+    return load_from(path, xml.data(), xml.size(), std::string(), false);
+}
+
+// Documents are parsed as they come out of the inflater, under the ids they
+// would have as files beside the package, so a packed database hashes (and
+// numbers its lenses) like the directory it was packed from. A damaged
+// package fails the call but keeps the documents read before the damage.
+lfError Database::load_pack(const std::string &path)
+{
+    const TraceSpan span("db.load_pack", path.c_str());
+    const size_t slash = path.rfind('/');
+    const std::string dir = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    bool loaded_any = false;
+    PackStats stats;
+    const bool ok = read_pack(
+        path,
+        [this, &path, &dir, &loaded_any](const std::string &name, const char *xml, size_t size) {
+            loaded_any = load_from(dir + name, xml, size, path, false) == LF_NO_ERROR || loaded_any;
+        },
+        &stats);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        packages_ += stats;
+    }
+    return ok && loaded_any ? LF_NO_ERROR : LF_NO_DATABASE;
+}
+
+lfError Database::load_xml(const std::string &doc_id, const char *xml, size_t size)
+{
+    return load_from(doc_id, xml, size, std::string(), true);
+}
+
+std::pair<const char *, size_t> Database::prune(
+    const std::string &doc_id, const char *xml, size_t size, std::string *kept, PruneCounts *pruned) const
+{
+    if (filter_.active())
+    {
+        const TraceSpan span("db.prune", doc_id.c_str());
+        const AllocScope alloc_scope(AllocCategory::DatabaseLoad);
+        if (prune_records(filter_, xml, size, kept, pruned))
+        {
+            return std::make_pair(kept->data(), kept->size());
+        }
+    }
+    return std::make_pair(xml, size);
+}
+
+// Filtered records never reach lensfun, and the hash covers what it parsed:
+// lens ordinals depend on which records are loaded.
+lfError Database::load_from(
+    const std::string &doc_id, const char *xml, size_t size, const std::string &pack, bool in_memory)
+{
+    std::string kept;
+    Document added;
+    const std::pair<const char *, size_t> parsed = prune(doc_id, xml, size, &kept, &added.pruned);
+    added.hash = hash_bytes(parsed.first, parsed.second);
+    added.pack = pack;
+    added.in_memory = in_memory;
+    if (in_memory)
+    {
+        const AllocScope alloc_scope(AllocCategory::DatabaseLoad);
+        added.xml.assign(parsed.first, parsed.second);
+    }
+    return load_document(doc_id, std::move(added), [&doc_id, parsed](lfDatabase *db) {
+        return lf_db_load_data(db, doc_id.c_str(), parsed.first, parsed.second);
+    });
+}
+
+bool Database::unload(const std::string &doc_id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    const auto doc = documents_.find(doc_id);
+    if (doc == documents_.end())
+    {
+        return false;
+    }
+
+    retire(doc->second);
+    documents_.erase(doc);
+    return true;
+}
+
+// Reads every live document again (files and packages from disk, the rest
+// from the bytes kept at load) and loads it into a new instance in its
+// original order. Identical bytes give identical records, which are matched
+// to the old ones by position to carry their handles over.
+std::shared_ptr<Database> Database::compacted() const
+{
+    const TraceSpan span("db.compact");
+    struct Live
+    {
+        std::string id;
+        Document doc;
+        std::vector<uint32_t> handles;
+        std::vector<std::pair<std::string, std::string>> names;
+    };
+
+    std::vector<Live> live;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        live.reserve(documents_.size());
+        for (const auto &entry : documents_)
+        {
+            Live doc;
+            doc.id = entry.first;
+            doc.doc = entry.second;
+            for (const lfLens *lens : entry.second.lenses)
+            {
+                doc.handles.push_back(lens_handles_.at(lens));
+                doc.names.emplace_back(mlstr_or_empty(lens->Maker), mlstr_or_empty(lens->Model));
+            }
+            live.push_back(std::move(doc));
+        }
+    }
+    std::sort(live.begin(), live.end(), [](const Live &a, const Live &b) { return a.doc.sequence < b.doc.sequence; });
+
+    auto fresh = std::make_shared<Database>(filter_);
+    if (!fresh->valid())
+    {
+        return nullptr;
+    }
+
+    // Each package is inflated once, keeping only its live documents.
+    std::map<std::string, std::string> packed;
+    std::set<std::string> packs_read;
+    for (const Live &doc : live)
+    {
+        if (doc.doc.pack.empty() || !packs_read.insert(doc.doc.pack).second)
+        {
+            continue;
+        }
+        const size_t slash = doc.doc.pack.rfind('/');
+        const std::string dir = slash == std::string::npos ? std::string() : doc.doc.pack.substr(0, slash + 1);
+        PackStats stats;
+        read_pack(
+            doc.doc.pack,
+            [&live, &packed, &doc, &dir](const std::string &name, const char *xml, size_t size) {
+                const std::string id = dir + name;
+                const bool wanted = std::any_of(live.begin(), live.end(), [&doc, &id](const Live &other) {
+                    return other.id == id && other.doc.pack == doc.doc.pack;
+                });
+                if (wanted)
+                {
+                    packed[id].assign(xml, size);
+                }
+            },
+            &stats);
+    }
+
+    for (Live &doc : live)
+    {
+        std::string source;
+        if (doc.doc.in_memory)
+        {
+            source.swap(doc.doc.xml);
+        }
+        else if (!doc.doc.pack.empty())
+        {
+            const auto found = packed.find(doc.id);
+            if (found == packed.end())
+            {
+                return nullptr;
+            }
+            source.swap(found->second);
+        }
+        else if (!read_file(doc.id, &source))
+        {
+            return nullptr;
+        }
+
+        // Bytes kept in memory were already pruned; the rest prune as before.
+        std::string kept;
+        Document added;
+        added.pruned = doc.doc.pruned;
+        added.pack = doc.doc.pack;
+        added.in_memory = doc.doc.in_memory;
+        PruneCounts pruned;
+        const std::pair<const char *, size_t> parsed =
+            doc.doc.in_memory ? std::make_pair(source.data(), source.size())
+                              : prune(doc.id, source.data(), source.size(), &kept, &pruned);
+        added.hash = hash_bytes(parsed.first, parsed.second);
+        if (added.hash != doc.doc.hash)
+        {
+            return nullptr;
+        }
+        if (doc.doc.in_memory)
+        {
+            added.xml = source;
+        }
+
+        const std::string &id = doc.id;
+        const lfError err = fresh->load_document(
+            id,
+            std::move(added),
+            [&id, parsed](lfDatabase *db) { return lf_db_load_data(db, id.c_str(), parsed.first, parsed.second); },
+            &doc.handles);
+        if (err != LF_NO_ERROR)
+        {
+            return nullptr;
+        }
+        const std::vector<const lfLens *> &lenses = fresh->documents_.at(id).lenses;
+        for (size_t i = 0; i < lenses.size(); ++i)
+        {
+            if (!same_name(lenses[i], doc.names[i].first.c_str(), doc.names[i].second.c_str()))
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    // Package counts describe the loads, not this rebuild.
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    fresh->packages_ = packages_;
+    return fresh;
+}
+
+Database::Counts Database::counts() const
+{
+    Counts counts;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    counts.documents = documents_.size();
+    counts.lenses = live_lenses_.size();
+    counts.retired_lenses = known_lenses_.size() - live_lenses_.size();
+    counts.cameras = live_cameras_.size();
+    counts.retired_cameras = known_cameras_.size() - live_cameras_.size();
+    for (const auto &doc : documents_)
+    {
+        counts.pruned += doc.second.pruned;
+    }
+    counts.packages = packages_;
+
+    const lfMount *const *mounts = db_ ? lf_db_get_mounts(db_) : nullptr;
+    for (size_t i = 0; mounts && mounts[i] != nullptr; ++i)
+    {
+        ++counts.mounts;
+    }
+    return counts;
+}
+
+std::vector<const Database::Document *> Database::documents_by_hash() const
+{
+    std::vector<const Document *> docs;
+    docs.reserve(documents_.size());
+    for (const auto &doc : documents_)
+    {
+        docs.push_back(&doc.second);
+    }
+    std::stable_sort(docs.begin(), docs.end(), [](const Document *a, const Document *b) { return a->hash < b->hash; });
+    return docs;
+}
+
+uint64_t Database::content_hash() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    uint64_t hash = hash_bytes(nullptr, 0);
+    for (const Document *doc : documents_by_hash())
+    {
+        hash = hash_bytes(&doc->hash, sizeof(doc->hash), hash);
+    }
+    return hash;
+}
+
+uint32_t Database::lens_ordinal(const lfLens *lens) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const char *maker = mlstr_or_empty(lens->Maker);
+    const char *model = mlstr_or_empty(lens->Model);
+    uint32_t ordinal = 0;
+    for (const Document *doc : documents_by_hash())
+    {
+        for (const lfLens *candidate : doc->lenses)
+        {
+            if (candidate == lens)
+            {
+                return ordinal;
+            }
+            if (same_name(candidate, maker, model))
+            {
+                ++ordinal;
+            }
+        }
+    }
+    return ordinal;
+}
+
+const lfLens *Database::find_lens(const char *maker, const char *model, uint32_t ordinal) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const Document *doc : documents_by_hash())
+    {
+        for (const lfLens *candidate : doc->lenses)
+        {
+            if (same_name(candidate, maker, model) && ordinal-- == 0)
+            {
+                return candidate;
+            }
+        }
+    }
+    return nullptr;
+}
+
+uint32_t Database::lens_handle(const lfLens *lens) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto it = lens_handles_.find(lens);
+    return it != lens_handles_.end() ? it->second : 0;
+}
+
+const lfLens *Database::resolve_lens(uint32_t handle) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto it = handle_lenses_.find(handle);
+    if (it == handle_lenses_.end())
+    {
+        return nullptr;
+    }
+    return live_lenses_.count(it->second) != 0 ? it->second : nullptr;
+}
+
+std::vector<Database::LensMatch> Database::find_lenses(
+    const char *camera_maker,
+    const char *camera_model,
+    const char *lens_maker,
+    const char *lens_model,
+    int search_flags) const
+{
+    const AllocScope alloc_scope(AllocCategory::Search);
+    std::vector<LensMatch> matches;
+    if (!db_)
+    {
+        return matches;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const std::lock_guard<std::mutex> search_lock(search_mutex_);
+
+    const lfCamera *camera = nullptr;
+    const lfCamera **cameras = nullptr;
+    if (camera_maker || camera_model)
+    {
+        cameras = lf_db_find_cameras(db_, camera_maker, camera_model);
+        for (size_t i = 0; cameras && cameras[i] != nullptr; ++i)
+        {
+            if (live_cameras_.count(cameras[i]) != 0)
+            {
+                camera = cameras[i];
+                break;
+            }
+        }
+    }
+
+    // With retired records around, lensfun's uniquify pass could keep a retired
+    // duplicate and drop its live replacement, so filter first and uniquify here.
+    const bool has_retired = known_lenses_.size() != live_lenses_.size();
+    const bool uniquify = has_retired && (search_flags & LF_SEARCH_SORT_AND_UNIQUIFY) != 0;
+    const int lensfun_flags = uniquify ? (search_flags & ~LF_SEARCH_SORT_AND_UNIQUIFY) : search_flags;
+    const lfLens **lenses = lf_db_find_lenses(db_, camera, lens_maker, lens_model, lensfun_flags);
+
+    if (lenses)
+    {
+        for (size_t i = 0; lenses[i] != nullptr; ++i)
+        {
+            if (live_lenses_.count(lenses[i]) != 0)
+            {
+                matches.push_back(LensMatch{lenses[i], lenses[i]->Score});
+            }
+        }
+        lf_free(lenses);
+    }
+
+    if (cameras)
+    {
+        lf_free(cameras);
+    }
+
+    if (uniquify)
+    {
+        uniquify_lenses(matches);
+    }
+    return matches;
+}
+
+std::vector<Database::CameraMatch> Database::find_cameras(const char *maker, const char *model, int search_flags) const
+{
+    const AllocScope alloc_scope(AllocCategory::Search);
+    std::vector<CameraMatch> matches;
+    if (!db_)
+    {
+        return matches;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const std::lock_guard<std::mutex> search_lock(search_mutex_);
+    const lfCamera **cameras = lf_db_find_cameras_ext(db_, maker, model, search_flags);
+    if (cameras)
+    {
+        for (size_t i = 0; cameras[i] != nullptr; ++i)
+        {
+            if (live_cameras_.count(cameras[i]) != 0)
+            {
+                matches.push_back(CameraMatch{cameras[i], cameras[i]->Score});
+            }
+        }
+        lf_free(cameras);
+    }
+    return matches;
+}
+} // namespace lfw
@@ -0,0 +1,173 @@
+#ifndef LFW_DATABASE_H
+#define LFW_DATABASE_H
+
+#include "lensfun.h"
+#include "lfw_calibration.h"
+#include "lfw_pack.h"
+#include "lfw_prune.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace lfw
+{
+// Parsed lensfun database plus the per-document registry used for
+// incremental updates. One instance is shared by every context bound to it:
+// lookups take a shared lock, document loads take an exclusive one.
+//
+// lensfun cannot delete records from a live database, so records of a
+// replaced or unloaded document are only retired: they stay allocated (and
+// their handles stay dereferenceable) for the lifetime of the instance, but
+// are hidden from searches and rejected by resolve_lens. They still cost
+// heap and lengthen every lensfun search, so a database that is updated
+// over and over is replaced now and then by compacted().
+//
+// Lens handles are process-unique integers handed out as records are loaded,
+// not pointers, so they fit the 32-bit bridge ABI on 64-bit native builds too.
+class Database
+{
+public:
+    struct Counts
+    {
+        size_t documents = 0;
+        size_t lenses = 0;
+        size_t retired_lenses = 0;
+        size_t cameras = 0;
+        size_t retired_cameras = 0;
+        size_t mounts = 0;
+        // Records the filter kept out of the live documents.
+        PruneCounts pruned;
+        // Every package read, including documents since unloaded.
+        PackStats packages;
+    };
+
+    // Every document loaded is pruned by `filter` before lensfun parses it.
+    explicit Database(RecordFilter filter = RecordFilter());
+    ~Database();
+
+    Database(const Database &) = delete;
+    Database &operator=(const Database &) = delete;
+
+    bool valid() const;
+
+    // Loads a single file or every *.xml file and package of a directory,
+    // one document per file (the file path is the document id).
+    lfError load_path(const char *path);
+    lfError load_file(const std::string &path);
+    // Loads each document of a package as if it were a file next to it.
+    lfError load_pack(const std::string &path);
+    // The document is kept in memory, as parsed, for compacted().
+    lfError load_xml(const std::string &doc_id, const char *xml, size_t size);
+    bool unload(const std::string &doc_id);
+    Counts counts() const;
+
+    // A new database holding only the live documents, loaded in the order
+    // they were, whose lenses keep their handles. Files and packages are read
+    // again; null if one of them is gone or no longer hashes the same.
+    // Objects built from this database keep it alive, retired records and
+    // all, until they are destroyed.
+    std::shared_ptr<Database> compacted() const;
+
+    // Hash of the live documents' content, independent of their ids and of
+    // the order they were loaded in: two databases loaded from the same files
+    // hash the same wherever they live.
+    uint64_t content_hash() const;
+    // Lenses are identified across sessions by maker, model and an ordinal
+    // among the live lenses with that name, counted in document content hash
+    // order, then load order. Given the same content_hash(), the same triple
+    // names the same record.
+    uint32_t lens_ordinal(const lfLens *lens) const;
+    const lfLens *find_lens(const char *maker, const char *model, uint32_t ordinal) const;
+
+    uint32_t lens_handle(const lfLens *lens) const;
+    const lfLens *resolve_lens(uint32_t handle) const;
+
+    // A search result with the score lensfun gave it. lensfun keeps the score
+    // in the shared record, where the next search overwrites it, so it is
+    // copied out before the search lock is released.
+    struct LensMatch
+    {
+        const lfLens *lens = nullptr;
+        int score = 0;
+    };
+    struct CameraMatch
+    {
+        const lfCamera *camera = nullptr;
+        int score = 0;
+    };
+
+    std::vector<LensMatch> find_lenses(
+        const char *camera_maker,
+        const char *camera_model,
+        const char *lens_maker,
+        const char *lens_model,
+        int search_flags) const;
+    std::vector<CameraMatch> find_cameras(const char *maker, const char *model, int search_flags) const;
+
+    // Shared by every modifier built from this database.
+    CalibrationCache &calibrations() const
+    {
+        return calibrations_;
+    }
+
+private:
+    struct Document
+    {
+        uint64_t hash = 0;
+        PruneCounts pruned;
+        // Load order, kept by compacted().
+        uint64_t sequence = 0;
+        // Where compacted() reads the document again: the package it was
+        // inflated from, or else the file named by its id. Documents loaded
+        // from memory keep the XML lensfun parsed instead.
+        std::string pack;
+        bool in_memory = false;
+        std::string xml;
+        std::vector<const lfLens *> lenses;
+        std::vector<const lfCamera *> cameras;
+    };
+
+    // `added` carries the document's hash, prune counts and source. Its
+    // lenses get fresh handles, or `handles` in order if given.
+    template <typename Loader>
+    lfError load_document(
+        const std::string &doc_id, Document added, Loader load, const std::vector<uint32_t> *handles = nullptr);
+    // Prunes `xml` by the filter into `kept` when it removes anything;
+    // returns the bytes to parse.
+    std::pair<const char *, size_t> prune(
+        const std::string &doc_id, const char *xml, size_t size, std::string *kept, PruneCounts *pruned) const;
+    lfError load_from(const std::string &doc_id, const char *xml, size_t size, const std::string &pack, bool in_memory);
+    void retire(const Document &doc);
+    // Live documents by content hash; needs the lock held.
+    std::vector<const Document *> documents_by_hash() const;
+
+    lfDatabase *db_ = nullptr;
+    const RecordFilter filter_;
+    mutable std::shared_mutex mutex_;
+    // Held, inside a shared lock of `mutex_`, by every lensfun search: they
+    // write the Score of the records they visit.
+    mutable std::mutex search_mutex_;
+    std::map<std::string, Document> documents_;
+    uint64_t next_sequence_ = 0;
+    PackStats packages_;
+    std::unordered_set<const lfLens *> live_lenses_;
+    std::unordered_set<const lfCamera *> live_cameras_;
+    std::unordered_set<const lfLens *> known_lenses_;
+    std::unordered_set<const lfCamera *> known_cameras_;
+    std::unordered_map<const lfLens *, uint32_t> lens_handles_;
+    std::unordered_map<uint32_t, const lfLens *> handle_lenses_;
+    mutable CalibrationCache calibrations_;
+};
+} // namespace lfw
+
+#endif
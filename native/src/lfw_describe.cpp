@@ -0,0 +1,378 @@
+#include "lfw_describe.h"
+
+#include "lfw_radial.h"
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace lfw
+{
+namespace
+{
+// Points per side of the grid a descriptor is checked on.
+constexpr int kChecks = 33;
+// Points along the diagonal, besides corners and edge midpoints, that the
+// scale is fitted to.
+constexpr int kDiagonalProbes = 16;
+// The scale is searched over kScanRange times either way of a first guess,
+// then refined by golden section.
+constexpr double kScanRange = 16.0;
+constexpr int kScanSteps = 129;
+constexpr int kRefineSteps = 40;
+
+class ScopedModifier
+{
+public:
+    explicit ScopedModifier(const MapRequest &r)
+    {
+        const TraceSpan span("lf_modifier_create");
+        modifier_ = lf_modifier_create(r.lens, r.focal, r.crop, r.width, r.height, LF_PF_F32, r.reverse);
+    }
+    ~ScopedModifier()
+    {
+        if (modifier_)
+        {
+            lf_modifier_destroy(modifier_);
+        }
+    }
+
+    ScopedModifier(const ScopedModifier &) = delete;
+    ScopedModifier &operator=(const ScopedModifier &) = delete;
+
+    lfModifier *get() const
+    {
+        return modifier_;
+    }
+
+private:
+    lfModifier *modifier_ = nullptr;
+};
+
+struct Probe
+{
+    float x;
+    float y;
+    float expected[6];
+};
+
+bool lensfun_point(lfModifier *modifier, MapKind kind, float x, float y, float *out)
+{
+    switch (kind)
+    {
+    case MapKind::Geometry:
+        return lf_modifier_apply_geometry_distortion(modifier, x, y, 1, 1, out);
+    case MapKind::Tca:
+        return lf_modifier_apply_subpixel_distortion(modifier, x, y, 1, 1, out);
+    default:
+        std::fill(out, out + 3, 1.0f);
+        return lf_modifier_apply_color_modification(
+            modifier, out, x, y, 1, 1, LF_CR_3(RED, GREEN, BLUE), 3 * static_cast<int>(sizeof(float)));
+    }
+}
+
+// Largest distance between two points' coordinates, or largest gain
+// difference.
+double point_error(MapKind kind, const float *a, const float *b)
+{
+    double worst = 0.0;
+    if (kind == MapKind::Vignetting)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            worst = std::max(worst, fabs(static_cast<double>(a[c]) - b[c]));
+        }
+        return worst;
+    }
+    for (int c = 0; c < map_channels(kind); c += 2)
+    {
+        worst = std::max(worst, hypot(static_cast<double>(a[c]) - b[c], static_cast<double>(a[c + 1]) - b[c + 1]));
+    }
+    return worst;
+}
+
+double probe_error(const CorrectionDescriptor &d, MapKind kind, const std::vector<Probe> &probes)
+{
+    double worst = 0.0;
+    for (const Probe &probe : probes)
+    {
+        float got[6];
+        evaluate_descriptor_points(d, static_cast<int>(kind), &probe.x, 1, probe.y, got);
+        const double error = point_error(kind, got, probe.expected);
+        // NaN from a scale far off the mark counts as the worst fit.
+        worst = error == error ? std::max(worst, error) : HUGE_VAL;
+    }
+    return worst;
+}
+
+DescriptorComponent &component(CorrectionDescriptor *d, MapKind kind)
+{
+    switch (kind)
+    {
+    case MapKind::Geometry:
+        return d->distortion;
+    case MapKind::Tca:
+        return d->tca;
+    default:
+        return d->vignetting;
+    }
+}
+
+// Fits the scale of one correction to lensfun's output on the image border
+// and diagonal, then checks the whole image.
+int32_t fit_scale(CorrectionDescriptor *d, MapKind kind, lfModifier *modifier)
+{
+    const TraceSpan span("descriptor fit");
+    const float w = static_cast<float>(d->width - 1);
+    const float h = static_cast<float>(d->height - 1);
+    std::vector<Probe> probes;
+    const float xs[] = {0.0f, 0.5f * w, w};
+    const float ys[] = {0.0f, 0.5f * h, h};
+    for (float y : ys)
+    {
+        for (float x : xs)
+        {
+            probes.push_back(Probe{x, y, {}});
+        }
+    }
+    const float far_x = d->cx < 0.5f * w ? w : 0.0f;
+    const float far_y = d->cy < 0.5f * h ? h : 0.0f;
+    for (int i = 1; i <= kDiagonalProbes; ++i)
+    {
+        const float t = static_cast<float>(i) / kDiagonalProbes;
+        probes.push_back(Probe{d->cx + (far_x - d->cx) * t, d->cy + (far_y - d->cy) * t, {}});
+    }
+    for (Probe &probe : probes)
+    {
+        if (!lensfun_point(modifier, kind, probe.x, probe.y, probe.expected))
+        {
+            return -6;
+        }
+    }
+
+    DescriptorComponent &c = component(d, kind);
+    const double guess = 2.0 / hypot(static_cast<double>(w) + 1.0, static_cast<double>(h) + 1.0);
+    const double span_log = log(kScanRange);
+    auto error_at = [&](double log_scale) {
+        c.scale = static_cast<float>(guess * exp(log_scale));
+        return probe_error(*d, kind, probes);
+    };
+
+    int best = 0;
+    double best_error = HUGE_VAL;
+    const double delta = 2.0 * span_log / (kScanSteps - 1);
+    for (int i = 0; i < kScanSteps; ++i)
+    {
+        const double error = error_at(-span_log + i * delta);
+        if (error < best_error)
+        {
+            best_error = error;
+            best = i;
+        }
+    }
+    double lo = -span_log + (best - 1) * delta;
+    double hi = -span_log + (best + 1) * delta;
+    const double ratio = 0.5 * (sqrt(5.0) - 1.0);
+    double a = hi - ratio * (hi - lo);
+    double b = lo + ratio * (hi - lo);
+    double fa = error_at(a);
+    double fb = error_at(b);
+    for (int i = 0; i < kRefineSteps; ++i)
+    {
+        if (fa <= fb)
+        {
+            hi = b;
+            b = a;
+            fb = fa;
+            a = hi - ratio * (hi - lo);
+            fa = error_at(a);
+        }
+        else
+        {
+            lo = a;
+            a = b;
+            fa = fb;
+            b = lo + ratio * (hi - lo);
+            fb = error_at(b);
+        }
+    }
+    double best_log = -span_log + best * delta;
+    if (std::min(fa, fb) < best_error)
+    {
+        best_log = fa <= fb ? a : b;
+    }
+    c.scale = static_cast<float>(guess * exp(best_log));
+
+    const double bound =
+        kind == MapKind::Vignetting ? RadialTable::kMaxGainResidual : RadialTable::kMaxGeometryResidual;
+    for (int j = 0; j < kChecks; ++j)
+    {
+        for (int i = 0; i < kChecks; ++i)
+        {
+            const float x = static_cast<float>(i) * w / (kChecks - 1);
+            const float y = static_cast<float>(j) * h / (kChecks - 1);
+            float expected[6];
+            float got[6];
+            if (!lensfun_point(modifier, kind, x, y, expected))
+            {
+                return -6;
+            }
+            evaluate_descriptor_points(*d, static_cast<int>(kind), &x, 1, y, got);
+            if (!(point_error(kind, got, expected) <= bound))
+            {
+                return -6;
+            }
+        }
+    }
+    return 0;
+}
+
+bool set_distortion(const lfLensCalibDistortion &calib, DescriptorComponent *out)
+{
+    const float *t = calib.Terms;
+    switch (calib.Model)
+    {
+    case LF_DIST_MODEL_POLY3:
+        out->model = static_cast<int>(DistortionModel::Poly3);
+        out->terms[0] = t[0];
+        return true;
+    case LF_DIST_MODEL_POLY5:
+        out->model = static_cast<int>(DistortionModel::Poly5);
+        std::copy(t, t + 2, out->terms);
+        return true;
+    case LF_DIST_MODEL_PTLENS:
+        out->model = static_cast<int>(DistortionModel::PtLens);
+        std::copy(t, t + 3, out->terms);
+        return true;
+    case LF_DIST_MODEL_ACM:
+        out->model = static_cast<int>(DistortionModel::Acm);
+        std::copy(t, t + 3, out->terms);
+        return t[3] == 0.0f && t[4] == 0.0f;
+    default:
+        return false;
+    }
+}
+
+bool set_tca(const lfLensCalibTCA &calib, DescriptorComponent *out)
+{
+    switch (calib.Model)
+    {
+    case LF_TCA_MODEL_LINEAR:
+        out->model = static_cast<int>(TcaModel::Linear);
+        std::copy(calib.Terms, calib.Terms + 2, out->terms);
+        return true;
+    case LF_TCA_MODEL_POLY3:
+        out->model = static_cast<int>(TcaModel::Poly3);
+        std::copy(calib.Terms, calib.Terms + 6, out->terms);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool set_vignetting(const lfLensCalibVignetting &calib, DescriptorComponent *out)
+{
+    switch (calib.Model)
+    {
+    case LF_VIGNETTING_MODEL_PA:
+        out->model = static_cast<int>(VignettingModel::Pa);
+        break;
+    case LF_VIGNETTING_MODEL_ACM:
+        out->model = static_cast<int>(VignettingModel::Acm);
+        break;
+    default:
+        return false;
+    }
+    std::copy(calib.Terms, calib.Terms + 3, out->terms);
+    return true;
+}
+} // namespace
+
+int32_t describe_correction(const MapRequest &request, CalibrationCache &cache, CorrectionDescriptor *out)
+{
+    const MapRequest &r = request;
+    if (!r.lens || r.width <= 0 || r.height <= 0)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("describe correction");
+    CorrectionDescriptor d;
+    d.width = r.width;
+    d.height = r.height;
+    d.crop = r.crop;
+    d.focal = r.focal;
+    d.reverse = r.reverse;
+    d.cx = 0.5f * (r.width - 1);
+    d.cy = 0.5f * (r.height - 1);
+
+    // The distortion goes first: its displacement field gives the centre
+    // the other corrections share.
+    lfLensCalibDistortion distortion;
+    if (cache.distortion(r.lens, r.crop, r.focal, &distortion) && distortion.Model != LF_DIST_MODEL_NONE)
+    {
+        const ScopedModifier modifier(r);
+        if (!modifier.get())
+        {
+            return -3;
+        }
+        if (!set_distortion(distortion, &d.distortion) ||
+            !(enable_distortion(modifier.get(), cache, r.lens, r.crop, r.focal) & LF_MODIFY_DISTORTION) ||
+            !find_radial_centre(modifier.get(), r.width, r.height, &d.cx, &d.cy))
+        {
+            return -6;
+        }
+        const int32_t rc = fit_scale(&d, MapKind::Geometry, modifier.get());
+        if (rc != 0)
+        {
+            return rc;
+        }
+    }
+
+    lfLensCalibTCA tca;
+    if (cache.tca(r.lens, r.crop, r.focal, &tca) && tca.Model != LF_TCA_MODEL_NONE)
+    {
+        const ScopedModifier modifier(r);
+        if (!modifier.get())
+        {
+            return -3;
+        }
+        if (!set_tca(tca, &d.tca) || !(enable_tca(modifier.get(), cache, r.lens, r.crop, r.focal) & LF_MODIFY_TCA))
+        {
+            return -6;
+        }
+        const int32_t rc = fit_scale(&d, MapKind::Tca, modifier.get());
+        if (rc != 0)
+        {
+            return rc;
+        }
+    }
+
+    lfLensCalibVignetting vignetting;
+    if (r.aperture > 0.0f && cache.vignetting(r.lens, r.crop, r.focal, r.aperture, r.distance, &vignetting) &&
+        vignetting.Model != LF_VIGNETTING_MODEL_NONE)
+    {
+        const ScopedModifier modifier(r);
+        if (!modifier.get())
+        {
+            return -3;
+        }
+        if (!set_vignetting(vignetting, &d.vignetting) ||
+            !(enable_vignetting(modifier.get(), cache, r.lens, r.crop, r.focal, r.aperture, r.distance) &
+              LF_MODIFY_VIGNETTING))
+        {
+            return -6;
+        }
+        const int32_t rc = fit_scale(&d, MapKind::Vignetting, modifier.get());
+        if (rc != 0)
+        {
+            return rc;
+        }
+    }
+
+    *out = d;
+    return 0;
+}
+} // namespace lfw
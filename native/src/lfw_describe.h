@@ -0,0 +1,26 @@
+#ifndef LFW_DESCRIBE_H
+#define LFW_DESCRIBE_H
+
+#include "lfw_calibration.h"
+#include "lfw_descriptor.h"
+#include "lfw_maps.h"
+
+#include <stdint.h>
+
+namespace lfw
+{
+// Resolves the descriptor of `request` (kind and step are ignored; vignetting
+// is left out when the aperture is not positive). The model terms are the
+// cached interpolated calibrations. The centre comes from the distortion's
+// displacement field and each correction's scale is fitted to lensfun's own
+// output, since lensfun's normalization is not part of its API. Every
+// correction is then checked against lensfun on a 33x33 grid within the
+// RadialTable bounds.
+//
+// Returns 0, -1 for a bad request, -3 when lensfun has no modifier, or -6
+// when a calibration of the lens can not be described within those bounds
+// (e.g. ACM tangential terms or an ACM TCA model).
+int32_t describe_correction(const MapRequest &request, CalibrationCache &cache, CorrectionDescriptor *out);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,294 @@
+#include "lfw_descriptor.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace lfw
+{
+namespace
+{
+constexpr int kGeometry = 0;
+constexpr int kTca = 1;
+constexpr int kVignetting = 2;
+
+// Newton steps of the reverse solve; the models are smooth and start next to
+// the root, so this is far below float precision.
+constexpr int kNewtonSteps = 8;
+
+// Every radial model of the descriptor as the ratio of moved to original
+// radius, g(r) = c0 + c1 r + c2 r^2 + c3 r^3 + c4 r^4 + c6 r^6 in the
+// normalized radius r, so one loop serves all of them.
+struct Radial
+{
+    float c[7] = {};
+
+    float ratio(float r) const
+    {
+        const float r2 = r * r;
+        return c[0] + r * (c[1] + r * (c[2] + r * (c[3] + r * c[4]))) + c[6] * r2 * r2 * r2;
+    }
+
+    // d(r g(r)) / dr
+    float slope(float r) const
+    {
+        const float r2 = r * r;
+        return c[0] + r * (2.0f * c[1] + r * (3.0f * c[2] + r * (4.0f * c[3] + r * 5.0f * c[4]))) +
+               7.0f * c[6] * r2 * r2 * r2;
+    }
+
+    // Ratio of original to moved radius at moved radius `rd`.
+    float inverse_ratio(float rd) const
+    {
+        float ru = rd;
+        for (int i = 0; i < kNewtonSteps; ++i)
+        {
+            const float s = slope(ru);
+            ru -= (ru * ratio(ru) - rd) / (fabsf(s) > 1e-6f ? s : 1e-6f);
+        }
+        return rd > 0.0f ? ru / rd : 1.0f / c[0];
+    }
+};
+
+Radial distortion_radial(const DescriptorComponent &component)
+{
+    Radial p;
+    const float *t = component.terms;
+    switch (static_cast<DistortionModel>(component.model))
+    {
+    case DistortionModel::Poly3:
+        p.c[0] = 1.0f - t[0];
+        p.c[2] = t[0];
+        break;
+    case DistortionModel::Poly5:
+        p.c[0] = 1.0f;
+        p.c[2] = t[0];
+        p.c[4] = t[1];
+        break;
+    case DistortionModel::PtLens:
+        p.c[0] = 1.0f - t[0] - t[1] - t[2];
+        p.c[1] = t[2];
+        p.c[2] = t[1];
+        p.c[3] = t[0];
+        break;
+    default:
+        p.c[0] = 1.0f;
+        p.c[2] = t[0];
+        p.c[4] = t[1];
+        p.c[6] = t[2];
+        break;
+    }
+    return p;
+}
+
+// Channel 0 is red, 1 is blue.
+Radial tca_radial(const DescriptorComponent &component, int channel)
+{
+    Radial p;
+    const float *t = component.terms;
+    p.c[0] = t[channel];
+    if (static_cast<TcaModel>(component.model) == TcaModel::Poly3)
+    {
+        p.c[1] = t[2 + channel];
+        p.c[2] = t[4 + channel];
+    }
+    return p;
+}
+
+// Moves the points (xs[i], y) radially by `p`, writing x/y pairs every
+// `stride` floats.
+void radial_points(
+    const Radial &p,
+    bool reverse,
+    float cx,
+    float cy,
+    float scale,
+    const float *xs,
+    int count,
+    float y,
+    int stride,
+    float *out)
+{
+    const float dy = y - cy;
+    for (int i = 0; i < count; ++i)
+    {
+        const float dx = xs[i] - cx;
+        const float r = sqrtf(dx * dx + dy * dy) * scale;
+        const float k = reverse ? p.inverse_ratio(r) : p.ratio(r);
+        out[i * stride] = cx + dx * k;
+        out[i * stride + 1] = cy + dy * k;
+    }
+}
+
+void vignetting_points(const CorrectionDescriptor &d, const float *xs, int count, float y, float *out)
+{
+    const float *t = d.vignetting.terms;
+    const float scale2 = d.vignetting.scale * d.vignetting.scale;
+    const float dy = y - d.cy;
+    for (int i = 0; i < count; ++i)
+    {
+        const float dx = xs[i] - d.cx;
+        const float r2 = (dx * dx + dy * dy) * scale2;
+        const float v = 1.0f + r2 * (t[0] + r2 * (t[1] + r2 * t[2]));
+        const float gain = d.reverse ? v : 1.0f / v;
+        out[3 * i] = gain;
+        out[3 * i + 1] = gain;
+        out[3 * i + 2] = gain;
+    }
+}
+
+float sample_coord(int index, int step, int bound)
+{
+    const int value = index * step;
+    const int clamped = std::min(value, std::max(bound - 1, 0));
+    return static_cast<float>(clamped);
+}
+
+bool finite(float value)
+{
+    return value == value && fabsf(value) <= 3.0e38f;
+}
+} // namespace
+
+void pack_descriptor(const CorrectionDescriptor &d, float *out)
+{
+    std::fill(out, out + kDescriptorFloats, 0.0f);
+    out[0] = static_cast<float>(kDescriptorVersion);
+    out[1] = static_cast<float>(d.width);
+    out[2] = static_cast<float>(d.height);
+    out[3] = d.crop;
+    out[4] = d.focal;
+    out[5] = d.reverse ? 1.0f : 0.0f;
+    out[6] = d.cx;
+    out[7] = d.cy;
+    const DescriptorComponent *components[] = {&d.distortion, &d.tca, &d.vignetting};
+    const int offsets[] = {8, 13, 21};
+    const int terms[] = {3, 6, 3};
+    for (int i = 0; i < 3; ++i)
+    {
+        float *block = out + offsets[i];
+        block[0] = static_cast<float>(components[i]->model);
+        block[1] = components[i]->scale;
+        std::copy(components[i]->terms, components[i]->terms + terms[i], block + 2);
+    }
+}
+
+bool unpack_descriptor(const float *data, int32_t len, CorrectionDescriptor *out)
+{
+    if (!data || len < kDescriptorFloats || data[0] != static_cast<float>(kDescriptorVersion))
+    {
+        return false;
+    }
+    for (int i = 0; i < kDescriptorFloats; ++i)
+    {
+        if (!finite(data[i]))
+        {
+            return false;
+        }
+    }
+    if (!(data[1] >= 1.0f && data[1] <= 1.0e8f) || !(data[2] >= 1.0f && data[2] <= 1.0e8f))
+    {
+        return false;
+    }
+
+    CorrectionDescriptor d;
+    d.width = static_cast<int>(data[1]);
+    d.height = static_cast<int>(data[2]);
+    d.crop = data[3];
+    d.focal = data[4];
+    d.reverse = data[5] != 0.0f;
+    d.cx = data[6];
+    d.cy = data[7];
+    DescriptorComponent *components[] = {&d.distortion, &d.tca, &d.vignetting};
+    const int offsets[] = {8, 13, 21};
+    const int terms[] = {3, 6, 3};
+    const int model_counts[] = {
+        static_cast<int>(DistortionModel::Count),
+        static_cast<int>(TcaModel::Count),
+        static_cast<int>(VignettingModel::Count)};
+    for (int i = 0; i < 3; ++i)
+    {
+        const float *block = data + offsets[i];
+        const int model = static_cast<int>(block[0]);
+        if (static_cast<float>(model) != block[0] || model < 0 || model >= model_counts[i] || !(block[1] > 0.0f))
+        {
+            return false;
+        }
+        components[i]->model = model;
+        components[i]->scale = block[1];
+        std::copy(block + 2, block + 2 + terms[i], components[i]->terms);
+    }
+    *out = d;
+    return true;
+}
+
+bool descriptor_has(const CorrectionDescriptor &d, int kind)
+{
+    switch (kind)
+    {
+    case kGeometry:
+        return d.distortion.model != 0;
+    case kTca:
+        return d.tca.model != 0;
+    case kVignetting:
+        return d.vignetting.model != 0;
+    default:
+        return false;
+    }
+}
+
+void evaluate_descriptor_points(
+    const CorrectionDescriptor &d,
+    int kind,
+    const float *xs,
+    int count,
+    float y,
+    float *out)
+{
+    switch (kind)
+    {
+    case kGeometry:
+        radial_points(distortion_radial(d.distortion), d.reverse, d.cx, d.cy, d.distortion.scale, xs, count, y, 2, out);
+        break;
+    case kTca:
+        radial_points(tca_radial(d.tca, 0), d.reverse, d.cx, d.cy, d.tca.scale, xs, count, y, 6, out);
+        for (int i = 0; i < count; ++i)
+        {
+            out[6 * i + 2] = xs[i];
+            out[6 * i + 3] = y;
+        }
+        radial_points(tca_radial(d.tca, 1), d.reverse, d.cx, d.cy, d.tca.scale, xs, count, y, 6, out + 4);
+        break;
+    default:
+        vignetting_points(d, xs, count, y, out);
+        break;
+    }
+}
+
+int32_t evaluate_descriptor_rows(const CorrectionDescriptor &d, int kind, int step, int y0, int y1, float *out)
+{
+    if (kind < kGeometry || kind > kVignetting || step <= 0)
+    {
+        return -1;
+    }
+    if (!descriptor_has(d, kind))
+    {
+        return -4;
+    }
+
+    const int grid_width = (d.width - 1) / step + 1;
+    const int channels = kind == kGeometry ? 2 : kind == kTca ? 6 : 3;
+    std::vector<float> xs(grid_width);
+    for (int x = 0; x < grid_width; ++x)
+    {
+        xs[x] = sample_coord(x, step, d.width);
+    }
+    for (int y = y0; y < y1; ++y)
+    {
+        evaluate_descriptor_points(d, kind, xs.data(), grid_width, sample_coord(y, step, d.height), out);
+        out += static_cast<size_t>(grid_width) * channels;
+    }
+    return 0;
+}
+} // namespace lfw
@@ -0,0 +1,102 @@
+#ifndef LFW_DESCRIPTOR_H
+#define LFW_DESCRIPTOR_H
+
+#include <stdint.h>
+
+namespace lfw
+{
+// The resolved correction of one lens at one focal, crop, aperture, distance
+// and image size: the model of each correction, its interpolated terms, the
+// scale from pixels to the model's normalized radius and the optical centre.
+// Packed, it is kDescriptorFloats floats:
+//
+//   0 version, 1 width, 2 height, 3 crop, 4 focal, 5 reverse,
+//   6 centre x, 7 centre y,
+//   8 distortion model, 9 scale, 10..12 terms,
+//   13 tca model, 14 scale, 15..20 terms,
+//   21 vignetting model, 22 scale, 23..25 terms.
+//
+// A model of 0 means the correction is not available. This header and its
+// source do not use lensfun, so the evaluator can be built on its own and a
+// stored descriptor replayed without a lens database.
+constexpr int kDescriptorVersion = 1;
+constexpr int kDescriptorFloats = 26;
+
+// Terms: k1 (poly3), k1 k2 (poly5), a b c (ptlens) or k1 k2 k3 (acm, radial
+// part only).
+enum class DistortionModel
+{
+    None,
+    Poly3,
+    Poly5,
+    PtLens,
+    Acm,
+    Count
+};
+
+// Terms: kr kb (linear) or vr vb cr cb br bb (poly3).
+enum class TcaModel
+{
+    None,
+    Linear,
+    Poly3,
+    Count
+};
+
+// Terms: k1 k2 k3 of the gain polynomial in r^2.
+enum class VignettingModel
+{
+    None,
+    Pa,
+    Acm,
+    Count
+};
+
+struct DescriptorComponent
+{
+    int model = 0;
+    float scale = 1.0f;
+    float terms[6] = {};
+};
+
+struct CorrectionDescriptor
+{
+    int width = 0;
+    int height = 0;
+    float crop = 0.0f;
+    float focal = 0.0f;
+    bool reverse = false;
+    float cx = 0.0f;
+    float cy = 0.0f;
+    DescriptorComponent distortion;
+    DescriptorComponent tca;
+    DescriptorComponent vignetting;
+};
+
+void pack_descriptor(const CorrectionDescriptor &descriptor, float *out);
+// False for another version, a short buffer or out-of-range fields.
+bool unpack_descriptor(const float *data, int32_t len, CorrectionDescriptor *out);
+
+// Map kinds use the lfw_map_stream_create numbering: 0 geometry, 1 TCA,
+// 2 vignetting. Returns false when the descriptor has no such correction.
+bool descriptor_has(const CorrectionDescriptor &descriptor, int kind);
+
+// Evaluates `count` points of map `kind` at (xs[i], y) in the lfw_build_*_map
+// layout. Every model is evaluated in one branch-free loop per row, so the
+// compiler can vectorize it.
+void evaluate_descriptor_points(
+    const CorrectionDescriptor &descriptor,
+    int kind,
+    const float *xs,
+    int count,
+    float y,
+    float *out);
+
+// Writes grid rows [y0, y1) of map `kind` sampled every `step` pixels, like
+// MapBuilder::fill_rows. Returns 0, -1 for a bad kind or step, or -4 when the
+// descriptor lacks the correction (the lfw_build_*_map code for lensfun
+// rejecting it).
+int32_t evaluate_descriptor_rows(const CorrectionDescriptor &descriptor, int kind, int step, int y0, int y1, float *out);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,230 @@
+#include "lfw_fixed.h"
+
+#include "lfw_handles.h"
+#include "lfw_trace.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<FixedMap> g_fixed_maps;
+
+// Offsets are first taken with this many fractional bits, then narrowed to
+// what fits an int16.
+constexpr int kMaxFractionBits = 8;
+constexpr int32_t kWideOutside = INT32_MIN;
+constexpr int kBandRows = 32;
+// Largest image side; an offset of a whole side must fit an int16.
+constexpr int kMaxSide = 32767;
+
+// Pixels are loaded as little-endian words (wasm, x86 and ARM all are), so
+// red is the low byte and alpha the high one.
+uint32_t load_pixel(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// a + (b - a) * f / 256 for all four bytes at once: red/blue and green/alpha
+// each fit two 16-bit lanes of a word.
+uint32_t lerp_pixel(uint32_t a, uint32_t b, uint32_t f)
+{
+    const uint32_t g = 256 - f;
+    const uint32_t rb = ((((a & 0x00FF00FFu) * g + (b & 0x00FF00FFu) * f + 0x00800080u) >> 8) & 0x00FF00FFu);
+    const uint32_t ga = ((((a >> 8) & 0x00FF00FFu) * g + ((b >> 8) & 0x00FF00FFu) * f + 0x00800080u) & 0xFF00FF00u);
+    return rb | ga;
+}
+
+class Sampler
+{
+public:
+    Sampler(const uint8_t *src, int width, int height, int fraction_bits)
+        : src_(src),
+          row_bytes_(static_cast<size_t>(width) * 4),
+          width_(width),
+          height_(height),
+          bits_(fraction_bits),
+          mask_((1 << fraction_bits) - 1),
+          max_x_((width - 1) << fraction_bits),
+          max_y_((height - 1) << fraction_bits)
+    {
+    }
+
+    // Bilinear sample at (x, y) + offset, in fixed point.
+    uint32_t sample(int x, int y, const int16_t *offset) const
+    {
+        // Rounding the offsets can step a fraction past the border.
+        const int32_t sx = std::min(std::max((x << bits_) + offset[0], 0), max_x_);
+        const int32_t sy = std::min(std::max((y << bits_) + offset[1], 0), max_y_);
+        const int ix = sx >> bits_;
+        const int iy = sy >> bits_;
+        const uint32_t fx = static_cast<uint32_t>(sx & mask_) << (kMaxFractionBits - bits_);
+        const uint32_t fy = static_cast<uint32_t>(sy & mask_) << (kMaxFractionBits - bits_);
+        const uint8_t *p0 = src_ + row_bytes_ * iy + static_cast<size_t>(ix) * 4;
+        const uint8_t *p1 = iy + 1 < height_ ? p0 + row_bytes_ : p0;
+        const size_t right = ix + 1 < width_ ? 4 : 0;
+        const uint32_t top = lerp_pixel(load_pixel(p0), load_pixel(p0 + right), fx);
+        const uint32_t bottom = lerp_pixel(load_pixel(p1), load_pixel(p1 + right), fx);
+        return lerp_pixel(top, bottom, fy);
+    }
+
+private:
+    const uint8_t *src_;
+    size_t row_bytes_;
+    int width_;
+    int height_;
+    int bits_;
+    int32_t mask_;
+    int32_t max_x_;
+    int32_t max_y_;
+};
+} // namespace
+
+FixedMap::FixedMap(const FixedMapRequest &request, std::shared_ptr<Database> db)
+    : request_(request),
+      db_(std::move(db))
+{
+}
+
+int32_t FixedMap::init()
+{
+    MapRequest map = request_.map;
+    if ((map.kind != MapKind::Geometry && map.kind != MapKind::Tca) || map.width <= 0 || map.height <= 0 ||
+        map.width > kMaxSide || map.height > kMaxSide)
+    {
+        return -1;
+    }
+    map.step = 1;
+
+    const TraceSpan span("fixed map");
+    MapBuilder builder(map, db_);
+    int32_t rc = builder.init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    // Offsets with kMaxFractionBits first, tracking the largest.
+    const int channels = map_channels(map.kind);
+    const size_t row_floats = builder.row_floats();
+    std::vector<float> band(row_floats * kBandRows);
+    std::vector<int32_t> wide(row_floats * map.height);
+    const float scale = static_cast<float>(1 << kMaxFractionBits);
+    const float max_x = static_cast<float>(map.width - 1);
+    const float max_y = static_cast<float>(map.height - 1);
+    int32_t largest = 0;
+    for (int y0 = 0; y0 < map.height; y0 += kBandRows)
+    {
+        const int y1 = std::min(y0 + kBandRows, map.height);
+        rc = builder.fill_rows(y0, y1, band.data());
+        if (rc != 0)
+        {
+            return rc;
+        }
+        for (int y = y0; y < y1; ++y)
+        {
+            const float *in = band.data() + row_floats * (y - y0);
+            int32_t *out = wide.data() + row_floats * y;
+            for (int x = 0; x < map.width; ++x)
+            {
+                for (int c = 0; c < channels; c += 2)
+                {
+                    const float sx = in[x * channels + c];
+                    const float sy = in[x * channels + c + 1];
+                    int32_t *pair = out + x * channels + c;
+                    // Written so that NaN counts as outside.
+                    if (!(sx >= 0.0f && sx <= max_x && sy >= 0.0f && sy <= max_y))
+                    {
+                        pair[0] = kWideOutside;
+                        pair[1] = kWideOutside;
+                        continue;
+                    }
+                    pair[0] = static_cast<int32_t>(lrintf((sx - static_cast<float>(x)) * scale));
+                    pair[1] = static_cast<int32_t>(lrintf((sy - static_cast<float>(y)) * scale));
+                    largest = std::max(largest, std::max(std::abs(pair[0]), std::abs(pair[1])));
+                }
+            }
+        }
+    }
+
+    // As many fractional bits as leave the largest offset inside an int16,
+    // whose lowest value is the outside marker.
+    int shift = 0;
+    while (((largest + (1 << shift >> 1)) >> shift) > INT16_MAX)
+    {
+        ++shift;
+    }
+    fraction_bits_ = kMaxFractionBits - shift;
+    offsets_.resize(wide.size());
+    const int32_t half = shift > 0 ? 1 << (shift - 1) : 0;
+    for (size_t i = 0; i < wide.size(); ++i)
+    {
+        offsets_[i] = wide[i] == kWideOutside ? kOutside : static_cast<int16_t>((wide[i] + half) >> shift);
+    }
+    db_.reset();
+    return 0;
+}
+
+int32_t FixedMap::remap(const uint8_t *src, uint8_t *dst, int y0, int y1) const
+{
+    const int w = width();
+    const int h = height();
+    if (offsets_.empty() || !src || !dst || y0 < 0 || y1 > h || y0 > y1)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("fixed remap");
+    const Sampler sampler(src, w, h, fraction_bits_);
+    const int channels = map_channels(kind());
+    const size_t row_bytes = static_cast<size_t>(w) * 4;
+    for (int y = y0; y < y1; ++y)
+    {
+        const int16_t *offset = offsets_.data() + static_cast<size_t>(y) * w * channels;
+        uint8_t *out = dst + row_bytes * y;
+        if (kind() == MapKind::Geometry)
+        {
+            for (int x = 0; x < w; ++x, offset += 2, out += 4)
+            {
+                const uint32_t pixel = offset[0] == kOutside ? 0 : sampler.sample(x, y, offset);
+                memcpy(out, &pixel, sizeof(pixel));
+            }
+            continue;
+        }
+        // With TCA, red and blue come from their own positions; alpha
+        // follows green.
+        for (int x = 0; x < w; ++x, offset += 6, out += 4)
+        {
+            const uint32_t red = offset[0] == kOutside ? 0 : sampler.sample(x, y, offset);
+            const uint32_t green = offset[2] == kOutside ? 0 : sampler.sample(x, y, offset + 2);
+            const uint32_t blue = offset[4] == kOutside ? 0 : sampler.sample(x, y, offset + 4);
+            const uint32_t pixel = (red & 0x000000FFu) | (green & 0xFF00FF00u) | (blue & 0x00FF0000u);
+            memcpy(out, &pixel, sizeof(pixel));
+        }
+    }
+    return 0;
+}
+
+uint32_t register_fixed_map(std::unique_ptr<FixedMap> map)
+{
+    return g_fixed_maps.add(std::move(map));
+}
+
+FixedMap *find_fixed_map(uint32_t handle)
+{
+    return g_fixed_maps.find(handle);
+}
+
+bool destroy_fixed_map(uint32_t handle)
+{
+    return g_fixed_maps.remove(handle);
+}
+} // namespace lfw
@@ -0,0 +1,84 @@
+#ifndef LFW_FIXED_H
+#define LFW_FIXED_H
+
+#include "lfw_maps.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+struct FixedMapRequest
+{
+    // Geometry or TCA; `map.step` is ignored, the map has a point per pixel.
+    MapRequest map;
+};
+
+// A geometry or TCA map in fixed point for remapping 8-bit RGBA images.
+// Each coordinate is stored as an int16 offset from the pixel's own
+// position, with as many fractional bits (at most 8) as the largest offset
+// leaves room for, so the map takes half the memory of the float map and
+// the fraction gives the 8-bit bilinear weights directly. Points outside the
+// image hold kOutside.
+//
+// Remapping is integer arithmetic only: the red/blue and green/alpha bytes
+// of a pixel are interpolated as two 16-bit lanes of one 32-bit word. Rows
+// can be remapped in any order and from several threads at once.
+class FixedMap
+{
+public:
+    static constexpr int16_t kOutside = INT16_MIN;
+
+    FixedMap(const FixedMapRequest &request, std::shared_ptr<Database> db);
+
+    FixedMap(const FixedMap &) = delete;
+    FixedMap &operator=(const FixedMap &) = delete;
+
+    // Builds the map and releases the database. Returns 0, -1 for a bad
+    // request or a map builder code.
+    int32_t init();
+
+    MapKind kind() const
+    {
+        return request_.map.kind;
+    }
+    int width() const
+    {
+        return request_.map.width;
+    }
+    int height() const
+    {
+        return request_.map.height;
+    }
+    int fraction_bits() const
+    {
+        return fraction_bits_;
+    }
+    size_t bytes() const
+    {
+        return offsets_.size() * sizeof(int16_t);
+    }
+
+    // Remaps output rows [y0, y1) of `src` into `dst`; both are width x
+    // height RGBA8 images of `width * 4` bytes per row. Pixels that map
+    // outside the image are written as 0. Returns 0 or -1 for bad rows.
+    int32_t remap(const uint8_t *src, uint8_t *dst, int y0, int y1) const;
+
+private:
+    FixedMapRequest request_;
+    std::shared_ptr<Database> db_;
+    int fraction_bits_ = 0;
+    // Row-major, one x/y pair per pixel, or three with TCA.
+    std::vector<int16_t> offsets_;
+};
+
+// Maps handed out by lfw_fixed_map_create.
+uint32_t register_fixed_map(std::unique_ptr<FixedMap> map);
+FixedMap *find_fixed_map(uint32_t handle);
+bool destroy_fixed_map(uint32_t handle);
+} // namespace lfw
+
+#endif
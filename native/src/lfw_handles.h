@@ -0,0 +1,59 @@
+#ifndef LFW_HANDLES_H
+#define LFW_HANDLES_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace lfw
+{
+// Owns objects handed out to callers as small integer handles, like context
+// handles; 0 is never used. Lookups are locked, the objects are not: each
+// one must only be used by one thread at a time.
+template <typename T>
+class HandleRegistry
+{
+public:
+    uint32_t add(std::unique_ptr<T> object)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint32_t handle = next_++;
+        objects_.emplace(handle, std::move(object));
+        return handle;
+    }
+
+    T *find(uint32_t handle) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto found = objects_.find(handle);
+        return found != objects_.end() ? found->second.get() : nullptr;
+    }
+
+    // The object is destroyed outside the lock.
+    bool remove(uint32_t handle)
+    {
+        std::unique_ptr<T> object;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto found = objects_.find(handle);
+            if (found == objects_.end())
+            {
+                return false;
+            }
+            object = std::move(found->second);
+            objects_.erase(found);
+        }
+        return true;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, std::unique_ptr<T>> objects_;
+    uint32_t next_ = 1;
+};
+} // namespace lfw
+
+#endif
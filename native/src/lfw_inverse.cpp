@@ -0,0 +1,99 @@
+#include "lfw_inverse.h"
+
+#include "lfw_radial.h"
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace lfw
+{
+std::unique_ptr<RadialInverse> RadialInverse::build(lfModifier *forward, lfModifier *reverse, int width, int height)
+{
+    const TraceSpan span("reverse table");
+    std::unique_ptr<RadialInverse> table(new RadialInverse());
+    float cx = 0.0f;
+    float cy = 0.0f;
+    if (!find_radial_centre(forward, width, height, &cx, &cy))
+    {
+        return nullptr;
+    }
+    table->cx_ = cx;
+    table->cy_ = cy;
+
+    double max_rd = 0.0;
+    const float corners[][2] = {
+        {0.0f, 0.0f},
+        {static_cast<float>(width - 1), 0.0f},
+        {0.0f, static_cast<float>(height - 1)},
+        {static_cast<float>(width - 1), static_cast<float>(height - 1)}};
+    for (const auto &corner : corners)
+    {
+        max_rd = std::max(max_rd, hypot(static_cast<double>(corner[0]) - cx, static_cast<double>(corner[1]) - cy));
+    }
+
+    // Forward radius of undistorted radius k, one pixel apart along +x. Three
+    // times the image radius covers any distortion lensfun can invert.
+    const int samples = static_cast<int>(ceil(3.0 * max_rd)) + 2;
+    std::vector<float> forward_row(static_cast<size_t>(samples) * 2);
+    if (!lf_modifier_apply_geometry_distortion(forward, cx, cy, samples, 1, forward_row.data()))
+    {
+        return nullptr;
+    }
+    std::vector<double> fr(samples);
+    for (int k = 0; k < samples; ++k)
+    {
+        fr[k] = static_cast<double>(forward_row[2 * k]) - cx;
+    }
+
+    const int entries = static_cast<int>(ceil(max_rd * kSamplesPerPixel)) + 2;
+    table->radii_.resize(entries);
+    int k = 0;
+    for (int j = 0; j < entries; ++j)
+    {
+        const double rd = j / static_cast<double>(kSamplesPerPixel);
+        while (k + 2 < samples && fr[k + 1] < rd)
+        {
+            if (!(fr[k + 1] > fr[k]))
+            {
+                return nullptr;
+            }
+            ++k;
+        }
+        if (!(fr[k + 1] > fr[k]) || (k + 2 == samples && fr[k + 1] < rd))
+        {
+            return nullptr;
+        }
+        table->radii_[j] = static_cast<float>(k + (rd - fr[k]) / (fr[k + 1] - fr[k]));
+    }
+    table->centre_scale_ = static_cast<float>(1.0 / (fr[1] - fr[0]));
+
+    // Compare with lensfun's own inversion.
+    constexpr int kChecks = 33;
+    double residual = 0.0;
+    for (int j = 0; j < kChecks; ++j)
+    {
+        for (int i = 0; i < kChecks; ++i)
+        {
+            const float x = static_cast<float>(i) * (width - 1) / (kChecks - 1);
+            const float y = static_cast<float>(j) * (height - 1) / (kChecks - 1);
+            float expected[2];
+            float got[2];
+            if (!lf_modifier_apply_geometry_distortion(reverse, x, y, 1, 1, expected))
+            {
+                return nullptr;
+            }
+            table->apply(x, y, got);
+            const double error = hypot(static_cast<double>(got[0]) - expected[0], static_cast<double>(got[1]) - expected[1]);
+            if (!(error <= kMaxResidual))
+            {
+                return nullptr;
+            }
+            residual = std::max(residual, error);
+        }
+    }
+    table->residual_ = residual;
+    return table;
+}
+} // namespace lfw
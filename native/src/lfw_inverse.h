@@ -0,0 +1,71 @@
+#ifndef LFW_INVERSE_H
+#define LFW_INVERSE_H
+
+#include "lensfun.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+// Inverse of a radial geometry distortion as a 1D table. All of lensfun's
+// distortion models move a point along the ray from the optical centre, so
+// the forward map is sampled once along a ray, inverted into a table of
+// undistorted radius per half pixel of distorted radius, and every reverse
+// point becomes a table lookup instead of lensfun's per-point Newton solve.
+class RadialInverse
+{
+public:
+    // Largest allowed distance from lensfun's own reverse map, in pixels.
+    static constexpr double kMaxResidual = 0.005;
+
+    // `forward` and `reverse` are modifiers of the same lens, focal, crop and
+    // size with only distortion enabled. The table is checked against
+    // `reverse` on a 33x33 grid spanning the image; null is returned when
+    // the distortion is not monotonic over the image or the residual
+    // exceeds kMaxResidual.
+    static std::unique_ptr<RadialInverse> build(lfModifier *forward, lfModifier *reverse, int width, int height);
+
+    double residual() const
+    {
+        return residual_;
+    }
+
+    // Heap held by the table, for the calibration cache's byte budget.
+    size_t bytes() const
+    {
+        return sizeof(*this) + radii_.capacity() * sizeof(float);
+    }
+
+    void apply(float x, float y, float *out) const
+    {
+        const float dx = x - cx_;
+        const float dy = y - cy_;
+        const float rd = sqrtf(dx * dx + dy * dy);
+        float t = rd * kSamplesPerPixel;
+        const float last = static_cast<float>(radii_.size() - 1);
+        t = t < last ? t : last;
+        const int i = static_cast<int>(t);
+        const int j = i + 1 < static_cast<int>(radii_.size()) ? i + 1 : i;
+        const float ru = radii_[i] + (radii_[j] - radii_[i]) * (t - static_cast<float>(i));
+        const float scale = rd > 0.0f ? ru / rd : centre_scale_;
+        out[0] = cx_ + dx * scale;
+        out[1] = cy_ + dy * scale;
+    }
+
+private:
+    static constexpr float kSamplesPerPixel = 2.0f;
+
+    float cx_ = 0.0f;
+    float cy_ = 0.0f;
+    float centre_scale_ = 1.0f;
+    // Undistorted radius at each distorted radius i / kSamplesPerPixel.
+    std::vector<float> radii_;
+    double residual_ = 0.0;
+};
+} // namespace lfw
+
+#endif
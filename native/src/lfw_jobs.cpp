@@ -0,0 +1,194 @@
+#include "lfw_jobs.h"
+
+#include "lfw_handles.h"
+#include "lfw_trace.h"
+
+#include <limits.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<MapJob> g_jobs;
+
+// Rows built between two cancellation checks: a few milliseconds of work at
+// step 1 on a large image.
+constexpr int kBandRows = 16;
+} // namespace
+
+MapJob::MapJob(const MapJobRequest &request, std::shared_ptr<Database> db)
+    : request_(request),
+      builder_(std::make_unique<MapBuilder>(request.map, db))
+{
+    if (request_.coarse_step > 0)
+    {
+        MapRequest coarse = request_.map;
+        coarse.step = request_.coarse_step;
+        coarse_builder_ = std::make_unique<MapBuilder>(coarse, std::move(db));
+    }
+}
+
+int32_t MapJob::init()
+{
+    const int step = request_.map.step;
+    if (step <= 0 || request_.coarse_step < 0 ||
+        (request_.coarse_step > 0 && (request_.coarse_step <= step || request_.coarse_step % step != 0)))
+    {
+        return -1;
+    }
+
+    int32_t rc = builder_->init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+    fine_floats_ = builder_->row_floats() * builder_->grid_height();
+    total_rows_ = builder_->grid_height();
+    stage_ = MapJobStage::Refine;
+    if (coarse_builder_)
+    {
+        rc = coarse_builder_->init();
+        if (rc != 0)
+        {
+            return rc;
+        }
+        coarse_.resize(coarse_builder_->row_floats() * coarse_builder_->grid_height());
+        total_rows_ += coarse_builder_->grid_height();
+        stage_ = MapJobStage::Coarse;
+    }
+    return 0;
+}
+
+int32_t MapJob::run(int max_rows)
+{
+    if (error_ != 0)
+    {
+        return error_;
+    }
+
+    int budget = max_rows > 0 ? max_rows : INT_MAX;
+    while (budget > 0 && stage_ != MapJobStage::Done)
+    {
+        if (cancelled_.load(std::memory_order_relaxed))
+        {
+            return fail(kCancelled);
+        }
+        const int band = std::min(budget, kBandRows);
+        const int32_t rows = stage_ == MapJobStage::Coarse ? run_coarse(band) : run_refine(band);
+        if (rows < 0)
+        {
+            return fail(rows);
+        }
+        budget -= rows;
+    }
+    return static_cast<int32_t>(stage_);
+}
+
+void MapJob::cancel()
+{
+    cancelled_.store(true, std::memory_order_relaxed);
+}
+
+int32_t MapJob::run_coarse(int rows)
+{
+    const int y1 = std::min(row_ + rows, coarse_builder_->grid_height());
+    const int32_t rc = coarse_builder_->fill_rows(row_, y1, coarse_.data() + coarse_builder_->row_floats() * row_);
+    if (rc != 0)
+    {
+        return rc;
+    }
+    const int done = y1 - row_;
+    rows_done_ += done;
+    row_ = y1;
+    if (row_ == coarse_builder_->grid_height())
+    {
+        coarse_builder_.reset();
+        stage_ = MapJobStage::Refine;
+        row_ = 0;
+    }
+    return done;
+}
+
+int32_t MapJob::run_refine(int rows)
+{
+    const TraceSpan span("map job refine");
+    if (!fine_)
+    {
+        fine_.reset(new float[fine_floats_]);
+    }
+    const int y1 = std::min(row_ + rows, builder_->grid_height());
+    const size_t row_floats = builder_->row_floats();
+    const int ratio = request_.coarse_step > 0 ? request_.coarse_step / request_.map.step : 0;
+    const int channels = map_channels(request_.map.kind);
+    const size_t coarse_row_floats =
+        ratio > 0 ? static_cast<size_t>(grid_points(request_.map.width, request_.coarse_step)) * channels : 0;
+
+    int y = row_;
+    while (y < y1)
+    {
+        float *out = fine_.get() + row_floats * y;
+        int32_t rc = 0;
+        if (ratio > 0 && y % ratio == 0)
+        {
+            // Coarse point k is point k * ratio of this row.
+            const float *coarse = coarse_.data() + coarse_row_floats * (y / ratio);
+            for (size_t k = 0; k < coarse_row_floats / channels; ++k)
+            {
+                std::copy(coarse + k * channels, coarse + (k + 1) * channels, out + k * ratio * channels);
+            }
+            rc = builder_->fill_row_gaps(y, ratio, out);
+            ++y;
+        }
+        else
+        {
+            // Rows up to the next coarse one are built whole.
+            const int next = ratio > 0 ? std::min(y1, (y / ratio + 1) * ratio) : y1;
+            rc = builder_->fill_rows(y, next, out);
+            y = next;
+        }
+        if (rc != 0)
+        {
+            return rc;
+        }
+    }
+
+    const int done = y1 - row_;
+    rows_done_ += done;
+    row_ = y1;
+    if (row_ == builder_->grid_height())
+    {
+        // Also lets the database go.
+        builder_.reset();
+        stage_ = MapJobStage::Done;
+    }
+    return done;
+}
+
+int32_t MapJob::fail(int32_t code)
+{
+    error_ = code;
+    coarse_builder_.reset();
+    builder_.reset();
+    std::vector<float>().swap(coarse_);
+    fine_.reset();
+    return code;
+}
+
+uint32_t register_map_job(std::unique_ptr<MapJob> job)
+{
+    return g_jobs.add(std::move(job));
+}
+
+MapJob *find_map_job(uint32_t handle)
+{
+    return g_jobs.find(handle);
+}
+
+bool destroy_map_job(uint32_t handle)
+{
+    return g_jobs.remove(handle);
+}
+} // namespace lfw
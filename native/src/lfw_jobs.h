@@ -0,0 +1,123 @@
+#ifndef LFW_JOBS_H
+#define LFW_JOBS_H
+
+#include "lfw_maps.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+struct MapJobRequest
+{
+    MapRequest map;
+    // Step of a first, coarse pass; 0 for none. It must be a multiple of
+    // `map.step` larger than it.
+    int coarse_step = 0;
+};
+
+enum class MapJobStage
+{
+    // Building the coarse grid.
+    Coarse,
+    // The coarse grid (if any) is ready; building the requested one.
+    Refine,
+    Done
+};
+
+// A map build that runs a budget of rows at a time and can be cancelled
+// between row bands, for maps that go stale while they are built (a focal or
+// aperture slider being dragged).
+//
+// With a coarse step the job first fills the coarse grid, which can be shown
+// while the requested grid is refined. Every coarse point is also a point of
+// the requested grid, so refining copies those and only builds the rest.
+//
+// One thread runs the job; cancel() may be called from any thread.
+class MapJob
+{
+public:
+    // Returned by run() once the job has been cancelled.
+    static constexpr int32_t kCancelled = -7;
+
+    MapJob(const MapJobRequest &request, std::shared_ptr<Database> db);
+
+    MapJob(const MapJob &) = delete;
+    MapJob &operator=(const MapJob &) = delete;
+
+    // Returns 0, -1 for a bad request or the MapBuilder::init codes.
+    int32_t init();
+
+    // Builds up to `max_rows` grid rows, or all that are left when it is 0
+    // or less, checking for cancellation before each band. Returns the stage
+    // reached, kCancelled or a MapBuilder::fill_rows code; a failed job keeps
+    // returning its code.
+    int32_t run(int max_rows);
+    void cancel();
+
+    MapKind kind() const
+    {
+        return request_.map.kind;
+    }
+    // Rows of the grid being built and how many are done, across both
+    // passes.
+    int total_rows() const
+    {
+        return total_rows_;
+    }
+    int rows_done() const
+    {
+        return rows_done_;
+    }
+    // The grids once their pass has finished, else null. A failed or
+    // cancelled job has released both.
+    const float *coarse() const
+    {
+        return error_ == 0 && stage_ != MapJobStage::Coarse && request_.coarse_step > 0 ? coarse_.data() : nullptr;
+    }
+    size_t coarse_floats() const
+    {
+        return coarse_.size();
+    }
+    const float *result() const
+    {
+        return error_ == 0 && stage_ == MapJobStage::Done ? fine_.get() : nullptr;
+    }
+    size_t result_floats() const
+    {
+        return fine_floats_;
+    }
+
+private:
+    int32_t run_coarse(int rows);
+    int32_t run_refine(int rows);
+    int32_t fail(int32_t code);
+
+    MapJobRequest request_;
+    std::unique_ptr<MapBuilder> coarse_builder_;
+    std::unique_ptr<MapBuilder> builder_;
+    std::vector<float> coarse_;
+    // Allocated when refining starts, so the coarse grid is not held up by
+    // clearing a buffer every row of which is written anyway.
+    std::unique_ptr<float[]> fine_;
+    size_t fine_floats_ = 0;
+    MapJobStage stage_ = MapJobStage::Coarse;
+    // Next row of the current pass.
+    int row_ = 0;
+    int rows_done_ = 0;
+    int total_rows_ = 0;
+    int32_t error_ = 0;
+    std::atomic<bool> cancelled_{false};
+};
+
+// Jobs handed out by lfw_map_job_create.
+uint32_t register_map_job(std::unique_ptr<MapJob> job);
+MapJob *find_map_job(uint32_t handle);
+// Must not be called while another thread is running the job.
+bool destroy_map_job(uint32_t handle);
+} // namespace lfw
+
+#endif
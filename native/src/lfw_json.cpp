@@ -0,0 +1,47 @@
+#include "lfw_json.h"
+
+namespace lfw
+{
+void append_json_escaped(std::ostringstream &out, const char *value)
+{
+    out << '"';
+    if (value)
+    {
+        for (const char *p = value; *p; ++p)
+        {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            switch (c)
+            {
+            case '\\':
+                out << "\\\\";
+                break;
+            case '"':
+                out << "\\\"";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    out << "\\u00";
+                    const char hex[] = "0123456789abcdef";
+                    out << hex[(c >> 4) & 0x0F] << hex[c & 0x0F];
+                }
+                else
+                {
+                    out << *p;
+                }
+                break;
+            }
+        }
+    }
+    out << '"';
+}
+} // namespace lfw
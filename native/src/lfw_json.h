@@ -0,0 +1,12 @@
+#ifndef LFW_JSON_H
+#define LFW_JSON_H
+
+#include <sstream>
+
+namespace lfw
+{
+// Writes `value` as a quoted JSON string; null is written as "".
+void append_json_escaped(std::ostringstream &out, const char *value);
+} // namespace lfw
+
+#endif
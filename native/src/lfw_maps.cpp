@@ -0,0 +1,273 @@
+#include "lfw_maps.h"
+
+#include "lfw_handles.h"
+#include "lfw_trace.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<MapBuilder> g_streams;
+
+const char *const kPassNames[] = {
+    "geometry pass",
+    "tca pass",
+    "vignetting pass",
+};
+
+float sample_coord(int index, int step, int bound)
+{
+    const int value = index * step;
+    const int clamped = std::min(value, std::max(bound - 1, 0));
+    return static_cast<float>(clamped);
+}
+} // namespace
+
+int map_channels(MapKind kind)
+{
+    switch (kind)
+    {
+    case MapKind::Geometry:
+        return 2;
+    case MapKind::Tca:
+        return 6;
+    case MapKind::Vignetting:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+int grid_points(int size, int step)
+{
+    if (size <= 0 || step <= 0)
+    {
+        return 0;
+    }
+    return ((size - 1) / step) + 1;
+}
+
+MapBuilder::MapBuilder(const MapRequest &request, std::shared_ptr<Database> db)
+    : request_(request),
+      db_(std::move(db)),
+      grid_width_(grid_points(request.width, request.step)),
+      grid_height_(grid_points(request.height, request.step))
+{
+}
+
+MapBuilder::~MapBuilder()
+{
+    if (modifier_)
+    {
+        lf_modifier_destroy(modifier_);
+    }
+}
+
+int32_t MapBuilder::init()
+{
+    if (!request_.lens || grid_width_ == 0 || grid_height_ == 0 || map_channels(request_.kind) == 0)
+    {
+        return -1;
+    }
+
+    {
+        const TraceSpan span("lf_modifier_create");
+        modifier_ = lf_modifier_create(
+            request_.lens,
+            request_.focal,
+            request_.crop,
+            request_.width,
+            request_.height,
+            LF_PF_F32,
+            request_.reverse);
+    }
+    if (!modifier_)
+    {
+        return -3;
+    }
+
+    CalibrationCache &cache = db_->calibrations();
+    const MapRequest &r = request_;
+    switch (r.kind)
+    {
+    case MapKind::Geometry:
+        if (!(enable_distortion(modifier_, cache, r.lens, r.crop, r.focal) & LF_MODIFY_DISTORTION))
+        {
+            break;
+        }
+        if (r.reverse)
+        {
+            inverse_ = cache.reverse_geometry(r.lens, r.crop, r.focal, r.width, r.height, [this, &cache]() {
+                return build_inverse(cache);
+            });
+        }
+        else
+        {
+            radial_ = cache.radial_geometry(r.lens, r.crop, r.focal, r.width, r.height, [this]() {
+                return RadialTable::geometry(modifier_, request_.width, request_.height);
+            });
+        }
+        break;
+    case MapKind::Tca:
+        enable_tca(modifier_, cache, r.lens, r.crop, r.focal);
+        break;
+    default:
+        if (!enable_vignetting(modifier_, cache, r.lens, r.crop, r.focal, r.aperture, r.distance))
+        {
+            return -4;
+        }
+        radial_ = cache.radial_vignetting(
+            r.lens, r.crop, r.focal, r.aperture, r.distance, r.width, r.height, r.reverse, [this]() {
+                return RadialTable::vignetting(modifier_, request_.width, request_.height);
+            });
+        break;
+    }
+    return 0;
+}
+
+std::unique_ptr<RadialInverse> MapBuilder::build_inverse(CalibrationCache &cache) const
+{
+    const MapRequest &r = request_;
+    lfModifier *forward = lf_modifier_create(r.lens, r.focal, r.crop, r.width, r.height, LF_PF_F32, false);
+    if (!forward)
+    {
+        return nullptr;
+    }
+    std::unique_ptr<RadialInverse> table;
+    if (enable_distortion(forward, cache, r.lens, r.crop, r.focal) & LF_MODIFY_DISTORTION)
+    {
+        table = RadialInverse::build(forward, modifier_, r.width, r.height);
+    }
+    lf_modifier_destroy(forward);
+    return table;
+}
+
+// At step 1 a grid row is a run of adjacent pixels, so each row is one
+// lensfun call; coarser grids are sampled point by point.
+int32_t MapBuilder::fill_rows(int y0, int y1, float *out)
+{
+    const TraceSpan span(kPassNames[static_cast<int>(request_.kind)]);
+    const int step = request_.step;
+    const int channels = map_channels(request_.kind);
+    const int run = step == 1 ? grid_width_ : 1;
+
+    float *cursor = out;
+    for (int y = y0; y < y1; ++y)
+    {
+        const float py = sample_coord(y, step, request_.height);
+        for (int x = 0; x < grid_width_; x += run)
+        {
+            if (!fill_run(sample_coord(x, step, request_.width), py, run, cursor))
+            {
+                return request_.kind == MapKind::Vignetting ? -5 : -4;
+            }
+            cursor += run * channels;
+        }
+    }
+    return 0;
+}
+
+int32_t MapBuilder::fill_row_gaps(int y, int every, float *out)
+{
+    if (y < 0 || y >= grid_height_ || every <= 0)
+    {
+        return -1;
+    }
+
+    const TraceSpan span(kPassNames[static_cast<int>(request_.kind)]);
+    const int step = request_.step;
+    const int channels = map_channels(request_.kind);
+    const float py = sample_coord(y, step, request_.height);
+    int x = 1;
+    while (x < grid_width_)
+    {
+        if (x % every == 0)
+        {
+            ++x;
+            continue;
+        }
+        // The points between two kept ones are one run at step 1.
+        const int run = step == 1 ? std::min(every - x % every, grid_width_ - x) : 1;
+        if (!fill_run(sample_coord(x, step, request_.width), py, run, out + static_cast<size_t>(x) * channels))
+        {
+            return request_.kind == MapKind::Vignetting ? -5 : -4;
+        }
+        x += run;
+    }
+    return 0;
+}
+
+int32_t MapBuilder::fill_point(float x, float y, float *out)
+{
+    if (!fill_run(x, y, 1, out))
+    {
+        return request_.kind == MapKind::Vignetting ? -5 : -4;
+    }
+    return 0;
+}
+
+// `run` adjacent pixels from (px, py); runs longer than one only at step 1.
+bool MapBuilder::fill_run(float px, float py, int run, float *out)
+{
+    switch (request_.kind)
+    {
+    case MapKind::Geometry:
+        if (inverse_)
+        {
+            for (int i = 0; i < run; ++i)
+            {
+                inverse_->apply(px + static_cast<float>(i), py, out + 2 * i);
+            }
+            return true;
+        }
+        if (radial_)
+        {
+            for (int i = 0; i < run; ++i)
+            {
+                radial_->apply_geometry(px + static_cast<float>(i), py, out + 2 * i);
+            }
+            return true;
+        }
+        return lf_modifier_apply_geometry_distortion(modifier_, px, py, run, 1, out);
+    case MapKind::Tca:
+        return lf_modifier_apply_subpixel_distortion(modifier_, px, py, run, 1, out);
+    default:
+        if (radial_)
+        {
+            for (int i = 0; i < run; ++i)
+            {
+                radial_->apply_gains(px + static_cast<float>(i), py, out + 3 * i);
+            }
+            return true;
+        }
+        std::fill(out, out + run * 3, 1.0f);
+        return lf_modifier_apply_color_modification(
+            modifier_,
+            out,
+            px,
+            py,
+            run,
+            1,
+            LF_CR_3(RED, GREEN, BLUE),
+            run * 3 * static_cast<int>(sizeof(float)));
+    }
+}
+
+uint32_t register_map_stream(std::unique_ptr<MapBuilder> builder)
+{
+    return g_streams.add(std::move(builder));
+}
+
+MapBuilder *find_map_stream(uint32_t handle)
+{
+    return g_streams.find(handle);
+}
+
+bool destroy_map_stream(uint32_t handle)
+{
+    return g_streams.remove(handle);
+}
+} // namespace lfw
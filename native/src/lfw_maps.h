@@ -0,0 +1,116 @@
+#ifndef LFW_MAPS_H
+#define LFW_MAPS_H
+
+#include "lensfun.h"
+#include "lfw_database.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+namespace lfw
+{
+enum class MapKind
+{
+    Geometry,
+    Tca,
+    Vignetting,
+    Count
+};
+
+// Floats per grid point: x/y, r/g/b x/y pairs, or r/g/b gains.
+int map_channels(MapKind kind);
+
+int grid_points(int size, int step);
+
+struct MapRequest
+{
+    MapKind kind = MapKind::Geometry;
+    const lfLens *lens = nullptr;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    // Vignetting only.
+    float aperture = 0.0f;
+    float distance = 0.0f;
+    int width = 0;
+    int height = 0;
+    bool reverse = false;
+    int step = 1;
+};
+
+// One configured lfModifier sampling a map on a `step` grid. Rows can be
+// produced in any order and any number of calls, so a map far larger than
+// the heap can be streamed through a small buffer. A builder must only be
+// used by one thread at a time.
+//
+// Geometry and vignetting maps are read from radial tables (a RadialTable, or
+// a RadialInverse for reverse geometry) when one reproduces lensfun within its
+// residual bound, so lensfun evaluates the model once per pixel of radius
+// instead of once per grid point; otherwise every point goes to lensfun.
+class MapBuilder
+{
+public:
+    MapBuilder(const MapRequest &request, std::shared_ptr<Database> db);
+    ~MapBuilder();
+
+    MapBuilder(const MapBuilder &) = delete;
+    MapBuilder &operator=(const MapBuilder &) = delete;
+
+    // Creates and configures the modifier. Returns 0, -1 for a bad request,
+    // -3 when lensfun has no modifier and -4 when vignetting cannot be
+    // enabled (the lfw_build_*_map codes).
+    int32_t init();
+
+    MapKind kind() const
+    {
+        return request_.kind;
+    }
+    int grid_width() const
+    {
+        return grid_width_;
+    }
+    int grid_height() const
+    {
+        return grid_height_;
+    }
+    size_t row_floats() const
+    {
+        return static_cast<size_t>(grid_width_) * map_channels(request_.kind);
+    }
+
+    // Writes grid rows [y0, y1) to `out`, row after row. Returns 0, -4 when
+    // lensfun rejects a geometry or TCA row, or -5 for a vignetting row.
+    int32_t fill_rows(int y0, int y1, float *out);
+
+    // Writes grid row `y` to `out` except the points whose x is a multiple of
+    // `every`, which the caller already holds (say, from a coarser grid).
+    // Returns 0, -1 for a bad row or the fill_rows codes.
+    int32_t fill_row_gaps(int y, int every, float *out);
+
+    // Writes the map at pixel (x, y), which need not be a grid point. Returns
+    // 0 or the fill_rows codes.
+    int32_t fill_point(float x, float y, float *out);
+
+private:
+    std::unique_ptr<RadialInverse> build_inverse(CalibrationCache &cache) const;
+    bool fill_run(float px, float py, int run, float *out);
+
+    MapRequest request_;
+    // Keeps the lens alive while the builder exists.
+    std::shared_ptr<Database> db_;
+    lfModifier *modifier_ = nullptr;
+    std::shared_ptr<const RadialInverse> inverse_;
+    std::shared_ptr<const RadialTable> radial_;
+    int grid_width_ = 0;
+    int grid_height_ = 0;
+};
+
+// Streaming builders handed out by lfw_map_stream_create.
+uint32_t register_map_stream(std::unique_ptr<MapBuilder> builder);
+MapBuilder *find_map_stream(uint32_t handle);
+// Must not be called while another thread is filling rows of the stream.
+bool destroy_map_stream(uint32_t handle);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,204 @@
+#include "lfw_normalized.h"
+
+#include "lfw_handles.h"
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<NormalizedMap> g_normalized_maps;
+
+// The reference image is at most this many nodes long, i.e. 32769 pixels.
+constexpr int kMaxGridSize = 2049;
+
+float sample_fraction(int index, int step, int size)
+{
+    return size > 1 ? static_cast<float>(std::min(index * step, size - 1)) / static_cast<float>(size - 1) : 0.0f;
+}
+
+// Node pairs and weights along one axis for every output sample: the nodes
+// are kReferenceStep reference pixels apart except for a shorter last gap.
+void axis_weights(
+    const std::vector<float> &nodes,
+    int reference,
+    int samples,
+    int step,
+    int size,
+    std::vector<int> *index,
+    std::vector<float> *weight)
+{
+    index->resize(samples);
+    weight->resize(samples);
+    const int last = static_cast<int>(nodes.size()) - 2;
+    for (int i = 0; i < samples; ++i)
+    {
+        const float u = sample_fraction(i, step, size);
+        const int j =
+            std::min(static_cast<int>(u * static_cast<float>(reference - 1) / NormalizedMap::kReferenceStep), last);
+        const float t = (u - nodes[j]) / (nodes[j + 1] - nodes[j]);
+        (*index)[i] = j;
+        (*weight)[i] = std::min(std::max(t, 0.0f), 1.0f);
+    }
+}
+
+// Interpolates one output row between the nodes of a blended node row; the
+// channel count is fixed so the inner loop unrolls.
+template <int Channels>
+void lerp_row(const float *nodes, const int *index, const float *weight, int columns, float *out)
+{
+    for (int x = 0; x < columns; ++x)
+    {
+        const float *a = nodes + index[x] * Channels;
+        const float t = weight[x];
+        for (int c = 0; c < Channels; ++c)
+        {
+            out[c] = a[c] + (a[c + Channels] - a[c]) * t;
+        }
+        out += Channels;
+    }
+}
+} // namespace
+
+NormalizedMap::NormalizedMap(const NormalizedRequest &request, std::shared_ptr<Database> db)
+    : request_(request),
+      db_(std::move(db))
+{
+}
+
+int32_t NormalizedMap::init()
+{
+    const NormalizedRequest &r = request_;
+    if (!r.map.lens || !(r.aspect >= 1e-4f && r.aspect <= 1e4f) || r.grid_size < 2 || r.grid_size > kMaxGridSize)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("normalized map");
+    const int longer = (r.grid_size - 1) * kReferenceStep + 1;
+    const double ratio = std::max(static_cast<double>(r.aspect), 1.0 / r.aspect);
+    const int shorter = std::max(static_cast<int>(lround((longer - 1) / ratio)) + 1, 2);
+    MapRequest map = r.map;
+    map.width = r.aspect >= 1.0f ? longer : shorter;
+    map.height = r.aspect >= 1.0f ? shorter : longer;
+    map.step = kReferenceStep;
+
+    MapBuilder builder(map, db_);
+    int32_t rc = builder.init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+    grid_width_ = builder.grid_width();
+    grid_height_ = builder.grid_height();
+    nodes_.resize(builder.row_floats() * grid_height_);
+    rc = builder.fill_rows(0, grid_height_, nodes_.data());
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    node_x_.resize(grid_width_);
+    for (int i = 0; i < grid_width_; ++i)
+    {
+        node_x_[i] = sample_fraction(i, kReferenceStep, map.width);
+    }
+    node_y_.resize(grid_height_);
+    for (int j = 0; j < grid_height_; ++j)
+    {
+        node_y_[j] = sample_fraction(j, kReferenceStep, map.height);
+    }
+    if (r.map.kind != MapKind::Vignetting)
+    {
+        const float sx = 1.0f / static_cast<float>(map.width - 1);
+        const float sy = 1.0f / static_cast<float>(map.height - 1);
+        for (size_t i = 0; i < nodes_.size(); i += 2)
+        {
+            nodes_[i] *= sx;
+            nodes_[i + 1] *= sy;
+        }
+    }
+    reference_width_ = map.width;
+    reference_height_ = map.height;
+    db_.reset();
+    return 0;
+}
+
+size_t NormalizedMap::sample_floats(MapKind kind, int width, int height, int step)
+{
+    return static_cast<size_t>(grid_points(width, step)) * grid_points(height, step) * map_channels(kind);
+}
+
+int32_t NormalizedMap::sample(int width, int height, int step, float *out) const
+{
+    if (nodes_.empty() || width <= 0 || height <= 0 || step <= 0)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("normalized sample");
+    const int channels = map_channels(kind());
+    const int columns = grid_points(width, step);
+    const int rows = grid_points(height, step);
+    std::vector<int> column_index;
+    std::vector<float> column_weight;
+    std::vector<int> row_index;
+    std::vector<float> row_weight;
+    axis_weights(node_x_, reference_width_, columns, step, width, &column_index, &column_weight);
+    axis_weights(node_y_, reference_height_, rows, step, height, &row_index, &row_weight);
+
+    float scale[6];
+    for (int c = 0; c < channels; ++c)
+    {
+        scale[c] = kind() == MapKind::Vignetting ? 1.0f : static_cast<float>(c % 2 == 0 ? width - 1 : height - 1);
+    }
+    const size_t node_row = static_cast<size_t>(grid_width_) * channels;
+    std::vector<float> blended(node_row);
+    for (int y = 0; y < rows; ++y)
+    {
+        // Blending the two node rows first leaves one lerp per float for the
+        // output row.
+        const float *top = nodes_.data() + node_row * row_index[y];
+        const float *bottom = top + node_row;
+        const float ty = row_weight[y];
+        for (size_t i = 0; i < node_row; ++i)
+        {
+            blended[i] = (top[i] + (bottom[i] - top[i]) * ty) * scale[i % channels];
+        }
+        switch (channels)
+        {
+        case 2:
+            lerp_row<2>(blended.data(), column_index.data(), column_weight.data(), columns, out);
+            break;
+        case 3:
+            lerp_row<3>(blended.data(), column_index.data(), column_weight.data(), columns, out);
+            break;
+        default:
+            lerp_row<6>(blended.data(), column_index.data(), column_weight.data(), columns, out);
+            break;
+        }
+        out += static_cast<size_t>(columns) * channels;
+    }
+    return 0;
+}
+
+uint32_t register_normalized_map(std::unique_ptr<NormalizedMap> map)
+{
+    return g_normalized_maps.add(std::move(map));
+}
+
+NormalizedMap *find_normalized_map(uint32_t handle)
+{
+    return g_normalized_maps.find(handle);
+}
+
+bool destroy_normalized_map(uint32_t handle)
+{
+    return g_normalized_maps.remove(handle);
+}
+} // namespace lfw
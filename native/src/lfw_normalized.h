@@ -0,0 +1,89 @@
+#ifndef LFW_NORMALIZED_H
+#define LFW_NORMALIZED_H
+
+#include "lfw_maps.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+struct NormalizedRequest
+{
+    // `map.width`, `map.height` and `map.step` are ignored; the map is built
+    // for `aspect`.
+    MapRequest map;
+    // Width over height of the images the map serves.
+    float aspect = 1.5f;
+    // Nodes along the longer side.
+    int grid_size = 257;
+};
+
+// One map in coordinates normalized to the image extent, built once for an
+// aspect ratio and crop and then sampled at any resolution. lensfun scales
+// its models with the image, so a point's source position as a fraction of
+// the image does not depend on the image size; each sample is a bilinear
+// lookup in the node grid instead of a lensfun evaluation.
+//
+// The nodes are built at a reference size of kReferenceStep pixels per node
+// along the longer side, which keeps lensfun well above the rounding of
+// small images. Sampling only reads the nodes, so several threads may sample
+// one map at once.
+class NormalizedMap
+{
+public:
+    static constexpr int kReferenceStep = 16;
+
+    NormalizedMap(const NormalizedRequest &request, std::shared_ptr<Database> db);
+
+    NormalizedMap(const NormalizedMap &) = delete;
+    NormalizedMap &operator=(const NormalizedMap &) = delete;
+
+    // Builds the nodes and releases the database. Returns 0, -1 for a bad
+    // request or a map builder code.
+    int32_t init();
+
+    MapKind kind() const
+    {
+        return request_.map.kind;
+    }
+    int grid_width() const
+    {
+        return grid_width_;
+    }
+    int grid_height() const
+    {
+        return grid_height_;
+    }
+
+    // Floats of the map of a `width` x `height` image sampled every `step`
+    // pixels, in the lfw_build_*_map layout.
+    static size_t sample_floats(MapKind kind, int width, int height, int step);
+
+    // Writes that map to `out`. Returns 0 or -1 for a bad size or step.
+    int32_t sample(int width, int height, int step, float *out) const;
+
+private:
+    NormalizedRequest request_;
+    std::shared_ptr<Database> db_;
+    int reference_width_ = 0;
+    int reference_height_ = 0;
+    int grid_width_ = 0;
+    int grid_height_ = 0;
+    // Node positions along each axis as fractions of the image extent.
+    std::vector<float> node_x_;
+    std::vector<float> node_y_;
+    // Coordinates are stored as fractions of the image extent, gains as is.
+    std::vector<float> nodes_;
+};
+
+// Maps handed out by lfw_normalized_map_create.
+uint32_t register_normalized_map(std::unique_ptr<NormalizedMap> map);
+NormalizedMap *find_normalized_map(uint32_t handle);
+bool destroy_normalized_map(uint32_t handle);
+} // namespace lfw
+
+#endif
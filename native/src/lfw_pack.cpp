@@ -0,0 +1,136 @@
+#include "lfw_pack.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#if LFW_ENABLE_DB_PACK
+#include <zlib.h>
+#endif
+
+namespace lfw
+{
+namespace
+{
+// Compressed bytes read, and inflated bytes produced, per step.
+constexpr size_t kChunkBytes = 65536;
+// Document names are file names; a longer one means a damaged stream.
+constexpr uint32_t kMaxNameBytes = 4096;
+constexpr size_t kDocumentHeaderBytes = 8;
+
+uint32_t read_u32(const unsigned char *p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+           static_cast<uint32_t>(p[3]) << 24;
+}
+} // namespace
+
+bool has_pack_suffix(const char *name)
+{
+    const size_t len = strlen(name);
+    const size_t suffix = strlen(kPackSuffix);
+    return len > suffix && strcmp(name + len - suffix, kPackSuffix) == 0;
+}
+
+#if LFW_ENABLE_DB_PACK
+bool read_pack(const std::string &path, const PackSink &sink, PackStats *stats)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    ++stats->packages;
+
+    unsigned char header[kPackHeaderBytes];
+    const size_t header_bytes = fread(header, 1, sizeof(header), file);
+    stats->packed_bytes += header_bytes;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (header_bytes != kPackHeaderBytes || read_u32(header) != kPackMagic || read_u32(header + 4) != kPackVersion ||
+        inflateInit(&zs) != Z_OK)
+    {
+        fclose(file);
+        return false;
+    }
+    const uint32_t documents = read_u32(header + 8);
+    const uint32_t xml_total = read_u32(header + 12);
+
+    std::vector<unsigned char> in(kChunkBytes);
+    // Inflated bytes not handed over yet, starting at a document header.
+    std::string pending;
+    uint32_t handed = 0;
+    bool ok = true;
+
+    // Hands over every complete document at the front of `pending`.
+    const auto hand_over = [&]() {
+        size_t used = 0;
+        while (pending.size() - used >= kDocumentHeaderBytes)
+        {
+            const unsigned char *at = reinterpret_cast<const unsigned char *>(pending.data() + used);
+            const uint32_t name_bytes = read_u32(at);
+            const uint32_t xml_bytes = read_u32(at + 4);
+            if (name_bytes == 0 || name_bytes > kMaxNameBytes || xml_bytes > xml_total || handed == documents)
+            {
+                return false;
+            }
+            const size_t need = kDocumentHeaderBytes + name_bytes + xml_bytes;
+            if (pending.size() - used < need)
+            {
+                // Grow once for the rest of this document.
+                pending.reserve(pending.size() - used + need + kChunkBytes);
+                break;
+            }
+            const char *name = pending.data() + used + kDocumentHeaderBytes;
+            sink(std::string(name, name_bytes), name + name_bytes, xml_bytes);
+            ++stats->documents;
+            stats->xml_bytes += xml_bytes;
+            ++handed;
+            used += need;
+        }
+        pending.erase(0, used);
+        return true;
+    };
+
+    int zrc = Z_OK;
+    // A full output buffer may leave inflated bytes inside zlib; those come
+    // out before more input is read.
+    bool need_input = true;
+    while (ok && zrc != Z_STREAM_END)
+    {
+        if (zs.avail_in == 0 && need_input)
+        {
+            const size_t got = fread(in.data(), 1, in.size(), file);
+            stats->packed_bytes += got;
+            if (got == 0)
+            {
+                ok = false;
+                break;
+            }
+            zs.next_in = in.data();
+            zs.avail_in = static_cast<uInt>(got);
+        }
+
+        const size_t before = pending.size();
+        pending.resize(before + kChunkBytes);
+        zs.next_out = reinterpret_cast<Bytef *>(&pending[before]);
+        zs.avail_out = static_cast<uInt>(kChunkBytes);
+        zrc = inflate(&zs, Z_NO_FLUSH);
+        pending.resize(before + kChunkBytes - zs.avail_out);
+        need_input = zs.avail_out != 0;
+        // Z_BUF_ERROR only says nothing was left to inflate without input.
+        ok = (zrc == Z_OK || zrc == Z_STREAM_END || zrc == Z_BUF_ERROR) && hand_over();
+    }
+
+    inflateEnd(&zs);
+    fclose(file);
+    return ok && pending.empty() && handed == documents;
+}
+#else
+bool read_pack(const std::string &, const PackSink &, PackStats *)
+{
+    return false;
+}
+#endif
+} // namespace lfw
@@ -0,0 +1,68 @@
+#ifndef LFW_PACK_H
+#define LFW_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#ifndef LFW_ENABLE_DB_PACK
+#define LFW_ENABLE_DB_PACK 1
+#endif
+
+namespace lfw
+{
+// A database package: every XML document of a database directory in one
+// zlib stream, written at build time by scripts/pack-db.mjs so the module
+// ships and preloads a fraction of the raw XML. Header fields are
+// little-endian u32:
+//
+//   0 magic "LFWD", 4 version, 8 documents, 12 XML bytes of all documents,
+//   16 zlib stream holding, per document, its name bytes and XML bytes
+//   (u32 each), its file name (no directory), then its XML.
+//
+// The documents share one stream so later files reuse the deflate window of
+// earlier ones; they are stored in file name order.
+constexpr uint32_t kPackMagic = 0x4457464c;
+constexpr uint32_t kPackVersion = 1;
+constexpr size_t kPackHeaderBytes = 16;
+constexpr const char *kPackSuffix = ".lfwpack";
+
+// Whether the bridge was built with zlib and can read packages.
+constexpr bool kPackSupported = LFW_ENABLE_DB_PACK != 0;
+
+struct PackStats
+{
+    size_t packages = 0;
+    size_t documents = 0;
+    // Bytes read from package files.
+    size_t packed_bytes = 0;
+    // XML bytes inflated from them.
+    size_t xml_bytes = 0;
+
+    PackStats &operator+=(const PackStats &other)
+    {
+        packages += other.packages;
+        documents += other.documents;
+        packed_bytes += other.packed_bytes;
+        xml_bytes += other.xml_bytes;
+        return *this;
+    }
+};
+
+using PackSink = std::function<void(const std::string &name, const char *xml, size_t size)>;
+
+bool has_pack_suffix(const char *name);
+
+// Reads the package at `path` in fixed-size chunks and inflates it as it
+// goes, handing each document to `sink` as soon as its last byte is out:
+// only the current document is ever held inflated, and the first ones are
+// parsed before the rest of the file is read. Returns false for an
+// unreadable file, a bad header or a damaged stream. zlib's checksum covers
+// the whole stream, so documents before the damage may already have been
+// handed over. `stats` counts what was read either way.
+bool read_pack(const std::string &path, const PackSink &sink, PackStats *stats);
+} // namespace lfw
+
+#endif
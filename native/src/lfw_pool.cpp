@@ -0,0 +1,123 @@
+#include "lfw_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <thread>
+#define LFW_POOL_ENABLED 1
+#else
+#define LFW_POOL_ENABLED 0
+#endif
+
+// Set from LFW_THREAD_POOL_SIZE by CMake; the wasm link reserves the same
+// number of pthreads.
+#ifndef LFW_POOL_THREADS
+#define LFW_POOL_THREADS 4
+#endif
+
+namespace lfw
+{
+namespace
+{
+#if LFW_POOL_ENABLED
+class WorkerPool
+{
+public:
+    WorkerPool()
+    {
+        for (int i = 0; i < LFW_POOL_THREADS; ++i)
+        {
+            std::thread(&WorkerPool::serve, this).detach();
+        }
+    }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        queued_.notify_one();
+    }
+
+private:
+    void serve()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queued_.wait(lock, [this]() { return !tasks_.empty(); });
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::deque<std::function<void()>> tasks_;
+};
+
+// Never destroyed: the workers are detached and may still be waiting on it
+// while the process exits.
+WorkerPool &pool()
+{
+    static WorkerPool *instance = new WorkerPool();
+    return *instance;
+}
+#endif
+} // namespace
+
+int pool_threads()
+{
+#if LFW_POOL_ENABLED
+    return LFW_POOL_THREADS;
+#else
+    return 0;
+#endif
+}
+
+void pool_submit(std::function<void()> task)
+{
+#if LFW_POOL_ENABLED
+    if (LFW_POOL_THREADS > 0)
+    {
+        pool().submit(std::move(task));
+        return;
+    }
+#endif
+    task();
+}
+
+void pool_run(int threads, const std::function<void()> &work)
+{
+    const int helpers = std::min(threads - 1, pool_threads());
+    if (helpers <= 0)
+    {
+        work();
+        return;
+    }
+    std::mutex mutex;
+    std::condition_variable finished;
+    int running = helpers;
+    for (int i = 0; i < helpers; ++i)
+    {
+        pool_submit([&]() {
+            work();
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+            finished.notify_all();
+        });
+    }
+    work();
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]() { return running == 0; });
+}
+} // namespace lfw
@@ -0,0 +1,31 @@
+#ifndef LFW_POOL_H
+#define LFW_POOL_H
+
+#include <functional>
+
+namespace lfw
+{
+// Worker threads shared by correction batches and zoom sequences. They are
+// started once, on first use, and wait for tasks until the process exits.
+// The wasm module starts as many pthreads with the runtime
+// (PTHREAD_POOL_SIZE), so handing work to the pool never waits for a thread
+// that cannot start while the browser main thread is blocked.
+//
+// Without threads (a wasm build without pthreads) the pool is empty and
+// every task runs on the caller.
+
+// Number of worker threads; 0 where threads are not available.
+int pool_threads();
+
+// Runs `task` on a worker, or at once on the caller when the pool is empty.
+// Tasks must not wait for tasks queued after them.
+void pool_submit(std::function<void()> task);
+
+// Runs `work` on the caller and on up to `threads - 1` workers at once, and
+// returns when every copy has returned. Copies queued behind busy workers run
+// late, so `work` should share its tasks through a counter rather than split
+// them up front.
+void pool_run(int threads, const std::function<void()> &work);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,235 @@
+#include "lfw_prune.h"
+
+#include <string.h>
+
+#include <string_view>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+constexpr size_t npos = std::string_view::npos;
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+std::string_view trim(std::string_view value)
+{
+    while (!value.empty() && is_space(value.front()))
+    {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && is_space(value.back()))
+    {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+char ascii_lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool same_name(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (ascii_lower(a[i]) != ascii_lower(b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The predefined entities; lensfun's files use no others in names.
+std::string decode(std::string_view value)
+{
+    static const std::pair<const char *, char> kEntities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+    std::string out;
+    out.reserve(value.size());
+    size_t i = 0;
+    while (i < value.size())
+    {
+        bool replaced = false;
+        if (value[i] == '&')
+        {
+            for (const auto &entity : kEntities)
+            {
+                const size_t len = strlen(entity.first);
+                if (value.compare(i, len, entity.first) == 0)
+                {
+                    out += entity.second;
+                    i += len;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced)
+        {
+            out += value[i++];
+        }
+    }
+    return std::string(trim(out));
+}
+
+// Whether `<name` at `at` opens a start tag of that name rather than of a
+// longer one (<lensdatabase> is not <lens>).
+bool start_tag_at(std::string_view text, size_t at, const char *name)
+{
+    const size_t len = strlen(name);
+    if (at + 1 + len >= text.size() || text[at] != '<' || text.compare(at + 1, len, name) != 0)
+    {
+        return false;
+    }
+    const char next = text[at + 1 + len];
+    return next == '>' || next == '/' || is_space(next);
+}
+
+size_t count_tags(std::string_view record, const char *name)
+{
+    size_t count = 0;
+    for (size_t at = record.find('<'); at != npos; at = record.find('<', at + 1))
+    {
+        count += start_tag_at(record, at, name) ? 1 : 0;
+    }
+    return count;
+}
+
+// Whether the text of some <name> element of `record` is in `allowed`.
+bool any_allowed(std::string_view record, const char *name, const std::vector<std::string> &allowed)
+{
+    if (allowed.empty())
+    {
+        return true;
+    }
+    for (size_t at = record.find('<'); at != npos; at = record.find('<', at + 1))
+    {
+        if (!start_tag_at(record, at, name))
+        {
+            continue;
+        }
+        const size_t gt = record.find('>', at);
+        const size_t lt = gt != npos ? record.find('<', gt) : npos;
+        if (lt == npos || record[gt - 1] == '/')
+        {
+            continue;
+        }
+        const std::string value = decode(record.substr(gt + 1, lt - gt - 1));
+        for (const std::string &entry : allowed)
+        {
+            if (same_name(value, entry))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+} // namespace
+
+std::vector<std::string> split_filter_list(const char *list)
+{
+    std::vector<std::string> entries;
+    std::string_view rest = list ? std::string_view(list) : std::string_view();
+    while (!rest.empty())
+    {
+        const size_t end = rest.find('\n');
+        const std::string_view entry = trim(rest.substr(0, end));
+        if (!entry.empty())
+        {
+            entries.emplace_back(entry);
+        }
+        rest.remove_prefix(end == npos ? rest.size() : end + 1);
+    }
+    return entries;
+}
+
+bool prune_records(const RecordFilter &filter, const char *xml, size_t size, std::string *out, PruneCounts *counts)
+{
+    const std::string_view text(xml, size);
+    std::string kept;
+    PruneCounts removed;
+    // Text before `copied` is already in `kept`.
+    size_t copied = 0;
+    size_t at = text.find('<');
+    while (at != npos)
+    {
+        // Markup inside comments and CDATA is not markup.
+        const char *skip_to = text.compare(at, 4, "<!--") == 0        ? "-->"
+                              : text.compare(at, 9, "<![CDATA[") == 0 ? "]]>"
+                                                                      : nullptr;
+        if (skip_to)
+        {
+            const size_t end = text.find(skip_to, at + 4);
+            at = end != npos ? text.find('<', end) : npos;
+            continue;
+        }
+
+        const bool lens = start_tag_at(text, at, "lens");
+        if (!lens && !start_tag_at(text, at, "camera"))
+        {
+            at = text.find('<', at + 1);
+            continue;
+        }
+        const size_t gt = text.find('>', at);
+        if (gt == npos)
+        {
+            break;
+        }
+        size_t end = gt + 1;
+        if (text[gt - 1] != '/')
+        {
+            const char *close = lens ? "</lens>" : "</camera>";
+            end = text.find(close, gt);
+            if (end == npos)
+            {
+                break;
+            }
+            end += strlen(close);
+        }
+
+        const std::string_view record = text.substr(at, end - at);
+        if (!any_allowed(record, "mount", filter.mounts) || !any_allowed(record, "maker", filter.makers))
+        {
+            if (kept.empty())
+            {
+                kept.reserve(size);
+            }
+            kept.append(text.substr(copied, at - copied));
+            copied = end;
+            if (lens)
+            {
+                ++removed.lenses;
+                removed.calibrations +=
+                    count_tags(record, "distortion") + count_tags(record, "tca") + count_tags(record, "vignetting");
+            }
+            else
+            {
+                ++removed.cameras;
+            }
+            removed.xml_bytes += record.size();
+        }
+        at = text.find('<', end);
+    }
+
+    if (removed.lenses == 0 && removed.cameras == 0)
+    {
+        return false;
+    }
+    kept.append(text.substr(copied));
+    *out = std::move(kept);
+    *counts = removed;
+    return true;
+}
+} // namespace lfw
@@ -0,0 +1,60 @@
+#ifndef LFW_PRUNE_H
+#define LFW_PRUNE_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+namespace lfw
+{
+// Allow-lists for the camera and lens records of a database. A record is
+// kept when one of its mounts is in `mounts` and one of its makers (any
+// language) is in `makers`; an empty list allows everything. Names compare
+// without ASCII case and surrounding spaces. Mounts are matched by name
+// only: lenses that fit an allowed mount through its compatible mounts must
+// have those listed too.
+struct RecordFilter
+{
+    std::vector<std::string> mounts;
+    std::vector<std::string> makers;
+
+    bool active() const
+    {
+        return !mounts.empty() || !makers.empty();
+    }
+};
+
+// Splits a newline-separated list, dropping blank entries. Null is empty.
+std::vector<std::string> split_filter_list(const char *list);
+
+// What a filter removed from a document.
+struct PruneCounts
+{
+    size_t lenses = 0;
+    size_t cameras = 0;
+    // Distortion, TCA and vignetting entries of the removed lenses.
+    size_t calibrations = 0;
+    // XML text of the removed records, not the heap their parsed objects
+    // would have taken; the allocation tracker measures that.
+    size_t xml_bytes = 0;
+
+    PruneCounts &operator+=(const PruneCounts &other)
+    {
+        lenses += other.lenses;
+        cameras += other.cameras;
+        calibrations += other.calibrations;
+        xml_bytes += other.xml_bytes;
+        return *this;
+    }
+};
+
+// Copies a lensfun XML document to `out` without the <lens> and <camera>
+// records `filter` rejects, so the parser never builds them. One pass over
+// the text, with no DOM: records are matched by their tags, comments are
+// copied as they are, and everything else is left alone. Returns false, with
+// `out` untouched, when nothing was removed.
+bool prune_records(const RecordFilter &filter, const char *xml, size_t size, std::string *out, PruneCounts *counts);
+} // namespace lfw
+
+#endif
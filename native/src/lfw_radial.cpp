@@ -0,0 +1,212 @@
+#include "lfw_radial.h"
+
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace lfw
+{
+namespace
+{
+// Displacements shorter than this carry too little direction to locate the
+// centre in float coordinates.
+constexpr double kMinDisplacement = 0.01;
+
+// Points per side of the grid a table is checked on.
+constexpr int kChecks = 33;
+} // namespace
+
+// The optical centre is where the displacement lines of the corners and the
+// edge midpoints meet (least squares).
+bool find_radial_centre(lfModifier *modifier, int width, int height, float *cx, float *cy)
+{
+    const float xs[] = {0.0f, 0.5f * (width - 1), static_cast<float>(width - 1)};
+    const float ys[] = {0.0f, 0.5f * (height - 1), static_cast<float>(height - 1)};
+    double a11 = 0.0;
+    double a12 = 0.0;
+    double a22 = 0.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    for (int j = 0; j < 3; ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (i == 1 && j == 1)
+            {
+                continue;
+            }
+            float q[2];
+            if (!lf_modifier_apply_geometry_distortion(modifier, xs[i], ys[j], 1, 1, q))
+            {
+                return false;
+            }
+            const double dx = static_cast<double>(q[0]) - xs[i];
+            const double dy = static_cast<double>(q[1]) - ys[j];
+            const double length = hypot(dx, dy);
+            if (!(length > kMinDisplacement))
+            {
+                continue;
+            }
+            const double nx = -dy / length;
+            const double ny = dx / length;
+            const double d = nx * xs[i] + ny * ys[j];
+            a11 += nx * nx;
+            a12 += nx * ny;
+            a22 += ny * ny;
+            b1 += nx * d;
+            b2 += ny * d;
+        }
+    }
+
+    const double det = a11 * a22 - a12 * a12;
+    if (det > 1e-6)
+    {
+        *cx = static_cast<float>((a22 * b1 - a12 * b2) / det);
+        *cy = static_cast<float>((a11 * b2 - a12 * b1) / det);
+    }
+    else
+    {
+        *cx = 0.5f * (width - 1);
+        *cy = 0.5f * (height - 1);
+    }
+    return true;
+}
+
+std::unique_ptr<RadialTable> RadialTable::geometry(lfModifier *modifier, int width, int height)
+{
+    const TraceSpan span("radial table");
+    float cx = 0.0f;
+    float cy = 0.0f;
+    if (!find_radial_centre(modifier, width, height, &cx, &cy))
+    {
+        return nullptr;
+    }
+    return sample(modifier, 1, cx, cy, width, height);
+}
+
+// Vignetting gains carry no direction, so the table assumes the image centre
+// and the check rejects a lens whose vignetting is centred elsewhere.
+std::unique_ptr<RadialTable> RadialTable::vignetting(lfModifier *modifier, int width, int height)
+{
+    const TraceSpan span("radial table");
+    return sample(modifier, 3, 0.5f * (width - 1), 0.5f * (height - 1), width, height);
+}
+
+std::unique_ptr<RadialTable> RadialTable::sample(
+    lfModifier *modifier,
+    int channels,
+    float cx,
+    float cy,
+    int width,
+    int height)
+{
+    std::unique_ptr<RadialTable> table(new RadialTable(channels, cx, cy));
+    double max_r = 0.0;
+    const float corners[][2] = {
+        {0.0f, 0.0f},
+        {static_cast<float>(width - 1), 0.0f},
+        {0.0f, static_cast<float>(height - 1)},
+        {static_cast<float>(width - 1), static_cast<float>(height - 1)}};
+    for (const auto &corner : corners)
+    {
+        max_r = std::max(max_r, hypot(static_cast<double>(corner[0]) - cx, static_cast<double>(corner[1]) - cy));
+    }
+
+    // One lensfun call along +x from the centre, one pixel per entry.
+    const int entries = static_cast<int>(ceil(max_r)) + 2;
+    table->values_.resize(static_cast<size_t>(entries) * channels);
+    if (channels == 1)
+    {
+        std::vector<float> row(static_cast<size_t>(entries) * 2);
+        if (!lf_modifier_apply_geometry_distortion(modifier, cx, cy, entries, 1, row.data()))
+        {
+            return nullptr;
+        }
+        for (int i = 1; i < entries; ++i)
+        {
+            table->values_[i] = (row[2 * i] - cx) / static_cast<float>(i);
+        }
+        // The ratio is even in the radius, so it is flat at the centre.
+        table->values_[0] = table->values_[1];
+    }
+    else
+    {
+        std::fill(table->values_.begin(), table->values_.end(), 1.0f);
+        if (!lf_modifier_apply_color_modification(
+                modifier,
+                table->values_.data(),
+                cx,
+                cy,
+                entries,
+                1,
+                LF_CR_3(RED, GREEN, BLUE),
+                entries * channels * static_cast<int>(sizeof(float))))
+        {
+            return nullptr;
+        }
+    }
+
+    if (!table->verify(modifier, width, height))
+    {
+        return nullptr;
+    }
+    return table;
+}
+
+bool RadialTable::verify(lfModifier *modifier, int width, int height)
+{
+    const double bound = channels_ == 1 ? kMaxGeometryResidual : kMaxGainResidual;
+    double residual = 0.0;
+    for (int j = 0; j < kChecks; ++j)
+    {
+        for (int i = 0; i < kChecks; ++i)
+        {
+            const float x = static_cast<float>(i) * (width - 1) / (kChecks - 1);
+            const float y = static_cast<float>(j) * (height - 1) / (kChecks - 1);
+            double error = 0.0;
+            if (channels_ == 1)
+            {
+                float expected[2];
+                float got[2];
+                if (!lf_modifier_apply_geometry_distortion(modifier, x, y, 1, 1, expected))
+                {
+                    return false;
+                }
+                apply_geometry(x, y, got);
+                error = hypot(static_cast<double>(got[0]) - expected[0], static_cast<double>(got[1]) - expected[1]);
+            }
+            else
+            {
+                float expected[3] = {1.0f, 1.0f, 1.0f};
+                float got[3];
+                if (!lf_modifier_apply_color_modification(
+                        modifier,
+                        expected,
+                        x,
+                        y,
+                        1,
+                        1,
+                        LF_CR_3(RED, GREEN, BLUE),
+                        static_cast<int>(sizeof(expected))))
+                {
+                    return false;
+                }
+                apply_gains(x, y, got);
+                for (int c = 0; c < 3; ++c)
+                {
+                    error = std::max(error, fabs(static_cast<double>(got[c]) - expected[c]));
+                }
+            }
+            if (!(error <= bound))
+            {
+                return false;
+            }
+            residual = std::max(residual, error);
+        }
+    }
+    residual_ = residual;
+    return true;
+}
+} // namespace lfw
@@ -0,0 +1,115 @@
+#ifndef LFW_RADIAL_H
+#define LFW_RADIAL_H
+
+#include "lensfun.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+// Estimates the optical centre of the distortion enabled on `modifier` from
+// the displacement of the image corners and edge midpoints. Falls back to the
+// image centre when the distortion is too weak to tell. Returns false when
+// lensfun rejects a point.
+bool find_radial_centre(lfModifier *modifier, int width, int height, float *cx, float *cy);
+
+// A forward distortion or a vignetting correction as a 1D table over the
+// distance from the optical centre. lensfun evaluates both as functions of
+// that radius alone, so one lensfun call along a ray samples the whole model
+// and every map point becomes a lookup: model evaluations drop from one per
+// grid point to one per pixel of radius.
+//
+// Geometry entries hold the ratio of source to output radius, so a point is
+// moved with one multiply-add per axis; vignetting entries hold the r/g/b
+// gains.
+class RadialTable
+{
+public:
+    // Largest allowed distance from lensfun's own map, in pixels.
+    static constexpr double kMaxGeometryResidual = 0.005;
+    // Largest allowed difference from lensfun's own gains.
+    static constexpr double kMaxGainResidual = 5e-5;
+
+    // `modifier` is a forward modifier with only distortion enabled, or one
+    // with only vignetting enabled. The table is checked against `modifier`
+    // on a 33x33 grid spanning the image; null is returned when the residual
+    // exceeds its bound, e.g. for a model that is not centred where the
+    // table assumes.
+    static std::unique_ptr<RadialTable> geometry(lfModifier *modifier, int width, int height);
+    static std::unique_ptr<RadialTable> vignetting(lfModifier *modifier, int width, int height);
+
+    double residual() const
+    {
+        return residual_;
+    }
+
+    // Heap held by the table, for the calibration cache's byte budget.
+    size_t bytes() const
+    {
+        return sizeof(*this) + values_.capacity() * sizeof(float);
+    }
+
+    // Writes the source x/y of output point (x, y).
+    void apply_geometry(float x, float y, float *out) const
+    {
+        const float dx = x - cx_;
+        const float dy = y - cy_;
+        float scale;
+        lookup(dx, dy, &scale);
+        out[0] = cx_ + dx * scale;
+        out[1] = cy_ + dy * scale;
+    }
+
+    // Writes the r/g/b gains at (x, y).
+    void apply_gains(float x, float y, float *out) const
+    {
+        lookup(x - cx_, y - cy_, out);
+    }
+
+private:
+    RadialTable(int channels, float cx, float cy)
+        : channels_(channels),
+          cx_(cx),
+          cy_(cy)
+    {
+    }
+
+    static std::unique_ptr<RadialTable> sample(
+        lfModifier *modifier,
+        int channels,
+        float cx,
+        float cy,
+        int width,
+        int height);
+    bool verify(lfModifier *modifier, int width, int height);
+
+    // Entry i holds the values at radius i pixels; writes the channels
+    // interpolated at the radius of (dx, dy).
+    void lookup(float dx, float dy, float *out) const
+    {
+        const int last = static_cast<int>(values_.size()) / channels_ - 1;
+        float t = sqrtf(dx * dx + dy * dy);
+        t = t < static_cast<float>(last) ? t : static_cast<float>(last);
+        const int i = static_cast<int>(t);
+        const float f = t - static_cast<float>(i);
+        const float *a = values_.data() + i * channels_;
+        const float *b = i < last ? a + channels_ : a;
+        for (int c = 0; c < channels_; ++c)
+        {
+            out[c] = a[c] + (b[c] - a[c]) * f;
+        }
+    }
+
+    int channels_;
+    float cx_;
+    float cy_;
+    std::vector<float> values_;
+    double residual_ = 0.0;
+};
+} // namespace lfw
+
+#endif
@@ -0,0 +1,332 @@
+#include "lfw_stats.h"
+
+#include "lfw_database.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+#if defined(__EMSCRIPTEN__)
+#include <emscripten/heap.h>
+#endif
+
+namespace lfw
+{
+namespace
+{
+// Latency histogram with four linear sub-buckets per power of two of
+// nanoseconds, which bounds the percentile error to 25% at any scale.
+constexpr int kSubBucketBits = 2;
+constexpr int kSubBuckets = 1 << kSubBucketBits;
+constexpr int kBuckets = 64 * kSubBuckets;
+
+constexpr int kEntryCount = static_cast<int>(Entry::Count);
+
+const char *const kEntryNames[kEntryCount] = {
+    "lfw_init",
+    "lfw_init_filtered",
+    "lfw_dispose",
+    "lfw_db_load_xml",
+    "lfw_db_load_file",
+    "lfw_db_unload",
+    "lfw_db_compact",
+    "lfw_find_lenses_json",
+    "lfw_find_cameras_json",
+    "lfw_available_mods",
+    "lfw_build_geometry_map",
+    "lfw_build_tca_map",
+    "lfw_build_vignetting_map",
+    "lfw_map_stream_create",
+    "lfw_map_stream_rows",
+    "lfw_tiler_create",
+    "lfw_tiler_begin_tile",
+    "lfw_tiler_finish_tile",
+    "lfw_tiler_run",
+    "lfw_zoom_create",
+    "lfw_zoom_blend",
+    "lfw_zoom_prepare",
+    "lfw_zoom_acquire",
+    "lfw_correction_descriptor",
+    "lfw_descriptor_build_map",
+    "lfw_normalized_map_create",
+    "lfw_normalized_map_sample",
+    "lfw_valid_crop",
+    "lfw_thumbnail",
+    "lfw_cfa_vignetting",
+    "lfw_fixed_map_create",
+    "lfw_fixed_map_remap",
+    "lfw_map_job_create",
+    "lfw_map_job_run",
+    "lfw_batch_create",
+    "lfw_batch_add",
+    "lfw_batch_run",
+    "lfw_map_blob_export",
+    "lfw_map_blob_import",
+    "lfw_choose_step",
+};
+
+struct EntryStats
+{
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+    std::atomic<uint64_t> buckets[kBuckets] = {};
+};
+
+EntryStats g_entries[kEntryCount];
+
+int bucket_index(uint64_t ns)
+{
+    if (ns < kSubBuckets)
+    {
+        return static_cast<int>(ns);
+    }
+
+    int exponent = 63;
+    while ((ns >> exponent) == 0)
+    {
+        --exponent;
+    }
+    const int sub = static_cast<int>((ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// Midpoint of a bucket, in nanoseconds.
+double bucket_value(int index)
+{
+    if (index < kSubBuckets)
+    {
+        return static_cast<double>(index);
+    }
+
+    const int exponent = index / kSubBuckets + kSubBucketBits - 1;
+    const int sub = index % kSubBuckets;
+    const double width = static_cast<double>(uint64_t(1) << (exponent - kSubBucketBits));
+    return (kSubBuckets + sub + 0.5) * width;
+}
+
+double percentile_ms(const uint64_t *buckets, uint64_t total, double fraction)
+{
+    if (total == 0)
+    {
+        return 0.0;
+    }
+
+    const uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            return bucket_value(i) / 1e6;
+        }
+    }
+    return bucket_value(kBuckets - 1) / 1e6;
+}
+
+void write_entry(std::ostringstream &out, const EntryStats &stats)
+{
+    uint64_t buckets[kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        buckets[i] = stats.buckets[i].load(std::memory_order_relaxed);
+        total += buckets[i];
+    }
+
+    const uint64_t calls = stats.calls.load(std::memory_order_relaxed);
+    const double max_ms = static_cast<double>(stats.max_ns.load(std::memory_order_relaxed)) / 1e6;
+    out << "{\"calls\":" << calls;
+    out << ",\"totalMs\":" << static_cast<double>(stats.total_ns.load(std::memory_order_relaxed)) / 1e6;
+    out << ",\"maxMs\":" << max_ms;
+    out << ",\"p50Ms\":" << std::min(percentile_ms(buckets, total, 0.50), max_ms);
+    out << ",\"p90Ms\":" << std::min(percentile_ms(buckets, total, 0.90), max_ms);
+    out << ",\"p99Ms\":" << std::min(percentile_ms(buckets, total, 0.99), max_ms);
+    out << ",\"allocations\":" << stats.allocations.load(std::memory_order_relaxed);
+    out << ",\"allocatedBytes\":" << stats.allocated_bytes.load(std::memory_order_relaxed);
+    out << '}';
+}
+
+void write_alloc_categories(std::ostringstream &out, const AllocCategoryStats *categories, bool leaks_only)
+{
+    out << '{';
+    for (int i = 0; i < static_cast<int>(AllocCategory::Count); ++i)
+    {
+        if (i > 0)
+        {
+            out << ',';
+        }
+
+        const AllocCategoryStats &stats = categories[i];
+        out << '"' << alloc_category_name(static_cast<AllocCategory>(i)) << "\":{";
+        if (!leaks_only)
+        {
+            out << "\"allocations\":" << stats.allocations;
+            out << ",\"frees\":" << stats.frees << ',';
+        }
+        out << "\"liveBlocks\":" << stats.live_blocks;
+        out << ",\"liveBytes\":" << stats.live_bytes;
+        if (!leaks_only)
+        {
+            out << ",\"peakBytes\":" << stats.peak_bytes;
+        }
+        out << '}';
+    }
+    out << '}';
+}
+} // namespace
+
+const char *entry_name(Entry entry)
+{
+    return kEntryNames[static_cast<int>(entry)];
+}
+
+void record_call(Entry entry, uint64_t elapsed_ns, const AllocCounters &allocs)
+{
+    EntryStats &stats = g_entries[static_cast<int>(entry)];
+    stats.calls.fetch_add(1, std::memory_order_relaxed);
+    stats.total_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+    stats.allocations.fetch_add(allocs.malloc_calls + allocs.realloc_calls, std::memory_order_relaxed);
+    stats.allocated_bytes.fetch_add(allocs.requested_bytes, std::memory_order_relaxed);
+    stats.buckets[bucket_index(elapsed_ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t seen = stats.max_ns.load(std::memory_order_relaxed);
+    while (elapsed_ns > seen && !stats.max_ns.compare_exchange_weak(seen, elapsed_ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void reset_stats()
+{
+    for (EntryStats &stats : g_entries)
+    {
+        stats.calls.store(0, std::memory_order_relaxed);
+        stats.total_ns.store(0, std::memory_order_relaxed);
+        stats.max_ns.store(0, std::memory_order_relaxed);
+        stats.allocations.store(0, std::memory_order_relaxed);
+        stats.allocated_bytes.store(0, std::memory_order_relaxed);
+        for (auto &bucket : stats.buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string stats_json(const Database *db)
+{
+    std::ostringstream out;
+    out << "{\"calls\":{";
+    for (int i = 0; i < kEntryCount; ++i)
+    {
+        if (i > 0)
+        {
+            out << ',';
+        }
+        out << '"' << kEntryNames[i] << "\":";
+        write_entry(out, g_entries[i]);
+    }
+    out << '}';
+
+    const AllocCounters allocs = process_alloc_counters();
+    out << ",\"allocator\":{\"mallocCalls\":" << allocs.malloc_calls;
+    out << ",\"reallocCalls\":" << allocs.realloc_calls;
+    out << ",\"freeCalls\":" << allocs.free_calls;
+    out << ",\"requestedBytes\":" << allocs.requested_bytes;
+    out << '}';
+
+    out << ",\"database\":";
+    if (db)
+    {
+        const Database::Counts counts = db->counts();
+        out << "{\"documents\":" << counts.documents;
+        out << ",\"lenses\":" << counts.lenses;
+        out << ",\"retiredLenses\":" << counts.retired_lenses;
+        out << ",\"cameras\":" << counts.cameras;
+        out << ",\"retiredCameras\":" << counts.retired_cameras;
+        out << ",\"mounts\":" << counts.mounts;
+        out << ",\"pruned\":{\"lenses\":" << counts.pruned.lenses;
+        out << ",\"cameras\":" << counts.pruned.cameras;
+        out << ",\"calibrations\":" << counts.pruned.calibrations;
+        out << ",\"xmlBytes\":" << counts.pruned.xml_bytes << '}';
+        out << ",\"packages\":{\"count\":" << counts.packages.packages;
+        out << ",\"documents\":" << counts.packages.documents;
+        out << ",\"packedBytes\":" << counts.packages.packed_bytes;
+        out << ",\"xmlBytes\":" << counts.packages.xml_bytes << '}';
+        out << ",\"calibrationCache\":{";
+        const char *const kinds[] = {
+            "distortion",
+            "tca",
+            "vignetting",
+            "reverseGeometry",
+            "radialGeometry",
+            "radialVignetting",
+        };
+        for (int i = 0; i < static_cast<int>(CalibrationKind::Count); ++i)
+        {
+            const CalibrationCache::Counters cache = db->calibrations().counters(static_cast<CalibrationKind>(i));
+            out << (i == 0 ? "" : ",") << '"' << kinds[i] << "\":{\"hits\":" << cache.hits
+                << ",\"misses\":" << cache.misses << ",\"entries\":" << cache.entries
+                << ",\"bytes\":" << cache.bytes << '}';
+        }
+        out << "}}";
+    }
+    else
+    {
+        out << "null";
+    }
+
+    out << '}';
+    return out.str();
+}
+
+std::string alloc_report_json()
+{
+    const AllocTrackingReport report = alloc_tracking_report();
+
+    std::ostringstream out;
+    out << "{\"enabled\":" << (report.enabled ? "true" : "false");
+    out << ",\"liveBytes\":" << report.live_bytes;
+    out << ",\"peakBytes\":" << report.peak_bytes;
+#if defined(__EMSCRIPTEN__)
+    out << ",\"heapBytes\":" << emscripten_get_heap_size();
+#else
+    out << ",\"heapBytes\":null";
+#endif
+    out << ",\"categories\":";
+    write_alloc_categories(out, report.categories, false);
+    out << ",\"leaksAtDispose\":";
+    if (report.has_dispose_leaks)
+    {
+        write_alloc_categories(out, report.dispose_leaks, true);
+    }
+    else
+    {
+        out << "null";
+    }
+    out << '}';
+    return out.str();
+}
+
+void report_dispose_leaks()
+{
+    const AllocTrackingReport report = alloc_tracking_mark_dispose();
+    for (int i = 0; i < static_cast<int>(AllocCategory::Count); ++i)
+    {
+        const AllocCategoryStats &leaks = report.dispose_leaks[i];
+        if (leaks.live_blocks != 0)
+        {
+            fprintf(
+                stderr,
+                "[lensfun-wasm] %llu block(s), %llu byte(s) still live at dispose (%s)\n",
+                static_cast<unsigned long long>(leaks.live_blocks),
+                static_cast<unsigned long long>(leaks.live_bytes),
+                alloc_category_name(static_cast<AllocCategory>(i)));
+        }
+    }
+}
+} // namespace lfw
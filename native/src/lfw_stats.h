@@ -0,0 +1,118 @@
+#ifndef LFW_STATS_H
+#define LFW_STATS_H
+
+#include "lfw_alloc.h"
+#include "lfw_trace.h"
+
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+
+namespace lfw
+{
+class Database;
+
+enum class Entry
+{
+    Init,
+    InitFiltered,
+    Dispose,
+    DbLoadXml,
+    DbLoadFile,
+    DbUnload,
+    DbCompact,
+    FindLenses,
+    FindCameras,
+    AvailableMods,
+    BuildGeometryMap,
+    BuildTcaMap,
+    BuildVignettingMap,
+    MapStreamCreate,
+    MapStreamRows,
+    TilerCreate,
+    TilerBeginTile,
+    TilerFinishTile,
+    TilerRun,
+    ZoomCreate,
+    ZoomBlend,
+    ZoomPrepare,
+    ZoomAcquire,
+    CorrectionDescriptor,
+    DescriptorBuildMap,
+    NormalizedMapCreate,
+    NormalizedMapSample,
+    ValidCrop,
+    Thumbnail,
+    CfaVignetting,
+    FixedMapCreate,
+    FixedMapRemap,
+    MapJobCreate,
+    MapJobRun,
+    BatchCreate,
+    BatchAdd,
+    BatchRun,
+    MapBlobExport,
+    MapBlobImport,
+    ChooseStep,
+    Count
+};
+
+const char *entry_name(Entry entry);
+void record_call(Entry entry, uint64_t elapsed_ns, const AllocCounters &allocs);
+void reset_stats();
+
+// Stats document returned by lfw_get_stats_json. `db` may be null.
+std::string stats_json(const Database *db);
+
+// Allocation tracker document returned by lfw_alloc_report_json.
+std::string alloc_report_json();
+
+// Snapshots the tracker's live blocks as leaks and logs them to stderr.
+void report_dispose_leaks();
+
+// Times one entry-point call and attributes the g_malloc traffic made on the
+// calling thread meanwhile. Costs two clock reads and a few relaxed atomics.
+// While tracing is on, the call is also recorded as a trace span.
+class CallTimer
+{
+public:
+    explicit CallTimer(Entry entry)
+        : entry_(entry),
+          start_(std::chrono::steady_clock::now()),
+          allocs_(thread_alloc_counters())
+    {
+    }
+
+    ~CallTimer()
+    {
+        const auto end = std::chrono::steady_clock::now();
+        const auto elapsed = end - start_;
+        const AllocCounters now = thread_alloc_counters();
+        AllocCounters delta;
+        delta.malloc_calls = now.malloc_calls - allocs_.malloc_calls;
+        delta.realloc_calls = now.realloc_calls - allocs_.realloc_calls;
+        delta.free_calls = now.free_calls - allocs_.free_calls;
+        delta.requested_bytes = now.requested_bytes - allocs_.requested_bytes;
+        record_call(
+            entry_,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+            delta);
+
+        if (trace_enabled())
+        {
+            trace_complete(entry_name(entry_), start_, end, nullptr);
+        }
+    }
+
+    CallTimer(const CallTimer &) = delete;
+    CallTimer &operator=(const CallTimer &) = delete;
+
+private:
+    Entry entry_;
+    std::chrono::steady_clock::time_point start_;
+    AllocCounters allocs_;
+};
+} // namespace lfw
+
+#endif
@@ -0,0 +1,158 @@
+#include "lfw_step.h"
+
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace lfw
+{
+namespace
+{
+// Image points whose grid cells are probed, as fractions of each side.
+const float kProbeFractions[] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
+
+// Largest difference between the bilinear blend of the probed cells'
+// corners and the exact map at points inside them and along their edges.
+int32_t probe_step(MapBuilder &builder, const MapRequest &map, int step, double *error, int *evaluations)
+{
+    const TraceSpan span("step probe");
+    const int channels = map_channels(map.kind);
+    const int grid_width = grid_points(map.width, step);
+    const int grid_height = grid_points(map.height, step);
+
+    // Quarters of the step inside a cell; fewer for small steps.
+    std::vector<int> offsets;
+    for (int q = 0; q < 4; ++q)
+    {
+        const int offset = step * q / 4;
+        if (offsets.empty() || offset != offsets.back())
+        {
+            offsets.push_back(offset);
+        }
+    }
+
+    std::vector<std::pair<int, int>> cells;
+    for (float fy : kProbeFractions)
+    {
+        for (float fx : kProbeFractions)
+        {
+            const int cx = std::min(static_cast<int>(fx * static_cast<float>(map.width - 1)) / step, grid_width - 2);
+            const int cy = std::min(static_cast<int>(fy * static_cast<float>(map.height - 1)) / step, grid_height - 2);
+            cells.emplace_back(cx, cy);
+        }
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    float corners[4][6];
+    float exact[6];
+    double worst = 0.0;
+    for (const std::pair<int, int> &cell : cells)
+    {
+        const int x0 = cell.first * step;
+        const int y0 = cell.second * step;
+        for (int k = 0; k < 4; ++k)
+        {
+            const int32_t rc = builder.fill_point(
+                static_cast<float>(x0 + (k & 1) * step), static_cast<float>(y0 + (k >> 1) * step), corners[k]);
+            if (rc != 0)
+            {
+                return rc;
+            }
+        }
+        *evaluations += 4;
+
+        for (int oy : offsets)
+        {
+            for (int ox : offsets)
+            {
+                if (ox == 0 && oy == 0)
+                {
+                    continue;
+                }
+                const int32_t rc = builder.fill_point(static_cast<float>(x0 + ox), static_cast<float>(y0 + oy), exact);
+                if (rc != 0)
+                {
+                    return rc;
+                }
+                ++*evaluations;
+                // The blend readers of the map use, as in sample_map.
+                const float fx = static_cast<float>(ox) / static_cast<float>(step);
+                const float fy = static_cast<float>(oy) / static_cast<float>(step);
+                for (int c = 0; c < channels; ++c)
+                {
+                    const float top = corners[0][c] + (corners[1][c] - corners[0][c]) * fx;
+                    const float bottom = corners[2][c] + (corners[3][c] - corners[2][c]) * fx;
+                    const float value = top + (bottom - top) * fy;
+                    worst = std::max(worst, fabs(static_cast<double>(value) - exact[c]));
+                }
+            }
+        }
+    }
+    *error = worst;
+    return 0;
+}
+} // namespace
+
+int32_t choose_step(const StepRequest &request, std::shared_ptr<Database> db, StepChoice *out)
+{
+    const MapRequest &r = request.map;
+    if (!r.lens || r.width <= 0 || r.height <= 0 || map_channels(r.kind) == 0 || !(request.tolerance > 0.0f) ||
+        request.max_step <= 0 || !out)
+    {
+        return -1;
+    }
+    const int max_step = std::max(1, std::min(request.max_step, std::min(r.width, r.height) - 1));
+
+    MapRequest exact = r;
+    exact.step = 1;
+    MapBuilder builder(exact, std::move(db));
+    int32_t rc = builder.init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    // Step 1 always passes; `fail` is the smallest step known not to.
+    StepChoice choice;
+    int fail = max_step + 1;
+    int next = max_step;
+    while (next > choice.step)
+    {
+        double error = 0.0;
+        rc = probe_step(builder, r, next, &error, &choice.evaluations);
+        if (rc != 0)
+        {
+            return rc;
+        }
+        if (error <= request.tolerance)
+        {
+            choice.step = next;
+            choice.error = error;
+        }
+        else
+        {
+            fail = next;
+        }
+        if (fail - choice.step <= 1)
+        {
+            break;
+        }
+        // Aim where this error predicts the tolerance is met, but at least a
+        // quarter of the bracket in from either end so the search narrows
+        // quickly even when the prediction is poor.
+        const double predicted =
+            error > 0.0 ? static_cast<double>(next) * sqrt(request.tolerance / error) : static_cast<double>(fail);
+        const int margin = std::max(1, (fail - choice.step) / 4);
+        const int lower = choice.step + margin;
+        const int upper = std::max(lower, fail - margin);
+        next = std::min(std::max(static_cast<int>(predicted), lower), upper);
+    }
+    *out = choice;
+    return 0;
+}
+} // namespace lfw
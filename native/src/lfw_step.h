@@ -0,0 +1,58 @@
+#ifndef LFW_STEP_H
+#define LFW_STEP_H
+
+#include "lfw_maps.h"
+
+#include <stdint.h>
+
+#include <memory>
+
+namespace lfw
+{
+// Floats written by lfw_choose_step: step, error, points evaluated.
+constexpr int kStepChoiceFloats = 3;
+
+struct StepRequest
+{
+    // `map.step` is ignored.
+    MapRequest map;
+    // Largest allowed difference between the bilinear reconstruction of a
+    // grid and the exact map, in pixels for geometry and TCA and in gain for
+    // vignetting.
+    float tolerance = 0.1f;
+    // Clamped to one less than the shorter side, so the grid has a cell in
+    // each direction.
+    int max_step = 64;
+};
+
+struct StepChoice
+{
+    int step = 1;
+    // The largest difference found by the probe at `step`; 0 at step 1,
+    // where every pixel is a grid point.
+    double error = 0.0;
+    // Map points the choice cost, to compare with the grid it saves.
+    int evaluations = 0;
+};
+
+// Picks the largest step up to `max_step` whose grid reconstructs the map
+// within tolerance, without building any grid.
+//
+// A step is probed on the grid cells under a 5x5 lattice of image points
+// (the corners, edge midpoints and centre among them, where radial models
+// bend most): the cell's corners and a few points inside and along its edges
+// are evaluated, and each inner point is compared with the bilinear blend of
+// the corners. Bilinear error grows with the square of the step, so the next
+// step tried is the one the last error predicts to meet the tolerance, kept
+// inside the bracket of steps already probed; a few probes settle the
+// search.
+//
+// The error is measured between grid points. Pixels past the last grid row
+// or column are outside every cell, and how they are filled is up to the
+// reader of the map.
+//
+// Returns 0, -1 for a bad request or the MapBuilder codes.
+int32_t choose_step(const StepRequest &request, std::shared_ptr<Database> db, StepChoice *out);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,340 @@
+#include "lfw_thumbnail.h"
+
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace lfw
+{
+namespace
+{
+constexpr int kThumbnailMods = LF_MODIFY_DISTORTION | LF_MODIFY_TCA | LF_MODIFY_VIGNETTING;
+
+constexpr int kLanczosLobes = 3;
+constexpr float kPi = 3.14159265358979f;
+// A footprint is at most this many times the nominal block size, so the
+// stretched corners of a strong distortion cannot make one pixel read a
+// large part of the source.
+constexpr float kMaxStretch = 4.0f;
+
+// Source pixels and normalized weights along one axis.
+struct Taps
+{
+    int first = 0;
+    std::vector<float> weights;
+};
+
+float sinc(float x)
+{
+    if (fabsf(x) < 1e-6f)
+    {
+        return 1.0f;
+    }
+    const float px = kPi * x;
+    return sinf(px) / px;
+}
+
+// Fills `taps` for a footprint `size` source pixels wide centred on
+// `centre`, clipped to [0, extent). Returns false when no source pixel has
+// weight.
+bool axis_taps(ThumbnailFilter filter, float centre, float size, int extent, Taps *taps)
+{
+    int first = 0;
+    int last = -1;
+    if (filter == ThumbnailFilter::Box)
+    {
+        // Pixel i covers [i - 0.5, i + 0.5].
+        const float half = 0.5f * size;
+        first = std::max(0, static_cast<int>(floorf(centre - half + 0.5f)));
+        last = std::min(extent - 1, static_cast<int>(floorf(centre + half + 0.5f)));
+    }
+    else
+    {
+        const float radius = kLanczosLobes * size;
+        first = std::max(0, static_cast<int>(ceilf(centre - radius)));
+        last = std::min(extent - 1, static_cast<int>(floorf(centre + radius)));
+    }
+    if (last < first)
+    {
+        return false;
+    }
+
+    taps->first = first;
+    taps->weights.resize(last - first + 1);
+    float sum = 0.0f;
+    for (int i = first; i <= last; ++i)
+    {
+        float weight = 0.0f;
+        if (filter == ThumbnailFilter::Box)
+        {
+            const float half = 0.5f * size;
+            weight = std::max(0.0f, std::min(i + 0.5f, centre + half) - std::max(i - 0.5f, centre - half));
+        }
+        else
+        {
+            const float t = (static_cast<float>(i) - centre) / size;
+            weight = sinc(t) * sinc(t / kLanczosLobes);
+        }
+        taps->weights[i - first] = weight;
+        sum += weight;
+    }
+    if (!(sum > 1e-6f))
+    {
+        return false;
+    }
+    for (float &weight : taps->weights)
+    {
+        weight /= sum;
+    }
+    return true;
+}
+
+// Weighted sum of `Count` interleaved channels under one footprint; the
+// count is fixed so the inner loop unrolls.
+template <int Count>
+void filter_taps(const float *source, int channels, size_t row_floats, const Taps &tx, const Taps &ty, float *out)
+{
+    float sum[Count] = {};
+    const size_t columns = tx.weights.size();
+    for (size_t j = 0; j < ty.weights.size(); ++j)
+    {
+        const float *p = source + row_floats * (ty.first + j) + static_cast<size_t>(tx.first) * channels;
+        float row[Count] = {};
+        for (size_t i = 0; i < columns; ++i, p += channels)
+        {
+            const float w = tx.weights[i];
+            for (int c = 0; c < Count; ++c)
+            {
+                row[c] += p[c] * w;
+            }
+        }
+        const float w = ty.weights[j];
+        for (int c = 0; c < Count; ++c)
+        {
+            sum[c] += row[c] * w;
+        }
+    }
+    for (int c = 0; c < Count; ++c)
+    {
+        out[c] = sum[c];
+    }
+}
+
+void filter_channels(
+    const float *source, int channels, int count, size_t row_floats, const Taps &tx, const Taps &ty, float *out)
+{
+    switch (count)
+    {
+    case 1:
+        filter_taps<1>(source, channels, row_floats, tx, ty, out);
+        break;
+    case 3:
+        filter_taps<3>(source, channels, row_floats, tx, ty, out);
+        break;
+    default:
+        filter_taps<4>(source, channels, row_floats, tx, ty, out);
+        break;
+    }
+}
+
+// Footprint along one axis from the spacing of the neighbouring centres,
+// between one pixel and kMaxStretch blocks.
+float footprint(float before, float here, float after, bool has_before, bool has_after, float nominal)
+{
+    float spacing = nominal;
+    if (has_before && has_after)
+    {
+        spacing = 0.5f * fabsf(after - before);
+    }
+    else if (has_before)
+    {
+        spacing = fabsf(here - before);
+    }
+    else if (has_after)
+    {
+        spacing = fabsf(after - here);
+    }
+    if (!(spacing == spacing))
+    {
+        spacing = nominal;
+    }
+    return std::min(std::max(spacing, 1.0f), kMaxStretch * nominal);
+}
+} // namespace
+
+int32_t render_thumbnail(const ThumbnailRequest &request, CalibrationCache &cache, const float *source, float *out)
+{
+    const ThumbnailRequest &r = request;
+    const bool channels_ok = r.channels == 1 || r.channels == 3 || r.channels == 4;
+    const bool filter_ok = r.filter == ThumbnailFilter::Box || r.filter == ThumbnailFilter::Lanczos3;
+    if (!r.lens || !source || !out || r.width <= 0 || r.height <= 0 || r.out_width <= 0 || r.out_height <= 0 ||
+        !channels_ok || !filter_ok || (r.mods & ~kThumbnailMods) != 0)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("thumbnail");
+    lfModifier *modifier = nullptr;
+    bool geometry = false;
+    bool tca = false;
+    bool vignetting = false;
+    if (r.mods != 0)
+    {
+        {
+            const TraceSpan create_span("lf_modifier_create");
+            modifier = lf_modifier_create(r.lens, r.focal, r.crop, r.width, r.height, LF_PF_F32, false);
+        }
+        if (!modifier)
+        {
+            return -3;
+        }
+        if (r.mods & LF_MODIFY_DISTORTION)
+        {
+            geometry = (enable_distortion(modifier, cache, r.lens, r.crop, r.focal) & LF_MODIFY_DISTORTION) != 0;
+        }
+        if (r.mods & LF_MODIFY_TCA)
+        {
+            tca = (enable_tca(modifier, cache, r.lens, r.crop, r.focal) & LF_MODIFY_TCA) != 0;
+        }
+        if (r.mods & LF_MODIFY_VIGNETTING)
+        {
+            vignetting = (enable_vignetting(modifier, cache, r.lens, r.crop, r.focal, r.aperture, r.distance) &
+                          LF_MODIFY_VIGNETTING) != 0;
+        }
+        if (geometry != ((r.mods & LF_MODIFY_DISTORTION) != 0) || tca != ((r.mods & LF_MODIFY_TCA) != 0) ||
+            vignetting != ((r.mods & LF_MODIFY_VIGNETTING) != 0))
+        {
+            lf_modifier_destroy(modifier);
+            return -4;
+        }
+    }
+
+    // Source centres of every output pixel: one coordinate pair, or one per
+    // colour with TCA.
+    const int stride = tca ? 6 : 2;
+    const int green = tca ? 2 : 0;
+    const float sx = static_cast<float>(r.width) / static_cast<float>(r.out_width);
+    const float sy = static_cast<float>(r.height) / static_cast<float>(r.out_height);
+    std::vector<float> coords(static_cast<size_t>(r.out_width) * r.out_height * stride);
+    {
+        const TraceSpan coords_span("thumbnail coords");
+        float *c = coords.data();
+        for (int v = 0; v < r.out_height; ++v)
+        {
+            const float y = (static_cast<float>(v) + 0.5f) * sy - 0.5f;
+            for (int u = 0; u < r.out_width; ++u, c += stride)
+            {
+                const float x = (static_cast<float>(u) + 0.5f) * sx - 0.5f;
+                bool ok = true;
+                if (geometry && tca)
+                {
+                    ok = lf_modifier_apply_subpixel_geometry_distortion(modifier, x, y, 1, 1, c);
+                }
+                else if (tca)
+                {
+                    ok = lf_modifier_apply_subpixel_distortion(modifier, x, y, 1, 1, c);
+                }
+                else if (geometry)
+                {
+                    ok = lf_modifier_apply_geometry_distortion(modifier, x, y, 1, 1, c);
+                }
+                else
+                {
+                    c[0] = x;
+                    c[1] = y;
+                }
+                if (!ok)
+                {
+                    lf_modifier_destroy(modifier);
+                    return -5;
+                }
+            }
+        }
+    }
+
+    const TraceSpan filter_span("thumbnail filter");
+    const int channels = r.channels;
+    const size_t row_floats = static_cast<size_t>(r.width) * channels;
+    const size_t coord_row = static_cast<size_t>(r.out_width) * stride;
+    const float max_x = static_cast<float>(r.width) - 0.5f;
+    const float max_y = static_cast<float>(r.height) - 0.5f;
+    Taps tx;
+    Taps ty;
+    int32_t rc = 0;
+    for (int v = 0; v < r.out_height && rc == 0; ++v)
+    {
+        const float *row = coords.data() + coord_row * v;
+        for (int u = 0; u < r.out_width; ++u)
+        {
+            const float *c = row + static_cast<size_t>(u) * stride;
+            float *pixel = out + (static_cast<size_t>(v) * r.out_width + u) * channels;
+            std::fill(pixel, pixel + channels, 0.0f);
+
+            const float gx = c[green];
+            const float gy = c[green + 1];
+            const bool has_left = u > 0;
+            const bool has_right = u + 1 < r.out_width;
+            const bool has_up = v > 0;
+            const bool has_down = v + 1 < r.out_height;
+            const float fx = footprint(
+                has_left ? c[green - stride] : 0.0f, gx, has_right ? c[green + stride] : 0.0f, has_left, has_right, sx);
+            const float fy = footprint(
+                has_up ? c[green + 1 - coord_row] : 0.0f,
+                gy,
+                has_down ? c[green + 1 + coord_row] : 0.0f,
+                has_up,
+                has_down,
+                sy);
+
+            // Every colour about its own centre with TCA; intensity and
+            // alpha follow green.
+            const int passes = tca && channels >= 3 ? 3 : 1;
+            for (int p = 0; p < passes; ++p)
+            {
+                const float cx = c[p * 2 + (passes == 1 ? green : 0)];
+                const float cy = c[p * 2 + 1 + (passes == 1 ? green : 0)];
+                if (!(cx >= -0.5f && cx <= max_x && cy >= -0.5f && cy <= max_y) ||
+                    !axis_taps(r.filter, cx, fx, r.width, &tx) || !axis_taps(r.filter, cy, fy, r.height, &ty))
+                {
+                    continue;
+                }
+                if (passes == 1)
+                {
+                    filter_channels(source, channels, channels, row_floats, tx, ty, pixel);
+                    continue;
+                }
+                filter_channels(source + p, channels, 1, row_floats, tx, ty, pixel + p);
+                if (p == 1 && channels == 4)
+                {
+                    filter_channels(source + 3, channels, 1, row_floats, tx, ty, pixel + 3);
+                }
+            }
+
+            if (vignetting && gx >= -0.5f && gx <= max_x && gy >= -0.5f && gy <= max_y)
+            {
+                float gain = 1.0f;
+                if (!lf_modifier_apply_color_modification(
+                        modifier, &gain, gx, gy, 1, 1, LF_CR_1(INTENSITY), static_cast<int>(sizeof(float))))
+                {
+                    rc = -5;
+                    break;
+                }
+                // Alpha is not a colour and keeps its value.
+                const int colours = channels == 4 ? 3 : channels;
+                for (int k = 0; k < colours; ++k)
+                {
+                    pixel[k] *= gain;
+                }
+            }
+        }
+    }
+    if (modifier)
+    {
+        lf_modifier_destroy(modifier);
+    }
+    return rc;
+}
+} // namespace lfw
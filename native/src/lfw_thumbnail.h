@@ -0,0 +1,55 @@
+#ifndef LFW_THUMBNAIL_H
+#define LFW_THUMBNAIL_H
+
+#include "lensfun.h"
+#include "lfw_calibration.h"
+
+#include <stdint.h>
+
+namespace lfw
+{
+enum class ThumbnailFilter
+{
+    // Average of the source pixels under the output pixel's footprint.
+    Box = 0,
+    // Lanczos with three lobes, stretched to the footprint.
+    Lanczos3 = 1
+};
+
+struct ThumbnailRequest
+{
+    const lfLens *lens = nullptr;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    // Vignetting only.
+    float aperture = 0.0f;
+    float distance = 0.0f;
+    // Source image.
+    int width = 0;
+    int height = 0;
+    // Interleaved float pixels: 1 (intensity), 3 (RGB) or 4 (RGB + alpha).
+    int channels = 3;
+    // LF_MODIFY_DISTORTION, LF_MODIFY_TCA and LF_MODIFY_VIGNETTING; none
+    // gives a plain downscale.
+    int mods = 0;
+    int out_width = 0;
+    int out_height = 0;
+    ThumbnailFilter filter = ThumbnailFilter::Box;
+};
+
+// Corrects and downscales `source` in one pass, without a full-size
+// corrected image or map. Each output pixel covers a block of the corrected
+// full-size image; its centre is taken through lensfun to the source, where
+// the prefilter is applied over the block's footprint, sized from the
+// spacing of neighbouring centres so that strong distortion neither aliases
+// nor blurs. With TCA every colour is filtered about its own centre, with
+// intensity and alpha following green. Vignetting is the gain at the
+// footprint centre. Pixels whose centre maps outside the source are 0.
+//
+// Returns 0, -1 for a bad request, -3 when lensfun has no modifier, -4 when a
+// requested correction is not available for the lens, or -5 when lensfun
+// rejects a point.
+int32_t render_thumbnail(const ThumbnailRequest &request, CalibrationCache &cache, const float *source, float *out);
+} // namespace lfw
+
+#endif
@@ -0,0 +1,325 @@
+#include "lfw_tiles.h"
+
+#include "lfw_handles.h"
+#include "lfw_trace.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<TileCorrector> g_tilers;
+
+constexpr int kTileMods = LF_MODIFY_DISTORTION | LF_MODIFY_TCA | LF_MODIFY_VIGNETTING;
+
+int component_roles(int channels)
+{
+    switch (channels)
+    {
+    case 1:
+        return LF_CR_1(INTENSITY);
+    case 3:
+        return LF_CR_3(RED, GREEN, BLUE);
+    default:
+        return LF_CR_4(RED, GREEN, BLUE, UNKNOWN);
+    }
+}
+
+int tiles_along(int size, int tile)
+{
+    return (size + tile - 1) / tile;
+}
+} // namespace
+
+TileCorrector::TileCorrector(const TileRequest &request, std::shared_ptr<Database> db)
+    : request_(request),
+      db_(std::move(db))
+{
+}
+
+TileCorrector::~TileCorrector()
+{
+    if (modifier_)
+    {
+        lf_modifier_destroy(modifier_);
+    }
+}
+
+int32_t TileCorrector::init()
+{
+    const TileRequest &r = request_;
+    const bool channels_ok = r.channels == 1 || r.channels == 3 || r.channels == 4;
+    if (!r.lens || r.width <= 0 || r.height <= 0 || r.tile_size <= 0 || !channels_ok || (r.mods & kTileMods) == 0 ||
+        (r.mods & ~kTileMods) != 0)
+    {
+        return -1;
+    }
+
+    {
+        const TraceSpan span("lf_modifier_create");
+        modifier_ = lf_modifier_create(r.lens, r.focal, r.crop, r.width, r.height, LF_PF_F32, false);
+    }
+    if (!modifier_)
+    {
+        return -3;
+    }
+
+    CalibrationCache &cache = db_->calibrations();
+    if (r.mods & LF_MODIFY_DISTORTION)
+    {
+        geometry_ = (enable_distortion(modifier_, cache, r.lens, r.crop, r.focal) & LF_MODIFY_DISTORTION) != 0;
+    }
+    if (r.mods & LF_MODIFY_TCA)
+    {
+        tca_ = (enable_tca(modifier_, cache, r.lens, r.crop, r.focal) & LF_MODIFY_TCA) != 0;
+    }
+    if (r.mods & LF_MODIFY_VIGNETTING)
+    {
+        vignetting_ = (enable_vignetting(modifier_, cache, r.lens, r.crop, r.focal, r.aperture, r.distance) &
+                       LF_MODIFY_VIGNETTING) != 0;
+    }
+    if (geometry_ != ((r.mods & LF_MODIFY_DISTORTION) != 0) || tca_ != ((r.mods & LF_MODIFY_TCA) != 0) ||
+        vignetting_ != ((r.mods & LF_MODIFY_VIGNETTING) != 0))
+    {
+        return -4;
+    }
+
+    coord_stride_ = tca_ ? 6 : geometry_ ? 2 : 0;
+    return 0;
+}
+
+int TileCorrector::tile_count() const
+{
+    return tiles_along(request_.width, request_.tile_size) * tiles_along(request_.height, request_.tile_size);
+}
+
+int32_t TileCorrector::begin_tile(int index, TileRect *dst, TileRect *src)
+{
+    has_tile_ = false;
+    if (!modifier_ || index < 0 || index >= tile_count())
+    {
+        return -1;
+    }
+
+    const int tile = request_.tile_size;
+    const int columns = tiles_along(request_.width, tile);
+    dst_.x = (index % columns) * tile;
+    dst_.y = (index / columns) * tile;
+    dst_.width = std::min(tile, request_.width - dst_.x);
+    dst_.height = std::min(tile, request_.height - dst_.y);
+
+    if (coord_stride_ == 0)
+    {
+        // Vignetting alone moves no pixels.
+        src_ = dst_;
+    }
+    else
+    {
+        const TraceSpan span("tile coords");
+        const size_t row = static_cast<size_t>(dst_.width) * coord_stride_;
+        coords_.resize(row * dst_.height);
+        for (int j = 0; j < dst_.height; ++j)
+        {
+            const float x = static_cast<float>(dst_.x);
+            const float y = static_cast<float>(dst_.y + j);
+            float *out = coords_.data() + row * j;
+            bool ok = false;
+            if (geometry_ && tca_)
+            {
+                ok = lf_modifier_apply_subpixel_geometry_distortion(modifier_, x, y, dst_.width, 1, out);
+            }
+            else if (tca_)
+            {
+                ok = lf_modifier_apply_subpixel_distortion(modifier_, x, y, dst_.width, 1, out);
+            }
+            else
+            {
+                ok = lf_modifier_apply_geometry_distortion(modifier_, x, y, dst_.width, 1, out);
+            }
+            if (!ok)
+            {
+                return -4;
+            }
+        }
+
+        // Bounding box of every in-image coordinate plus the right/bottom
+        // neighbour bilinear sampling reads.
+        const float max_x = static_cast<float>(request_.width - 1);
+        const float max_y = static_cast<float>(request_.height - 1);
+        int x0 = request_.width;
+        int y0 = request_.height;
+        int x1 = -1;
+        int y1 = -1;
+        for (size_t i = 0; i + 1 < coords_.size(); i += 2)
+        {
+            const float cx = coords_[i];
+            const float cy = coords_[i + 1];
+            if (!(cx >= 0.0f && cx <= max_x && cy >= 0.0f && cy <= max_y))
+            {
+                continue;
+            }
+            const int fx = static_cast<int>(cx);
+            const int fy = static_cast<int>(cy);
+            x0 = std::min(x0, fx);
+            y0 = std::min(y0, fy);
+            x1 = std::max(x1, std::min(fx + 1, request_.width - 1));
+            y1 = std::max(y1, std::min(fy + 1, request_.height - 1));
+        }
+
+        src_ = TileRect();
+        if (x1 >= x0 && y1 >= y0)
+        {
+            src_.x = x0;
+            src_.y = y0;
+            src_.width = x1 - x0 + 1;
+            src_.height = y1 - y0 + 1;
+        }
+    }
+
+    source_.resize(static_cast<size_t>(src_.width) * src_.height * request_.channels);
+    *dst = dst_;
+    *src = src_;
+    has_tile_ = true;
+    return 0;
+}
+
+int32_t TileCorrector::finish_tile(float *out, size_t out_len)
+{
+    if (!has_tile_ || !out)
+    {
+        return -1;
+    }
+    const int channels = request_.channels;
+    if (out_len < static_cast<size_t>(dst_.width) * dst_.height * channels)
+    {
+        return -2;
+    }
+    has_tile_ = false;
+
+    if (vignetting_ && src_.width > 0)
+    {
+        const TraceSpan span("tile vignetting");
+        if (!lf_modifier_apply_color_modification(
+                modifier_,
+                source_.data(),
+                static_cast<float>(src_.x),
+                static_cast<float>(src_.y),
+                src_.width,
+                src_.height,
+                component_roles(channels),
+                src_.width * channels * static_cast<int>(sizeof(float))))
+        {
+            return -5;
+        }
+    }
+
+    if (coord_stride_ == 0)
+    {
+        memcpy(out, source_.data(), source_.size() * sizeof(float));
+    }
+    else
+    {
+        sample_tile(out);
+    }
+    return 0;
+}
+
+// Bilinear resampling of the source footprint. Pixels whose coordinate falls
+// outside the image are written as 0.
+void TileCorrector::sample_tile(float *out) const
+{
+    const TraceSpan span("tile resample");
+    const int channels = request_.channels;
+    const float max_x = static_cast<float>(request_.width - 1);
+    const float max_y = static_cast<float>(request_.height - 1);
+    const size_t src_row = static_cast<size_t>(src_.width) * channels;
+    const size_t pixels = static_cast<size_t>(dst_.width) * dst_.height;
+
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        const float *coord = coords_.data() + i * coord_stride_;
+        for (int c = 0; c < channels; ++c)
+        {
+            // With TCA each colour has its own coordinate; intensity and
+            // alpha follow green.
+            const int pair = coord_stride_ == 6 ? (channels == 1 || c == 3 ? 1 : c) : 0;
+            const float x = coord[pair * 2];
+            const float y = coord[pair * 2 + 1];
+            float value = 0.0f;
+            if (x >= 0.0f && x <= max_x && y >= 0.0f && y <= max_y)
+            {
+                const float lx = x - static_cast<float>(src_.x);
+                const float ly = y - static_cast<float>(src_.y);
+                const int x0 = static_cast<int>(lx);
+                const int y0 = static_cast<int>(ly);
+                const int x1 = std::min(x0 + 1, src_.width - 1);
+                const int y1 = std::min(y0 + 1, src_.height - 1);
+                const float fx = lx - static_cast<float>(x0);
+                const float fy = ly - static_cast<float>(y0);
+                const float *row0 = source_.data() + src_row * y0;
+                const float *row1 = source_.data() + src_row * y1;
+                const float top = row0[x0 * channels + c] + (row0[x1 * channels + c] - row0[x0 * channels + c]) * fx;
+                const float bottom = row1[x0 * channels + c] + (row1[x1 * channels + c] - row1[x0 * channels + c]) * fx;
+                value = top + (bottom - top) * fy;
+            }
+            out[i * channels + c] = value;
+        }
+    }
+}
+
+int32_t TileCorrector::run(TileReadFn read, TileWriteFn write, void *user)
+{
+    if (!read || !write)
+    {
+        return -1;
+    }
+
+    const int tiles = tile_count();
+    for (int index = 0; index < tiles; ++index)
+    {
+        TileRect dst;
+        TileRect src;
+        int32_t rc = begin_tile(index, &dst, &src);
+        if (rc != 0)
+        {
+            return rc;
+        }
+        if (src.width > 0 && read(user, src.x, src.y, src.width, src.height, source_buffer()) != 0)
+        {
+            has_tile_ = false;
+            return -6;
+        }
+
+        output_.resize(static_cast<size_t>(dst.width) * dst.height * request_.channels);
+        rc = finish_tile(output_.data(), output_.size());
+        if (rc != 0)
+        {
+            return rc;
+        }
+        if (write(user, dst.x, dst.y, dst.width, dst.height, output_.data()) != 0)
+        {
+            return -7;
+        }
+    }
+    return 0;
+}
+
+uint32_t register_tiler(std::unique_ptr<TileCorrector> tiler)
+{
+    return g_tilers.add(std::move(tiler));
+}
+
+TileCorrector *find_tiler(uint32_t handle)
+{
+    return g_tilers.find(handle);
+}
+
+bool destroy_tiler(uint32_t handle)
+{
+    return g_tilers.remove(handle);
+}
+} // namespace lfw
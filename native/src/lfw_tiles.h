@@ -0,0 +1,111 @@
+#ifndef LFW_TILES_H
+#define LFW_TILES_H
+
+#include "lensfun.h"
+#include "lfw_database.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace lfw
+{
+struct TileRect
+{
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct TileRequest
+{
+    const lfLens *lens = nullptr;
+    float focal = 0.0f;
+    float crop = 0.0f;
+    // Vignetting only.
+    float aperture = 0.0f;
+    float distance = 0.0f;
+    int width = 0;
+    int height = 0;
+    // Interleaved float pixels: 1 (intensity), 3 (RGB) or 4 (RGB + alpha).
+    int channels = 3;
+    // LF_MODIFY_DISTORTION, LF_MODIFY_TCA and LF_MODIFY_VIGNETTING.
+    int mods = 0;
+    int tile_size = 256;
+};
+
+typedef int32_t (*TileReadFn)(void *user, int32_t x, int32_t y, int32_t width, int32_t height, float *out);
+typedef int32_t (*TileWriteFn)(void *user, int32_t x, int32_t y, int32_t width, int32_t height, const float *tile);
+
+// Corrects an image one output tile at a time. For each tile the source
+// coordinates of its pixels are computed first; their bounding box is the
+// only part of the source that has to be fetched. Vignetting is applied to
+// that source region, then the tile is resampled bilinearly. Memory is one
+// tile of coordinates, one source footprint and one output tile, whatever
+// the image size. A corrector must only be used by one thread at a time.
+class TileCorrector
+{
+public:
+    TileCorrector(const TileRequest &request, std::shared_ptr<Database> db);
+    ~TileCorrector();
+
+    TileCorrector(const TileCorrector &) = delete;
+    TileCorrector &operator=(const TileCorrector &) = delete;
+
+    // Returns 0, -1 for a bad request, -3 when lensfun has no modifier and -4
+    // when a requested correction is not available for the lens.
+    int32_t init();
+
+    int tile_count() const;
+
+    // Computes the coordinates of tile `index` (row-major) and its source
+    // footprint, which is empty when the whole tile maps outside the image.
+    // Returns 0, -1 for a bad index or -4 when lensfun rejects a row.
+    int32_t begin_tile(int index, TileRect *dst, TileRect *src);
+
+    // Buffer the caller fills with the source footprint of the current tile,
+    // rows of `src.width * channels` floats.
+    float *source_buffer()
+    {
+        return source_.data();
+    }
+
+    // Resamples the current tile into `out` (`dst.width * dst.height *
+    // channels` floats). Returns 0, -1 without a current tile, -2 when `out`
+    // is too short or -5 when vignetting fails.
+    int32_t finish_tile(float *out, size_t out_len);
+
+    // Runs every tile through the callbacks. Returns 0, a code of begin_tile
+    // or finish_tile, -6 when `read` fails or -7 when `write` fails.
+    int32_t run(TileReadFn read, TileWriteFn write, void *user);
+
+private:
+    void sample_tile(float *out) const;
+
+    TileRequest request_;
+    // Keeps the lens alive while the corrector exists.
+    std::shared_ptr<Database> db_;
+    lfModifier *modifier_ = nullptr;
+    bool geometry_ = false;
+    bool tca_ = false;
+    bool vignetting_ = false;
+    int coord_stride_ = 0;
+
+    bool has_tile_ = false;
+    TileRect dst_;
+    TileRect src_;
+    std::vector<float> coords_;
+    std::vector<float> source_;
+    std::vector<float> output_;
+};
+
+// Correctors handed out by lfw_tiler_create.
+uint32_t register_tiler(std::unique_ptr<TileCorrector> tiler);
+TileCorrector *find_tiler(uint32_t handle);
+bool destroy_tiler(uint32_t handle);
+} // namespace lfw
+
+#endif
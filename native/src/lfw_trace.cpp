@@ -0,0 +1,141 @@
+#include "lfw_trace.h"
+
+#include "lfw_json.h"
+
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace lfw
+{
+#if LFW_ENABLE_TRACE
+std::atomic<bool> g_trace_enabled{false};
+
+namespace
+{
+struct TraceEvent
+{
+    const char *name = nullptr;
+    std::string detail;
+    int64_t ts_us = 0;
+    int64_t dur_us = 0;
+    uint32_t tid = 0;
+};
+
+std::mutex g_trace_mutex;
+std::vector<TraceEvent> g_ring;
+size_t g_next = 0;
+uint64_t g_recorded = 0;
+
+std::atomic<uint32_t> g_next_tid{1};
+thread_local uint32_t t_tid = 0;
+
+uint32_t current_tid()
+{
+    if (t_tid == 0)
+    {
+        t_tid = g_next_tid.fetch_add(1, std::memory_order_relaxed);
+    }
+    return t_tid;
+}
+
+int64_t to_us(TraceClock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+} // namespace
+
+bool trace_start(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    g_ring.assign(capacity, TraceEvent());
+    g_next = 0;
+    g_recorded = 0;
+    g_trace_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void trace_stop()
+{
+    g_trace_enabled.store(false, std::memory_order_relaxed);
+}
+
+void trace_complete(const char *name, TraceClock::time_point start, TraceClock::time_point end, const char *detail)
+{
+    const uint32_t tid = current_tid();
+
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    if (g_ring.empty())
+    {
+        return;
+    }
+
+    TraceEvent &event = g_ring[g_next];
+    event.name = name;
+    event.detail.assign(detail ? detail : "");
+    event.ts_us = to_us(start);
+    event.dur_us = to_us(end) - event.ts_us;
+    event.tid = tid;
+
+    g_next = (g_next + 1) % g_ring.size();
+    ++g_recorded;
+}
+
+// Timestamps are steady_clock microseconds, which under Emscripten is the
+// performance.now() timeline, so the dump lines up with JS traces.
+std::string trace_json()
+{
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+
+    const size_t count = g_recorded < g_ring.size() ? static_cast<size_t>(g_recorded) : g_ring.size();
+    const size_t first = g_recorded < g_ring.size() ? 0 : g_next;
+
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"droppedEvents\":" << (g_recorded - count) << ",\"traceEvents\":[";
+    for (size_t i = 0; i < count; ++i)
+    {
+        const TraceEvent &event = g_ring[(first + i) % g_ring.size()];
+        if (i > 0)
+        {
+            out << ',';
+        }
+        out << "{\"name\":";
+        append_json_escaped(out, event.name);
+        out << ",\"cat\":\"lensfun\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.tid;
+        out << ",\"ts\":" << event.ts_us << ",\"dur\":" << event.dur_us;
+        if (!event.detail.empty())
+        {
+            out << ",\"args\":{\"detail\":";
+            append_json_escaped(out, event.detail.c_str());
+            out << '}';
+        }
+        out << '}';
+    }
+    out << "]}";
+    return out.str();
+}
+#else
+bool trace_start(size_t)
+{
+    return false;
+}
+
+void trace_stop()
+{
+}
+
+void trace_complete(const char *, TraceClock::time_point, TraceClock::time_point, const char *)
+{
+}
+
+std::string trace_json()
+{
+    return "{\"displayTimeUnit\":\"ms\",\"droppedEvents\":0,\"traceEvents\":[]}";
+}
+#endif
+} // namespace lfw
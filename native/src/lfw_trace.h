@@ -0,0 +1,86 @@
+#ifndef LFW_TRACE_H
+#define LFW_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#ifndef LFW_ENABLE_TRACE
+#define LFW_ENABLE_TRACE 1
+#endif
+
+namespace lfw
+{
+using TraceClock = std::chrono::steady_clock;
+
+#if LFW_ENABLE_TRACE
+extern std::atomic<bool> g_trace_enabled;
+
+inline bool trace_enabled()
+{
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+#else
+constexpr bool trace_enabled()
+{
+    return false;
+}
+#endif
+
+// Starts recording into a ring buffer of `capacity` events, discarding any
+// previous recording. Once full, the oldest events are overwritten.
+bool trace_start(size_t capacity);
+void trace_stop();
+
+// Recorded events in Chrome trace-event JSON, oldest first.
+std::string trace_json();
+
+// Records one complete ("X") event. `name` must be a string literal or
+// otherwise outlive the recording; `detail` is copied.
+void trace_complete(const char *name, TraceClock::time_point start, TraceClock::time_point end, const char *detail);
+
+// Scoped span around a phase of an entry point. Disabled tracing costs one
+// relaxed load; with LFW_ENABLE_TRACE=0 the span compiles away entirely.
+class TraceSpan
+{
+public:
+#if LFW_ENABLE_TRACE
+    explicit TraceSpan(const char *name, const char *detail = nullptr)
+        : name_(trace_enabled() ? name : nullptr)
+    {
+        if (name_)
+        {
+            detail_ = detail ? detail : "";
+            start_ = TraceClock::now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (name_)
+        {
+            trace_complete(name_, start_, TraceClock::now(), detail_.empty() ? nullptr : detail_.c_str());
+        }
+    }
+#else
+    explicit TraceSpan(const char *, const char * = nullptr)
+    {
+    }
+#endif
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+#if LFW_ENABLE_TRACE
+private:
+    const char *name_;
+    std::string detail_;
+    TraceClock::time_point start_;
+#endif
+};
+} // namespace lfw
+
+#endif
@@ -0,0 +1,243 @@
+#include "lfw_zoom.h"
+
+#include "lfw_handles.h"
+#include "lfw_pool.h"
+#include "lfw_trace.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+namespace lfw
+{
+namespace
+{
+HandleRegistry<ZoomSequence> g_zooms;
+
+// Where the blend error of an interval is measured, as fractions of it.
+constexpr float kProbes[] = {0.25f, 0.5f, 0.75f};
+
+// Each call blends into a caller buffer, so blends can run on any thread as
+// long as the anchors are not being built.
+void blend_anchors(const float *a, const float *b, float t, size_t count, float *out)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = a[i] + (b[i] - a[i]) * t;
+    }
+}
+
+// Largest difference between the blend of `a` and `b` at `t` and `exact`,
+// without storing the blend.
+double blend_error(const float *a, const float *b, float t, const float *exact, size_t count)
+{
+    double worst = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float blended = a[i] + (b[i] - a[i]) * t;
+        worst = std::max(worst, fabs(static_cast<double>(blended) - exact[i]));
+    }
+    return worst;
+}
+} // namespace
+
+ZoomSequence::ZoomSequence(const ZoomRequest &request, std::shared_ptr<Database> db)
+    : request_(request),
+      db_(std::move(db))
+{
+}
+
+ZoomSequence::~ZoomSequence()
+{
+    wait();
+}
+
+int32_t ZoomSequence::build(float focal, std::vector<float> *out) const
+{
+    MapRequest map = request_.map;
+    map.focal = focal;
+    MapBuilder builder(map, db_);
+    const int32_t rc = builder.init();
+    if (rc != 0)
+    {
+        return rc;
+    }
+    out->resize(frame_floats_);
+    return builder.fill_rows(0, builder.grid_height(), out->data());
+}
+
+// Largest blend error at the probes of interval [focals_[i], focals_[i + 1]].
+// Only one exact map is held at a time, and none is kept afterwards.
+int32_t ZoomSequence::interval_error(size_t interval, double *error) const
+{
+    const float lower = focals_[interval];
+    const float upper = focals_[interval + 1];
+    std::vector<float> exact;
+    *error = 0.0;
+    for (const float t : kProbes)
+    {
+        const int32_t rc = build(lower + (upper - lower) * t, &exact);
+        if (rc != 0)
+        {
+            return rc;
+        }
+        *error = std::max(*error,
+                          blend_error(anchors_[interval].data(), anchors_[interval + 1].data(), t, exact.data(),
+                                      frame_floats_));
+    }
+    return 0;
+}
+
+int32_t ZoomSequence::init()
+{
+    const ZoomRequest &r = request_;
+    if (!r.map.lens || !(r.min_focal > 0.0f) || r.max_focal < r.min_focal || !(r.tolerance > 0.0f) ||
+        r.max_anchors < 2)
+    {
+        return -1;
+    }
+    grid_width_ = grid_points(r.map.width, r.map.step);
+    grid_height_ = grid_points(r.map.height, r.map.step);
+    frame_floats_ = static_cast<size_t>(grid_width_) * grid_height_ * map_channels(r.map.kind);
+    if (frame_floats_ == 0)
+    {
+        return -1;
+    }
+
+    const TraceSpan span("zoom anchors");
+    focals_.push_back(r.min_focal);
+    anchors_.emplace_back();
+    int32_t rc = build(r.min_focal, &anchors_.back());
+    if (rc != 0)
+    {
+        return rc;
+    }
+    if (r.max_focal == r.min_focal)
+    {
+        return 0;
+    }
+    focals_.push_back(r.max_focal);
+    anchors_.emplace_back();
+    rc = build(r.max_focal, &anchors_.back());
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    // errors[i] belongs to interval i; splitting the worst one replaces it by
+    // its two halves, with a new anchor at its middle.
+    std::vector<double> errors(1);
+    rc = interval_error(0, &errors[0]);
+    while (rc == 0 && static_cast<int>(focals_.size()) < r.max_anchors)
+    {
+        const size_t worst = static_cast<size_t>(std::max_element(errors.begin(), errors.end()) - errors.begin());
+        if (errors[worst] <= r.tolerance)
+        {
+            break;
+        }
+        const float mid = 0.5f * (focals_[worst] + focals_[worst + 1]);
+        std::vector<float> anchor;
+        rc = build(mid, &anchor);
+        if (rc != 0)
+        {
+            break;
+        }
+        focals_.insert(focals_.begin() + worst + 1, mid);
+        anchors_.insert(anchors_.begin() + worst + 1, std::move(anchor));
+        errors.insert(errors.begin() + worst + 1, 0.0);
+        rc = interval_error(worst, &errors[worst]);
+        if (rc == 0)
+        {
+            rc = interval_error(worst + 1, &errors[worst + 1]);
+        }
+    }
+    if (rc != 0)
+    {
+        return rc;
+    }
+    max_error_ = *std::max_element(errors.begin(), errors.end());
+    return 0;
+}
+
+void ZoomSequence::blend(float focal, float *out) const
+{
+    const TraceSpan span("zoom blend");
+    if (anchors_.size() == 1)
+    {
+        std::copy(anchors_[0].begin(), anchors_[0].end(), out);
+        return;
+    }
+    focal = std::min(std::max(focal, focals_.front()), focals_.back());
+    const size_t upper = static_cast<size_t>(std::upper_bound(focals_.begin(), focals_.end(), focal) - focals_.begin());
+    const size_t i = std::min(std::max<size_t>(upper, 1), focals_.size() - 1) - 1;
+    const float t = (focal - focals_[i]) / (focals_[i + 1] - focals_[i]);
+    blend_anchors(anchors_[i].data(), anchors_[i + 1].data(), t, frame_floats_, out);
+}
+
+void ZoomSequence::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    blended_.wait(lock, [this]() { return !blending_; });
+}
+
+void ZoomSequence::prepare(float focal)
+{
+    wait();
+    const int back = 1 - front_;
+    buffers_[back].resize(frame_floats_);
+    float *out = buffers_[back].data();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blending_ = true;
+    }
+    pool_submit([this, focal, out]() {
+        blend(focal, out);
+        std::lock_guard<std::mutex> lock(mutex_);
+        blending_ = false;
+        blended_.notify_all();
+    });
+    prepared_ = true;
+}
+
+const float *ZoomSequence::acquire()
+{
+    if (!prepared_)
+    {
+        return nullptr;
+    }
+    wait();
+    front_ = 1 - front_;
+    prepared_ = false;
+    return buffers_[front_].data();
+}
+
+std::string ZoomSequence::info_json() const
+{
+    std::ostringstream out;
+    out << "{\"anchors\":[";
+    for (size_t i = 0; i < focals_.size(); ++i)
+    {
+        out << (i == 0 ? "" : ",") << focals_[i];
+    }
+    out << "],\"maxError\":" << max_error_ << ",\"gridWidth\":" << grid_width_ << ",\"gridHeight\":" << grid_height_
+        << ",\"channels\":" << map_channels(request_.map.kind) << "}";
+    return out.str();
+}
+
+uint32_t register_zoom(std::unique_ptr<ZoomSequence> sequence)
+{
+    return g_zooms.add(std::move(sequence));
+}
+
+ZoomSequence *find_zoom(uint32_t handle)
+{
+    return g_zooms.find(handle);
+}
+
+bool destroy_zoom(uint32_t handle)
+{
+    return g_zooms.remove(handle);
+}
+} // namespace lfw
@@ -0,0 +1,98 @@
+#ifndef LFW_ZOOM_H
+#define LFW_ZOOM_H
+
+#include "lfw_maps.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lfw
+{
+struct ZoomRequest
+{
+    // `map.focal` is ignored; anchors are placed in [min_focal, max_focal].
+    MapRequest map;
+    float min_focal = 0.0f;
+    float max_focal = 0.0f;
+    // Largest allowed difference between a blended and an exact map, in
+    // pixels for geometry and TCA and in gain for vignetting.
+    float tolerance = 0.05f;
+    int max_anchors = 16;
+};
+
+// Maps of one lens over a focal range for zoom video. Exact maps are built at
+// a few focal anchors, placed by bisecting the interval whose blend is
+// furthest from the exact map until every interval is within tolerance or the
+// anchor budget is spent. The error of an interval is measured at a quarter,
+// half and three quarters of it, so the bound holds at those probes rather
+// than at every focal length. Frames are then linear blends of the two
+// neighbouring anchors: one multiply-add per float instead of a modifier.
+//
+// Frames are double-buffered: prepare() hands the blend of the next frame
+// into the back buffer to the worker pool (lfw_pool.h) while the caller still
+// reads the front one, and acquire() waits for it and swaps.
+class ZoomSequence
+{
+public:
+    explicit ZoomSequence(const ZoomRequest &request, std::shared_ptr<Database> db);
+    ~ZoomSequence();
+
+    ZoomSequence(const ZoomSequence &) = delete;
+    ZoomSequence &operator=(const ZoomSequence &) = delete;
+
+    // Builds the anchors. Returns 0, -1 for a bad request or a map builder
+    // code.
+    int32_t init();
+
+    size_t frame_floats() const
+    {
+        return frame_floats_;
+    }
+
+    // Blends the frame at `focal` (clamped to the range) into `out`.
+    void blend(float focal, float *out) const;
+
+    void prepare(float focal);
+    // The last prepared frame, valid until the next acquire(), or null if
+    // nothing was prepared.
+    const float *acquire();
+
+    // {"anchors":[...],"maxError":e,"gridWidth":w,"gridHeight":h,"channels":c}
+    std::string info_json() const;
+
+private:
+    int32_t build(float focal, std::vector<float> *out) const;
+    int32_t interval_error(size_t interval, double *error) const;
+    void wait();
+
+    ZoomRequest request_;
+    std::shared_ptr<Database> db_;
+    size_t frame_floats_ = 0;
+    int grid_width_ = 0;
+    int grid_height_ = 0;
+    std::vector<float> focals_;
+    std::vector<std::vector<float>> anchors_;
+    double max_error_ = 0.0;
+
+    std::vector<float> buffers_[2];
+    int front_ = 0;
+    bool prepared_ = false;
+    // Set while the pool blends into the back buffer.
+    bool blending_ = false;
+    std::mutex mutex_;
+    std::condition_variable blended_;
+};
+
+// Sequences handed out by lfw_zoom_create.
+uint32_t register_zoom(std::unique_ptr<ZoomSequence> sequence);
+ZoomSequence *find_zoom(uint32_t handle);
+bool destroy_zoom(uint32_t handle);
+} // namespace lfw
+
+#endif
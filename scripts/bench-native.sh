@@ -0,0 +1,10 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="${ROOT_DIR}/native-build"
+
+cmake -S "${ROOT_DIR}/native" -B "${BUILD_DIR}" -DCMAKE_BUILD_TYPE=Release -DLFW_BUILD_BENCH=ON
+cmake --build "${BUILD_DIR}" --target lfw_bench -j
+
+"${BUILD_DIR}/lfw_bench" --golden "${ROOT_DIR}/native/bench/golden" "$@"
@@ -0,0 +1,63 @@
+#!/usr/bin/env node
+
+// Packs the *.xml files of a lensfun database directory into one
+// compressed package (layout in native/src/lfw_pack.h), which lfw_init
+// inflates document by document.
+
+import fs from 'node:fs';
+import path from 'node:path';
+import process from 'node:process';
+import zlib from 'node:zlib';
+
+const MAGIC = 0x4457464c;
+const VERSION = 1;
+
+const [dbDir, outFile] = process.argv.slice(2);
+
+if (!dbDir || !outFile) {
+  console.error('[pack-db] usage: node scripts/pack-db.mjs <db dir> <output .lfwpack>');
+  process.exit(1);
+}
+
+if (!fs.existsSync(dbDir) || !fs.statSync(dbDir).isDirectory()) {
+  console.error(`[pack-db] database directory not found: ${dbDir}`);
+  process.exit(1);
+}
+
+// Same order as a directory load, so documents are parsed in the same order.
+const names = fs
+  .readdirSync(dbDir)
+  .filter((name) => name.endsWith('.xml'))
+  .sort((a, b) => Buffer.compare(Buffer.from(a), Buffer.from(b)));
+
+if (names.length === 0) {
+  console.error(`[pack-db] no .xml files in ${dbDir}`);
+  process.exit(1);
+}
+
+const parts = [];
+let xmlBytes = 0;
+for (const name of names) {
+  const nameBytes = Buffer.from(name, 'utf8');
+  const xml = fs.readFileSync(path.join(dbDir, name));
+  const sizes = Buffer.alloc(8);
+  sizes.writeUInt32LE(nameBytes.length, 0);
+  sizes.writeUInt32LE(xml.length, 4);
+  parts.push(sizes, nameBytes, xml);
+  xmlBytes += xml.length;
+}
+
+const header = Buffer.alloc(16);
+header.writeUInt32LE(MAGIC, 0);
+header.writeUInt32LE(VERSION, 4);
+header.writeUInt32LE(names.length, 8);
+header.writeUInt32LE(xmlBytes, 12);
+
+const stream = zlib.deflateSync(Buffer.concat(parts), { level: zlib.constants.Z_BEST_COMPRESSION, memLevel: 9 });
+
+fs.mkdirSync(path.dirname(outFile), { recursive: true });
+fs.writeFileSync(outFile, Buffer.concat([header, stream]));
+
+const packedBytes = header.length + stream.length;
+const ratio = ((100 * packedBytes) / xmlBytes).toFixed(1);
+console.log(`[pack-db] ${names.length} documents, ${xmlBytes} XML bytes -> ${packedBytes} bytes (${ratio}%) in ${outFile}`);
@@ -8,9 +8,14 @@ export const LF_MODIFY_GEOMETRY = 0x00000010;
 export const LF_MODIFY_SCALE = 0x00000020;
 export const LF_MODIFY_PERSPECTIVE = 0x00000040;
 
+// Floats in a packed correction descriptor (lfw_correction_descriptor).
+export const CORRECTION_DESCRIPTOR_FLOATS = 26;
+
 export interface LensfunModule {
   cwrap: (ident: string, returnType: string | null, argTypes: string[]) => (...args: unknown[]) => unknown;
   UTF8ToString: (ptr: number) => string;
+  stringToUTF8: (str: string, outPtr: number, maxBytesToWrite: number) => void;
+  lengthBytesUTF8: (str: string) => number;
   _malloc: (size: number) => number;
   _free: (ptr: number) => void;
   HEAPF32: Float32Array;
@@ -24,6 +29,9 @@ export interface LensfunInitOptions {
   locateFile?: (path: string, prefix: string) => string;
   dbPath?: string;
   autoInitDb?: boolean;
+  // Only cameras and lenses with one of these mounts and makers are loaded.
+  mounts?: string[];
+  makers?: string[];
 }
 
 export interface LensMatch {
@@ -84,17 +92,381 @@ export interface CorrectionMaps {
   vignetting?: Float32Array;
 }
 
+export type MapKind = 'geometry' | 'tca' | 'vignetting';
+
+export interface MapStreamInput {
+  kind: MapKind;
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  step?: number;
+  reverse?: boolean;
+  aperture?: number;
+  distance?: number;
+  bandRows?: number;
+}
+
+export interface ZoomSequenceInput {
+  kind: MapKind;
+  lensHandle: number;
+  width: number;
+  height: number;
+  minFocal: number;
+  maxFocal: number;
+  crop: number;
+  step?: number;
+  reverse?: boolean;
+  aperture?: number;
+  distance?: number;
+  tolerance?: number;
+  maxAnchors?: number;
+}
+
+export interface NormalizedMapInput {
+  kind: MapKind;
+  lensHandle: number;
+  focal: number;
+  crop: number;
+  aspect: number;
+  reverse?: boolean;
+  aperture?: number;
+  distance?: number;
+  gridSize?: number;
+}
+
+export interface CorrectionDescriptorInput {
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  reverse?: boolean;
+  aperture?: number;
+  distance?: number;
+}
+
+export interface DescriptorMapOptions {
+  step?: number;
+  includeTca?: boolean;
+  includeVignetting?: boolean;
+}
+
+export interface TileRect {
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+export interface ValidCropInput {
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  includeTca?: boolean;
+}
+
+export interface ValidCrop extends TileRect {
+  scale: number;
+}
+
+export type ThumbnailFilter = 'box' | 'lanczos3';
+
+export interface ThumbnailInput {
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  mods: number;
+  source: Float32Array;
+  outWidth: number;
+  outHeight: number;
+  channels?: 1 | 3 | 4;
+  filter?: ThumbnailFilter;
+  aperture?: number;
+  distance?: number;
+}
+
+export interface CfaVignettingInput {
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  aperture: number;
+  distance?: number;
+  pattern: string;
+  patternWidth: number;
+  data: Uint16Array;
+  blackLevel?: number;
+  whiteLevel?: number;
+  stride?: number;
+}
+
+export interface FixedMapInput {
+  kind: 'geometry' | 'tca';
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  reverse?: boolean;
+}
+
+export interface MapJobInput {
+  kind: MapKind;
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  step?: number;
+  coarseStep?: number;
+  reverse?: boolean;
+  aperture?: number;
+  distance?: number;
+}
+
+export type MapJobStage = 'coarse' | 'refine' | 'done';
+
+export interface ProgressiveMapOptions {
+  signal?: AbortSignal;
+  rowsPerSlice?: number;
+  onCoarse?: (map: Float32Array, gridWidth: number, gridHeight: number) => void;
+}
+
+export type MapBlobInput = Omit<MapJobInput, 'coarseStep'>;
+
+export interface ImportedMap {
+  kind: MapKind;
+  // The lens's handle in this session.
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  aperture: number;
+  distance: number;
+  step: number;
+  reverse: boolean;
+  gridWidth: number;
+  gridHeight: number;
+  map: Float32Array;
+}
+
+export interface StepChoiceInput extends Omit<MapJobInput, 'step' | 'coarseStep'> {
+  // Largest allowed difference between a grid's bilinear reconstruction and
+  // the exact map: pixels for geometry and TCA, gain for vignetting.
+  tolerance: number;
+  maxStep?: number;
+}
+
+export interface StepChoice {
+  step: number;
+  // Largest difference the probe found at `step`.
+  error: number;
+  // Map points evaluated to make the choice.
+  evaluations: number;
+}
+
+export interface BatchCorrectionItem extends CorrectionInput {
+  // Interleaved float pixels corrected with the item's maps.
+  pixels?: Float32Array;
+  channels?: 1 | 3 | 4;
+}
+
+export interface BatchCorrectionOptions {
+  threads?: number;
+}
+
+export interface BatchCorrectionResult {
+  // One entry per distinct parameter set; items that share one share its
+  // maps.
+  groups: CorrectionMaps[];
+  itemGroups: number[];
+  // The corrected pixels of items that had some.
+  outputs: (Float32Array | undefined)[];
+}
+
+export interface TiledCorrectionInput {
+  lensHandle: number;
+  width: number;
+  height: number;
+  focal: number;
+  crop: number;
+  mods: number;
+  channels?: 1 | 3 | 4;
+  aperture?: number;
+  distance?: number;
+  tileSize?: number;
+  read: (rect: TileRect) => Float32Array | Promise<Float32Array>;
+  write: (rect: TileRect, tile: Float32Array) => void | Promise<void>;
+}
+
+export interface CallStats {
+  calls: number;
+  totalMs: number;
+  maxMs: number;
+  p50Ms: number;
+  p90Ms: number;
+  p99Ms: number;
+  allocations: number;
+  allocatedBytes: number;
+}
+
+export type CalibrationCacheKind =
+  | 'distortion'
+  | 'tca'
+  | 'vignetting'
+  | 'reverseGeometry'
+  | 'radialGeometry'
+  | 'radialVignetting';
+
+export interface CalibrationCacheStats {
+  hits: number;
+  misses: number;
+  entries: number;
+  // Bytes held by tables kept to a byte budget; 0 for the others.
+  bytes: number;
+}
+
+export interface LensfunStats {
+  calls: Record<string, CallStats>;
+  allocator: {
+    mallocCalls: number;
+    reallocCalls: number;
+    freeCalls: number;
+    requestedBytes: number;
+  };
+  database: {
+    documents: number;
+    lenses: number;
+    retiredLenses: number;
+    cameras: number;
+    retiredCameras: number;
+    mounts: number;
+    // Records kept out by the `mounts` and `makers` filters.
+    pruned: { lenses: number; cameras: number; calibrations: number; xmlBytes: number };
+    // Compressed database packages read, and the XML inflated from them.
+    packages: { count: number; documents: number; packedBytes: number; xmlBytes: number };
+    calibrationCache: Record<CalibrationCacheKind, CalibrationCacheStats>;
+  } | null;
+}
+
+export interface TraceEvent {
+  name: string;
+  cat: string;
+  ph: 'X';
+  pid: number;
+  tid: number;
+  ts: number;
+  dur: number;
+  args?: { detail: string };
+}
+
+export interface LensfunTrace {
+  displayTimeUnit: 'ms';
+  droppedEvents: number;
+  traceEvents: TraceEvent[];
+}
+
+export interface AllocCategoryStats {
+  allocations: number;
+  frees: number;
+  liveBlocks: number;
+  liveBytes: number;
+  peakBytes: number;
+}
+
+export type AllocCategory = 'other' | 'databaseLoad' | 'search' | 'modifier' | 'jsonOutput';
+
+export interface LensfunAllocReport {
+  enabled: boolean;
+  liveBytes: number;
+  peakBytes: number;
+  heapBytes: number | null;
+  categories: Record<AllocCategory, AllocCategoryStats>;
+  leaksAtDispose: Record<AllocCategory, Pick<AllocCategoryStats, 'liveBlocks' | 'liveBytes'>> | null;
+}
+
 type CFn = (...args: unknown[]) => unknown;
 
 interface NativeFns {
   init: CFn;
+  initFiltered: CFn;
   dispose: CFn;
+  dbLoadXml: CFn;
+  dbLoadFile: CFn;
+  dbUnload: CFn;
+  dbCompact: CFn;
   findLensesJson: CFn;
   findCamerasJson: CFn;
   availableMods: CFn;
   buildGeometryMap: CFn;
   buildTcaMap: CFn;
   buildVignettingMap: CFn;
+  mapStreamCreate: CFn;
+  mapStreamRows: CFn;
+  mapStreamDestroy: CFn;
+  tilerCreate: CFn;
+  tilerTileCount: CFn;
+  tilerBeginTile: CFn;
+  tilerSourceBuffer: CFn;
+  tilerFinishTile: CFn;
+  tilerDestroy: CFn;
+  zoomCreate: CFn;
+  zoomInfoJson: CFn;
+  zoomBlend: CFn;
+  zoomPrepare: CFn;
+  zoomAcquire: CFn;
+  zoomDestroy: CFn;
+  correctionDescriptor: CFn;
+  descriptorBuildMap: CFn;
+  normalizedMapCreate: CFn;
+  normalizedMapSample: CFn;
+  normalizedMapDestroy: CFn;
+  validCrop: CFn;
+  thumbnail: CFn;
+  cfaVignetting: CFn;
+  fixedMapCreate: CFn;
+  fixedMapFractionBits: CFn;
+  fixedMapRemap: CFn;
+  fixedMapDestroy: CFn;
+  mapJobCreate: CFn;
+  mapJobRun: CFn;
+  mapJobCancel: CFn;
+  mapJobProgress: CFn;
+  mapJobCoarse: CFn;
+  mapJobResult: CFn;
+  mapJobDestroy: CFn;
+  batchCreate: CFn;
+  batchAdd: CFn;
+  batchSetPixels: CFn;
+  batchRun: CFn;
+  batchItemGroup: CFn;
+  batchItemStatus: CFn;
+  batchMap: CFn;
+  batchDestroy: CFn;
+  dbContentHash: CFn;
+  mapBlobSize: CFn;
+  mapBlobExport: CFn;
+  mapBlobImport: CFn;
+  chooseStep: CFn;
+  getStatsJson: CFn;
+  resetStats: CFn;
+  traceStart: CFn;
+  traceStop: CFn;
+  traceDumpJson: CFn;
+  captureStart: CFn;
+  captureStop: CFn;
+  captureDump: CFn;
+  allocTrackingStart: CFn;
+  allocTrackingStop: CFn;
+  allocReportJson: CFn;
   freePtr: CFn;
 }
 
@@ -111,6 +483,12 @@ function toFlag(value: boolean | undefined): number {
   return value ? 1 : 0;
 }
 
+const MAP_KINDS: Record<MapKind, { id: number; channels: number }> = {
+  geometry: { id: 0, channels: 2 },
+  tca: { id: 1, channels: 6 },
+  vignetting: { id: 2, channels: 3 }
+};
+
 function toGrid(size: number, step: number): number {
   return Math.floor((size - 1) / step) + 1;
 }
@@ -201,10 +579,25 @@ function parseJsonPtr<T>(module: LensfunModule, freePtr: CFn, ptr: number): T[]
   return JSON.parse(raw) as T[];
 }
 
+function parseJsonObjectPtr<T>(module: LensfunModule, freePtr: CFn, ptr: number): T {
+  if (!ptr) {
+    throw new Error('[lensfun-wasm] native call returned no data');
+  }
+
+  const raw = module.UTF8ToString(ptr);
+  freePtr(ptr);
+  return JSON.parse(raw) as T;
+}
+
 function bindFns(module: LensfunModule): NativeFns {
   return {
     init: module.cwrap('lfw_init', 'number', ['string']),
+    initFiltered: module.cwrap('lfw_init_filtered', 'number', ['string', 'string', 'string']),
     dispose: module.cwrap('lfw_dispose', null, []),
+    dbLoadXml: module.cwrap('lfw_db_load_xml', 'number', ['string', 'number', 'number']),
+    dbLoadFile: module.cwrap('lfw_db_load_file', 'number', ['string']),
+    dbUnload: module.cwrap('lfw_db_unload', 'number', ['string']),
+    dbCompact: module.cwrap('lfw_db_compact', 'number', ['number']),
     findLensesJson: module.cwrap('lfw_find_lenses_json', 'number', ['string', 'string', 'string', 'string', 'number']),
     findCamerasJson: module.cwrap('lfw_find_cameras_json', 'number', ['string', 'string', 'number']),
     availableMods: module.cwrap('lfw_available_mods', 'number', ['number', 'number']),
@@ -243,104 +636,848 @@ function bindFns(module: LensfunModule): NativeFns {
       'number',
       'number'
     ]),
-    freePtr: module.cwrap('lfw_free', null, ['number'])
-  };
-}
-
-export class LensfunClient {
-  private readonly module: LensfunModule;
-  private readonly fns: NativeFns;
-  private disposed = false;
-
-  constructor(module: LensfunModule, fns: NativeFns) {
-    this.module = module;
-    this.fns = fns;
-  }
-
-  dispose(): void {
-    if (this.disposed) {
-      return;
-    }
-    this.fns.dispose();
-    this.disposed = true;
-  }
-
-  searchLenses(input: SearchLensesInput): LensMatch[] {
-    this.ensureAlive();
-    const lensModel = requiredString(input.lensModel, 'lensModel');
-    const ptr = this.fns.findLensesJson(
-      input.cameraMaker ?? '',
-      input.cameraModel ?? '',
-      input.lensMaker ?? '',
-      lensModel,
-      input.searchFlags ?? LF_SEARCH_SORT_AND_UNIQUIFY
-    ) as number;
-    return parseJsonPtr<LensMatch>(this.module, this.fns.freePtr, ptr);
-  }
-
-  searchCameras(input: SearchCamerasInput): CameraMatch[] {
-    this.ensureAlive();
-    const ptr = this.fns.findCamerasJson(
-      input.maker ?? '',
-      input.model ?? '',
-      input.searchFlags ?? 0
-    ) as number;
-    return parseJsonPtr<CameraMatch>(this.module, this.fns.freePtr, ptr);
-  }
-
-  getAvailableModifications(lensHandle: number, crop: number): number {
-    this.ensureAlive();
-    return this.fns.availableMods(lensHandle, crop) as number;
-  }
-
-  buildCorrectionMaps(input: CorrectionInput): CorrectionMaps {
-    this.ensureAlive();
-
-    const width = requirePositiveInt(input.width, 'width');
-    const height = requirePositiveInt(input.height, 'height');
-    const step = requirePositiveInt(input.step ?? 1, 'step');
-
-    const gridWidth = toGrid(width, step);
-    const gridHeight = toGrid(height, step);
-
-    const geometry = this.runFloatMap(
-      gridWidth * gridHeight * 2,
-      this.fns.buildGeometryMap,
-      input.lensHandle,
-      input.focal,
-      input.crop,
-      width,
-      height,
-      toFlag(input.reverse),
-      step
-    );
-
-    const result: CorrectionMaps = {
-      gridWidth,
-      gridHeight,
-      step,
-      geometry
-    };
-
-    if (input.includeTca) {
-      result.tca = this.runFloatMap(
-        gridWidth * gridHeight * 6,
-        this.fns.buildTcaMap,
-        input.lensHandle,
-        input.focal,
-        input.crop,
-        width,
-        height,
-        toFlag(input.reverse),
-        step
-      );
-    }
-
-    if (input.includeVignetting) {
-      if (typeof input.aperture !== 'number') {
-        throw new Error('[lensfun-wasm] aperture is required for vignetting map');
-      }
-      result.vignetting = this.runFloatMap(
+    mapStreamCreate: module.cwrap('lfw_map_stream_create', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    mapStreamRows: module.cwrap('lfw_map_stream_rows', 'number', ['number', 'number', 'number', 'number', 'number']),
+    mapStreamDestroy: module.cwrap('lfw_map_stream_destroy', 'number', ['number']),
+    tilerCreate: module.cwrap('lfw_tiler_create', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    tilerTileCount: module.cwrap('lfw_tiler_tile_count', 'number', ['number']),
+    tilerBeginTile: module.cwrap('lfw_tiler_begin_tile', 'number', ['number', 'number', 'number']),
+    tilerSourceBuffer: module.cwrap('lfw_tiler_source_buffer', 'number', ['number']),
+    tilerFinishTile: module.cwrap('lfw_tiler_finish_tile', 'number', ['number', 'number', 'number']),
+    tilerDestroy: module.cwrap('lfw_tiler_destroy', 'number', ['number']),
+    zoomCreate: module.cwrap('lfw_zoom_create', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    zoomInfoJson: module.cwrap('lfw_zoom_info_json', 'number', ['number']),
+    zoomBlend: module.cwrap('lfw_zoom_blend', 'number', ['number', 'number', 'number', 'number']),
+    zoomPrepare: module.cwrap('lfw_zoom_prepare', 'number', ['number', 'number']),
+    zoomAcquire: module.cwrap('lfw_zoom_acquire', 'number', ['number']),
+    zoomDestroy: module.cwrap('lfw_zoom_destroy', 'number', ['number']),
+    correctionDescriptor: module.cwrap('lfw_correction_descriptor', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    descriptorBuildMap: module.cwrap('lfw_descriptor_build_map', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    normalizedMapCreate: module.cwrap('lfw_normalized_map_create', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    normalizedMapSample: module.cwrap('lfw_normalized_map_sample', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    normalizedMapDestroy: module.cwrap('lfw_normalized_map_destroy', 'number', ['number']),
+    validCrop: module.cwrap('lfw_valid_crop', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    thumbnail: module.cwrap('lfw_thumbnail', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    cfaVignetting: module.cwrap('lfw_cfa_vignetting', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'string',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    fixedMapCreate: module.cwrap('lfw_fixed_map_create', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    fixedMapFractionBits: module.cwrap('lfw_fixed_map_fraction_bits', 'number', ['number']),
+    fixedMapRemap: module.cwrap('lfw_fixed_map_remap', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    fixedMapDestroy: module.cwrap('lfw_fixed_map_destroy', 'number', ['number']),
+    mapJobCreate: module.cwrap('lfw_map_job_create', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    mapJobRun: module.cwrap('lfw_map_job_run', 'number', ['number', 'number']),
+    mapJobCancel: module.cwrap('lfw_map_job_cancel', 'number', ['number']),
+    mapJobProgress: module.cwrap('lfw_map_job_progress', 'number', ['number']),
+    mapJobCoarse: module.cwrap('lfw_map_job_coarse', 'number', ['number']),
+    mapJobResult: module.cwrap('lfw_map_job_result', 'number', ['number']),
+    mapJobDestroy: module.cwrap('lfw_map_job_destroy', 'number', ['number']),
+    batchCreate: module.cwrap('lfw_batch_create', 'number', []),
+    batchAdd: module.cwrap('lfw_batch_add', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    batchSetPixels: module.cwrap('lfw_batch_set_pixels', 'number', ['number', 'number', 'number', 'number', 'number']),
+    batchRun: module.cwrap('lfw_batch_run', 'number', ['number', 'number']),
+    batchItemGroup: module.cwrap('lfw_batch_item_group', 'number', ['number', 'number']),
+    batchItemStatus: module.cwrap('lfw_batch_item_status', 'number', ['number', 'number']),
+    batchMap: module.cwrap('lfw_batch_map', 'number', ['number', 'number', 'number']),
+    batchDestroy: module.cwrap('lfw_batch_destroy', 'number', ['number']),
+    dbContentHash: module.cwrap('lfw_db_content_hash', 'number', []),
+    mapBlobSize: module.cwrap('lfw_map_blob_size', 'number', ['number', 'number', 'number', 'number', 'number']),
+    mapBlobExport: module.cwrap('lfw_map_blob_export', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    mapBlobImport: module.cwrap('lfw_map_blob_import', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    chooseStep: module.cwrap('lfw_choose_step', 'number', [
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number',
+      'number'
+    ]),
+    getStatsJson: module.cwrap('lfw_get_stats_json', 'number', []),
+    resetStats: module.cwrap('lfw_reset_stats', null, []),
+    traceStart: module.cwrap('lfw_trace_start', 'number', ['number']),
+    traceStop: module.cwrap('lfw_trace_stop', null, []),
+    traceDumpJson: module.cwrap('lfw_trace_dump_json', 'number', []),
+    captureStart: module.cwrap('lfw_capture_start', 'number', ['number']),
+    captureStop: module.cwrap('lfw_capture_stop', null, []),
+    captureDump: module.cwrap('lfw_capture_dump', 'number', []),
+    allocTrackingStart: module.cwrap('lfw_alloc_tracking_start', null, []),
+    allocTrackingStop: module.cwrap('lfw_alloc_tracking_stop', null, []),
+    allocReportJson: module.cwrap('lfw_alloc_report_json', 'number', []),
+    freePtr: module.cwrap('lfw_free', null, ['number'])
+  };
+}
+
+export class LensfunMapStream {
+  readonly kind: MapKind;
+  readonly gridWidth: number;
+  readonly gridHeight: number;
+  readonly step: number;
+  readonly channels: number;
+  readonly bandRows: number;
+
+  private readonly module: LensfunModule;
+  private readonly fns: NativeFns;
+  private readonly onClose: (stream: LensfunMapStream) => void;
+  private handle: number;
+  private ptr: number;
+
+  constructor(
+    module: LensfunModule,
+    fns: NativeFns,
+    handle: number,
+    input: MapStreamInput,
+    onClose: (stream: LensfunMapStream) => void
+  ) {
+    this.module = module;
+    this.fns = fns;
+    this.handle = handle;
+    this.onClose = onClose;
+    this.kind = input.kind;
+    this.step = input.step ?? 1;
+    this.gridWidth = toGrid(input.width, this.step);
+    this.gridHeight = toGrid(input.height, this.step);
+    this.channels = MAP_KINDS[input.kind].channels;
+    this.bandRows = Math.min(input.bandRows ?? 64, this.gridHeight);
+    this.ptr = module._malloc(this.bandRows * this.gridWidth * this.channels * 4);
+  }
+
+  readRows(y0: number, y1: number, out?: Float32Array): Float32Array {
+    if (!this.handle) {
+      throw new Error('[lensfun-wasm] map stream is closed');
+    }
+    if (!Number.isInteger(y0) || !Number.isInteger(y1) || y0 < 0 || y1 <= y0 || y1 > this.gridHeight) {
+      throw new Error(`[lensfun-wasm] invalid row range ${y0}..${y1}`);
+    }
+    if (y1 - y0 > this.bandRows) {
+      throw new Error(`[lensfun-wasm] row range ${y0}..${y1} exceeds bandRows ${this.bandRows}`);
+    }
+
+    const size = (y1 - y0) * this.gridWidth * this.channels;
+    const rc = this.fns.mapStreamRows(this.handle, y0, y1, this.ptr, size) as number;
+    if (rc !== 0) {
+      throw new Error(`[lensfun-wasm] lfw_map_stream_rows failed with code ${rc}`);
+    }
+
+    const start = this.ptr >> 2;
+    const rows = this.module.HEAPF32.subarray(start, start + size);
+    if (out) {
+      if (out.length < size) {
+        throw new Error(`[lensfun-wasm] output holds ${out.length} floats, ${size} needed`);
+      }
+      out.set(rows);
+      return out.subarray(0, size);
+    }
+    return new Float32Array(rows);
+  }
+
+  *bands(): Generator<{ y0: number; y1: number; data: Float32Array }> {
+    const out = new Float32Array(this.bandRows * this.gridWidth * this.channels);
+    for (let y0 = 0; y0 < this.gridHeight; y0 += this.bandRows) {
+      const y1 = Math.min(this.gridHeight, y0 + this.bandRows);
+      yield { y0, y1, data: this.readRows(y0, y1, out) };
+    }
+  }
+
+  close(): void {
+    if (!this.handle) {
+      return;
+    }
+    this.fns.mapStreamDestroy(this.handle);
+    this.module._free(this.ptr);
+    this.handle = 0;
+    this.ptr = 0;
+    this.onClose(this);
+  }
+}
+
+export class LensfunZoomSequence {
+  readonly kind: MapKind;
+  readonly gridWidth: number;
+  readonly gridHeight: number;
+  readonly channels: number;
+  readonly anchors: number[];
+  readonly maxError: number;
+
+  private readonly module: LensfunModule;
+  private readonly fns: NativeFns;
+  private readonly onClose: (zoom: LensfunZoomSequence) => void;
+  private handle: number;
+  private ptr: number;
+
+  constructor(
+    module: LensfunModule,
+    fns: NativeFns,
+    handle: number,
+    kind: MapKind,
+    onClose: (zoom: LensfunZoomSequence) => void
+  ) {
+    this.module = module;
+    this.fns = fns;
+    this.handle = handle;
+    this.onClose = onClose;
+    this.kind = kind;
+
+    const info = parseJsonObjectPtr<{
+      anchors: number[];
+      maxError: number;
+      gridWidth: number;
+      gridHeight: number;
+      channels: number;
+    }>(module, fns.freePtr, fns.zoomInfoJson(handle) as number);
+    this.anchors = info.anchors;
+    this.maxError = info.maxError;
+    this.gridWidth = info.gridWidth;
+    this.gridHeight = info.gridHeight;
+    this.channels = info.channels;
+    this.ptr = module._malloc(this.frameFloats * 4);
+  }
+
+  get frameFloats(): number {
+    return this.gridWidth * this.gridHeight * this.channels;
+  }
+
+  frame(focal: number, out?: Float32Array): Float32Array {
+    this.ensureOpen();
+    const size = this.frameFloats;
+    const rc = this.fns.zoomBlend(this.handle, focal, this.ptr, size) as number;
+    if (rc !== 0) {
+      throw new Error(`[lensfun-wasm] lfw_zoom_blend failed with code ${rc}`);
+    }
+
+    const start = this.ptr >> 2;
+    const map = this.module.HEAPF32.subarray(start, start + size);
+    if (out) {
+      if (out.length < size) {
+        throw new Error(`[lensfun-wasm] output holds ${out.length} floats, ${size} needed`);
+      }
+      out.set(map);
+      return out.subarray(0, size);
+    }
+    return new Float32Array(map);
+  }
+
+  prepare(focal: number): void {
+    this.ensureOpen();
+    const rc = this.fns.zoomPrepare(this.handle, focal) as number;
+    if (rc !== 0) {
+      throw new Error(`[lensfun-wasm] lfw_zoom_prepare failed with code ${rc}`);
+    }
+  }
+
+  // The returned view aliases the wasm heap: it stays valid until the next
+  // acquire() and must not be kept across calls that may grow the heap.
+  acquire(): Float32Array {
+    this.ensureOpen();
+    const ptr = this.fns.zoomAcquire(this.handle) as number;
+    if (!ptr) {
+      throw new Error('[lensfun-wasm] no prepared zoom frame; call prepare() first');
+    }
+    const start = ptr >> 2;
+    return this.module.HEAPF32.subarray(start, start + this.frameFloats);
+  }
+
+  close(): void {
+    if (!this.handle) {
+      return;
+    }
+    this.fns.zoomDestroy(this.handle);
+    this.module._free(this.ptr);
+    this.handle = 0;
+    this.ptr = 0;
+    this.onClose(this);
+  }
+
+  private ensureOpen(): void {
+    if (!this.handle) {
+      throw new Error('[lensfun-wasm] zoom sequence is closed');
+    }
+  }
+}
+
+export class LensfunNormalizedMap {
+  readonly kind: MapKind;
+
+  private readonly module: LensfunModule;
+  private readonly fns: NativeFns;
+  private readonly onClose: (map: LensfunNormalizedMap) => void;
+  private handle: number;
+
+  constructor(
+    module: LensfunModule,
+    fns: NativeFns,
+    handle: number,
+    kind: MapKind,
+    onClose: (map: LensfunNormalizedMap) => void
+  ) {
+    this.module = module;
+    this.fns = fns;
+    this.handle = handle;
+    this.onClose = onClose;
+    this.kind = kind;
+  }
+
+  sample(width: number, height: number, step = 1): Float32Array {
+    this.ensureOpen();
+    const w = requirePositiveInt(width, 'width');
+    const h = requirePositiveInt(height, 'height');
+    const s = requirePositiveInt(step, 'step');
+    const size = toGrid(w, s) * toGrid(h, s) * MAP_KINDS[this.kind].channels;
+
+    const ptr = this.module._malloc(size * 4);
+    try {
+      const rc = this.fns.normalizedMapSample(this.handle, w, h, s, ptr, size) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_normalized_map_sample failed with code ${rc}`);
+      }
+
+      const start = ptr >> 2;
+      const out = new Float32Array(size);
+      out.set(this.module.HEAPF32.subarray(start, start + size));
+      return out;
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  close(): void {
+    if (!this.handle) {
+      return;
+    }
+    this.fns.normalizedMapDestroy(this.handle);
+    this.handle = 0;
+    this.onClose(this);
+  }
+
+  private ensureOpen(): void {
+    if (!this.handle) {
+      throw new Error('[lensfun-wasm] normalized map is closed');
+    }
+  }
+}
+
+export class LensfunFixedMap {
+  readonly kind: 'geometry' | 'tca';
+  readonly width: number;
+  readonly height: number;
+  readonly fractionBits: number;
+
+  private readonly module: LensfunModule;
+  private readonly fns: NativeFns;
+  private readonly onClose: (map: LensfunFixedMap) => void;
+  private handle: number;
+
+  constructor(
+    module: LensfunModule,
+    fns: NativeFns,
+    handle: number,
+    input: FixedMapInput,
+    onClose: (map: LensfunFixedMap) => void
+  ) {
+    this.module = module;
+    this.fns = fns;
+    this.handle = handle;
+    this.onClose = onClose;
+    this.kind = input.kind;
+    this.width = input.width;
+    this.height = input.height;
+    this.fractionBits = fns.fixedMapFractionBits(handle) as number;
+  }
+
+  // Remaps an RGBA8 image of the map's size, such as ImageData.data.
+  remap(source: Uint8Array | Uint8ClampedArray, target?: Uint8ClampedArray): Uint8ClampedArray {
+    this.ensureOpen();
+    const size = this.width * this.height * 4;
+    if (source.length < size) {
+      throw new Error(`[lensfun-wasm] source has ${source.length} bytes, ${size} needed`);
+    }
+    const out = target ?? new Uint8ClampedArray(size);
+    if (out.length < size) {
+      throw new Error(`[lensfun-wasm] target has ${out.length} bytes, ${size} needed`);
+    }
+
+    const srcPtr = this.module._malloc(size);
+    const dstPtr = this.module._malloc(size);
+    try {
+      new Uint8Array(this.module.HEAPF32.buffer, srcPtr, size).set(source.subarray(0, size));
+      const rc = this.fns.fixedMapRemap(this.handle, srcPtr, size, dstPtr, size, 0, this.height) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_fixed_map_remap failed with code ${rc}`);
+      }
+      out.set(new Uint8Array(this.module.HEAPF32.buffer, dstPtr, size));
+      return out;
+    } finally {
+      this.module._free(dstPtr);
+      this.module._free(srcPtr);
+    }
+  }
+
+  close(): void {
+    if (!this.handle) {
+      return;
+    }
+    this.fns.fixedMapDestroy(this.handle);
+    this.handle = 0;
+    this.onClose(this);
+  }
+
+  private ensureOpen(): void {
+    if (!this.handle) {
+      throw new Error('[lensfun-wasm] fixed map is closed');
+    }
+  }
+}
+
+const MAP_KIND_NAMES: MapKind[] = ['geometry', 'tca', 'vignetting'];
+// Map blob header size; native/src/lfw_blob.h lists the field offsets.
+const MAP_BLOB_HEADER_BYTES = 88;
+
+const MAP_JOB_STAGES: MapJobStage[] = ['coarse', 'refine', 'done'];
+// lfw_map_job_run code for a cancelled job.
+const MAP_JOB_CANCELLED = -7;
+
+export class LensfunMapJob {
+  readonly kind: MapKind;
+  readonly gridWidth: number;
+  readonly gridHeight: number;
+  readonly step: number;
+  readonly coarseStep: number;
+  readonly coarseGridWidth: number;
+  readonly coarseGridHeight: number;
+
+  private readonly module: LensfunModule;
+  private readonly fns: NativeFns;
+  private readonly onClose: (job: LensfunMapJob) => void;
+  private handle: number;
+
+  constructor(
+    module: LensfunModule,
+    fns: NativeFns,
+    handle: number,
+    input: MapJobInput,
+    onClose: (job: LensfunMapJob) => void
+  ) {
+    this.module = module;
+    this.fns = fns;
+    this.handle = handle;
+    this.onClose = onClose;
+    this.kind = input.kind;
+    this.step = input.step ?? 1;
+    this.coarseStep = input.coarseStep ?? 0;
+    this.gridWidth = toGrid(input.width, this.step);
+    this.gridHeight = toGrid(input.height, this.step);
+    this.coarseGridWidth = this.coarseStep > 0 ? toGrid(input.width, this.coarseStep) : 0;
+    this.coarseGridHeight = this.coarseStep > 0 ? toGrid(input.height, this.coarseStep) : 0;
+  }
+
+  // Builds up to `maxRows` grid rows (all that are left when 0). Throws once
+  // the job has been cancelled.
+  run(maxRows = 0): MapJobStage {
+    this.ensureOpen();
+    const rc = this.fns.mapJobRun(this.handle, Math.max(0, Math.floor(maxRows))) as number;
+    if (rc === MAP_JOB_CANCELLED) {
+      throw new Error('[lensfun-wasm] map job was cancelled');
+    }
+    if (rc < 0) {
+      throw new Error(`[lensfun-wasm] lfw_map_job_run failed with code ${rc}`);
+    }
+    return MAP_JOB_STAGES[rc];
+  }
+
+  // Safe to call while another thread runs the job; the run stops at its
+  // next row band.
+  cancel(): void {
+    this.ensureOpen();
+    this.fns.mapJobCancel(this.handle);
+  }
+
+  get progress(): number {
+    this.ensureOpen();
+    return Math.max(0, this.fns.mapJobProgress(this.handle) as number);
+  }
+
+  coarse(): Float32Array | null {
+    this.ensureOpen();
+    return this.copyOut(
+      this.fns.mapJobCoarse(this.handle) as number,
+      this.coarseGridWidth * this.coarseGridHeight * MAP_KINDS[this.kind].channels
+    );
+  }
+
+  result(): Float32Array | null {
+    this.ensureOpen();
+    return this.copyOut(
+      this.fns.mapJobResult(this.handle) as number,
+      this.gridWidth * this.gridHeight * MAP_KINDS[this.kind].channels
+    );
+  }
+
+  close(): void {
+    if (!this.handle) {
+      return;
+    }
+    this.fns.mapJobDestroy(this.handle);
+    this.handle = 0;
+    this.onClose(this);
+  }
+
+  private copyOut(ptr: number, size: number): Float32Array | null {
+    if (!ptr) {
+      return null;
+    }
+    const start = ptr >> 2;
+    const out = new Float32Array(size);
+    out.set(this.module.HEAPF32.subarray(start, start + size));
+    return out;
+  }
+
+  private ensureOpen(): void {
+    if (!this.handle) {
+      throw new Error('[lensfun-wasm] map job is closed');
+    }
+  }
+}
+
+export class LensfunClient {
+  private readonly module: LensfunModule;
+  private readonly fns: NativeFns;
+  private readonly streams = new Set<LensfunMapStream>();
+  private readonly zooms = new Set<LensfunZoomSequence>();
+  private readonly normalizedMaps = new Set<LensfunNormalizedMap>();
+  private readonly fixedMaps = new Set<LensfunFixedMap>();
+  private readonly jobs = new Set<LensfunMapJob>();
+  private disposed = false;
+
+  constructor(module: LensfunModule, fns: NativeFns) {
+    this.module = module;
+    this.fns = fns;
+  }
+
+  dispose(): void {
+    if (this.disposed) {
+      return;
+    }
+    for (const stream of [...this.streams]) {
+      stream.close();
+    }
+    for (const zoom of [...this.zooms]) {
+      zoom.close();
+    }
+    for (const map of [...this.normalizedMaps]) {
+      map.close();
+    }
+    for (const map of [...this.fixedMaps]) {
+      map.close();
+    }
+    for (const job of [...this.jobs]) {
+      job.close();
+    }
+    this.fns.dispose();
+    this.disposed = true;
+  }
+
+  loadDatabaseXml(docId: string, xml: string): void {
+    this.ensureAlive();
+    const id = requiredString(docId, 'docId');
+    const bytes = this.module.lengthBytesUTF8(xml);
+    const ptr = this.module._malloc(bytes + 1);
+    try {
+      this.module.stringToUTF8(xml, ptr, bytes + 1);
+      const rc = this.fns.dbLoadXml(id, ptr, bytes) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_db_load_xml failed with code ${rc} for ${id}`);
+      }
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  loadDatabaseFile(path: string): void {
+    this.ensureAlive();
+    const file = requiredString(path, 'path');
+    const rc = this.fns.dbLoadFile(file) as number;
+    if (rc !== 0) {
+      throw new Error(`[lensfun-wasm] lfw_db_load_file failed with code ${rc} for ${file}`);
+    }
+  }
+
+  unloadDatabaseDocument(docId: string): boolean {
+    this.ensureAlive();
+    return (this.fns.dbUnload(requiredString(docId, 'docId')) as number) === 0;
+  }
+
+  compactDatabase(minRetired = 0): boolean {
+    this.ensureAlive();
+    if (!Number.isInteger(minRetired) || minRetired < 0) {
+      throw new Error('[lensfun-wasm] minRetired must be a non-negative integer');
+    }
+    const rc = this.fns.dbCompact(minRetired) as number;
+    if (rc < 0) {
+      throw new Error(`[lensfun-wasm] lfw_db_compact failed with code ${rc}`);
+    }
+    return rc === 1;
+  }
+
+  searchLenses(input: SearchLensesInput): LensMatch[] {
+    this.ensureAlive();
+    const lensModel = requiredString(input.lensModel, 'lensModel');
+    const ptr = this.fns.findLensesJson(
+      input.cameraMaker ?? '',
+      input.cameraModel ?? '',
+      input.lensMaker ?? '',
+      lensModel,
+      input.searchFlags ?? LF_SEARCH_SORT_AND_UNIQUIFY
+    ) as number;
+    return parseJsonPtr<LensMatch>(this.module, this.fns.freePtr, ptr);
+  }
+
+  searchCameras(input: SearchCamerasInput): CameraMatch[] {
+    this.ensureAlive();
+    const ptr = this.fns.findCamerasJson(
+      input.maker ?? '',
+      input.model ?? '',
+      input.searchFlags ?? 0
+    ) as number;
+    return parseJsonPtr<CameraMatch>(this.module, this.fns.freePtr, ptr);
+  }
+
+  getAvailableModifications(lensHandle: number, crop: number): number {
+    this.ensureAlive();
+    return this.fns.availableMods(lensHandle, crop) as number;
+  }
+
+  buildCorrectionMaps(input: CorrectionInput): CorrectionMaps {
+    this.ensureAlive();
+
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const step = requirePositiveInt(input.step ?? 1, 'step');
+
+    const gridWidth = toGrid(width, step);
+    const gridHeight = toGrid(height, step);
+
+    const geometry = this.runFloatMap(
+      gridWidth * gridHeight * 2,
+      this.fns.buildGeometryMap,
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      width,
+      height,
+      toFlag(input.reverse),
+      step
+    );
+
+    const result: CorrectionMaps = {
+      gridWidth,
+      gridHeight,
+      step,
+      geometry
+    };
+
+    if (input.includeTca) {
+      result.tca = this.runFloatMap(
+        gridWidth * gridHeight * 6,
+        this.fns.buildTcaMap,
+        input.lensHandle,
+        input.focal,
+        input.crop,
+        width,
+        height,
+        toFlag(input.reverse),
+        step
+      );
+    }
+
+    if (input.includeVignetting) {
+      if (typeof input.aperture !== 'number') {
+        throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+      }
+      result.vignetting = this.runFloatMap(
         gridWidth * gridHeight * 3,
         this.fns.buildVignettingMap,
         input.lensHandle,
@@ -351,11 +1488,837 @@ export class LensfunClient {
         width,
         height,
         toFlag(input.reverse),
-        step
-      );
+        step
+      );
+    }
+
+    return result;
+  }
+
+  openMapStream(input: MapStreamInput): LensfunMapStream {
+    this.ensureAlive();
+
+    const kind = MAP_KINDS[input.kind];
+    if (!kind) {
+      throw new Error(`[lensfun-wasm] unknown map kind ${String(input.kind)}`);
+    }
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const step = requirePositiveInt(input.step ?? 1, 'step');
+    requirePositiveInt(input.bandRows ?? 64, 'bandRows');
+    if (input.kind === 'vignetting' && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+    }
+
+    const handle = this.fns.mapStreamCreate(
+      kind.id,
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      input.aperture ?? 0,
+      input.distance ?? 1000,
+      width,
+      height,
+      toFlag(input.reverse),
+      step
+    ) as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_map_stream_create failed with code ${handle}`);
+    }
+
+    const stream = new LensfunMapStream(this.module, this.fns, handle, input, (closed) => this.streams.delete(closed));
+    this.streams.add(stream);
+    return stream;
+  }
+
+  openMapJob(input: MapJobInput): LensfunMapJob {
+    this.ensureAlive();
+
+    const kind = MAP_KINDS[input.kind];
+    if (!kind) {
+      throw new Error(`[lensfun-wasm] unknown map kind ${String(input.kind)}`);
+    }
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const step = requirePositiveInt(input.step ?? 1, 'step');
+    const coarseStep = input.coarseStep ?? 0;
+    if (coarseStep !== 0 && (!Number.isInteger(coarseStep) || coarseStep <= step || coarseStep % step !== 0)) {
+      throw new Error('[lensfun-wasm] coarseStep must be 0 or a multiple of step larger than it');
+    }
+    if (input.kind === 'vignetting' && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+    }
+
+    const handle = this.fns.mapJobCreate(
+      kind.id,
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      input.aperture ?? 0,
+      input.distance ?? 1000,
+      width,
+      height,
+      toFlag(input.reverse),
+      step,
+      coarseStep
+    ) as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_map_job_create failed with code ${handle}`);
+    }
+
+    const job = new LensfunMapJob(this.module, this.fns, handle, input, (closed) => this.jobs.delete(closed));
+    this.jobs.add(job);
+    return job;
+  }
+
+  // Builds a map a slice of rows at a time, yielding to the event loop in
+  // between so an aborted build stops at the next slice.
+  async buildMapProgressive(input: MapJobInput, options: ProgressiveMapOptions = {}): Promise<Float32Array> {
+    const rowsPerSlice = requirePositiveInt(options.rowsPerSlice ?? 64, 'rowsPerSlice');
+    const job = this.openMapJob({ ...input, coarseStep: input.coarseStep ?? 32 * (input.step ?? 1) });
+    try {
+      let stage: MapJobStage = 'coarse';
+      let coarseSent = false;
+      while (stage !== 'done') {
+        if (options.signal?.aborted) {
+          job.cancel();
+        }
+        stage = job.run(rowsPerSlice);
+        if (stage !== 'coarse' && !coarseSent) {
+          coarseSent = true;
+          const coarse = job.coarse();
+          if (coarse && options.onCoarse) {
+            options.onCoarse(coarse, job.coarseGridWidth, job.coarseGridHeight);
+          }
+        }
+        if (stage !== 'done') {
+          await new Promise<void>((resolve) => setTimeout(resolve, 0));
+        }
+      }
+      return job.result() as Float32Array;
+    } finally {
+      job.close();
+    }
+  }
+
+  openZoomSequence(input: ZoomSequenceInput): LensfunZoomSequence {
+    this.ensureAlive();
+
+    const kind = MAP_KINDS[input.kind];
+    if (!kind) {
+      throw new Error(`[lensfun-wasm] unknown map kind ${String(input.kind)}`);
+    }
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const step = requirePositiveInt(input.step ?? 1, 'step');
+    const maxAnchors = requirePositiveInt(input.maxAnchors ?? 16, 'maxAnchors');
+    if (!(input.minFocal > 0) || !(input.maxFocal >= input.minFocal)) {
+      throw new Error('[lensfun-wasm] focal range must satisfy 0 < minFocal <= maxFocal');
+    }
+    if (input.kind === 'vignetting' && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+    }
+
+    const handle = this.fns.zoomCreate(
+      kind.id,
+      input.lensHandle,
+      input.minFocal,
+      input.maxFocal,
+      input.crop,
+      input.aperture ?? 0,
+      input.distance ?? 1000,
+      width,
+      height,
+      toFlag(input.reverse),
+      step,
+      input.tolerance ?? 0.05,
+      maxAnchors
+    ) as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_zoom_create failed with code ${handle}`);
+    }
+
+    const zoom = new LensfunZoomSequence(this.module, this.fns, handle, input.kind, (closed) =>
+      this.zooms.delete(closed)
+    );
+    this.zooms.add(zoom);
+    return zoom;
+  }
+
+  openNormalizedMap(input: NormalizedMapInput): LensfunNormalizedMap {
+    this.ensureAlive();
+
+    const kind = MAP_KINDS[input.kind];
+    if (!kind) {
+      throw new Error(`[lensfun-wasm] unknown map kind ${String(input.kind)}`);
+    }
+    if (!(input.aspect > 0)) {
+      throw new Error('[lensfun-wasm] aspect must be positive');
+    }
+    const gridSize = requirePositiveInt(input.gridSize ?? 257, 'gridSize');
+    if (input.kind === 'vignetting' && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+    }
+
+    const handle = this.fns.normalizedMapCreate(
+      kind.id,
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      input.aperture ?? 0,
+      input.distance ?? 1000,
+      input.aspect,
+      toFlag(input.reverse),
+      gridSize
+    ) as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_normalized_map_create failed with code ${handle}`);
+    }
+
+    const map = new LensfunNormalizedMap(this.module, this.fns, handle, input.kind, (closed) =>
+      this.normalizedMaps.delete(closed)
+    );
+    this.normalizedMaps.add(map);
+    return map;
+  }
+
+  getCorrectionDescriptor(input: CorrectionDescriptorInput): Float32Array {
+    this.ensureAlive();
+
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const size = CORRECTION_DESCRIPTOR_FLOATS;
+    const ptr = this.module._malloc(size * 4);
+    try {
+      const rc = this.fns.correctionDescriptor(
+        input.lensHandle,
+        input.focal,
+        input.crop,
+        input.aperture ?? 0,
+        input.distance ?? 1000,
+        width,
+        height,
+        toFlag(input.reverse),
+        ptr,
+        size
+      ) as number;
+      if (rc !== size) {
+        throw new Error(`[lensfun-wasm] lfw_correction_descriptor failed with code ${rc}`);
+      }
+
+      const start = ptr >> 2;
+      const out = new Float32Array(size);
+      out.set(this.module.HEAPF32.subarray(start, start + size));
+      return out;
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  buildMapsFromDescriptor(descriptor: Float32Array, options: DescriptorMapOptions = {}): CorrectionMaps {
+    this.ensureAlive();
+
+    const size = CORRECTION_DESCRIPTOR_FLOATS;
+    if (descriptor.length < size) {
+      throw new Error(`[lensfun-wasm] correction descriptor must have ${size} floats`);
+    }
+    const step = requirePositiveInt(options.step ?? 1, 'step');
+    const gridWidth = toGrid(requirePositiveInt(descriptor[1], 'descriptor width'), step);
+    const gridHeight = toGrid(requirePositiveInt(descriptor[2], 'descriptor height'), step);
+
+    const ptr = this.module._malloc(size * 4);
+    try {
+      this.module.HEAPF32.set(descriptor.subarray(0, size), ptr >> 2);
+      const run = (kind: MapKind): Float32Array =>
+        this.runFloatMap(
+          gridWidth * gridHeight * MAP_KINDS[kind].channels,
+          this.fns.descriptorBuildMap,
+          ptr,
+          size,
+          MAP_KINDS[kind].id,
+          step
+        );
+
+      const result: CorrectionMaps = {
+        gridWidth,
+        gridHeight,
+        step,
+        geometry: run('geometry')
+      };
+      if (options.includeTca) {
+        result.tca = run('tca');
+      }
+      if (options.includeVignetting) {
+        result.vignetting = run('vignetting');
+      }
+      return result;
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  getValidCrop(input: ValidCropInput): ValidCrop {
+    this.ensureAlive();
+
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const mods = LF_MODIFY_DISTORTION | (input.includeTca ? LF_MODIFY_TCA : 0);
+    const ptr = this.module._malloc(5 * 4);
+    try {
+      const rc = this.fns.validCrop(input.lensHandle, input.focal, input.crop, width, height, mods, ptr, 5) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_valid_crop failed with code ${rc}`);
+      }
+
+      const view = this.module.HEAPF32.subarray(ptr >> 2, (ptr >> 2) + 5);
+      return { scale: view[0], x: view[1], y: view[2], width: view[3], height: view[4] };
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  renderThumbnail(input: ThumbnailInput): Float32Array {
+    this.ensureAlive();
+
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const outWidth = requirePositiveInt(input.outWidth, 'outWidth');
+    const outHeight = requirePositiveInt(input.outHeight, 'outHeight');
+    const channels = input.channels ?? 3;
+    if (channels !== 1 && channels !== 3 && channels !== 4) {
+      throw new Error('[lensfun-wasm] channels must be 1, 3 or 4');
+    }
+    if ((input.mods & LF_MODIFY_VIGNETTING) !== 0 && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting correction');
+    }
+    const sourceSize = width * height * channels;
+    if (input.source.length < sourceSize) {
+      throw new Error(`[lensfun-wasm] source has ${input.source.length} floats, ${sourceSize} needed`);
+    }
+
+    const outSize = outWidth * outHeight * channels;
+    const srcPtr = this.module._malloc(sourceSize * 4);
+    const outPtr = this.module._malloc(outSize * 4);
+    try {
+      this.module.HEAPF32.set(input.source.subarray(0, sourceSize), srcPtr >> 2);
+      const rc = this.fns.thumbnail(
+        input.lensHandle,
+        input.focal,
+        input.crop,
+        input.aperture ?? 0,
+        input.distance ?? 1000,
+        width,
+        height,
+        channels,
+        input.mods,
+        input.filter === 'lanczos3' ? 1 : 0,
+        srcPtr,
+        sourceSize,
+        outWidth,
+        outHeight,
+        outPtr,
+        outSize
+      ) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_thumbnail failed with code ${rc}`);
+      }
+
+      const out = new Float32Array(outSize);
+      const start = outPtr >> 2;
+      out.set(this.module.HEAPF32.subarray(start, start + outSize));
+      return out;
+    } finally {
+      this.module._free(outPtr);
+      this.module._free(srcPtr);
+    }
+  }
+
+  correctCfaVignetting(input: CfaVignettingInput): void {
+    this.ensureAlive();
+
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const stride = input.stride ?? width;
+    if (!Number.isInteger(stride) || stride < width) {
+      throw new Error('[lensfun-wasm] stride must be an integer of at least width');
+    }
+    const size = stride * (height - 1) + width;
+    if (input.data.length < size) {
+      throw new Error(`[lensfun-wasm] data has ${input.data.length} photosites, ${size} needed`);
+    }
+
+    const ptr = this.module._malloc(size * 2);
+    try {
+      const heap = new Uint16Array(this.module.HEAPF32.buffer, ptr, size);
+      heap.set(input.data.subarray(0, size));
+      const rc = this.fns.cfaVignetting(
+        input.lensHandle,
+        input.focal,
+        input.crop,
+        input.aperture,
+        input.distance ?? 1000,
+        width,
+        height,
+        input.pattern,
+        input.patternWidth,
+        input.blackLevel ?? 0,
+        input.whiteLevel ?? 65535,
+        ptr,
+        stride,
+        size
+      ) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_cfa_vignetting failed with code ${rc}`);
+      }
+      input.data.set(new Uint16Array(this.module.HEAPF32.buffer, ptr, size));
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  openFixedMap(input: FixedMapInput): LensfunFixedMap {
+    this.ensureAlive();
+
+    if (input.kind !== 'geometry' && input.kind !== 'tca') {
+      throw new Error(`[lensfun-wasm] fixed maps support geometry and tca, not ${String(input.kind)}`);
+    }
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+
+    const handle = this.fns.fixedMapCreate(
+      MAP_KINDS[input.kind].id,
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      width,
+      height,
+      toFlag(input.reverse)
+    ) as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_fixed_map_create failed with code ${handle}`);
+    }
+
+    const map = new LensfunFixedMap(this.module, this.fns, handle, { ...input, width, height }, (closed) =>
+      this.fixedMaps.delete(closed)
+    );
+    this.fixedMaps.add(map);
+    return map;
+  }
+
+  // Identifies the loaded database content; map blobs only import into a
+  // database with the same hash.
+  getDatabaseHash(): string {
+    this.ensureAlive();
+    const ptr = this.fns.dbContentHash() as number;
+    if (!ptr) {
+      throw new Error('[lensfun-wasm] no database is loaded');
+    }
+    const hash = this.module.UTF8ToString(ptr);
+    this.fns.freePtr(ptr);
+    return hash;
+  }
+
+  // Builds a map into a blob that can be stored and imported in a later
+  // session.
+  exportMapBlob(input: MapBlobInput): Uint8Array {
+    this.ensureAlive();
+
+    const args = this.mapBlobArgs(input);
+    const [kind, lensHandle, , , , , width, height, , step] = args;
+    const size = this.fns.mapBlobSize(kind, lensHandle, width, height, step) as number;
+    if (size <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_map_blob_size failed with code ${size}`);
+    }
+    const ptr = this.module._malloc(size);
+    try {
+      const rc = this.fns.mapBlobExport(...args, ptr, size) as number;
+      if (rc !== size) {
+        throw new Error(`[lensfun-wasm] lfw_map_blob_export failed with code ${rc}`);
+      }
+      return new Uint8Array(this.module.HEAPF32.buffer, ptr, size).slice();
+    } finally {
+      this.module._free(ptr);
+    }
+  }
+
+  // Returns the blob's map when it holds the map `expected` describes, or
+  // null when the blob is damaged, from another bridge version or database,
+  // names a lens that is not loaded, or holds a different map.
+  importMapBlob(blob: Uint8Array, expected: MapBlobInput): ImportedMap | null {
+    this.ensureAlive();
+    const args = this.mapBlobArgs(expected);
+    if (blob.length < MAP_BLOB_HEADER_BYTES) {
+      return null;
+    }
+    const header = new DataView(blob.buffer, blob.byteOffset, MAP_BLOB_HEADER_BYTES);
+    const kind = MAP_KIND_NAMES[header.getInt32(24, true)];
+    const gridWidth = header.getInt32(60, true);
+    const gridHeight = header.getInt32(64, true);
+    const floats = gridWidth * gridHeight * header.getInt32(68, true);
+    if (!kind || !(floats > 0) || floats * 4 > blob.length) {
+      return null;
+    }
+
+    const blobPtr = this.module._malloc(blob.length);
+    const outPtr = this.module._malloc(floats * 4);
+    try {
+      new Uint8Array(this.module.HEAPF32.buffer, blobPtr, blob.length).set(blob);
+      const rc = this.fns.mapBlobImport(blobPtr, blob.length, ...args, outPtr, floats) as number;
+      if (rc !== 0) {
+        return null;
+      }
+      const start = outPtr >> 2;
+      return {
+        kind,
+        lensHandle: expected.lensHandle,
+        width: header.getInt32(28, true),
+        height: header.getInt32(32, true),
+        focal: header.getFloat32(44, true),
+        crop: header.getFloat32(48, true),
+        aperture: header.getFloat32(52, true),
+        distance: header.getFloat32(56, true),
+        step: header.getInt32(36, true),
+        reverse: header.getInt32(40, true) !== 0,
+        gridWidth,
+        gridHeight,
+        map: this.module.HEAPF32.slice(start, start + floats)
+      };
+    } finally {
+      this.module._free(outPtr);
+      this.module._free(blobPtr);
+    }
+  }
+
+  // The key arguments shared by lfw_map_blob_export and lfw_map_blob_import.
+  private mapBlobArgs(input: MapBlobInput): number[] {
+    const kind = MAP_KINDS[input.kind];
+    if (!kind) {
+      throw new Error(`[lensfun-wasm] unknown map kind ${String(input.kind)}`);
+    }
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const step = requirePositiveInt(input.step ?? 1, 'step');
+    if (input.kind === 'vignetting' && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+    }
+    return [
+      kind.id,
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      input.aperture ?? 0,
+      input.distance ?? 1000,
+      width,
+      height,
+      toFlag(input.reverse),
+      step
+    ];
+  }
+
+  // Picks the largest grid step, up to `maxStep` (default 64), whose map
+  // stays within `tolerance` of the exact one, from a sparse probe of the
+  // lens model rather than built grids.
+  chooseStep(input: StepChoiceInput): StepChoice {
+    this.ensureAlive();
+
+    const kind = MAP_KINDS[input.kind];
+    if (!kind) {
+      throw new Error(`[lensfun-wasm] unknown map kind ${String(input.kind)}`);
+    }
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const maxStep = requirePositiveInt(input.maxStep ?? 64, 'maxStep');
+    if (!(input.tolerance > 0)) {
+      throw new Error('[lensfun-wasm] tolerance must be positive');
+    }
+    if (input.kind === 'vignetting' && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+    }
+
+    const ptr = this.module._malloc(3 * 4);
+    try {
+      const rc = this.fns.chooseStep(
+        kind.id,
+        input.lensHandle,
+        input.focal,
+        input.crop,
+        input.aperture ?? 0,
+        input.distance ?? 1000,
+        width,
+        height,
+        toFlag(input.reverse),
+        input.tolerance,
+        maxStep,
+        ptr,
+        3
+      ) as number;
+      if (rc !== 0) {
+        throw new Error(`[lensfun-wasm] lfw_choose_step failed with code ${rc}`);
+      }
+
+      const view = this.module.HEAPF32.subarray(ptr >> 2, (ptr >> 2) + 3);
+      return { step: view[0], error: view[1], evaluations: view[2] };
+    } finally {
+      this.module._free(ptr);
     }
+  }
 
-    return result;
+  // Corrects many images in one call: items with the same parameters share
+  // maps built once, and pixels are remapped on up to `threads` threads
+  // (where the build has them).
+  correctBatch(items: BatchCorrectionItem[], options: BatchCorrectionOptions = {}): BatchCorrectionResult {
+    this.ensureAlive();
+
+    const threads = requirePositiveInt(options.threads ?? 1, 'threads');
+    const handle = this.fns.batchCreate() as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_batch_create failed with code ${handle}`);
+    }
+
+    const buffers: number[] = [];
+    const outputPtrs: number[] = [];
+    try {
+      items.forEach((item, index) => {
+        const width = requirePositiveInt(item.width, 'width');
+        const height = requirePositiveInt(item.height, 'height');
+        const step = requirePositiveInt(item.step ?? 1, 'step');
+        if (item.includeVignetting && typeof item.aperture !== 'number') {
+          throw new Error('[lensfun-wasm] aperture is required for vignetting map');
+        }
+        const mods =
+          LF_MODIFY_DISTORTION |
+          (item.includeTca ? LF_MODIFY_TCA : 0) |
+          (item.includeVignetting ? LF_MODIFY_VIGNETTING : 0);
+        const rc = this.fns.batchAdd(
+          handle,
+          item.lensHandle,
+          item.focal,
+          item.crop,
+          item.aperture ?? 0,
+          item.distance ?? 1000,
+          width,
+          height,
+          toFlag(item.reverse),
+          step,
+          mods
+        ) as number;
+        if (rc !== index) {
+          throw new Error(`[lensfun-wasm] lfw_batch_add failed with code ${rc} for item ${index}`);
+        }
+
+        if (!item.pixels) {
+          return;
+        }
+        const channels = item.channels ?? 3;
+        if (channels !== 1 && channels !== 3 && channels !== 4) {
+          throw new Error('[lensfun-wasm] channels must be 1, 3 or 4');
+        }
+        const size = width * height * channels;
+        if (item.pixels.length < size) {
+          throw new Error(`[lensfun-wasm] item ${index} has ${item.pixels.length} floats, ${size} needed`);
+        }
+        const srcPtr = this.module._malloc(size * 4);
+        buffers.push(srcPtr);
+        const dstPtr = this.module._malloc(size * 4);
+        buffers.push(dstPtr);
+        if (!srcPtr || !dstPtr) {
+          throw new Error(`[lensfun-wasm] out of memory for the pixels of item ${index}`);
+        }
+        outputPtrs[index] = dstPtr;
+        this.module.HEAPF32.set(item.pixels.subarray(0, size), srcPtr >> 2);
+        const pixelsRc = this.fns.batchSetPixels(handle, index, srcPtr, dstPtr, channels) as number;
+        if (pixelsRc !== 0) {
+          throw new Error(`[lensfun-wasm] lfw_batch_set_pixels failed with code ${pixelsRc} for item ${index}`);
+        }
+      });
+
+      const groupCount = this.fns.batchRun(handle, threads) as number;
+      if (groupCount < 0) {
+        throw new Error(`[lensfun-wasm] lfw_batch_run failed with code ${groupCount}`);
+      }
+
+      const copy = (ptr: number, size: number): Float32Array => {
+        const start = ptr >> 2;
+        return this.module.HEAPF32.slice(start, start + size);
+      };
+      const groups: CorrectionMaps[] = new Array(groupCount);
+      const itemGroups: number[] = [];
+      const outputs: (Float32Array | undefined)[] = [];
+      items.forEach((item, index) => {
+        const status = this.fns.batchItemStatus(handle, index) as number;
+        if (status !== 0) {
+          throw new Error(`[lensfun-wasm] batch map build failed with code ${status} for item ${index}`);
+        }
+        const group = this.fns.batchItemGroup(handle, index) as number;
+        itemGroups.push(group);
+        if (!groups[group]) {
+          const step = item.step ?? 1;
+          const gridWidth = toGrid(item.width, step);
+          const gridHeight = toGrid(item.height, step);
+          const points = gridWidth * gridHeight;
+          const maps: CorrectionMaps = {
+            gridWidth,
+            gridHeight,
+            step,
+            geometry: copy(this.fns.batchMap(handle, index, MAP_KINDS.geometry.id) as number, points * 2)
+          };
+          if (item.includeTca) {
+            maps.tca = copy(this.fns.batchMap(handle, index, MAP_KINDS.tca.id) as number, points * 6);
+          }
+          if (item.includeVignetting) {
+            maps.vignetting = copy(this.fns.batchMap(handle, index, MAP_KINDS.vignetting.id) as number, points * 3);
+          }
+          groups[group] = maps;
+        }
+        outputs.push(
+          outputPtrs[index] !== undefined
+            ? copy(outputPtrs[index], item.width * item.height * (item.channels ?? 3))
+            : undefined
+        );
+      });
+      return { groups, itemGroups, outputs };
+    } finally {
+      for (const ptr of buffers) {
+        this.module._free(ptr);
+      }
+      this.fns.batchDestroy(handle);
+    }
+  }
+
+  async correctTiled(input: TiledCorrectionInput): Promise<void> {
+    this.ensureAlive();
+
+    const width = requirePositiveInt(input.width, 'width');
+    const height = requirePositiveInt(input.height, 'height');
+    const tileSize = requirePositiveInt(input.tileSize ?? 256, 'tileSize');
+    const channels = input.channels ?? 3;
+    if (channels !== 1 && channels !== 3 && channels !== 4) {
+      throw new Error('[lensfun-wasm] channels must be 1, 3 or 4');
+    }
+    if ((input.mods & LF_MODIFY_VIGNETTING) !== 0 && typeof input.aperture !== 'number') {
+      throw new Error('[lensfun-wasm] aperture is required for vignetting correction');
+    }
+
+    const handle = this.fns.tilerCreate(
+      input.lensHandle,
+      input.focal,
+      input.crop,
+      input.aperture ?? 0,
+      input.distance ?? 1000,
+      width,
+      height,
+      channels,
+      input.mods,
+      tileSize
+    ) as number;
+    if (handle <= 0) {
+      throw new Error(`[lensfun-wasm] lfw_tiler_create failed with code ${handle}`);
+    }
+
+    const outSize = tileSize * tileSize * channels;
+    const rectsPtr = this.module._malloc(8 * 4);
+    const outPtr = this.module._malloc(outSize * 4);
+    try {
+      const tiles = this.fns.tilerTileCount(handle) as number;
+      for (let index = 0; index < tiles; index += 1) {
+        let rc = this.fns.tilerBeginTile(handle, index, rectsPtr) as number;
+        if (rc !== 0) {
+          throw new Error(`[lensfun-wasm] lfw_tiler_begin_tile failed with code ${rc}`);
+        }
+        const r = new Int32Array(this.module.HEAPF32.buffer, rectsPtr, 8);
+        const dst: TileRect = { x: r[0], y: r[1], width: r[2], height: r[3] };
+        const src: TileRect = { x: r[4], y: r[5], width: r[6], height: r[7] };
+
+        if (src.width > 0) {
+          const pixels = await input.read(src);
+          const size = src.width * src.height * channels;
+          if (pixels.length < size) {
+            throw new Error(`[lensfun-wasm] read returned ${pixels.length} floats, ${size} needed`);
+          }
+          const bufPtr = this.fns.tilerSourceBuffer(handle) as number;
+          this.module.HEAPF32.set(pixels.subarray(0, size), bufPtr >> 2);
+        }
+
+        rc = this.fns.tilerFinishTile(handle, outPtr, outSize) as number;
+        if (rc !== 0) {
+          throw new Error(`[lensfun-wasm] lfw_tiler_finish_tile failed with code ${rc}`);
+        }
+        const start = outPtr >> 2;
+        await input.write(dst, this.module.HEAPF32.subarray(start, start + dst.width * dst.height * channels));
+      }
+    } finally {
+      this.module._free(outPtr);
+      this.module._free(rectsPtr);
+      this.fns.tilerDestroy(handle);
+    }
+  }
+
+  getStats(): LensfunStats {
+    this.ensureAlive();
+    const ptr = this.fns.getStatsJson() as number;
+    return parseJsonObjectPtr<LensfunStats>(this.module, this.fns.freePtr, ptr);
+  }
+
+  resetStats(): void {
+    this.ensureAlive();
+    this.fns.resetStats();
+  }
+
+  startTrace(capacity = 65536): void {
+    this.ensureAlive();
+    const rc = this.fns.traceStart(requirePositiveInt(capacity, 'capacity')) as number;
+    if (rc !== 0) {
+      throw new Error(`[lensfun-wasm] lfw_trace_start failed with code ${rc}`);
+    }
+  }
+
+  stopTrace(): void {
+    this.ensureAlive();
+    this.fns.traceStop();
+  }
+
+  dumpTrace(): LensfunTrace {
+    this.ensureAlive();
+    const ptr = this.fns.traceDumpJson() as number;
+    return parseJsonObjectPtr<LensfunTrace>(this.module, this.fns.freePtr, ptr);
+  }
+
+  startCapture(maxBytes = 16 * 1024 * 1024): void {
+    this.ensureAlive();
+    const rc = this.fns.captureStart(requirePositiveInt(maxBytes, 'maxBytes')) as number;
+    if (rc !== 0) {
+      throw new Error(`[lensfun-wasm] lfw_capture_start failed with code ${rc}`);
+    }
+  }
+
+  stopCapture(): void {
+    this.ensureAlive();
+    this.fns.captureStop();
+  }
+
+  dumpCapture(): string {
+    this.ensureAlive();
+    const ptr = this.fns.captureDump() as number;
+    if (!ptr) {
+      throw new Error('[lensfun-wasm] native call returned no data');
+    }
+    const raw = this.module.UTF8ToString(ptr);
+    this.fns.freePtr(ptr);
+    return raw;
+  }
+
+  startAllocTracking(): void {
+    this.ensureAlive();
+    this.fns.allocTrackingStart();
+  }
+
+  stopAllocTracking(): void {
+    this.fns.allocTrackingStop();
+  }
+
+  getAllocReport(): LensfunAllocReport {
+    const ptr = this.fns.allocReportJson() as number;
+    return parseJsonObjectPtr<LensfunAllocReport>(this.module, this.fns.freePtr, ptr);
   }
 
   private runFloatMap(size: number, fn: CFn, ...args: number[]): Float32Array {
@@ -398,7 +2361,17 @@ export async function createLensfun(options: LensfunInitOptions = {}): Promise<L
 
   if (options.autoInitDb ?? true) {
     const dbPath = options.dbPath ?? '/lensfun-db';
-    const rc = fns.init(dbPath) as number;
+    const filtered = options.mounts !== undefined || options.makers !== undefined;
+    for (const name of [...(options.mounts ?? []), ...(options.makers ?? [])]) {
+      if (name.includes('\n')) {
+        throw new Error('[lensfun-wasm] mount and maker names must not contain newlines');
+      }
+    }
+    const rc = (
+      filtered
+        ? fns.initFiltered(dbPath, (options.mounts ?? []).join('\n'), (options.makers ?? []).join('\n'))
+        : fns.init(dbPath)
+    ) as number;
     if (rc !== 0) {
       throw new Error(`[lensfun-wasm] lfw_init failed with code ${rc} for ${dbPath}`);
     }
@@ -0,0 +1,25 @@
+import { describe, expect, it } from 'vitest';
+import { clientFor, fakeModule, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('correctCfaVignetting', () => {
+  it('corrects CFA vignetting in place', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_cfa_vignetting: (...args) => {
+        const data = new Uint16Array(fake.heap, args[11], args[13]);
+        data.set(data.map((value) => value * 2));
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+    const data = new Uint16Array([1, 2, 3, 4, 5, 6]);
+    const input = { ...lens, aperture: 2.8, width: 2, height: 2, stride: 3, pattern: 'RGGB', patternWidth: 2, data };
+    client.correctCfaVignetting(input);
+
+    // Only the photosites up to the last row's width are handed over.
+    expect(Array.from(data)).toEqual([2, 4, 6, 8, 10, 6]);
+    expect(() => client.correctCfaVignetting({ ...input, stride: 1 })).toThrow(
+      /stride must be an integer of at least width/
+    );
+  });
+});
@@ -0,0 +1,28 @@
+import { describe, expect, it } from 'vitest';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('chooseStep', () => {
+  const input = { ...lens, kind: 'geometry' as const, width: 4000, height: 3000, tolerance: 0.1 };
+
+  it('returns the step, its error and the evaluations', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_choose_step: (...args) => {
+        floatsAt(fake, args[11], [16, 0.05, 320]);
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+
+    expect(client.chooseStep(input)).toEqual({ step: 16, error: Math.fround(0.05), evaluations: 320 });
+    expect(fake.called('lfw_choose_step')[0][10]).toBe(64);
+  });
+
+  it('validates the tolerance and reports native failures', async () => {
+    const client = await clientFor(fakeModule({ lfw_choose_step: () => -1 }));
+
+    expect(() => client.chooseStep({ ...input, tolerance: 0 })).toThrow(/tolerance must be positive/);
+    expect(() => client.chooseStep({ ...input, maxStep: 0 })).toThrow(/maxStep must be a positive integer/);
+    expect(() => client.chooseStep(input)).toThrow(/lfw_choose_step failed with code -1/);
+  });
+});
@@ -0,0 +1,104 @@
+import { describe, expect, it } from 'vitest';
+import { LF_MODIFY_DISTORTION, LF_MODIFY_TCA, LF_MODIFY_VIGNETTING } from '../src/index';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule, Native } from './fake-module';
+
+describe('correctBatch', () => {
+  function batchModule(overrides: Record<string, Native> = {}): FakeModule {
+    const items: number[] = [];
+    const fake: FakeModule = fakeModule({
+      lfw_batch_create: () => 3,
+      lfw_batch_add: () => {
+        items.push(items.length);
+        return items.length - 1;
+      },
+      lfw_batch_run: () => 1,
+      lfw_batch_item_group: () => 0,
+      lfw_batch_item_status: () => 0,
+      // The geometry map: one point per pixel of a 2x2 item at step 1.
+      lfw_batch_map: () => {
+        const ptr = fake.module._malloc(8 * 4);
+        floatsAt(fake, ptr, [0, 0, 1, 0, 0, 1, 1, 1]);
+        return ptr;
+      },
+      lfw_batch_set_pixels: () => 0,
+      ...overrides
+    });
+    return fake;
+  }
+
+  it('shares the maps of items with one parameter set and copies outputs', async () => {
+    const fake = batchModule();
+    const client = await clientFor(fake);
+    const pixels = new Float32Array(2 * 2 * 3).fill(0.5);
+    const result = client.correctBatch(
+      [
+        { ...lens, width: 2, height: 2, pixels },
+        { ...lens, width: 2, height: 2 }
+      ],
+      { threads: 2 }
+    );
+
+    expect(result.groups).toHaveLength(1);
+    expect(Array.from(result.groups[0].geometry)).toEqual([0, 0, 1, 0, 0, 1, 1, 1]);
+    expect(result.itemGroups).toEqual([0, 0]);
+    expect(result.outputs[0]).toHaveLength(12);
+    expect(result.outputs[1]).toBeUndefined();
+    expect(fake.called('lfw_batch_add')[0][10]).toBe(LF_MODIFY_DISTORTION);
+    expect(fake.called('lfw_batch_run')).toEqual([[3, 2]]);
+    expect(fake.called('lfw_batch_destroy')).toEqual([[3]]);
+  });
+
+  it('asks for TCA and vignetting only when included', async () => {
+    const fake = batchModule();
+    const client = await clientFor(fake);
+    client.correctBatch([{ ...lens, width: 2, height: 2, includeTca: true, includeVignetting: true, aperture: 4 }]);
+
+    expect(fake.called('lfw_batch_add')[0][10]).toBe(LF_MODIFY_DISTORTION | LF_MODIFY_TCA | LF_MODIFY_VIGNETTING);
+    expect(fake.called('lfw_batch_map').map((args) => args[2])).toEqual([0, 1, 2]);
+  });
+
+  it('throws when lfw_batch_set_pixels rejects an item, and frees the batch', async () => {
+    const fake = batchModule({ lfw_batch_set_pixels: () => -1 });
+    const client = await clientFor(fake);
+    const pixels = new Float32Array(2 * 2 * 3);
+
+    expect(() => client.correctBatch([{ ...lens, width: 2, height: 2, pixels }])).toThrow(
+      /lfw_batch_set_pixels failed with code -1 for item 0/
+    );
+    expect(fake.called('lfw_batch_run')).toHaveLength(0);
+    expect(fake.called('lfw_batch_destroy')).toEqual([[3]]);
+    expect(fake.freed).toHaveLength(2);
+  });
+
+  it('throws when the pixel buffers cannot be allocated', async () => {
+    const fake = batchModule();
+    const client = await clientFor(fake);
+    fake.module._malloc = () => 0;
+    const pixels = new Float32Array(2 * 2 * 3);
+
+    expect(() => client.correctBatch([{ ...lens, width: 2, height: 2, pixels }])).toThrow(/out of memory/);
+    expect(fake.called('lfw_batch_set_pixels')).toHaveLength(0);
+    expect(fake.called('lfw_batch_destroy')).toEqual([[3]]);
+  });
+
+  it('validates items before handing them to the batch', async () => {
+    const client = await clientFor(batchModule());
+
+    expect(() => client.correctBatch([{ ...lens, width: 2, height: 2, includeVignetting: true }])).toThrow(
+      /aperture is required/
+    );
+    expect(() =>
+      client.correctBatch([{ ...lens, width: 2, height: 2, pixels: new Float32Array(3) }])
+    ).toThrow(/item 0 has 3 floats, 12 needed/);
+    expect(() => client.correctBatch([], { threads: 0 })).toThrow(/threads must be a positive integer/);
+  });
+
+  it('reports a failed group build', async () => {
+    const client = await clientFor(batchModule({ lfw_batch_item_status: () => -2 }));
+
+    expect(() => client.correctBatch([{ ...lens, width: 2, height: 2 }])).toThrow(
+      /batch map build failed with code -2 for item 0/
+    );
+  });
+});
@@ -0,0 +1,26 @@
+import { describe, expect, it } from 'vitest';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('getCorrectionDescriptor and buildMapsFromDescriptor', () => {
+  it('builds maps from a correction descriptor', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_correction_descriptor: (...args) => {
+        floatsAt(fake, args[8], [1, 9, 5]);
+        return 26;
+      }
+    });
+    const client = await clientFor(fake);
+    const descriptor = client.getCorrectionDescriptor({ ...lens, width: 9, height: 5 });
+
+    expect(descriptor).toHaveLength(26);
+    expect(Array.from(descriptor.subarray(0, 3))).toEqual([1, 9, 5]);
+    const maps = client.buildMapsFromDescriptor(descriptor, { step: 4, includeVignetting: true });
+    expect([maps.gridWidth, maps.gridHeight, maps.step]).toEqual([3, 2, 4]);
+    expect(maps.geometry).toHaveLength(3 * 2 * 2);
+    expect(maps.vignetting).toHaveLength(3 * 2 * 3);
+    expect(maps.tca).toBeUndefined();
+    expect(fake.called('lfw_descriptor_build_map').map((args) => args[2])).toEqual([0, 2]);
+    expect(() => client.buildMapsFromDescriptor(new Float32Array(10))).toThrow(/must have 26 floats/);
+  });
+});
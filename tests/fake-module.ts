@@ -0,0 +1,55 @@
+import { createLensfun } from '../src/index';
+import type { LensfunClient, LensfunModule } from '../src/index';
+
+export type Native = (...args: number[]) => unknown;
+
+export interface FakeModule {
+  module: LensfunModule;
+  heap: ArrayBuffer;
+  calls: { ident: string; args: unknown[] }[];
+  freed: number[];
+  called: (ident: string) => unknown[][];
+}
+
+// A stand-in for the Emscripten module: a bump allocator over a plain heap,
+// and cwrap functions that record their calls and run `natives` (0 when the
+// entry point has none).
+export function fakeModule(natives: Record<string, Native> = {}): FakeModule {
+  const heap = new ArrayBuffer(1 << 20);
+  const calls: { ident: string; args: unknown[] }[] = [];
+  const freed: number[] = [];
+  let next = 64;
+  const module: LensfunModule = {
+    cwrap:
+      (ident: string) =>
+      (...args: unknown[]) => {
+        calls.push({ ident, args });
+        const native = natives[ident];
+        return native ? native(...(args as number[])) : 0;
+      },
+    UTF8ToString: () => '',
+    stringToUTF8: () => undefined,
+    lengthBytesUTF8: (str: string) => str.length,
+    _malloc: (size: number) => {
+      const ptr = next;
+      next += Math.ceil(size / 8) * 8;
+      return ptr;
+    },
+    _free: (ptr: number) => {
+      freed.push(ptr);
+    },
+    HEAPF32: new Float32Array(heap)
+  };
+  const called = (ident: string) => calls.filter((call) => call.ident === ident).map((call) => call.args);
+  return { module, heap, calls, freed, called };
+}
+
+export async function clientFor(fake: FakeModule): Promise<LensfunClient> {
+  return createLensfun({ moduleFactory: async () => fake.module, autoInitDb: false });
+}
+
+export function floatsAt(fake: FakeModule, ptr: number, values: ArrayLike<number>): void {
+  new Float32Array(fake.heap, ptr, values.length).set(values);
+}
+
+export const lens = { lensHandle: 7, focal: 35, crop: 1.5 };
@@ -0,0 +1,38 @@
+import { describe, expect, it } from 'vitest';
+import { clientFor, fakeModule, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('openFixedMap', () => {
+  const input = { ...lens, kind: 'geometry' as const, width: 2, height: 2 };
+
+  it('remaps RGBA8 images through the native map', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_fixed_map_create: () => 4,
+      lfw_fixed_map_fraction_bits: () => 5,
+      lfw_fixed_map_remap: (_map, src, srcLen, dst) => {
+        const source = new Uint8Array(fake.heap, src, srcLen);
+        new Uint8Array(fake.heap, dst, srcLen).set(source.map((value) => 255 - value));
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+    const map = client.openFixedMap(input);
+    const out = map.remap(new Uint8Array(16).fill(5));
+
+    expect(map.fractionBits).toBe(5);
+    expect(Array.from(out)).toEqual(new Array(16).fill(250));
+    expect(() => map.remap(new Uint8Array(8))).toThrow(/source has 8 bytes, 16 needed/);
+    map.close();
+    expect(fake.called('lfw_fixed_map_destroy')).toEqual([[4]]);
+    expect(() => map.remap(new Uint8Array(16))).toThrow(/fixed map is closed/);
+  });
+
+  it('only builds geometry and TCA maps', async () => {
+    const client = await clientFor(fakeModule({ lfw_fixed_map_create: () => -1 }));
+
+    expect(() => client.openFixedMap({ ...input, kind: 'vignetting' as unknown as 'geometry' })).toThrow(
+      /fixed maps support geometry and tca/
+    );
+    expect(() => client.openFixedMap(input)).toThrow(/lfw_fixed_map_create failed with code -1/);
+  });
+});
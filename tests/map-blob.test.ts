@@ -0,0 +1,95 @@
+import { describe, expect, it } from 'vitest';
+import type { MapBlobInput } from '../src/index';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('map blobs', () => {
+  // A blob header for a 3x2 geometry grid (2 channels) with `floats` map
+  // floats after it; offsets follow native/src/lfw_blob.h.
+  function blob(kind = 0, channels = 2, floats = 12): Uint8Array {
+    const bytes = new Uint8Array(88 + floats * 4);
+    const header = new DataView(bytes.buffer);
+    header.setInt32(24, kind, true);
+    header.setInt32(28, 5, true);
+    header.setInt32(32, 3, true);
+    header.setInt32(36, 2, true);
+    header.setInt32(40, 1, true);
+    header.setFloat32(44, 35, true);
+    header.setFloat32(48, 1.5, true);
+    header.setFloat32(52, 2.8, true);
+    header.setFloat32(56, 10, true);
+    header.setInt32(60, 3, true);
+    header.setInt32(64, 2, true);
+    header.setInt32(68, channels, true);
+    return bytes;
+  }
+
+  const input: MapBlobInput = {
+    kind: 'geometry',
+    lensHandle: 9,
+    width: 5,
+    height: 3,
+    focal: 35,
+    crop: 1.5,
+    step: 2,
+    reverse: true
+  };
+
+  it('parses the header of an imported blob', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_map_blob_import: (...args) => {
+        const [out, outLen] = args.slice(12);
+        floatsAt(fake, out, Array.from({ length: outLen }, (_, i) => i));
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+    const imported = client.importMapBlob(blob(), input);
+
+    expect(imported).not.toBeNull();
+    expect(imported?.kind).toBe('geometry');
+    expect(imported?.lensHandle).toBe(9);
+    expect([imported?.width, imported?.height, imported?.step, imported?.reverse]).toEqual([5, 3, 2, true]);
+    expect(imported?.focal).toBe(35);
+    expect(imported?.crop).toBe(1.5);
+    expect(imported?.aperture).toBeCloseTo(2.8);
+    expect(imported?.distance).toBe(10);
+    expect([imported?.gridWidth, imported?.gridHeight]).toEqual([3, 2]);
+    expect(Array.from(imported?.map ?? [])).toEqual([0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]);
+    const [call] = fake.called('lfw_map_blob_import');
+    expect([call[1], ...call.slice(2, 12), call[13]]).toEqual([136, 0, 9, 35, 1.5, 0, 1000, 5, 3, 1, 2, 12]);
+  });
+
+  it('returns null for short, unknown, oversized, rejected or mismatched blobs', async () => {
+    let rc = -4;
+    const fake: FakeModule = fakeModule({ lfw_map_blob_import: () => rc });
+    const client = await clientFor(fake);
+
+    expect(client.importMapBlob(new Uint8Array(40), input)).toBeNull();
+    expect(client.importMapBlob(blob(7, 0, 0), input)).toBeNull();
+    expect(client.importMapBlob(blob(0, 100, 0), input)).toBeNull();
+    expect(fake.called('lfw_map_blob_import')).toHaveLength(0);
+    expect(client.importMapBlob(blob(), input)).toBeNull();
+    rc = -7;
+    expect(client.importMapBlob(blob(), { ...input, focal: 50 })).toBeNull();
+    expect(fake.called('lfw_map_blob_import')).toHaveLength(2);
+  });
+
+  it('exports a blob of the size the bridge asks for', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_map_blob_size: () => 96,
+      lfw_map_blob_export: (...args) => {
+        new Uint8Array(fake.heap, args[10], 4).set([0x4c, 0x46, 0x57, 0x4d]);
+        return 96;
+      }
+    });
+    const client = await clientFor(fake);
+    const exported = client.exportMapBlob({ ...lens, kind: 'tca', width: 5, height: 3 });
+
+    expect(exported).toHaveLength(96);
+    expect(Array.from(exported.subarray(0, 4))).toEqual([0x4c, 0x46, 0x57, 0x4d]);
+    expect(() => client.exportMapBlob({ ...lens, kind: 'vignetting', width: 5, height: 3 })).toThrow(
+      /aperture is required/
+    );
+  });
+});
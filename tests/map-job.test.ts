@@ -0,0 +1,60 @@
+import { describe, expect, it } from 'vitest';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('openMapJob and buildMapProgressive', () => {
+  const input = { ...lens, kind: 'geometry' as const, width: 65, height: 33, step: 1 };
+
+  it('rejects coarse steps that are not larger multiples of step', async () => {
+    const client = await clientFor(fakeModule({ lfw_map_job_create: () => 1 }));
+
+    expect(() => client.openMapJob({ ...input, step: 2, coarseStep: 3 })).toThrow(/coarseStep must be 0 or a multiple/);
+    expect(() => client.openMapJob({ ...input, step: 2, coarseStep: 2 })).toThrow(/coarseStep must be 0 or a multiple/);
+    expect(() => client.openMapJob({ ...input, kind: 'vignetting' })).toThrow(/aperture is required/);
+  });
+
+  it('hands out the coarse map, then the refined one', async () => {
+    let stage = 0;
+    const fake: FakeModule = fakeModule({
+      lfw_map_job_create: () => 5,
+      lfw_map_job_run: () => stage++,
+      lfw_map_job_coarse: () => fake.module._malloc(4 * 4),
+      lfw_map_job_result: () => {
+        const ptr = fake.module._malloc(65 * 33 * 2 * 4);
+        floatsAt(fake, ptr, [1, 2]);
+        return ptr;
+      }
+    });
+    const client = await clientFor(fake);
+    const coarse: number[][] = [];
+    const map = await client.buildMapProgressive(
+      { ...input, coarseStep: 32 },
+      { onCoarse: (_, gridWidth, gridHeight) => coarse.push([gridWidth, gridHeight]) }
+    );
+
+    expect(coarse).toEqual([[3, 2]]);
+    expect(map).toHaveLength(65 * 33 * 2);
+    expect(Array.from(map.subarray(0, 2))).toEqual([1, 2]);
+    expect(fake.called('lfw_map_job_destroy')).toEqual([[5]]);
+  });
+
+  it('cancels the job when the signal aborts', async () => {
+    let cancelled = false;
+    const fake: FakeModule = fakeModule({
+      lfw_map_job_create: () => 5,
+      lfw_map_job_run: () => (cancelled ? -7 : 0),
+      lfw_map_job_cancel: () => {
+        cancelled = true;
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+    const controller = new AbortController();
+    const build = client.buildMapProgressive(input, { signal: controller.signal });
+    controller.abort();
+
+    await expect(build).rejects.toThrow(/map job was cancelled/);
+    expect(fake.called('lfw_map_job_cancel')).toEqual([[5]]);
+    expect(fake.called('lfw_map_job_destroy')).toEqual([[5]]);
+  });
+});
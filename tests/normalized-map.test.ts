@@ -0,0 +1,17 @@
+import { describe, expect, it } from 'vitest';
+import { clientFor, fakeModule, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('openNormalizedMap', () => {
+  it('samples normalized maps at any size', async () => {
+    const fake: FakeModule = fakeModule({ lfw_normalized_map_create: () => 6, lfw_normalized_map_sample: () => 0 });
+    const client = await clientFor(fake);
+
+    expect(() => client.openNormalizedMap({ ...lens, kind: 'geometry', aspect: 0 })).toThrow(/aspect must be positive/);
+    const map = client.openNormalizedMap({ ...lens, kind: 'tca', aspect: 1.5 });
+    expect(map.sample(9, 5, 4)).toHaveLength(3 * 2 * 6);
+    expect(fake.called('lfw_normalized_map_sample')[0].slice(0, 4)).toEqual([6, 9, 5, 4]);
+    map.close();
+    expect(() => map.sample(9, 5)).toThrow(/normalized map is closed/);
+  });
+});
@@ -0,0 +1,33 @@
+import { describe, expect, it } from 'vitest';
+import { LF_MODIFY_DISTORTION, LF_MODIFY_VIGNETTING } from '../src/index';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('renderThumbnail', () => {
+  it('renders thumbnails with the chosen filter', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_thumbnail: (...args) => {
+        floatsAt(fake, args[14], [0.25, 0.5, 0.75]);
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+    const input = {
+      ...lens,
+      width: 4,
+      height: 2,
+      mods: LF_MODIFY_DISTORTION,
+      source: new Float32Array(4 * 2 * 3),
+      outWidth: 1,
+      outHeight: 1
+    };
+
+    expect(Array.from(client.renderThumbnail({ ...input, filter: 'lanczos3' }))).toEqual([0.25, 0.5, 0.75]);
+    expect(fake.called('lfw_thumbnail')[0][9]).toBe(1);
+    expect(() => client.renderThumbnail({ ...input, source: new Float32Array(4) })).toThrow(/source has 4 floats/);
+    expect(() => client.renderThumbnail({ ...input, mods: LF_MODIFY_VIGNETTING })).toThrow(/aperture is required/);
+    expect(() => client.renderThumbnail({ ...input, channels: 2 as unknown as 3 })).toThrow(
+      /channels must be 1, 3 or 4/
+    );
+  });
+});
@@ -0,0 +1,20 @@
+import { describe, expect, it } from 'vitest';
+import { LF_MODIFY_DISTORTION, LF_MODIFY_TCA } from '../src/index';
+import { clientFor, fakeModule, floatsAt, lens } from './fake-module';
+import type { FakeModule } from './fake-module';
+
+describe('getValidCrop', () => {
+  it('reads the valid crop rectangle', async () => {
+    const fake: FakeModule = fakeModule({
+      lfw_valid_crop: (...args) => {
+        floatsAt(fake, args[6], [1.25, 4, 3, 92, 61]);
+        return 0;
+      }
+    });
+    const client = await clientFor(fake);
+    const crop = client.getValidCrop({ ...lens, width: 100, height: 67, includeTca: true });
+
+    expect(crop).toEqual({ scale: 1.25, x: 4, y: 3, width: 92, height: 61 });
+    expect(fake.called('lfw_valid_crop')[0][5]).toBe(LF_MODIFY_DISTORTION | LF_MODIFY_TCA);
+  });
+});